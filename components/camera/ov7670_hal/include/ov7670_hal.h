@@ -93,6 +93,16 @@ extern const uint32_t ov7670_polling_rate_ticks;
  */
 extern const uint8_t ov7670_i2c_address;
 
+/**
+ * @brief I2C bus the SCCB port of the OV7670 is wired to.
+ */
+extern const uint8_t ov7670_i2c_bus;
+
+/**
+ * @brief Clock frequency of that bus in Hertz.
+ */
+extern const uint32_t ov7670_i2c_freq_hz;
+
 /* Enums **********************************************************************/
 
 /**
@@ -10,9 +10,11 @@
 /* Constants ******************************************************************/
 
 const char    *ov7670_tag                = "OV7670";
-const uint8_t  ov7670_scl_io             = GPIO_NUM_22;
-const uint8_t  ov7670_sda_io             = GPIO_NUM_21;
+const uint8_t  ov7670_scl_io             = i2c_bus_scl_io(i2c_bus_ov7670);
+const uint8_t  ov7670_sda_io             = i2c_bus_sda_io(i2c_bus_ov7670);
 const uint8_t  ov7670_i2c_address        = 0x42;
+const uint8_t  ov7670_i2c_bus            = i2c_bus_ov7670;
+const uint32_t ov7670_i2c_freq_hz        = i2c_bus_freq_hz(i2c_bus_ov7670);
 const uint32_t ov7670_polling_rate_ticks = pdMS_TO_TICKS(5000);
 
 /* Private Functions (Static) *************************************************/
@@ -29,7 +31,7 @@ static esp_err_t priv_ov7670_configure_defaults(void)
   esp_err_t ret;
 
   /* Reset all registers */
-  ret = priv_i2c_write_reg_byte(0x12, 0x80, I2C_NUM_0, ov7670_i2c_address, ov7670_tag);
+  ret = priv_i2c_write_reg_byte(0x12, 0x80, ov7670_i2c_bus, ov7670_i2c_address, ov7670_tag);
   if (ret != ESP_OK) {
     return ret;
   }
@@ -37,7 +39,7 @@ static esp_err_t priv_ov7670_configure_defaults(void)
   vTaskDelay(pdMS_TO_TICKS(100)); /* Allow reset to complete */
 
   /* Example: Set QVGA resolution and RGB output */
-  ret = priv_i2c_write_reg_byte(0x12, 0x14, I2C_NUM_0, ov7670_i2c_address, ov7670_tag);
+  ret = priv_i2c_write_reg_byte(0x12, 0x14, ov7670_i2c_bus, ov7670_i2c_address, ov7670_tag);
   if (ret != ESP_OK) {
     return ret;
   }
@@ -53,7 +55,8 @@ esp_err_t ov7670_init(ov7670_data_t *sensor_data)
   ESP_LOGI(ov7670_tag, "Initializing OV7670 Camera");
 
   /* Initialize I2C interface */
-  esp_err_t ret = priv_i2c_init(ov7670_scl_io, ov7670_sda_io, 100000, I2C_NUM_0, ov7670_tag);
+  esp_err_t ret = priv_i2c_init(ov7670_scl_io, ov7670_sda_io, ov7670_i2c_freq_hz,
+                                ov7670_i2c_bus, ov7670_tag);
   if (ret != ESP_OK) {
     ESP_LOGE(ov7670_tag, "I2C initialization failed");
     sensor_data->state = k_ov7670_config_error;
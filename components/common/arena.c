@@ -0,0 +1,160 @@
+/* components/common/arena.c */
+
+#include "common/arena.h"
+#include <stdlib.h>
+#include "cJSON.h"
+
+/* Macros *********************************************************************/
+
+#define arena_alignment (8)
+
+/* Globals (Static) ***********************************************************/
+
+static arena_t     *s_arenas = NULL; /* Every arena begun at least once */
+static portMUX_TYPE s_lock   = portMUX_INITIALIZER_UNLOCKED;
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Returns the arena whose buffer holds `ptr`, or NULL.
+ */
+static arena_t *priv_arena_owning(const void *ptr)
+{
+  const uint8_t *address = ptr;
+
+  for (arena_t *arena = s_arenas; arena != NULL; arena = arena->next) {
+    if (address >= arena->base && address < arena->base + arena->capacity) {
+      return arena;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief cJSON allocator: the calling task's arena, else the heap.
+ */
+static void *priv_arena_json_malloc(size_t size)
+{
+  arena_t *arena = arena_current();
+  if (arena != NULL) {
+    void *ptr = arena_alloc(arena, size);
+    if (ptr != NULL) {
+      return ptr;
+    }
+  }
+  return malloc(size);
+}
+
+/**
+ * @brief cJSON deallocator: arena memory is released by `arena_end`.
+ */
+static void priv_arena_json_free(void *ptr)
+{
+  if (ptr != NULL && priv_arena_owning(ptr) == NULL) {
+    free(ptr);
+  }
+}
+
+/* Public Functions ***********************************************************/
+
+void arena_begin(arena_t *arena)
+{
+  portENTER_CRITICAL(&s_lock);
+  if (!arena->registered) {
+    arena->next       = s_arenas;
+    s_arenas          = arena;
+    arena->registered = true;
+  }
+  portEXIT_CRITICAL(&s_lock);
+
+  arena->used  = 0;
+  arena->owner = xTaskGetCurrentTaskHandle();
+}
+
+void arena_end(arena_t *arena)
+{
+  arena->owner = NULL;
+  arena->used  = 0;
+  arena->cycles++;
+}
+
+void *arena_alloc(arena_t *arena, size_t size)
+{
+  size_t offset = (arena->used + arena_alignment - 1) & ~(size_t)(arena_alignment - 1);
+
+  if (size > arena->capacity || offset > arena->capacity - size) {
+    arena->overflows++;
+    return NULL;
+  }
+
+  arena->used = offset + size;
+  if (arena->used > arena->high_water) {
+    arena->high_water = arena->used;
+  }
+  return arena->base + offset;
+}
+
+arena_t *arena_current(void)
+{
+  TaskHandle_t task = xTaskGetCurrentTaskHandle();
+
+  for (arena_t *arena = s_arenas; arena != NULL; arena = arena->next) {
+    if (arena->owner != NULL && arena->owner == task) {
+      return arena;
+    }
+  }
+  return NULL;
+}
+
+void arena_json_hooks_install(void)
+{
+  cJSON_Hooks hooks = {
+    .malloc_fn = priv_arena_json_malloc,
+    .free_fn   = priv_arena_json_free,
+  };
+  cJSON_InitHooks(&hooks);
+}
+
+size_t arena_get_stats(arena_stats_t *stats, size_t max_count)
+{
+  size_t count = 0;
+
+  /* Arenas are only ever prepended, so the list can be walked unlocked */
+  for (arena_t *arena = s_arenas; arena != NULL && count < max_count; arena = arena->next) {
+    stats[count++] = (arena_stats_t){
+      .name       = arena->name,
+      .capacity   = arena->capacity,
+      .high_water = arena->high_water,
+      .cycles     = arena->cycles,
+      .overflows  = arena->overflows,
+    };
+  }
+  return count;
+}
+
+char *arena_stats_to_json(void)
+{
+  arena_stats_t stats[arena_max_count];
+  size_t        count = arena_get_stats(stats, arena_max_count);
+
+  cJSON *json = cJSON_CreateObject();
+  if (json == NULL) {
+    return NULL;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    cJSON *arena = cJSON_AddObjectToObject(json, stats[i].name);
+    if (arena == NULL) {
+      cJSON_Delete(json);
+      return NULL;
+    }
+    cJSON_AddNumberToObject(arena, "capacity", stats[i].capacity);
+    cJSON_AddNumberToObject(arena, "high_water", stats[i].high_water);
+    cJSON_AddNumberToObject(arena, "cycles", stats[i].cycles);
+    cJSON_AddNumberToObject(arena, "overflows", stats[i].overflows);
+  }
+
+  char *json_string = cJSON_PrintUnformatted(json);
+  cJSON_Delete(json);
+  return json_string;
+}
@@ -0,0 +1,393 @@
+/* components/common/deferred_log.c */
+
+#include "common/deferred_log.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "common/rtos_alloc.h"
+
+/* Macros *********************************************************************/
+
+#ifdef CONFIG_TOPOROBO_DEFERRED_LOG_RING_RECORDS
+#define deferred_log_ring_records (CONFIG_TOPOROBO_DEFERRED_LOG_RING_RECORDS)
+#else
+#define deferred_log_ring_records (64)
+#endif
+
+#define deferred_log_payload_bytes    (deferred_log_record_bytes - sizeof(deferred_log_header_t))
+#define deferred_log_task_stack_bytes (4096) /* fopen on FATFS runs on this task */
+#define deferred_log_line_bytes       (256) /* Longest formatted message */
+
+/* Structs ********************************************************************/
+
+/**
+ * @brief One fixed-size slot of a ring.
+ */
+typedef struct {
+  deferred_log_header_t header;
+  uint8_t               payload[deferred_log_payload_bytes];
+} deferred_log_record_t;
+
+/**
+ * @brief Ring of records written by the tasks and ISRs of one core.
+ *
+ * `head` and `tail` are free running; the lock is only contended by the
+ * drain task, as writers only ever touch the ring of their own core.
+ */
+typedef struct {
+  portMUX_TYPE          lock;
+  uint32_t              head;    /**< Next slot to write */
+  uint32_t              tail;    /**< Next slot to drain */
+  uint32_t              dropped; /**< Records lost because the ring was full */
+  deferred_log_record_t records[deferred_log_ring_records];
+} deferred_log_ring_t;
+
+/* Globals (Constants) ********************************************************/
+
+static const char    *deferred_log_tag          = "DEFERRED_LOG";
+static const uint32_t deferred_log_drain_ticks  = pdMS_TO_TICKS(50);
+static const uint32_t deferred_log_open_retry_us = 1000000; /* The card mounts after the task starts */
+static const uint8_t  deferred_log_file_magic[] = { 'D', 'L', 'O', 'G', 1, 0, 0, 0 };
+
+/* Globals (Static) ***********************************************************/
+
+static deferred_log_ring_t s_rings[portNUM_PROCESSORS] = {
+  [0 ... portNUM_PROCESSORS - 1] = { .lock = portMUX_INITIALIZER_UNLOCKED },
+};
+static uint32_t            s_reported_dropped[portNUM_PROCESSORS];
+static FILE               *s_binary_file = NULL; /* NULL when formatting to the console */
+
+rtos_task_storage_define(s_deferred_log_task_storage, deferred_log_task_stack_bytes);
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Size of an encoded argument of the given type, strings excluded.
+ */
+static size_t priv_deferred_log_arg_size(uint8_t type)
+{
+  switch (type) {
+    case k_deferred_log_arg_i32:
+    case k_deferred_log_arg_u32:
+    case k_deferred_log_arg_f32:
+      return 4;
+    case k_deferred_log_arg_i64:
+    case k_deferred_log_arg_u64:
+    case k_deferred_log_arg_f64:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief Encode the captured arguments into a record payload.
+ *
+ * @return Number of payload bytes used. Encoding stops at the first argument
+ *         that does not fit; strings are truncated to the space left.
+ */
+static uint8_t priv_deferred_log_encode(const deferred_log_desc_t *desc,
+                                        const deferred_log_arg_t *args, uint8_t *payload)
+{
+  size_t used = 0;
+
+  for (uint8_t i = 0; i < desc->arg_count; i++) {
+    uint8_t type = desc->arg_types[i];
+
+    if (type == k_deferred_log_arg_str) {
+      const char *str = args[i].str ? args[i].str : "(null)";
+      if (used + 1 > deferred_log_payload_bytes) {
+        break;
+      }
+      size_t len      = strnlen(str, deferred_log_payload_bytes - used - 1);
+      payload[used++] = (uint8_t)len;
+      memcpy(&payload[used], str, len);
+      used += len;
+      continue;
+    }
+
+    size_t size = priv_deferred_log_arg_size(type);
+    if (used + size > deferred_log_payload_bytes) {
+      break;
+    }
+    if (type == k_deferred_log_arg_f32) {
+      float value = (float)args[i].f64;
+      memcpy(&payload[used], &value, size);
+    } else if (type == k_deferred_log_arg_f64) {
+      memcpy(&payload[used], &args[i].f64, size);
+    } else {
+      /* Little-endian target: the low bytes of the i64 are the 32-bit value */
+      memcpy(&payload[used], &args[i].i64, size);
+    }
+    used += size;
+  }
+
+  return (uint8_t)used;
+}
+
+/**
+ * @brief Format one conversion specification with the next payload argument.
+ *
+ * @return Number of characters produced (as snprintf), or -1 if the argument
+ *         is missing from the payload (truncated record).
+ */
+static int priv_deferred_log_format_arg(char *out, size_t out_len, const char *spec,
+                                        uint8_t type, const uint8_t *payload,
+                                        size_t payload_len, size_t *offset)
+{
+  if (type == k_deferred_log_arg_str) {
+    if (*offset + 1 > payload_len) {
+      return -1;
+    }
+    char   str[deferred_log_payload_bytes];
+    size_t len = payload[(*offset)++];
+    if (*offset + len > payload_len) {
+      return -1;
+    }
+    memcpy(str, &payload[*offset], len);
+    str[len]  = '\0';
+    *offset  += len;
+    return snprintf(out, out_len, spec, str);
+  }
+
+  size_t size = priv_deferred_log_arg_size(type);
+  if (size == 0 || *offset + size > payload_len) {
+    return -1;
+  }
+
+  const uint8_t *src = &payload[*offset];
+  *offset           += size;
+
+  switch (type) {
+    case k_deferred_log_arg_i32: { int32_t  v; memcpy(&v, src, size); return snprintf(out, out_len, spec, v); }
+    case k_deferred_log_arg_u32: { uint32_t v; memcpy(&v, src, size); return snprintf(out, out_len, spec, v); }
+    case k_deferred_log_arg_i64: { int64_t  v; memcpy(&v, src, size); return snprintf(out, out_len, spec, v); }
+    case k_deferred_log_arg_u64: { uint64_t v; memcpy(&v, src, size); return snprintf(out, out_len, spec, v); }
+    case k_deferred_log_arg_f32: { float    v; memcpy(&v, src, size); return snprintf(out, out_len, spec, (double)v); }
+    case k_deferred_log_arg_f64: { double   v; memcpy(&v, src, size); return snprintf(out, out_len, spec, v); }
+    default:                     return -1;
+  }
+}
+
+/**
+ * @brief Render a record into a text line, the way ESP_LOG would have.
+ *
+ * The format string is copied piecewise; each conversion specification is
+ * handed to snprintf together with the matching decoded argument, so the
+ * output is identical to a direct printf of the original call.
+ */
+static void priv_deferred_log_format(const deferred_log_record_t *record, char *out,
+                                     size_t out_len)
+{
+  const deferred_log_desc_t *desc   = (const deferred_log_desc_t *)(uintptr_t)record->header.desc_addr;
+  const char                *p      = desc->format;
+  size_t                     used   = 0;
+  size_t                     offset = 0;
+  uint8_t                    arg    = 0;
+
+  while (*p != '\0' && used < out_len - 1) {
+    if (*p != '%') {
+      out[used++] = *p++;
+      continue;
+    }
+    if (p[1] == '%') {
+      out[used++]  = '%';
+      p           += 2;
+      continue;
+    }
+
+    /* Copy flags, width, precision and length up to the conversion character */
+    char   spec[16];
+    size_t spec_len = 0;
+    do {
+      spec[spec_len++] = *p++;
+    } while (*p != '\0' && strchr("diouxXeEfFgGaAcs", *p) == NULL &&
+             spec_len < sizeof(spec) - 2);
+    if (*p != '\0') {
+      spec[spec_len++] = *p++;
+    }
+    spec[spec_len] = '\0';
+
+    int written = -1;
+    if (arg < desc->arg_count) {
+      written = priv_deferred_log_format_arg(&out[used], out_len - used, spec,
+                                             desc->arg_types[arg++], record->payload,
+                                             record->header.payload_len, &offset);
+    }
+    if (written < 0) {
+      written = snprintf(&out[used], out_len - used, "<?>"); /* Truncated record */
+    }
+    used += ((size_t)written < out_len - used) ? (size_t)written : out_len - used - 1;
+  }
+
+  out[used] = '\0';
+}
+
+/**
+ * @brief Pop the oldest record of a ring.
+ *
+ * @return true if a record was copied to `record`.
+ */
+static bool priv_deferred_log_pop(deferred_log_ring_t *ring, deferred_log_record_t *record)
+{
+  bool popped = false;
+
+  portENTER_CRITICAL(&ring->lock);
+  if (ring->tail != ring->head) {
+    deferred_log_record_t *slot = &ring->records[ring->tail % deferred_log_ring_records];
+    memcpy(&record->header, &slot->header, sizeof(record->header));
+    memcpy(record->payload, slot->payload, slot->header.payload_len);
+    ring->tail++;
+    popped = true;
+  }
+  portEXIT_CRITICAL(&ring->lock);
+
+  return popped;
+}
+
+/**
+ * @brief Output one drained record to the binary file or the console.
+ */
+static void priv_deferred_log_output(const deferred_log_record_t *record)
+{
+  if (s_binary_file != NULL) {
+    fwrite(record, 1, sizeof(record->header) + record->header.payload_len, s_binary_file);
+    return;
+  }
+
+  static const char          letters[] = { 'N', 'E', 'W', 'I', 'D', 'V' };
+  static char                line[deferred_log_line_bytes];
+  const deferred_log_desc_t *desc      = (const deferred_log_desc_t *)(uintptr_t)record->header.desc_addr;
+  const char                *tag       = (const char *)(uintptr_t)record->header.tag_addr;
+  char                       letter    = (desc->level < sizeof(letters)) ? letters[desc->level] : '?';
+
+  priv_deferred_log_format(record, line, sizeof(line));
+  esp_log_write((esp_log_level_t)desc->level, tag, "%c (%lu) %s: %s\n", letter,
+                (unsigned long)(record->header.timestamp_us / 1000), tag, line);
+}
+
+#if CONFIG_TOPOROBO_DEFERRED_LOG_BINARY
+/**
+ * @brief Open the binary file if it is not open and the last attempt is old
+ *        enough, so records go to it once the card is mounted.
+ *
+ * The first failure is reported once, later attempts stay silent until one
+ * succeeds; the records in between are formatted to the console.
+ */
+static void priv_deferred_log_open_binary(void)
+{
+  static int64_t last_attempt_us = 0;
+  static bool    warned          = false;
+  int64_t        now_us          = esp_timer_get_time();
+
+  if (s_binary_file != NULL ||
+      (last_attempt_us != 0 && now_us - last_attempt_us < deferred_log_open_retry_us)) {
+    return;
+  }
+  last_attempt_us = now_us;
+
+  s_binary_file = fopen(CONFIG_TOPOROBO_DEFERRED_LOG_BINARY_PATH, "ab");
+  if (s_binary_file == NULL) {
+    if (!warned) {
+      ESP_LOGW(deferred_log_tag, "Cannot open %s yet, formatting to the console until it opens",
+               CONFIG_TOPOROBO_DEFERRED_LOG_BINARY_PATH);
+      warned = true;
+    }
+    return;
+  }
+
+  fwrite(deferred_log_file_magic, 1, sizeof(deferred_log_file_magic), s_binary_file);
+  ESP_LOGI(deferred_log_tag, "Writing records to %s", CONFIG_TOPOROBO_DEFERRED_LOG_BINARY_PATH);
+  warned = false;
+}
+#endif
+
+/**
+ * @brief Drain task, empties every ring periodically.
+ */
+static void priv_deferred_log_task(void *param)
+{
+  static deferred_log_record_t record; /* Kept off the task stack */
+
+  while (1) {
+#if CONFIG_TOPOROBO_DEFERRED_LOG_BINARY
+    priv_deferred_log_open_binary();
+#endif
+
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+      deferred_log_ring_t *ring = &s_rings[core];
+
+      while (priv_deferred_log_pop(ring, &record)) {
+        priv_deferred_log_output(&record);
+      }
+
+      uint32_t dropped = ring->dropped;
+      if (dropped != s_reported_dropped[core]) {
+        ESP_LOGW(deferred_log_tag, "Core %d dropped %lu records (ring full)", core,
+                 (unsigned long)(dropped - s_reported_dropped[core]));
+        s_reported_dropped[core] = dropped;
+      }
+    }
+
+#if CONFIG_TOPOROBO_DEFERRED_LOG_BINARY
+    /* A failed flush means the card went away, reopen once it is back */
+    if (s_binary_file != NULL && fflush(s_binary_file) != 0) {
+      ESP_LOGW(deferred_log_tag, "Writing %s failed, formatting to the console",
+               CONFIG_TOPOROBO_DEFERRED_LOG_BINARY_PATH);
+      fclose(s_binary_file);
+      s_binary_file = NULL;
+    }
+#endif
+    vTaskDelay(deferred_log_drain_ticks);
+  }
+}
+
+/* Public Functions ***********************************************************/
+
+esp_err_t deferred_log_init(void)
+{
+  esp_err_t ret = priv_rtos_task_create(priv_deferred_log_task, "DeferredLog",
+                                        deferred_log_task_stack_bytes, NULL, 1, NULL, 0,
+                                        rtos_storage_ref(s_deferred_log_task_storage));
+  if (ret != ESP_OK) {
+    ESP_LOGE(deferred_log_tag, "Failed to create drain task");
+    return ESP_FAIL;
+  }
+
+  ESP_LOGI(deferred_log_tag, "Deferred logging started (%d records per core)",
+           deferred_log_ring_records);
+  return ESP_OK;
+}
+
+void deferred_log_write(const deferred_log_desc_t *desc, const char *tag,
+                        const deferred_log_arg_t *args)
+{
+  deferred_log_record_t record;
+
+  record.header.desc_addr    = (uint32_t)(uintptr_t)desc;
+  record.header.tag_addr     = (uint32_t)(uintptr_t)tag;
+  record.header.timestamp_us = (uint64_t)esp_timer_get_time();
+  record.header.payload_len  = priv_deferred_log_encode(desc, args, record.payload);
+  record.header.reserved     = 0;
+
+  /* Only the owning core writes a ring, the lock keeps out the drain task and
+   * preempting writers on the same core */
+  int                  core = xPortGetCoreID();
+  deferred_log_ring_t *ring = &s_rings[core];
+
+  record.header.core_id = (uint8_t)core;
+
+  portENTER_CRITICAL_SAFE(&ring->lock);
+  if (ring->head - ring->tail >= deferred_log_ring_records) {
+    ring->dropped++;
+  } else {
+    deferred_log_record_t *slot = &ring->records[ring->head % deferred_log_ring_records];
+    memcpy(&slot->header, &record.header, sizeof(record.header));
+    memcpy(slot->payload, record.payload, record.header.payload_len);
+    ring->head++;
+  }
+  portEXIT_CRITICAL_SAFE(&ring->lock);
+}
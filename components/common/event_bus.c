@@ -0,0 +1,369 @@
+/* components/common/event_bus.c */
+
+#include "common/event_bus.h"
+#include <string.h>
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+#include "common/rtos_alloc.h"
+#include "common/trace.h"
+#include "common/metrics.h"
+
+/* Macros *********************************************************************/
+
+#define event_bus_dispatch_task_stack_bytes (3072)
+
+/* Structs ********************************************************************/
+
+/**
+ * @brief One registered subscriber.
+ */
+typedef struct {
+  uint32_t      topic_mask; /**< Topics delivered to `queue` */
+  QueueHandle_t queue;      /**< Subscriber owned queue of `event_bus_msg_t *` */
+} event_bus_subscriber_t;
+
+/**
+ * @brief One sample waiting in an ingress ring.
+ */
+typedef struct {
+  int64_t  timestamp_us;                                             /**< Time of publishing */
+  uint16_t size;                                                     /**< Valid bytes in `payload` */
+  uint8_t  payload[event_bus_payload_bytes] __attribute__((aligned(8)));
+} event_bus_ingress_t;
+
+/* Globals (Constants) ********************************************************/
+
+static const char *event_bus_tag = "EVENT_BUS";
+
+static const char *event_bus_topic_names[k_event_bus_topic_count] = {
+  "bh1750", "qmc5883l", "mpu6050", "dht22", "gy_neo6mv2", "ccs811", "mq135",
+  "snapshot", "summary",
+};
+
+/* Globals (Static) ***********************************************************/
+
+static event_bus_msg_t        s_slots[event_bus_pool_slots];
+static event_bus_msg_t       *s_free_list = NULL;
+static event_bus_subscriber_t s_subscribers[event_bus_max_subscribers];
+static uint8_t                s_subscriber_count = 0;
+static event_bus_stats_t      s_stats;
+static portMUX_TYPE           s_lock = portMUX_INITIALIZER_UNLOCKED;
+static spsc_ring_t            s_ingress[k_event_bus_topic_count];
+static event_bus_ingress_t    s_ingress_items[k_event_bus_topic_count][event_bus_ingress_slots];
+static TaskHandle_t           s_dispatch_task = NULL;
+static metrics_counter_t      s_dropped_no_slot_metric;
+static metrics_counter_t      s_dropped_queue_full_metric;
+static metrics_counter_t      s_dropped_ingress_metric;
+
+rtos_task_storage_define(s_dispatch_task_storage, event_bus_dispatch_task_stack_bytes);
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Drops `count` references to `msg`, returning it to the pool at zero.
+ */
+static void priv_event_bus_unref(event_bus_msg_t *msg, uint8_t count)
+{
+  portENTER_CRITICAL(&s_lock);
+  msg->refs -= count;
+  if (msg->refs == 0) {
+    msg->next   = s_free_list;
+    s_free_list = msg;
+    s_stats.slots_in_use--;
+  }
+  portEXIT_CRITICAL(&s_lock);
+}
+
+/**
+ * @brief Hands a filled slot to every subscriber of its topic, keeping the
+ *        slot's timestamp.
+ */
+static esp_err_t priv_event_bus_deliver(event_bus_msg_t *msg)
+{
+  QueueHandle_t queues[event_bus_max_subscribers];
+  uint8_t       count = 0;
+
+  /* Take one reference per subscriber up front so an early release by a fast
+   * subscriber cannot free the slot while it is still being delivered */
+  portENTER_CRITICAL(&s_lock);
+  for (uint8_t i = 0; i < s_subscriber_count; i++) {
+    if (s_subscribers[i].topic_mask & event_bus_topic_bit(msg->topic)) {
+      queues[count++] = s_subscribers[i].queue;
+    }
+  }
+  msg->refs += count;
+  s_stats.published++;
+  portEXIT_CRITICAL(&s_lock);
+
+  uint8_t missed = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    if (xQueueSend(queues[i], &msg, 0) != pdTRUE) {
+      missed++;
+    }
+  }
+
+  portENTER_CRITICAL(&s_lock);
+  s_stats.delivered          += count - missed;
+  s_stats.dropped_queue_full += missed;
+  portEXIT_CRITICAL(&s_lock);
+
+  if (missed > 0) {
+    metrics_counter_add(&s_dropped_queue_full_metric, missed);
+  }
+  priv_event_bus_unref(msg, missed + 1); /* + the publisher's reference */
+  return (count > 0 && missed == count) ? ESP_FAIL : ESP_OK;
+}
+
+/**
+ * @brief Drains the ingress rings into pool slots and delivers them (core 0).
+ *
+ * Woken by a notification per published sample; each wake drains every ring,
+ * so samples pushed while it runs are picked up without another wake.
+ */
+static void priv_event_bus_dispatch_task(void *param)
+{
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    bool drained = false;
+    while (!drained) {
+      drained = true;
+      for (uint8_t topic = 0; topic < k_event_bus_topic_count; topic++) {
+        event_bus_ingress_t *item = spsc_ring_peek(&s_ingress[topic]);
+        if (item == NULL) {
+          continue;
+        }
+        drained = false;
+
+        event_bus_msg_t *msg = event_bus_acquire((event_bus_topic_t)topic);
+        if (msg != NULL) {
+          memcpy(msg->payload, item->payload, item->size);
+          msg->size         = item->size;
+          msg->timestamp_us = item->timestamp_us;
+        }
+        spsc_ring_consume(&s_ingress[topic]);
+
+        if (msg != NULL) {
+          priv_event_bus_deliver(msg);
+        }
+      }
+    }
+  }
+}
+
+/* Public Functions ***********************************************************/
+
+esp_err_t event_bus_init(void)
+{
+  portENTER_CRITICAL(&s_lock);
+  s_free_list = NULL;
+  for (int i = event_bus_pool_slots - 1; i >= 0; i--) {
+    s_slots[i].next = s_free_list;
+    s_free_list     = &s_slots[i];
+  }
+  memset(&s_stats, 0, sizeof(s_stats));
+  portEXIT_CRITICAL(&s_lock);
+
+  for (uint8_t topic = 0; topic < k_event_bus_topic_count; topic++) {
+    spsc_ring_init(&s_ingress[topic], s_ingress_items[topic], event_bus_ingress_slots,
+                   sizeof(event_bus_ingress_t));
+  }
+
+  metrics_counter_register(&s_dropped_no_slot_metric, "toporobo_event_bus_dropped_total",
+                           "Samples dropped by the event bus, by reason.", "reason=\"no_slot\"");
+  metrics_counter_register(&s_dropped_queue_full_metric, "toporobo_event_bus_dropped_total",
+                           "Samples dropped by the event bus, by reason.",
+                           "reason=\"queue_full\"");
+  metrics_counter_register(&s_dropped_ingress_metric, "toporobo_event_bus_dropped_total",
+                           "Samples dropped by the event bus, by reason.",
+                           "reason=\"ingress_full\"");
+
+  /* Above the sinks so slots are handed out before subscribers drain them */
+  if (priv_rtos_task_create(priv_event_bus_dispatch_task, "EventBusDispatch",
+                            event_bus_dispatch_task_stack_bytes, NULL, 5, &s_dispatch_task, 0,
+                            rtos_storage_ref(s_dispatch_task_storage)) != ESP_OK) {
+    ESP_LOGE(event_bus_tag, "Failed to create dispatch task");
+    return ESP_FAIL;
+  }
+
+  ESP_LOGI(event_bus_tag, "%d slots of %d bytes, %d ingress slots per topic",
+           event_bus_pool_slots, event_bus_payload_bytes, event_bus_ingress_slots);
+  return ESP_OK;
+}
+
+esp_err_t event_bus_subscribe(uint32_t topic_mask, QueueHandle_t queue)
+{
+  if (queue == NULL || (topic_mask & event_bus_all_topics) == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  esp_err_t ret = ESP_OK;
+  portENTER_CRITICAL(&s_lock);
+  if (s_subscriber_count < event_bus_max_subscribers) {
+    s_subscribers[s_subscriber_count].topic_mask = topic_mask;
+    s_subscribers[s_subscriber_count].queue      = queue;
+    s_subscriber_count++;
+  } else {
+    ret = ESP_ERR_NO_MEM;
+  }
+  portEXIT_CRITICAL(&s_lock);
+
+  if (ret != ESP_OK) {
+    ESP_LOGE(event_bus_tag, "No room for another subscriber");
+  }
+  return ret;
+}
+
+event_bus_msg_t *event_bus_acquire(event_bus_topic_t topic)
+{
+  portENTER_CRITICAL(&s_lock);
+  event_bus_msg_t *msg = s_free_list;
+  if (msg != NULL) {
+    s_free_list = msg->next;
+    if (++s_stats.slots_in_use > s_stats.slots_high_water) {
+      s_stats.slots_high_water = s_stats.slots_in_use;
+    }
+  } else {
+    s_stats.dropped_no_slot++;
+  }
+  portEXIT_CRITICAL(&s_lock);
+
+  if (msg == NULL) {
+    trace_instant(k_trace_category_queue, "bus no slot", topic);
+    metrics_counter_inc(&s_dropped_no_slot_metric);
+  }
+
+  if (msg != NULL) {
+    msg->next  = NULL;
+    msg->topic = topic;
+    msg->size  = 0;
+    msg->refs  = 1; /* Held by the publisher until published */
+  }
+  return msg;
+}
+
+esp_err_t event_bus_publish(event_bus_msg_t *msg)
+{
+  msg->timestamp_us = esp_timer_get_time();
+  return priv_event_bus_deliver(msg);
+}
+
+esp_err_t IRAM_ATTR event_bus_publish_copy(event_bus_topic_t topic, const void *data, size_t size)
+{
+  if (topic >= k_event_bus_topic_count) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (size > event_bus_payload_bytes) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  event_bus_ingress_t *item = spsc_ring_reserve(&s_ingress[topic]);
+  if (item == NULL) {
+    trace_instant(k_trace_category_queue, "ingress full", topic);
+    metrics_counter_inc(&s_dropped_ingress_metric);
+    return ESP_ERR_NO_MEM;
+  }
+  item->timestamp_us = esp_timer_get_time();
+  item->size         = size;
+  memcpy(item->payload, data, size);
+  spsc_ring_commit(&s_ingress[topic]);
+
+  if (xPortInIsrContext()) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(s_dispatch_task, &woken);
+    portYIELD_FROM_ISR(woken);
+  } else {
+    xTaskNotifyGive(s_dispatch_task);
+  }
+  return ESP_OK;
+}
+
+void event_bus_release(event_bus_msg_t *msg)
+{
+  if (msg != NULL) {
+    priv_event_bus_unref(msg, 1);
+  }
+}
+
+const char *event_bus_topic_name(event_bus_topic_t topic)
+{
+  return (topic < k_event_bus_topic_count) ? event_bus_topic_names[topic] : "unknown";
+}
+
+void event_bus_get_stats(event_bus_stats_t *stats)
+{
+  portENTER_CRITICAL(&s_lock);
+  *stats = s_stats;
+  portEXIT_CRITICAL(&s_lock);
+
+  stats->dropped_ingress = 0;
+  for (uint8_t topic = 0; topic < k_event_bus_topic_count; topic++) {
+    stats->dropped_ingress += __atomic_load_n(&s_ingress[topic].overflows, __ATOMIC_RELAXED);
+  }
+}
+
+esp_err_t event_bus_get_ingress_stats(event_bus_topic_t topic, spsc_ring_stats_t *stats)
+{
+  if (topic >= k_event_bus_topic_count || stats == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  spsc_ring_get_stats(&s_ingress[topic], stats);
+  return ESP_OK;
+}
+
+char *event_bus_stats_to_json(void)
+{
+  event_bus_stats_t stats;
+  event_bus_get_stats(&stats);
+
+  cJSON *json = cJSON_CreateObject();
+  if (!json) {
+    ESP_LOGE(event_bus_tag, "Failed to create JSON object.");
+    return NULL;
+  }
+
+  cJSON_AddNumberToObject(json, "published", stats.published);
+  cJSON_AddNumberToObject(json, "delivered", stats.delivered);
+  cJSON_AddNumberToObject(json, "dropped_no_slot", stats.dropped_no_slot);
+  cJSON_AddNumberToObject(json, "dropped_ingress", stats.dropped_ingress);
+  cJSON_AddNumberToObject(json, "dropped_queue_full", stats.dropped_queue_full);
+  cJSON_AddNumberToObject(json, "slots_in_use", stats.slots_in_use);
+  cJSON_AddNumberToObject(json, "slots_high_water", stats.slots_high_water);
+
+  cJSON *ingress = cJSON_AddObjectToObject(json, "ingress");
+  if (!ingress) {
+    ESP_LOGE(event_bus_tag, "Failed to add ingress to JSON.");
+    cJSON_Delete(json);
+    return NULL;
+  }
+
+  for (uint8_t topic = 0; topic < k_event_bus_topic_count; topic++) {
+    spsc_ring_stats_t ring;
+    spsc_ring_get_stats(&s_ingress[topic], &ring);
+
+    cJSON *entry = cJSON_AddObjectToObject(ingress, event_bus_topic_names[topic]);
+    if (!entry) {
+      ESP_LOGE(event_bus_tag, "Failed to add ring %s to JSON.", event_bus_topic_names[topic]);
+      cJSON_Delete(json);
+      return NULL;
+    }
+    cJSON_AddNumberToObject(entry, "capacity", ring.capacity);
+    cJSON_AddNumberToObject(entry, "occupancy", ring.occupancy);
+    cJSON_AddNumberToObject(entry, "high_water", ring.high_water);
+    cJSON_AddNumberToObject(entry, "pushed", ring.pushed);
+    cJSON_AddNumberToObject(entry, "overflows", ring.overflows);
+  }
+
+  char *json_string = cJSON_PrintUnformatted(json);
+  if (!json_string) {
+    ESP_LOGE(event_bus_tag, "Failed to serialize JSON object.");
+    cJSON_Delete(json);
+    return NULL;
+  }
+
+  cJSON_Delete(json);
+  return json_string;
+}
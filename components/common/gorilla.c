@@ -0,0 +1,245 @@
+/* components/common/gorilla.c */
+
+#include "common/gorilla.h"
+#include <string.h>
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Writes the low `bits` bits of `value`, most significant first.
+ */
+static void priv_gorilla_put_bits(gorilla_encoder_t *encoder, uint64_t value, uint8_t bits)
+{
+  if (encoder->overflow || encoder->bit_count + bits > encoder->capacity * 8) {
+    encoder->overflow = true;
+    return;
+  }
+
+  while (bits > 0) {
+    size_t  byte  = encoder->bit_count / 8;
+    uint8_t free  = 8 - (encoder->bit_count % 8);
+    uint8_t chunk = (bits < free) ? bits : free;
+    uint8_t part  = (value >> (bits - chunk)) & ((1U << chunk) - 1);
+
+    if (free == 8) {
+      encoder->buffer[byte] = 0;
+    }
+    encoder->buffer[byte] |= part << (free - chunk);
+    encoder->bit_count    += chunk;
+    bits                  -= chunk;
+  }
+}
+
+/**
+ * @brief Reads `bits` bits, most significant first.
+ *
+ * @return false if the stream ends first.
+ */
+static bool priv_gorilla_get_bits(gorilla_decoder_t *decoder, uint8_t bits, uint64_t *value)
+{
+  if (decoder->bit_pos + bits > decoder->length * 8) {
+    return false;
+  }
+
+  *value = 0;
+  while (bits > 0) {
+    uint8_t byte  = decoder->data[decoder->bit_pos / 8];
+    uint8_t left  = 8 - (decoder->bit_pos % 8);
+    uint8_t chunk = (bits < left) ? bits : left;
+
+    *value            = (*value << chunk) | ((byte >> (left - chunk)) & ((1U << chunk) - 1));
+    decoder->bit_pos += chunk;
+    bits             -= chunk;
+  }
+  return true;
+}
+
+/**
+ * @brief Sign-extends the low `bits` bits of `value`.
+ */
+static int64_t priv_gorilla_signed(uint64_t value, uint8_t bits)
+{
+  if (bits < 64 && (value & ((uint64_t)1 << (bits - 1)))) {
+    value |= ~(uint64_t)0 << bits;
+  }
+  return (int64_t)value;
+}
+
+/**
+ * @brief Tells whether `value` fits a `bits`-bit two's complement field.
+ */
+static bool priv_gorilla_fits(int64_t value, uint8_t bits)
+{
+  int64_t limit = (int64_t)1 << (bits - 1);
+  return value >= -limit && value < limit;
+}
+
+/* Public Functions ***********************************************************/
+
+void gorilla_encoder_init(gorilla_encoder_t *encoder, uint8_t *buffer, size_t capacity)
+{
+  memset(encoder, 0, sizeof(*encoder));
+  encoder->buffer   = buffer;
+  encoder->capacity = capacity;
+  encoder->leading  = UINT8_MAX; /* No window yet, the first XOR opens one */
+}
+
+bool gorilla_put_int(gorilla_encoder_t *encoder, int64_t value)
+{
+  if (encoder->count == 0) {
+    priv_gorilla_put_bits(encoder, (uint64_t)value, 64);
+  } else {
+    int64_t delta = value - encoder->previous;
+    int64_t dod   = delta - encoder->previous_delta;
+
+    if (dod == 0) {
+      priv_gorilla_put_bits(encoder, 0x0, 1);
+    } else if (priv_gorilla_fits(dod, 7)) {
+      priv_gorilla_put_bits(encoder, 0x2, 2);
+      priv_gorilla_put_bits(encoder, (uint64_t)dod, 7);
+    } else if (priv_gorilla_fits(dod, 9)) {
+      priv_gorilla_put_bits(encoder, 0x6, 3);
+      priv_gorilla_put_bits(encoder, (uint64_t)dod, 9);
+    } else if (priv_gorilla_fits(dod, 12)) {
+      priv_gorilla_put_bits(encoder, 0xE, 4);
+      priv_gorilla_put_bits(encoder, (uint64_t)dod, 12);
+    } else if (priv_gorilla_fits(dod, 20)) {
+      priv_gorilla_put_bits(encoder, 0x1E, 5);
+      priv_gorilla_put_bits(encoder, (uint64_t)dod, 20);
+    } else {
+      priv_gorilla_put_bits(encoder, 0x1F, 5);
+      priv_gorilla_put_bits(encoder, (uint64_t)dod, 64);
+    }
+    encoder->previous_delta = delta;
+  }
+
+  encoder->previous = value;
+  encoder->count++;
+  return !encoder->overflow;
+}
+
+bool gorilla_put_float(gorilla_encoder_t *encoder, float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  if (encoder->count == 0) {
+    priv_gorilla_put_bits(encoder, bits, 32);
+  } else {
+    uint32_t xor = bits ^ encoder->previous_bits;
+
+    if (xor == 0) {
+      priv_gorilla_put_bits(encoder, 0x0, 1);
+    } else {
+      uint8_t leading  = __builtin_clz(xor);
+      uint8_t trailing = __builtin_ctz(xor);
+
+      if (leading >= encoder->leading && trailing >= encoder->trailing) {
+        priv_gorilla_put_bits(encoder, 0x2, 2);
+        priv_gorilla_put_bits(encoder, xor >> encoder->trailing,
+                              32 - encoder->leading - encoder->trailing);
+      } else {
+        uint8_t meaningful = 32 - leading - trailing;
+        priv_gorilla_put_bits(encoder, 0x3, 2);
+        priv_gorilla_put_bits(encoder, leading, 5);
+        priv_gorilla_put_bits(encoder, meaningful - 1, 5);
+        priv_gorilla_put_bits(encoder, xor >> trailing, meaningful);
+        encoder->leading  = leading;
+        encoder->trailing = trailing;
+      }
+    }
+  }
+
+  encoder->previous_bits = bits;
+  encoder->count++;
+  return !encoder->overflow;
+}
+
+size_t gorilla_encoder_size(const gorilla_encoder_t *encoder)
+{
+  return encoder->overflow ? 0 : (encoder->bit_count + 7) / 8;
+}
+
+void gorilla_decoder_init(gorilla_decoder_t *decoder, const uint8_t *data, size_t length)
+{
+  memset(decoder, 0, sizeof(*decoder));
+  decoder->data   = data;
+  decoder->length = length;
+}
+
+bool gorilla_get_int(gorilla_decoder_t *decoder, int64_t *value)
+{
+  static const uint8_t payload_bits[] = { 7, 9, 12, 20, 64 }; /* Per count of leading '1's */
+  uint64_t             bits;
+
+  if (decoder->count == 0) {
+    if (!priv_gorilla_get_bits(decoder, 64, &bits)) {
+      return false;
+    }
+    decoder->previous = (int64_t)bits;
+  } else {
+    uint8_t ones = 0;
+    while (ones < sizeof(payload_bits)) {
+      if (!priv_gorilla_get_bits(decoder, 1, &bits)) {
+        return false;
+      }
+      if (bits == 0) {
+        break;
+      }
+      ones++;
+    }
+
+    int64_t dod = 0;
+    if (ones > 0) {
+      if (!priv_gorilla_get_bits(decoder, payload_bits[ones - 1], &bits)) {
+        return false;
+      }
+      dod = priv_gorilla_signed(bits, payload_bits[ones - 1]);
+    }
+    decoder->previous_delta += dod;
+    decoder->previous       += decoder->previous_delta;
+  }
+
+  decoder->count++;
+  *value = decoder->previous;
+  return true;
+}
+
+bool gorilla_get_float(gorilla_decoder_t *decoder, float *value)
+{
+  uint64_t bits;
+
+  if (decoder->count == 0) {
+    if (!priv_gorilla_get_bits(decoder, 32, &bits)) {
+      return false;
+    }
+    decoder->previous_bits = (uint32_t)bits;
+  } else {
+    if (!priv_gorilla_get_bits(decoder, 1, &bits)) {
+      return false;
+    }
+    if (bits != 0) {
+      if (!priv_gorilla_get_bits(decoder, 1, &bits)) {
+        return false;
+      }
+      if (bits != 0) {
+        uint64_t leading, meaningful;
+        if (!priv_gorilla_get_bits(decoder, 5, &leading) ||
+            !priv_gorilla_get_bits(decoder, 5, &meaningful)) {
+          return false;
+        }
+        decoder->leading  = (uint8_t)leading;
+        decoder->trailing = 32 - (uint8_t)leading - ((uint8_t)meaningful + 1);
+      }
+      if (decoder->leading + decoder->trailing >= 32 ||
+          !priv_gorilla_get_bits(decoder, 32 - decoder->leading - decoder->trailing, &bits)) {
+        return false;
+      }
+      decoder->previous_bits ^= (uint32_t)bits << decoder->trailing;
+    }
+  }
+
+  decoder->count++;
+  memcpy(value, &decoder->previous_bits, sizeof(*value));
+  return true;
+}
@@ -1,15 +1,101 @@
 /* components/common/i2c.c */
 
 #include "common/i2c.h"
+#include <stdbool.h>
 #include "driver/i2c.h"
 #include "esp_log.h"
+#include "sdkconfig.h"
+#include "common/rtos_alloc.h"
+#include "common/trace.h"
+#include "common/metrics.h"
 
 /* Constants ******************************************************************/
 
 const uint32_t i2c_timeout_ticks = pdMS_TO_TICKS(1000);
 
+/* Macros *********************************************************************/
+
+/**
+ * Command links for a transaction of up to `num_ops` operations. With
+ * `CONFIG_TOPOROBO_STATIC_ALLOCATION` the link is built in a buffer on the
+ * caller's stack instead of being allocated from the heap per transaction.
+ */
+#if CONFIG_TOPOROBO_STATIC_ALLOCATION
+#define i2c_link_storage(name, num_ops) uint8_t name[I2C_LINK_RECOMMENDED_SIZE(num_ops)]
+#define i2c_link_create(name)           i2c_cmd_link_create_static(name, sizeof(name))
+#define i2c_link_delete(cmd)            i2c_cmd_link_delete_static(cmd)
+#else
+#define i2c_link_storage(name, num_ops) (void)0
+#define i2c_link_create(name)           i2c_cmd_link_create()
+#define i2c_link_delete(cmd)            i2c_cmd_link_delete(cmd)
+#endif
+
+/**
+ * True for GPIO 6-11, which the ESP32 uses for its SPI flash.
+ */
+#define i2c_flash_io(io) ((io) >= 6 && (io) <= 11)
+
+/* Globals (Static) ***********************************************************/
+
+static SemaphoreHandle_t s_i2c_bus_locks[I2C_NUM_MAX];   /* Recursive, created by priv_i2c_init */
+static i2c_config_t      s_i2c_bus_configs[I2C_NUM_MAX]; /* Settings the driver was installed with */
+static bool              s_i2c_bus_installed[I2C_NUM_MAX];
+
+_Static_assert(I2C_NUM_MAX <= 2, "one lock storage per I2C port");
+_Static_assert(!i2c_flash_io(CONFIG_TOPOROBO_I2C_0_SDA_IO) && !i2c_flash_io(CONFIG_TOPOROBO_I2C_0_SCL_IO) &&
+               !i2c_flash_io(CONFIG_TOPOROBO_I2C_1_SDA_IO) && !i2c_flash_io(CONFIG_TOPOROBO_I2C_1_SCL_IO),
+               "GPIO 6-11 are the SPI flash pins");
+_Static_assert(CONFIG_TOPOROBO_I2C_0_SDA_IO != CONFIG_TOPOROBO_I2C_0_SCL_IO &&
+               CONFIG_TOPOROBO_I2C_1_SDA_IO != CONFIG_TOPOROBO_I2C_1_SCL_IO &&
+               CONFIG_TOPOROBO_I2C_0_SDA_IO != CONFIG_TOPOROBO_I2C_1_SDA_IO &&
+               CONFIG_TOPOROBO_I2C_0_SDA_IO != CONFIG_TOPOROBO_I2C_1_SCL_IO &&
+               CONFIG_TOPOROBO_I2C_0_SCL_IO != CONFIG_TOPOROBO_I2C_1_SDA_IO &&
+               CONFIG_TOPOROBO_I2C_0_SCL_IO != CONFIG_TOPOROBO_I2C_1_SCL_IO,
+               "the I2C buses need four distinct pins");
+rtos_semaphore_storage_define(s_i2c_bus_lock_storage_0);
+rtos_semaphore_storage_define(s_i2c_bus_lock_storage_1);
+
+static metrics_counter_t s_i2c_transaction_metrics[I2C_NUM_MAX];
+static metrics_counter_t s_i2c_error_metrics[I2C_NUM_MAX];
+static const char       *s_i2c_bus_labels[I2C_NUM_MAX] = {
+  "bus=\"0\"",
+#if I2C_NUM_MAX > 1
+  "bus=\"1\"",
+#endif
+};
+
 /* Private Functions **********************************************************/
 
+/**
+ * @brief Runs a command link with the bus lock held, so transactions from
+ *        other tasks cannot interleave with a caller's `priv_i2c_bus_lock` sweep.
+ *
+ * The transaction, waiting for the lock included, is traced as `name`, and
+ * counted in the bus's transaction and error metrics.
+ */
+static esp_err_t priv_i2c_execute(uint8_t i2c_bus, uint8_t i2c_address, const char *name,
+                                  i2c_cmd_handle_t cmd)
+{
+  uint16_t device = ((uint16_t)i2c_bus << 8) | i2c_address;
+
+  esp_err_t ret    = ESP_ERR_TIMEOUT;
+
+  trace_begin(k_trace_category_i2c, name, device);
+  if (priv_i2c_bus_lock(i2c_bus, i2c_timeout_ticks) == ESP_OK) {
+    ret = i2c_master_cmd_begin(i2c_bus, cmd, i2c_timeout_ticks);
+    priv_i2c_bus_unlock(i2c_bus);
+  }
+  trace_end(k_trace_category_i2c, name, device);
+
+  if (i2c_bus < I2C_NUM_MAX) {
+    metrics_counter_inc(&s_i2c_transaction_metrics[i2c_bus]);
+    if (ret != ESP_OK) {
+      metrics_counter_inc(&s_i2c_error_metrics[i2c_bus]);
+    }
+  }
+  return ret;
+}
+
 esp_err_t priv_i2c_init(uint8_t scl_io, uint8_t sda_io, uint32_t freq_hz,
                         uint8_t i2c_bus, const char *tag)
 {
@@ -23,22 +109,91 @@ esp_err_t priv_i2c_init(uint8_t scl_io, uint8_t sda_io, uint32_t freq_hz,
     .master.clk_speed = freq_hz,            /* Set the I2C master clock frequency */
   };
 
+  if (i2c_bus >= I2C_NUM_MAX) {
+    ESP_LOGE(tag, "Invalid I2C bus %u", i2c_bus);
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (!GPIO_IS_VALID_OUTPUT_GPIO(scl_io) || !GPIO_IS_VALID_OUTPUT_GPIO(sda_io) ||
+      i2c_flash_io(scl_io) || i2c_flash_io(sda_io) || scl_io == sda_io) {
+    ESP_LOGE(tag, "Invalid I2C pins SCL %u, SDA %u for bus %u", scl_io, sda_io, i2c_bus);
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  /* The pins of one bus cannot be shared with another; the matrix would route both */
+  for (uint8_t other = 0; other < I2C_NUM_MAX; other++) {
+    const i2c_config_t *used = &s_i2c_bus_configs[other];
+    if (other != i2c_bus && s_i2c_bus_installed[other] &&
+        (used->scl_io_num == scl_io || used->scl_io_num == sda_io ||
+         used->sda_io_num == scl_io || used->sda_io_num == sda_io)) {
+      ESP_LOGE(tag, "I2C pins SCL %u, SDA %u of bus %u are used by bus %u", scl_io, sda_io,
+               i2c_bus, other);
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+
+  /* Create the bus lock on first use, before any transaction can need it */
+  if (s_i2c_bus_locks[i2c_bus] == NULL) {
+    s_i2c_bus_locks[i2c_bus] = priv_rtos_recursive_mutex_create(
+      (i2c_bus == 0) ? rtos_storage_ref(s_i2c_bus_lock_storage_0)
+                     : rtos_storage_ref(s_i2c_bus_lock_storage_1));
+    if (s_i2c_bus_locks[i2c_bus] == NULL) {
+      ESP_LOGE(tag, "Failed to create lock for I2C bus %u", i2c_bus);
+      return ESP_ERR_NO_MEM;
+    }
+    metrics_counter_register(&s_i2c_transaction_metrics[i2c_bus],
+                             "toporobo_i2c_transactions_total",
+                             "I2C transactions run, per bus.", s_i2c_bus_labels[i2c_bus]);
+    metrics_counter_register(&s_i2c_error_metrics[i2c_bus], "toporobo_i2c_errors_total",
+                             "I2C transactions that failed, per bus.",
+                             s_i2c_bus_labels[i2c_bus]);
+  }
+
+  /* Every device on the bus calls this; only the first installs the driver */
+  esp_err_t err = priv_i2c_bus_lock(i2c_bus, i2c_timeout_ticks);
+  if (err != ESP_OK) {
+    ESP_LOGE(tag, "I2C bus %u busy during init", i2c_bus);
+    return err;
+  }
+
+  const i2c_config_t *installed = &s_i2c_bus_configs[i2c_bus];
+  if (s_i2c_bus_installed[i2c_bus]) {
+    if (installed->scl_io_num != conf.scl_io_num || installed->sda_io_num != conf.sda_io_num ||
+        installed->master.clk_speed != conf.master.clk_speed) {
+      ESP_LOGE(tag, "I2C bus %u already runs on SCL %d, SDA %d at %lu Hz", i2c_bus,
+               installed->scl_io_num, installed->sda_io_num,
+               (unsigned long)installed->master.clk_speed);
+      err = ESP_ERR_INVALID_STATE;
+    }
+    priv_i2c_bus_unlock(i2c_bus);
+    return err;
+  }
+
   /* Configure the I2C bus with the settings specified in 'conf' */
-  esp_err_t err = i2c_param_config(i2c_bus, &conf);
+  err = i2c_param_config(i2c_bus, &conf);
   if (err != ESP_OK) {
     ESP_LOGE(tag, "I2C param config failed: %s", esp_err_to_name(err));
+    priv_i2c_bus_unlock(i2c_bus);
     return err;  /* Return the error code if configuration fails */
   }
 
   /* Install the I2C driver for the master mode; no RX/TX buffers are required */
-  return i2c_driver_install(i2c_bus, conf.mode, 0, 0, 0);
+  err = i2c_driver_install(i2c_bus, conf.mode, 0, 0, 0);
+  if (err == ESP_OK) {
+    s_i2c_bus_configs[i2c_bus]   = conf;
+    s_i2c_bus_installed[i2c_bus] = true;
+    ESP_LOGI(tag, "I2C bus %u on SCL %u, SDA %u at %lu Hz", i2c_bus, scl_io, sda_io,
+             (unsigned long)freq_hz);
+  }
+  priv_i2c_bus_unlock(i2c_bus);
+  return err;
 }
 
 esp_err_t priv_i2c_write_byte(uint8_t data, uint8_t i2c_bus,
                               uint8_t i2c_address, const char *tag)
 {
   /* Create an I2C command link handle */
-  i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+  i2c_link_storage(link_buffer, 4);
+  i2c_cmd_handle_t cmd = i2c_link_create(link_buffer);
 
   /* Start I2C communication */
   i2c_master_start(cmd);
@@ -53,10 +208,10 @@ esp_err_t priv_i2c_write_byte(uint8_t data, uint8_t i2c_bus,
   i2c_master_stop(cmd);
 
   /* Execute the I2C command */
-  esp_err_t ret = i2c_master_cmd_begin(i2c_bus, cmd, i2c_timeout_ticks);
+  esp_err_t ret = priv_i2c_execute(i2c_bus, i2c_address, "i2c write", cmd);
 
   /* Delete the command link after execution */
-  i2c_cmd_link_delete(cmd);
+  i2c_link_delete(cmd);
 
   /* Check for errors in the I2C command */
   if (ret != ESP_OK) {
@@ -70,7 +225,8 @@ esp_err_t priv_i2c_read_bytes(uint8_t *data, size_t len, uint8_t i2c_bus,
                               uint8_t i2c_address, const char *tag)
 {
   /* Create an I2C command link handle */
-  i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+  i2c_link_storage(link_buffer, 5);
+  i2c_cmd_handle_t cmd = i2c_link_create(link_buffer);
 
   /* Start I2C communication */
   i2c_master_start(cmd);
@@ -91,10 +247,10 @@ esp_err_t priv_i2c_read_bytes(uint8_t *data, size_t len, uint8_t i2c_bus,
   i2c_master_stop(cmd);
 
   /* Execute the I2C command */
-  esp_err_t ret = i2c_master_cmd_begin(i2c_bus, cmd, i2c_timeout_ticks);
+  esp_err_t ret = priv_i2c_execute(i2c_bus, i2c_address, "i2c read", cmd);
 
   /* Delete the command link after execution */
-  i2c_cmd_link_delete(cmd);
+  i2c_link_delete(cmd);
 
   /* Check for errors in the I2C command */
   if (ret != ESP_OK) {
@@ -108,7 +264,8 @@ esp_err_t priv_i2c_write_reg_byte(uint8_t reg_addr, uint8_t data,
                                   uint8_t i2c_bus, uint8_t i2c_address,
                                   const char *tag)
 {
-  i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+  i2c_link_storage(link_buffer, 5);
+  i2c_cmd_handle_t cmd = i2c_link_create(link_buffer);
 
   i2c_master_start(cmd);
   i2c_master_write_byte(cmd, (i2c_address << 1) | I2C_MASTER_WRITE, true);
@@ -116,9 +273,9 @@ esp_err_t priv_i2c_write_reg_byte(uint8_t reg_addr, uint8_t data,
   i2c_master_write_byte(cmd, data, true);
   i2c_master_stop(cmd);
 
-  esp_err_t ret = i2c_master_cmd_begin(i2c_bus, cmd, i2c_timeout_ticks);
+  esp_err_t ret = priv_i2c_execute(i2c_bus, i2c_address, "i2c write reg", cmd);
 
-  i2c_cmd_link_delete(cmd);
+  i2c_link_delete(cmd);
 
   if (ret != ESP_OK) {
     ESP_LOGE(tag, "I2C write to register 0x%02X failed: %s", reg_addr, esp_err_to_name(ret));
@@ -131,7 +288,8 @@ esp_err_t priv_i2c_read_reg_bytes(uint8_t reg_addr, uint8_t *data, size_t len,
                                   uint8_t i2c_bus, uint8_t i2c_address,
                                   const char *tag)
 {
-  i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+  i2c_link_storage(link_buffer, 8);
+  i2c_cmd_handle_t cmd = i2c_link_create(link_buffer);
 
   /* Start I2C communication */
   i2c_master_start(cmd);
@@ -161,10 +319,10 @@ esp_err_t priv_i2c_read_reg_bytes(uint8_t reg_addr, uint8_t *data, size_t len,
   i2c_master_stop(cmd);
 
   /* Execute the I2C command */
-  esp_err_t ret = i2c_master_cmd_begin(i2c_bus, cmd, i2c_timeout_ticks);
+  esp_err_t ret = priv_i2c_execute(i2c_bus, i2c_address, "i2c read reg", cmd);
 
   /* Delete the command link after execution */
-  i2c_cmd_link_delete(cmd);
+  i2c_link_delete(cmd);
 
   /* Check for errors in the I2C command */
   if (ret != ESP_OK) {
@@ -174,3 +332,22 @@ esp_err_t priv_i2c_read_reg_bytes(uint8_t reg_addr, uint8_t *data, size_t len,
   return ret; /* Return the error status or ESP_OK */
 }
 
+
+esp_err_t priv_i2c_bus_lock(uint8_t i2c_bus, TickType_t timeout_ticks)
+{
+  if (i2c_bus >= I2C_NUM_MAX) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (s_i2c_bus_locks[i2c_bus] == NULL) {
+    return ESP_OK; /* Bus not initialized yet, nothing to serialize against */
+  }
+  return (xSemaphoreTakeRecursive(s_i2c_bus_locks[i2c_bus], timeout_ticks) == pdTRUE) ?
+         ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+void priv_i2c_bus_unlock(uint8_t i2c_bus)
+{
+  if (i2c_bus < I2C_NUM_MAX && s_i2c_bus_locks[i2c_bus] != NULL) {
+    xSemaphoreGiveRecursive(s_i2c_bus_locks[i2c_bus]);
+  }
+}
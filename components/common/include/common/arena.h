@@ -0,0 +1,129 @@
+/* components/common/include/common/arena.h */
+
+/* Scratch arenas for per-cycle temporary data.
+ *
+ * An arena is a fixed static buffer handed out by bumping an offset, and
+ * emptied in one step at the end of a processing cycle. Each task that
+ * needs scratch memory owns one, defined next to the task:
+ *
+ * @code
+ * arena_define(s_example_arena, "example", 1024);
+ * ...
+ * arena_begin(&s_example_arena);
+ * char *line = arena_alloc(&s_example_arena, 128);
+ * ...
+ * arena_end(&s_example_arena);
+ * @endcode
+ *
+ * Between `arena_begin` and `arena_end` the arena is bound to the calling
+ * task, and cJSON allocations made by that task are served from it (see
+ * `arena_json_hooks_install`), so a JSON tree and its printed string cost no
+ * heap allocation; they must not be used after `arena_end`. Allocations that
+ * do not fit fail (`arena_alloc`) or fall back to the heap (cJSON), and are
+ * counted as overflows. The high-water mark of every arena is kept, to size
+ * them (`GET /api/arenas`).
+ */
+
+#ifndef TOPOROBO_ARENA_H
+#define TOPOROBO_ARENA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+
+/* Macros *********************************************************************/
+
+/**
+ * @brief Most arenas listed by `arena_get_stats`.
+ */
+#define arena_max_count (8)
+
+/**
+ * @brief Defines a file-scope arena `var` of `bytes` bytes, shown as `label`.
+ */
+#define arena_define(var, label, bytes)                                        \
+  static uint8_t var##_buffer[(bytes)] __attribute__((aligned(8)));            \
+  static arena_t var = { .name = (label), .base = var##_buffer, .capacity = (bytes) }
+
+/* Structs ********************************************************************/
+
+/**
+ * @struct arena_t
+ * @brief One arena; declare it with `arena_define` rather than by hand.
+ */
+typedef struct arena {
+  struct arena *next;       /**< Next arena seen by `arena_begin` */
+  const char   *name;       /**< Name in the stats, e.g. "gps" */
+  uint8_t      *base;       /**< Static buffer */
+  size_t        capacity;   /**< Size of `base` in bytes */
+  size_t        used;       /**< Bytes handed out since `arena_begin` */
+  size_t        high_water; /**< Largest `used` so far */
+  uint32_t      cycles;     /**< Completed `arena_begin`/`arena_end` pairs */
+  uint32_t      overflows;  /**< Allocations that did not fit */
+  TaskHandle_t  owner;      /**< Task between `arena_begin` and `arena_end`, else NULL */
+  bool          registered; /**< Linked into the stats list */
+} arena_t;
+
+/**
+ * @struct arena_stats_t
+ * @brief Counters of one arena, see `arena_t`.
+ */
+typedef struct {
+  const char *name;
+  size_t      capacity;
+  size_t      high_water;
+  uint32_t    cycles;
+  uint32_t    overflows;
+} arena_stats_t;
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Starts a cycle: empties `arena` and binds it to the calling task.
+ */
+void arena_begin(arena_t *arena);
+
+/**
+ * @brief Ends the cycle: unbinds `arena` and releases everything allocated
+ *        from it.
+ */
+void arena_end(arena_t *arena);
+
+/**
+ * @brief Allocates `size` bytes, 8-byte aligned, from `arena`.
+ *
+ * @return The memory, or NULL if it does not fit (counted as an overflow).
+ */
+void *arena_alloc(arena_t *arena, size_t size);
+
+/**
+ * @brief Returns the arena bound to the calling task, or NULL.
+ */
+arena_t *arena_current(void);
+
+/**
+ * @brief Routes cJSON allocations through the arena of the calling task.
+ *
+ * Tasks without a bound arena keep using the heap, and freeing memory of an
+ * arena is a no-op. Call once at startup, before any JSON is built.
+ */
+void arena_json_hooks_install(void);
+
+/**
+ * @brief Copies the counters of up to `max_count` arenas into `stats`.
+ *
+ * @return Number of arenas copied.
+ */
+size_t arena_get_stats(arena_stats_t *stats, size_t max_count);
+
+/**
+ * @brief Serializes the arena counters to a JSON string.
+ *
+ * @return Heap string the caller frees with `cJSON_free`, or NULL on failure.
+ */
+char *arena_stats_to_json(void);
+
+#endif /* TOPOROBO_ARENA_H */
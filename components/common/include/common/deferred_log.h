@@ -0,0 +1,241 @@
+/* components/common/include/common/deferred_log.h */
+
+#ifndef TOPOROBO_DEFERRED_LOG_H
+#define TOPOROBO_DEFERRED_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+/* Macros *********************************************************************/
+
+/**
+ * @brief Most verbose level compiled into the firmware.
+ *
+ * `DEFERRED_LOG*` calls above this level expand to nothing, so neither the
+ * call site descriptor nor the argument capture reaches the binary.
+ */
+#ifdef CONFIG_TOPOROBO_DEFERRED_LOG_LEVEL
+#define deferred_log_compile_level (CONFIG_TOPOROBO_DEFERRED_LOG_LEVEL)
+#else
+#define deferred_log_compile_level (ESP_LOG_INFO)
+#endif
+
+/**
+ * @brief Maximum number of arguments a single deferred log call can take.
+ */
+#define deferred_log_max_args (8)
+
+/**
+ * @brief Size of one record in the per-core ring, header included.
+ *
+ * Arguments that do not fit (long strings, mostly) are truncated.
+ */
+#define deferred_log_record_bytes (64)
+
+/* Enums **********************************************************************/
+
+/**
+ * @enum deferred_log_arg_type_t
+ * @brief Encoding of one captured argument in a record's payload.
+ *
+ * The type is derived from the argument's C type at compile time. Integers
+ * and floats are stored little-endian in their native width, strings as a
+ * length byte followed by the characters (no terminator).
+ */
+typedef enum : uint8_t {
+  k_deferred_log_arg_none = 0, /**< Unused argument slot */
+  k_deferred_log_arg_i32  = 1, /**< Signed integer up to 32 bits */
+  k_deferred_log_arg_u32  = 2, /**< Unsigned integer up to 32 bits */
+  k_deferred_log_arg_i64  = 3, /**< Signed 64-bit integer */
+  k_deferred_log_arg_u64  = 4, /**< Unsigned 64-bit integer */
+  k_deferred_log_arg_f32  = 5, /**< float */
+  k_deferred_log_arg_f64  = 6, /**< double */
+  k_deferred_log_arg_str  = 7, /**< NUL-terminated string, copied into the record */
+} deferred_log_arg_type_t;
+
+/* Structs ********************************************************************/
+
+/**
+ * @struct deferred_log_desc_t
+ * @brief Compile-time description of one `DEFERRED_LOG*` call site.
+ *
+ * One descriptor is emitted into flash per call site. Records only carry its
+ * address, which the on-device formatter dereferences and the host decoder
+ * (`tools/dlog_decode.py`) resolves through the ELF file.
+ */
+typedef struct {
+  const char *format;                           /**< printf-style format string */
+  uint8_t     level;                            /**< esp_log_level_t of the call */
+  uint8_t     arg_count;                        /**< Number of captured arguments */
+  uint8_t     arg_types[deferred_log_max_args]; /**< deferred_log_arg_type_t per argument */
+} deferred_log_desc_t;
+
+/**
+ * @struct deferred_log_header_t
+ * @brief Header of one record, as stored in the rings and in binary dumps.
+ *
+ * A binary dump starts with the four bytes "DLOG" and a version byte followed
+ * by three reserved bytes, then holds back to back records of
+ * `sizeof(deferred_log_header_t) + payload_len` bytes. The file header is
+ * repeated every time the firmware reopens the dump (i.e. on every boot).
+ */
+typedef struct __attribute__((packed)) {
+  uint32_t desc_addr;    /**< Address of the call site's `deferred_log_desc_t` */
+  uint32_t tag_addr;     /**< Address of the tag string */
+  uint64_t timestamp_us; /**< esp_timer time of the call */
+  uint8_t  payload_len;  /**< Bytes of argument payload following the header */
+  uint8_t  core_id;      /**< Core the call was made on */
+  uint16_t reserved;     /**< Padding, always zero */
+} deferred_log_header_t;
+
+/**
+ * @brief Argument value as captured at the call site, before encoding.
+ */
+typedef union {
+  int64_t     i64; /**< Any integer, sign or zero extended */
+  double      f64; /**< Any floating point value */
+  const char *str; /**< String pointer, only valid until the record is written */
+} deferred_log_arg_t;
+
+/* Private Functions **********************************************************/
+
+/* Argument capture helpers used by the macros below; not meant to be called
+ * directly. */
+
+static inline deferred_log_arg_t priv_deferred_log_int(int64_t value)
+{
+  return (deferred_log_arg_t){ .i64 = value };
+}
+
+static inline deferred_log_arg_t priv_deferred_log_float(double value)
+{
+  return (deferred_log_arg_t){ .f64 = value };
+}
+
+static inline deferred_log_arg_t priv_deferred_log_str(const char *value)
+{
+  return (deferred_log_arg_t){ .str = value };
+}
+
+static inline void __attribute__((format(printf, 1, 2)))
+priv_deferred_log_check_format(const char *format, ...)
+{
+  (void)format; /* Only exists so the compiler type-checks format and arguments */
+}
+
+#define priv_deferred_log_type(x) _Generic((x),                                         \
+  _Bool: k_deferred_log_arg_u32, char: k_deferred_log_arg_i32,                          \
+  signed char: k_deferred_log_arg_i32, unsigned char: k_deferred_log_arg_u32,           \
+  short: k_deferred_log_arg_i32, unsigned short: k_deferred_log_arg_u32,                \
+  int: k_deferred_log_arg_i32, unsigned int: k_deferred_log_arg_u32,                    \
+  long: (sizeof(long) == 8 ? k_deferred_log_arg_i64 : k_deferred_log_arg_i32),          \
+  unsigned long: (sizeof(long) == 8 ? k_deferred_log_arg_u64 : k_deferred_log_arg_u32), \
+  long long: k_deferred_log_arg_i64, unsigned long long: k_deferred_log_arg_u64,        \
+  float: k_deferred_log_arg_f32, double: k_deferred_log_arg_f64,                        \
+  char *: k_deferred_log_arg_str, const char *: k_deferred_log_arg_str)
+
+#define priv_deferred_log_value(x) _Generic((x),                       \
+  float: priv_deferred_log_float, double: priv_deferred_log_float,      \
+  char *: priv_deferred_log_str, const char *: priv_deferred_log_str,   \
+  default: priv_deferred_log_int)(x)
+
+#define priv_deferred_log_count(...) \
+  priv_deferred_log_count_(_, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define priv_deferred_log_count_(_, a1, a2, a3, a4, a5, a6, a7, a8, n, ...) n
+
+#define priv_deferred_log_cat(a, b)  priv_deferred_log_cat_(a, b)
+#define priv_deferred_log_cat_(a, b) a##b
+
+#define priv_deferred_log_map(m, ...) \
+  priv_deferred_log_cat(priv_deferred_log_map_, priv_deferred_log_count(__VA_ARGS__))(m, ##__VA_ARGS__)
+#define priv_deferred_log_map_0(m)
+#define priv_deferred_log_map_1(m, a)      m(a)
+#define priv_deferred_log_map_2(m, a, ...) m(a), priv_deferred_log_map_1(m, __VA_ARGS__)
+#define priv_deferred_log_map_3(m, a, ...) m(a), priv_deferred_log_map_2(m, __VA_ARGS__)
+#define priv_deferred_log_map_4(m, a, ...) m(a), priv_deferred_log_map_3(m, __VA_ARGS__)
+#define priv_deferred_log_map_5(m, a, ...) m(a), priv_deferred_log_map_4(m, __VA_ARGS__)
+#define priv_deferred_log_map_6(m, a, ...) m(a), priv_deferred_log_map_5(m, __VA_ARGS__)
+#define priv_deferred_log_map_7(m, a, ...) m(a), priv_deferred_log_map_6(m, __VA_ARGS__)
+#define priv_deferred_log_map_8(m, a, ...) m(a), priv_deferred_log_map_7(m, __VA_ARGS__)
+
+/* Public Macros **************************************************************/
+
+/**
+ * @brief Record a log message without formatting it.
+ *
+ * Drop-in replacement for `ESP_LOG_LEVEL` in hot paths. The call stores the
+ * address of a per-call-site descriptor, the tag pointer, a timestamp and the
+ * raw argument values into the ring of the calling core; formatting and
+ * output happen later in the low-priority drain task (or on the host, see
+ * `tools/dlog_decode.py`).
+ *
+ * @note The tag must point to storage that outlives the record (a string
+ *       literal or a `const char *` constant, as used throughout the repo).
+ *       Strings are copied, pointers (`%p`) and `*` widths are not supported,
+ *       and at most `deferred_log_max_args` arguments can be passed.
+ */
+#define DEFERRED_LOG_LEVEL(log_level, log_tag, log_format, ...)                        \
+  do {                                                                                 \
+    if ((log_level) <= deferred_log_compile_level) {                                   \
+      static const deferred_log_desc_t priv_deferred_log_desc = {                      \
+        .format    = (log_format),                                                     \
+        .level     = (log_level),                                                      \
+        .arg_count = priv_deferred_log_count(__VA_ARGS__),                             \
+        .arg_types = { priv_deferred_log_map(priv_deferred_log_type, ##__VA_ARGS__) }, \
+      };                                                                               \
+      const deferred_log_arg_t priv_deferred_log_args[deferred_log_max_args] = {       \
+        priv_deferred_log_map(priv_deferred_log_value, ##__VA_ARGS__)                  \
+      };                                                                               \
+      if (0) {                                                                         \
+        priv_deferred_log_check_format(log_format, ##__VA_ARGS__);                     \
+      }                                                                                \
+      deferred_log_write(&priv_deferred_log_desc, (log_tag), priv_deferred_log_args);  \
+    }                                                                                  \
+  } while (0)
+
+#define DEFERRED_LOGE(tag, format, ...) DEFERRED_LOG_LEVEL(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define DEFERRED_LOGW(tag, format, ...) DEFERRED_LOG_LEVEL(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define DEFERRED_LOGI(tag, format, ...) DEFERRED_LOG_LEVEL(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define DEFERRED_LOGD(tag, format, ...) DEFERRED_LOG_LEVEL(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define DEFERRED_LOGV(tag, format, ...) DEFERRED_LOG_LEVEL(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Start the deferred log drain task.
+ *
+ * The drain task empties the per-core rings every few milliseconds at the
+ * lowest application priority. Records are either formatted and printed
+ * through `esp_log_write`, or appended verbatim to
+ * `CONFIG_TOPOROBO_DEFERRED_LOG_BINARY_PATH` when binary output is enabled.
+ * The drain task opens that file itself and retries every second, so it may
+ * live on a card mounted after this call; until it opens, or after a write
+ * to it fails, records are formatted to the console.
+ *
+ * Calls made before this function are kept in the rings and printed once the
+ * task runs.
+ *
+ * @return
+ * - ESP_OK if the drain task was started.
+ * - ESP_FAIL otherwise.
+ */
+esp_err_t deferred_log_init(void);
+
+/**
+ * @brief Encode one record into the ring of the calling core.
+ *
+ * Called by the `DEFERRED_LOG*` macros; safe from tasks and ISRs. When the
+ * ring is full the record is dropped and counted, the drain task reports the
+ * number of dropped records.
+ *
+ * @param[in] desc Call site descriptor.
+ * @param[in] tag Log tag.
+ * @param[in] args Captured argument values, `desc->arg_count` are used.
+ */
+void deferred_log_write(const deferred_log_desc_t *desc, const char *tag,
+                        const deferred_log_arg_t *args);
+
+#endif /* TOPOROBO_DEFERRED_LOG_H */
@@ -0,0 +1,250 @@
+/* components/common/include/common/event_bus.h */
+
+/* In-process publish/subscribe bus between producer tasks (sensor HALs) and
+ * any number of consumers (HTTP upload, storage, fusion, ...).
+ *
+ * Messages live in a fixed pool of slots. A publisher takes a slot, fills its
+ * payload in place and publishes it; the bus then hands the same slot pointer
+ * to every subscriber of the topic (no per-subscriber copy) and returns it to
+ * the pool once the last subscriber has released it.
+ *
+ * Acquisition and distribution are split across the cores. Sensor tasks on
+ * core 1 publish with `event_bus_publish_copy`, which only copies the sample
+ * into the topic's lock-free SPSC ingress ring and wakes the dispatcher. The
+ * dispatcher task on core 0 drains the rings into pool slots and fans them
+ * out, so the acquisition core never spins on the pool lock or a queue.
+ *
+ *******************************************************************************
+ *
+ *    core 1                          | core 0
+ *    HAL task --copy--> [ ring/topic ] --> dispatcher --> [ slot, refs = N ] --ptr--> queue 1 --> sink 1
+ *                                    |                                     --ptr--> queue 2 --> sink 2
+ *                                    |    each sink: receive -> use payload -> event_bus_release
+ *
+ *******************************************************************************/
+
+#ifndef TOPOROBO_EVENT_BUS_H
+#define TOPOROBO_EVENT_BUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "common/spsc_ring.h"
+
+/* Macros *********************************************************************/
+
+/**
+ * @brief Number of message slots in the pool, shared by all topics.
+ */
+#define event_bus_pool_slots (32)
+
+/**
+ * @brief Largest payload a slot can carry, in bytes.
+ */
+#define event_bus_payload_bytes (128)
+
+/**
+ * @brief Samples each topic's ingress ring can hold before the dispatcher
+ *        drains it, a power of two.
+ */
+#define event_bus_ingress_slots (8)
+
+/**
+ * @brief Maximum number of subscribers (queues) across all topics.
+ */
+#define event_bus_max_subscribers (8)
+
+/**
+ * @brief Item size for subscriber queues, which carry `event_bus_msg_t *`.
+ */
+#define event_bus_queue_item_size (sizeof(event_bus_msg_t *))
+
+/**
+ * @brief Bit for `topic` in a subscription mask.
+ */
+#define event_bus_topic_bit(topic) (1UL << (topic))
+
+/**
+ * @brief Subscription mask covering every topic.
+ */
+#define event_bus_all_topics ((1UL << k_event_bus_topic_count) - 1)
+
+/**
+ * @brief Publish a copy of `*sample` on `topic`, checking its size at compile time.
+ *
+ * @code
+ * event_bus_publish_sample(k_event_bus_topic_bh1750, bh1750_data);
+ * @endcode
+ */
+#define event_bus_publish_sample(topic, sample)                                  \
+  ({                                                                             \
+    _Static_assert(sizeof(*(sample)) <= event_bus_payload_bytes,                 \
+                   "sample does not fit an event bus slot");                     \
+    event_bus_publish_copy((topic), (sample), sizeof(*(sample)));                \
+  })
+
+/* Enums **********************************************************************/
+
+/**
+ * @enum event_bus_topic_t
+ * @brief Topics carried by the bus and the payload type of each.
+ *
+ * The payload of a message is a snapshot of the producer's data struct at the
+ * time of publishing; subscribers cast `payload` to the listed type.
+ */
+typedef enum : uint8_t {
+  k_event_bus_topic_bh1750     = 0, /**< `bh1750_data_t` */
+  k_event_bus_topic_qmc5883l   = 1, /**< `qmc5883l_data_t` */
+  k_event_bus_topic_mpu6050    = 2, /**< `mpu6050_data_t` */
+  k_event_bus_topic_dht22      = 3, /**< `dht22_data_t` */
+  k_event_bus_topic_gy_neo6mv2 = 4, /**< `gy_neo6mv2_data_t` */
+  k_event_bus_topic_ccs811     = 5, /**< `ccs811_data_t` */
+  k_event_bus_topic_mq135      = 6, /**< `mq135_data_t` */
+  k_event_bus_topic_snapshot   = 7, /**< `snapshot_record_t` (main, snapshot mode) */
+  k_event_bus_topic_summary    = 8, /**< `aggregation_summary_t` (main, windowed aggregation) */
+  k_event_bus_topic_count,          /**< Number of topics, not a topic */
+} event_bus_topic_t;
+
+/* Structs ********************************************************************/
+
+/**
+ * @struct event_bus_msg_t
+ * @brief One message slot from the pool.
+ *
+ * Subscribers must treat a received message as read-only: other subscribers
+ * see the same slot.
+ */
+typedef struct event_bus_msg {
+  struct event_bus_msg *next;         /**< Free list link, internal */
+  int64_t               timestamp_us; /**< esp_timer time of publishing */
+  uint16_t              size;         /**< Valid bytes in `payload` */
+  event_bus_topic_t     topic;        /**< Topic the message was published on */
+  uint8_t               refs;         /**< Subscribers still holding the slot, internal */
+  uint8_t               payload[event_bus_payload_bytes] __attribute__((aligned(8)));
+} event_bus_msg_t;
+
+/**
+ * @struct event_bus_stats_t
+ * @brief Counters describing bus traffic since boot.
+ */
+typedef struct {
+  uint32_t published;          /**< Messages published */
+  uint32_t delivered;          /**< Deliveries into subscriber queues */
+  uint32_t dropped_no_slot;    /**< Publishes rejected because the pool was empty */
+  uint32_t dropped_ingress;    /**< Samples rejected because an ingress ring was full */
+  uint32_t dropped_queue_full; /**< Deliveries skipped because a queue was full */
+  uint32_t slots_in_use;       /**< Slots currently held */
+  uint32_t slots_high_water;   /**< Most slots ever held at once */
+} event_bus_stats_t;
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Builds the slot pool and ingress rings and starts the dispatcher
+ *        task on core 0. Call once before any other bus function.
+ *
+ * @return
+ * - ESP_OK on success.
+ * - ESP_FAIL if the dispatcher task could not be created.
+ */
+esp_err_t event_bus_init(void);
+
+/**
+ * @brief Registers a queue to receive every message on the topics in `topic_mask`.
+ *
+ * The queue is created and owned by the subscriber with an item size of
+ * `event_bus_queue_item_size`. Every message taken from it must be given back
+ * with `event_bus_release`.
+ *
+ * @param[in] topic_mask Topics to receive, built from `event_bus_topic_bit`.
+ * @param[in] queue Queue the bus posts `event_bus_msg_t *` into.
+ *
+ * @return
+ * - ESP_OK on success.
+ * - ESP_ERR_INVALID_ARG if `queue` is NULL or the mask is empty.
+ * - ESP_ERR_NO_MEM if `event_bus_max_subscribers` is reached.
+ */
+esp_err_t event_bus_subscribe(uint32_t topic_mask, QueueHandle_t queue);
+
+/**
+ * @brief Takes a free slot to be filled and published on `topic`.
+ *
+ * @param[in] topic Topic the message will be published on.
+ * @return The slot, or NULL if the pool is empty.
+ */
+event_bus_msg_t *event_bus_acquire(event_bus_topic_t topic);
+
+/**
+ * @brief Publishes a slot from `event_bus_acquire` to all subscribers of its topic.
+ *
+ * Ownership of the slot passes to the bus. Never blocks: subscribers whose
+ * queue is full miss the message and the drop is counted.
+ *
+ * @param[in] msg Slot with `payload` and `size` filled in.
+ * @return
+ * - ESP_OK if at least one subscriber received it, or there are none.
+ * - ESP_FAIL if every subscriber's queue was full.
+ */
+esp_err_t event_bus_publish(event_bus_msg_t *msg);
+
+/**
+ * @brief Copies `size` bytes of `data` into the topic's ingress ring for the
+ *        dispatcher to publish.
+ *
+ * Lock-free and non-blocking, so it may be called from an ISR. Each topic's
+ * ring is single-producer: only one task or ISR may publish a given topic
+ * through this function.
+ *
+ * @param[in] topic Topic to publish on.
+ * @param[in] data Payload to copy.
+ * @param[in] size Payload size, at most `event_bus_payload_bytes`.
+ * @return
+ * - ESP_OK on success.
+ * - ESP_ERR_INVALID_ARG if `topic` is not a topic.
+ * - ESP_ERR_INVALID_SIZE if `size` exceeds a slot.
+ * - ESP_ERR_NO_MEM if the ingress ring is full.
+ */
+esp_err_t event_bus_publish_copy(event_bus_topic_t topic, const void *data, size_t size);
+
+/**
+ * @brief Gives back a message received from a subscriber queue.
+ *
+ * @param[in] msg Message to release; freed once every subscriber released it.
+ */
+void event_bus_release(event_bus_msg_t *msg);
+
+/**
+ * @brief Short name of `topic` (e.g. "bh1750"), used for JSON keys and file names.
+ *
+ * @param[in] topic Topic to name.
+ * @return The name, or "unknown".
+ */
+const char *event_bus_topic_name(event_bus_topic_t topic);
+
+/**
+ * @brief Copies the bus counters.
+ *
+ * @param[out] stats Destination for the counters.
+ */
+void event_bus_get_stats(event_bus_stats_t *stats);
+
+/**
+ * @brief Copies the occupancy and counters of one topic's ingress ring.
+ *
+ * @param[in] topic Topic whose ring to inspect.
+ * @param[out] stats Destination for the snapshot.
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG if `topic` is not a topic.
+ */
+esp_err_t event_bus_get_ingress_stats(event_bus_topic_t topic, spsc_ring_stats_t *stats);
+
+/**
+ * @brief Serializes the bus counters and every ingress ring to JSON.
+ *
+ * @return A dynamically allocated JSON string, or NULL on failure. The caller
+ *         frees it.
+ */
+char *event_bus_stats_to_json(void);
+
+#endif /* TOPOROBO_EVENT_BUS_H */
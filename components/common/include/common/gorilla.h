@@ -0,0 +1,140 @@
+/* components/common/include/common/gorilla.h */
+
+/* Gorilla-style compression of one time series into a bit stream.
+ *
+ * Integer streams (timestamps, counters) store each value as the difference
+ * of successive differences ("delta of delta"); a regularly sampled series
+ * then costs one bit per value. Float streams store each value XORed with
+ * the previous one; for slowly changing readings most bits of the XOR are
+ * zero and only the short run of meaningful bits is written.
+ *
+ * An encoder carries one stream of one kind. Bits are written MSB first;
+ * `gorilla_decoder_t` reads them back on the device and `tools/gorilla.py`
+ * on the host.
+ *
+ *******************************************************************************
+ *
+ *    integer stream: first value as 64 bits, then delta-of-delta d per value:
+ *      d == 0                 '0'
+ *      -64   <= d < 64        '10'    + 7 bits
+ *      -256  <= d < 256       '110'   + 9 bits
+ *      -2048 <= d < 2048      '1110'  + 12 bits
+ *      -2^19 <= d < 2^19      '11110' + 20 bits
+ *      otherwise              '11111' + 64 bits
+ *
+ *    float stream: first value as 32 bits, then x = bits XOR previous bits:
+ *      x == 0                 '0'
+ *      fits previous window   '10' + meaningful bits of the window
+ *      otherwise              '11' + 5 bits leading zeros
+ *                                  + 5 bits (meaningful bit count - 1)
+ *                                  + meaningful bits
+ *
+ *******************************************************************************/
+
+#ifndef TOPOROBO_GORILLA_H
+#define TOPOROBO_GORILLA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Structs ********************************************************************/
+
+/**
+ * @struct gorilla_encoder_t
+ * @brief State of one stream. Initialize with `gorilla_encoder_init`.
+ */
+typedef struct {
+  uint8_t *buffer;         /**< Output bytes */
+  size_t   capacity;       /**< Size of `buffer` */
+  size_t   bit_count;      /**< Bits written so far */
+  bool     overflow;       /**< A write did not fit, the stream is unusable */
+  uint32_t count;          /**< Values written so far */
+  int64_t  previous;       /**< Integer stream: last value */
+  int64_t  previous_delta; /**< Integer stream: last delta */
+  uint32_t previous_bits;  /**< Float stream: bits of the last value */
+  uint8_t  leading;        /**< Float stream: leading zeros of the window, UINT8_MAX for none */
+  uint8_t  trailing;       /**< Float stream: trailing zeros of the current window */
+} gorilla_encoder_t;
+
+/**
+ * @struct gorilla_decoder_t
+ * @brief Read position in one stream. Initialize with `gorilla_decoder_init`.
+ */
+typedef struct {
+  const uint8_t *data;           /**< Stream bytes */
+  size_t         length;         /**< Size of `data` */
+  size_t         bit_pos;        /**< Next bit to read */
+  uint32_t       count;          /**< Values read so far */
+  int64_t        previous;       /**< Integer stream: last value */
+  int64_t        previous_delta; /**< Integer stream: last delta */
+  uint32_t       previous_bits;  /**< Float stream: bits of the last value */
+  uint8_t        leading;        /**< Float stream: leading zeros of the window */
+  uint8_t        trailing;       /**< Float stream: trailing zeros of the window */
+} gorilla_decoder_t;
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Starts an empty stream writing into `buffer`.
+ *
+ * @param[out] encoder Encoder to initialize.
+ * @param[out] buffer Output bytes.
+ * @param[in] capacity Size of `buffer`.
+ */
+void gorilla_encoder_init(gorilla_encoder_t *encoder, uint8_t *buffer, size_t capacity);
+
+/**
+ * @brief Appends a value to an integer stream.
+ *
+ * @param[in,out] encoder Encoder of an integer stream.
+ * @param[in] value Value to append.
+ * @return false if the buffer is full.
+ */
+bool gorilla_put_int(gorilla_encoder_t *encoder, int64_t value);
+
+/**
+ * @brief Appends a value to a float stream.
+ *
+ * @param[in,out] encoder Encoder of a float stream.
+ * @param[in] value Value to append.
+ * @return false if the buffer is full.
+ */
+bool gorilla_put_float(gorilla_encoder_t *encoder, float value);
+
+/**
+ * @brief Returns the stream length in bytes, the last byte zero-padded.
+ *
+ * @param[in] encoder Encoder.
+ * @return Bytes used in the buffer, or 0 if the stream overflowed.
+ */
+size_t gorilla_encoder_size(const gorilla_encoder_t *encoder);
+
+/**
+ * @brief Starts reading a stream written by a `gorilla_encoder_t`.
+ *
+ * @param[out] decoder Decoder to initialize.
+ * @param[in] data Stream bytes, kept referenced while decoding.
+ * @param[in] length Size of `data`.
+ */
+void gorilla_decoder_init(gorilla_decoder_t *decoder, const uint8_t *data, size_t length);
+
+/**
+ * @brief Reads the next value of an integer stream.
+ *
+ * @param[in,out] decoder Decoder of an integer stream.
+ * @param[out] value Decoded value.
+ * @return false if the stream ended early.
+ */
+bool gorilla_get_int(gorilla_decoder_t *decoder, int64_t *value);
+
+/**
+ * @brief Reads the next value of a float stream.
+ *
+ * @param[in,out] decoder Decoder of a float stream.
+ * @param[out] value Decoded value.
+ * @return false if the stream ended early.
+ */
+bool gorilla_get_float(gorilla_decoder_t *decoder, float *value);
+
+#endif /* TOPOROBO_GORILLA_H */
@@ -4,6 +4,7 @@
 #define TOPOROBO_I2C_H
 
 #include <stdint.h>
+#include "sdkconfig.h"
 #include "esp_err.h"
 #include "driver/i2c.h"
 
@@ -11,6 +12,33 @@
 
 extern const uint32_t i2c_timeout_ticks; /* Timeout for I2C commands in ticks */
 
+/* Macros *********************************************************************/
+
+/**
+ * Bus assignment table. Each device is wired to one of the two I2C
+ * controllers, and each controller has its own pins and clock, all set in
+ * menuconfig. The devices with steady high-rate traffic (IMU, servo driver)
+ * default to bus 1, so their transactions run alongside, not between, those
+ * of the slow environmental sensors on bus 0.
+ */
+#define i2c_bus_bh1750   CONFIG_TOPOROBO_I2C_BUS_BH1750
+#define i2c_bus_ccs811   CONFIG_TOPOROBO_I2C_BUS_CCS811
+#define i2c_bus_mpu6050  CONFIG_TOPOROBO_I2C_BUS_MPU6050
+#define i2c_bus_ov7670   CONFIG_TOPOROBO_I2C_BUS_OV7670
+#define i2c_bus_pca9685  CONFIG_TOPOROBO_I2C_BUS_PCA9685
+#define i2c_bus_qmc5883l CONFIG_TOPOROBO_I2C_BUS_QMC5883L
+
+/**
+ * Pins and clock of controller `bus`; constant expressions, for the device
+ * constants of the HALs.
+ */
+#define i2c_bus_scl_io(bus)  \
+  ((bus) == 1 ? CONFIG_TOPOROBO_I2C_1_SCL_IO : CONFIG_TOPOROBO_I2C_0_SCL_IO)
+#define i2c_bus_sda_io(bus)  \
+  ((bus) == 1 ? CONFIG_TOPOROBO_I2C_1_SDA_IO : CONFIG_TOPOROBO_I2C_0_SDA_IO)
+#define i2c_bus_freq_hz(bus) \
+  ((bus) == 1 ? CONFIG_TOPOROBO_I2C_1_FREQ_HZ : CONFIG_TOPOROBO_I2C_0_FREQ_HZ)
+
 /* Private Functions **********************************************************/
 
 /**
@@ -26,12 +54,20 @@ extern const uint32_t i2c_timeout_ticks; /* Timeout for I2C commands in ticks */
  * @param[in,out] i2c_bus I2C bus number to use for communication.
  * @param[in] tag The tag for logging errors.
  *
+ * Devices sharing a bus all call this; the first call installs the driver
+ * and the others return ESP_OK, provided they ask for the same pins and
+ * clock.
+ *
  * @return
- *   - ESP_OK on successful initialization.
+ *   - ESP_OK on successful initialization, or if already initialized alike.
+ *   - ESP_ERR_INVALID_ARG for an invalid bus, a pin that cannot drive an
+ *     output or drives the SPI flash (GPIO 6-11), SDA equal to SCL, or a pin
+ *     already used by the other bus.
+ *   - ESP_ERR_INVALID_STATE if the bus was initialized with other pins or
+ *     another clock.
  *   - An error code from the esp_err_t enumeration on failure.
  *
  * @note The function enables internal pull-ups for both SDA and SCL pins.
- *       Make sure the I2C bus is free before calling this function.
  */
 esp_err_t priv_i2c_init(uint8_t scl_io, uint8_t sda_io, uint32_t freq_hz,
                         uint8_t i2c_bus, const char *tag);
@@ -119,5 +155,30 @@ esp_err_t priv_i2c_read_reg_bytes(uint8_t reg_addr, uint8_t *data, size_t len,
                                   uint8_t i2c_bus, uint8_t i2c_address,
                                   const char *tag);
 
+/**
+ * @brief Take exclusive use of an I2C bus across several transactions.
+ *
+ * Every `priv_i2c_*` transaction takes the same recursive lock, so while a
+ * task holds it transactions from other tasks on that bus wait, and the
+ * holder's own transactions go through. Use it to read several devices back
+ * to back without another task's traffic landing in between.
+ *
+ * @param[in] i2c_bus The I2C bus number to lock.
+ * @param[in] timeout_ticks Maximum time to wait for the bus.
+ *
+ * @return
+ *   - ESP_OK if the bus is held (or was never initialized).
+ *   - ESP_ERR_INVALID_ARG if `i2c_bus` is not a valid port.
+ *   - ESP_ERR_TIMEOUT if another task kept the bus for `timeout_ticks`.
+ */
+esp_err_t priv_i2c_bus_lock(uint8_t i2c_bus, TickType_t timeout_ticks);
+
+/**
+ * @brief Release one `priv_i2c_bus_lock` of an I2C bus.
+ *
+ * @param[in] i2c_bus The I2C bus number to unlock.
+ */
+void priv_i2c_bus_unlock(uint8_t i2c_bus);
+
 #endif /* TOPOROBO_I2C_H */
 
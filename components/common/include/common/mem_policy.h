@@ -0,0 +1,104 @@
+/* components/common/include/common/mem_policy.h */
+
+/* Placement of heap buffers by purpose.
+ *
+ * Callers name what a buffer is for instead of where it goes, and the policy
+ * maps the purpose to `heap_caps` capabilities:
+ * - internal: small, frequently touched objects (list nodes, headers), kept
+ *   in internal RAM for speed;
+ * - dma: buffers handed to a DMA peripheral (SD card blocks, SPI transfers),
+ *   so the driver does not bounce them through a temporary copy;
+ * - bulk: large buffers only the CPU touches (accumulating column blocks,
+ *   batches, export scratch), in PSRAM when fitted, else internal RAM, so
+ *   they do not use up the internal DMA-capable RAM.
+ *
+ * The memory is released with `free`. Requests, fallbacks and failures are
+ * counted per class (`GET /api/memory` and the metrics registry). A failure
+ * is logged with the state of the class's heap, and with
+ * `CONFIG_TOPOROBO_MEM_POLICY_ABORT` aborts at once, so exhaustion shows up
+ * where it happens rather than as a later, unrelated error.
+ */
+
+#ifndef TOPOROBO_MEM_POLICY_H
+#define TOPOROBO_MEM_POLICY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/* Enums **********************************************************************/
+
+/**
+ * @enum mem_policy_class_t
+ * @brief Purpose of a buffer.
+ */
+typedef enum : uint8_t {
+  k_mem_policy_internal = 0, /**< Small and hot, internal RAM */
+  k_mem_policy_dma      = 1, /**< Read or written by DMA, DMA-capable internal RAM */
+  k_mem_policy_bulk     = 2, /**< Large and CPU-only, PSRAM first */
+  k_mem_policy_count,        /**< Number of classes */
+} mem_policy_class_t;
+
+/* Structs ********************************************************************/
+
+/**
+ * @struct mem_policy_stats_t
+ * @brief Counters of one class since boot.
+ */
+typedef struct {
+  uint32_t allocs;        /**< Successful requests */
+  uint32_t fallbacks;     /**< Of those, served by the second choice of memory */
+  uint32_t failures;      /**< Requests that could not be served */
+  uint64_t bytes;         /**< Bytes requested by the successful requests */
+  uint32_t largest;       /**< Largest successful request */
+  uint32_t last_failed;   /**< Size of the last failed request */
+} mem_policy_stats_t;
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Registers the per-class metrics. Allocation works before this.
+ *
+ * @return ESP_OK.
+ */
+esp_err_t mem_policy_init(void);
+
+/**
+ * @brief Allocates `size` bytes for `mem_class`.
+ *
+ * @return The memory, to release with `free`, or NULL.
+ */
+void *mem_policy_malloc(mem_policy_class_t mem_class, size_t size);
+
+/**
+ * @brief Allocates `count * size` zeroed bytes for `mem_class`.
+ *
+ * @return The memory, to release with `free`, or NULL.
+ */
+void *mem_policy_calloc(mem_policy_class_t mem_class, size_t count, size_t size);
+
+/**
+ * @brief Resizes `ptr`, which keeps its contents, within `mem_class`.
+ *
+ * @return The memory, or NULL with `ptr` left allocated.
+ */
+void *mem_policy_realloc(mem_policy_class_t mem_class, void *ptr, size_t size);
+
+/**
+ * @brief Returns the name of `mem_class` ("internal", "dma", "bulk").
+ */
+const char *mem_policy_class_name(mem_policy_class_t mem_class);
+
+/**
+ * @brief Copies the counters of every class into `stats`.
+ */
+void mem_policy_get_stats(mem_policy_stats_t stats[k_mem_policy_count]);
+
+/**
+ * @brief Serializes the counters and the heap state of every class to JSON.
+ *
+ * @return Heap string the caller frees with `cJSON_free`, or NULL on failure.
+ */
+char *mem_policy_stats_to_json(void);
+
+#endif /* TOPOROBO_MEM_POLICY_H */
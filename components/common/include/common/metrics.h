@@ -0,0 +1,186 @@
+/* components/common/include/common/metrics.h */
+
+/* Registry of named counters, gauges and histograms.
+ *
+ * A component defines its metrics as static objects, registers them once at
+ * startup with a name, a help text and optional labels, and updates them on
+ * its hot paths. `metrics_export` writes every registered metric in the
+ * Prometheus text format (served at `GET /metrics`).
+ *
+ * Updates take no lock:
+ * - counters and histograms keep one set of values per core, updated with
+ *   interrupts masked on the calling core only, and summed on export;
+ * - gauges are a single 32-bit float, stored atomically.
+ *
+ * Names, help texts and labels are stored by pointer and must outlive the
+ * registry (string literals). Labels are written verbatim between the
+ * braces, e.g. `bus="0"`; series sharing a name are grouped on export.
+ */
+
+#ifndef TOPOROBO_METRICS_H
+#define TOPOROBO_METRICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+/* Macros *********************************************************************/
+
+/**
+ * @brief Most finite buckets a histogram can have (the +Inf bucket is extra).
+ */
+#define metrics_max_buckets (12)
+
+/* Enums **********************************************************************/
+
+/**
+ * @enum metrics_type_t
+ * @brief Kind of a metric, as in the Prometheus `# TYPE` line.
+ */
+typedef enum : uint8_t {
+  k_metrics_type_counter   = 0, /**< Monotonic count */
+  k_metrics_type_gauge     = 1, /**< Value that goes up and down */
+  k_metrics_type_histogram = 2, /**< Observations counted in fixed buckets */
+} metrics_type_t;
+
+/* Structs ********************************************************************/
+
+/**
+ * @struct metrics_metric_t
+ * @brief Registration common to all kinds, first member of each of them.
+ */
+typedef struct metrics_metric {
+  struct metrics_metric *next;       /**< Next registered metric */
+  const char            *name;       /**< e.g. "toporobo_i2c_errors_total" */
+  const char            *help;       /**< One line of help text */
+  const char            *labels;     /**< e.g. "bus=\"0\"", NULL for none */
+  metrics_type_t         type;       /**< Kind of the enclosing struct */
+  bool                   registered; /**< Linked into the registry */
+} metrics_metric_t;
+
+/**
+ * @struct metrics_counter_t
+ * @brief Monotonic counter, zero-initialized.
+ */
+typedef struct {
+  metrics_metric_t metric;
+  uint64_t         per_core[portNUM_PROCESSORS];
+} metrics_counter_t;
+
+/**
+ * @struct metrics_gauge_t
+ * @brief Gauge, zero-initialized.
+ */
+typedef struct {
+  metrics_metric_t metric;
+  uint32_t         bits; /**< The float value, accessed atomically */
+} metrics_gauge_t;
+
+/**
+ * @struct metrics_histogram_t
+ * @brief Histogram with fixed bucket bounds, zero-initialized.
+ */
+typedef struct {
+  metrics_metric_t metric;
+  const float     *bounds;       /**< Ascending upper bounds of the finite buckets */
+  uint8_t          bucket_count; /**< Number of `bounds` */
+  uint32_t         counts[portNUM_PROCESSORS][metrics_max_buckets + 1]; /**< Per bucket, not cumulative */
+  float            sum[portNUM_PROCESSORS];                             /**< Sum of the observations */
+} metrics_histogram_t;
+
+/**
+ * @brief Sink of the exported text, called with consecutive pieces.
+ *
+ * @return ESP_OK to go on, anything else aborts the export.
+ */
+typedef esp_err_t (*metrics_writer_t)(void *context, const char *data, size_t length);
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Registers a counter.
+ *
+ * @param[in,out] counter Static counter.
+ * @param[in] name Metric name, by convention ending in "_total".
+ * @param[in] help Help text.
+ * @param[in] labels Labels of this series, or NULL.
+ *
+ * @return
+ * - ESP_OK on success, or if `counter` was registered before.
+ * - ESP_ERR_INVALID_ARG if `counter` or `name` is NULL.
+ */
+esp_err_t metrics_counter_register(metrics_counter_t *counter, const char *name,
+                                   const char *help, const char *labels);
+
+/**
+ * @brief Adds to a counter; safe from tasks and ISRs.
+ */
+void metrics_counter_add(metrics_counter_t *counter, uint32_t value);
+
+/**
+ * @brief Adds one to a counter; safe from tasks and ISRs.
+ */
+static inline void metrics_counter_inc(metrics_counter_t *counter)
+{
+  metrics_counter_add(counter, 1);
+}
+
+/**
+ * @brief Returns the sum of a counter over all cores.
+ */
+uint64_t metrics_counter_value(const metrics_counter_t *counter);
+
+/**
+ * @brief Registers a gauge, see `metrics_counter_register`.
+ */
+esp_err_t metrics_gauge_register(metrics_gauge_t *gauge, const char *name, const char *help,
+                                 const char *labels);
+
+/**
+ * @brief Sets a gauge. Not from ISRs (floating point).
+ */
+void metrics_gauge_set(metrics_gauge_t *gauge, float value);
+
+/**
+ * @brief Adds to a gauge, `delta` may be negative. Not from ISRs (floating point).
+ */
+void metrics_gauge_add(metrics_gauge_t *gauge, float delta);
+
+/**
+ * @brief Returns the value of a gauge.
+ */
+float metrics_gauge_value(const metrics_gauge_t *gauge);
+
+/**
+ * @brief Registers a histogram, see `metrics_counter_register`.
+ *
+ * @param[in] bounds Ascending upper bounds of the buckets (static storage).
+ * @param[in] bucket_count Number of `bounds`, 1 to `metrics_max_buckets`.
+ *
+ * @return
+ * - ESP_OK on success, or if `histogram` was registered before.
+ * - ESP_ERR_INVALID_ARG if an argument is NULL, out of range or not ascending.
+ */
+esp_err_t metrics_histogram_register(metrics_histogram_t *histogram, const char *name,
+                                     const char *help, const char *labels,
+                                     const float *bounds, uint8_t bucket_count);
+
+/**
+ * @brief Counts one observation. Not from ISRs (floating point).
+ */
+void metrics_histogram_observe(metrics_histogram_t *histogram, float value);
+
+/**
+ * @brief Writes every registered metric in the Prometheus text format.
+ *
+ * @param[in] timestamp_ms Time appended to every sample (Unix ms), 0 for none.
+ * @param[in] writer Called with the text, piece by piece.
+ * @param[in] context Passed to `writer`.
+ *
+ * @return ESP_OK, or the first error returned by `writer`.
+ */
+esp_err_t metrics_export(int64_t timestamp_ms, metrics_writer_t writer, void *context);
+
+#endif /* TOPOROBO_METRICS_H */
@@ -0,0 +1,110 @@
+/* components/common/include/common/power.h */
+
+#ifndef TOPOROBO_POWER_H
+#define TOPOROBO_POWER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/* Constants ******************************************************************/
+
+/**
+ * @brief Logging tag for the power management layer.
+ */
+extern const char *power_tag;
+
+/**
+ * @brief Lowest CPU frequency DFS may select, in MHz.
+ *
+ * 80 MHz keeps the APB clock at its nominal rate when no lock is held, so
+ * UART baud rates and I2C timings configured at boot stay valid.
+ */
+extern const int power_min_cpu_freq_mhz;
+
+/* Enums **********************************************************************/
+
+/**
+ * @enum power_lock_t
+ * @brief Power management locks taken around timing-critical sections.
+ *
+ * Each lock maps to one `esp_pm_lock_handle_t` of the type noted below.
+ * Holding any of them keeps the chip out of automatic light sleep.
+ */
+typedef enum : uint8_t {
+  k_power_lock_dht22 = 0, /**< DHT22 bit-banged read (ESP_PM_CPU_FREQ_MAX) */
+  k_power_lock_i2c   = 1, /**< Multi-transaction I2C bursts (ESP_PM_APB_FREQ_MAX) */
+  k_power_lock_servo = 2, /**< Servo position updates (ESP_PM_APB_FREQ_MAX) */
+  k_power_lock_imu   = 3, /**< MPU6050 data-ready interrupts (ESP_PM_NO_LIGHT_SLEEP) */
+  k_power_lock_gps   = 4, /**< GPS UART reception (ESP_PM_NO_LIGHT_SLEEP) */
+  k_power_lock_count = 5, /**< Number of locks */
+} power_lock_t;
+
+/* Structs ********************************************************************/
+
+/**
+ * @struct power_lock_stats_t
+ * @brief Usage statistics of one power lock since boot.
+ */
+typedef struct {
+  uint32_t acquire_count; /**< Number of outermost acquisitions */
+  uint64_t held_us;       /**< Total time the lock was held, in microseconds */
+} power_lock_stats_t;
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Configure dynamic frequency scaling and automatic light sleep.
+ *
+ * Sets the CPU frequency range to [`power_min_cpu_freq_mhz`,
+ * `CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ`] and enables automatic light sleep when
+ * tickless idle is configured, then creates the locks of `power_lock_t`.
+ *
+ * @note Requires `CONFIG_PM_ENABLE`; without it the function logs a warning,
+ *       returns ESP_OK and the lock functions do nothing. Per-mode residency
+ *       additionally requires `CONFIG_PM_PROFILING` (see `sdkconfig.defaults`).
+ *
+ * @return
+ * - ESP_OK on success, or if power management is not enabled in the build.
+ * - An error from `esp_pm_configure` or `esp_pm_lock_create` otherwise.
+ */
+esp_err_t power_init(void);
+
+/**
+ * @brief Acquire a power lock; calls nest.
+ *
+ * @param[in] lock Lock to acquire.
+ */
+void power_lock_acquire(power_lock_t lock);
+
+/**
+ * @brief Release a power lock acquired with `power_lock_acquire`.
+ *
+ * @param[in] lock Lock to release.
+ */
+void power_lock_release(power_lock_t lock);
+
+/**
+ * @brief Copy the usage statistics of a power lock.
+ *
+ * @param[in] lock Lock to query.
+ * @param[out] stats Destination for the statistics.
+ *
+ * @return
+ * - ESP_OK on success.
+ * - ESP_ERR_INVALID_ARG if `lock` or `stats` is invalid.
+ */
+esp_err_t power_get_lock_stats(power_lock_t lock, power_lock_stats_t *stats);
+
+/**
+ * @brief Report the power state residency and lock usage as JSON.
+ *
+ * The JSON holds the configured frequency range, the statistics of every
+ * lock and, when `CONFIG_PM_PROFILING` is set, the time spent in each power
+ * mode (including light sleep) as printed by `esp_pm_dump_locks`.
+ *
+ * @return A JSON-formatted string, or NULL on failure.
+ * @note The returned string should be freed by the caller to prevent memory leaks.
+ */
+char *power_stats_to_json(void);
+
+#endif /* TOPOROBO_POWER_H */
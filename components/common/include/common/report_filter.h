@@ -0,0 +1,110 @@
+/* components/common/include/common/report_filter.h */
+
+/* Change-triggered reporting for one stream of samples.
+ *
+ * A filter watches a few numeric channels (fields) of a sample struct and
+ * lets a sample through only if at least one channel moved by more than its
+ * deadband since the last sample that was let through, or if nothing has been
+ * reported for `max_silence_ms` (a heartbeat, so a quiet sensor is not
+ * mistaken for a dead one). Everything else is counted as suppressed.
+ *
+ * A channel's deadband is absolute, relative to the last reported value, or
+ * both, in which case the wider one applies: the change must exceed
+ * max(abs_deadband, rel_deadband * |last|). The absolute deadband then keeps
+ * noise near zero quiet and the relative one scales with large values. A
+ * channel with both set to zero reports any change at all.
+ */
+
+#ifndef TOPOROBO_REPORT_FILTER_H
+#define TOPOROBO_REPORT_FILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/* Macros *********************************************************************/
+
+/**
+ * @brief Most channels a single filter can watch.
+ */
+#define report_filter_max_channels (4)
+
+/* Enums **********************************************************************/
+
+/**
+ * @enum report_filter_type_t
+ * @brief Storage type of a watched channel.
+ */
+typedef enum : uint8_t {
+  k_report_filter_float  = 0, /**< `float` */
+  k_report_filter_uint16 = 1, /**< `uint16_t` */
+  k_report_filter_uint8  = 2, /**< `uint8_t` */
+} report_filter_type_t;
+
+/* Structs ********************************************************************/
+
+/**
+ * @struct report_filter_channel_t
+ * @brief One watched field of the sample struct.
+ */
+typedef struct {
+  uint16_t             offset;       /**< `offsetof` the field in the sample */
+  report_filter_type_t type;         /**< Storage type of the field */
+  float                abs_deadband; /**< Smallest |change| worth reporting, 0 to disable */
+  float                rel_deadband; /**< Smallest |change| as a fraction of |last|, 0 to disable */
+} report_filter_channel_t;
+
+/**
+ * @struct report_filter_t
+ * @brief Filter state. Initialize with `report_filter_init`.
+ */
+typedef struct {
+  const report_filter_channel_t *channels;       /**< Watched channels */
+  uint8_t                        channel_count;  /**< Entries in `channels` */
+  bool                           primed;         /**< A sample has been reported */
+  uint32_t                       max_silence_ms; /**< Heartbeat interval, 0 for none */
+  int64_t                        last_report_us; /**< Time of the last reported sample */
+  float                          last[report_filter_max_channels]; /**< Last reported values */
+  uint32_t                       reported;       /**< Samples let through */
+  uint32_t                       suppressed;     /**< Samples held back */
+} report_filter_t;
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Prepares a filter over `channels`.
+ *
+ * @param[out] filter Filter to initialize.
+ * @param[in] channels Watched channels, kept by reference. NULL with a count
+ *                     of zero gives a filter that reports every sample.
+ * @param[in] channel_count Number of channels, at most `report_filter_max_channels`.
+ * @param[in] max_silence_ms Report at least this often, 0 for no heartbeat.
+ *
+ * @return
+ * - ESP_OK on success.
+ * - ESP_ERR_INVALID_ARG if `filter` is NULL or the channels are invalid.
+ */
+esp_err_t report_filter_init(report_filter_t *filter, const report_filter_channel_t *channels,
+                             uint8_t channel_count, uint32_t max_silence_ms);
+
+/**
+ * @brief Reads a numeric field as a float.
+ *
+ * @param[in] type Storage type of the field.
+ * @param[in] field Address of the field, need not be aligned.
+ * @return The value, or 0 for an unknown type.
+ */
+float report_filter_read(report_filter_type_t type, const void *field);
+
+/**
+ * @brief Decides whether `sample` should be reported, updating the filter.
+ *
+ * @param[in,out] filter Filter of the stream.
+ * @param[in] sample Sample struct the channel offsets refer to.
+ * @param[in] now_us Time of the sample, e.g. from `esp_timer_get_time`.
+ * @return true to report the sample, false if it was suppressed.
+ */
+bool report_filter_check(report_filter_t *filter, const void *sample, int64_t now_us);
+
+#endif /* TOPOROBO_REPORT_FILTER_H */
@@ -0,0 +1,187 @@
+/* components/common/include/common/rtos_alloc.h */
+
+#ifndef TOPOROBO_RTOS_ALLOC_H
+#define TOPOROBO_RTOS_ALLOC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "freertos/timers.h"
+
+/* Structs ********************************************************************/
+
+/**
+ * @struct rtos_task_storage_t
+ * @brief Link-time storage for one task created with `priv_rtos_task_create`.
+ *
+ * Only populated when `CONFIG_TOPOROBO_STATIC_ALLOCATION` is set; declare it
+ * with `rtos_task_storage_define` rather than by hand.
+ */
+typedef struct {
+  StaticTask_t tcb;         /**< Task control block */
+  StackType_t *stack;       /**< Statically reserved stack */
+  uint32_t     stack_bytes; /**< Size of `stack` in bytes */
+} rtos_task_storage_t;
+
+/**
+ * @struct rtos_queue_storage_t
+ * @brief Link-time storage for one queue created with `priv_rtos_queue_create`.
+ *
+ * Only populated when `CONFIG_TOPOROBO_STATIC_ALLOCATION` is set; declare it
+ * with `rtos_queue_storage_define` rather than by hand.
+ */
+typedef struct {
+  StaticQueue_t queue;     /**< Queue control block */
+  uint8_t      *buffer;    /**< Statically reserved item storage */
+  uint32_t      length;    /**< Number of items `buffer` can hold */
+  uint32_t      item_size; /**< Size of one item in bytes */
+} rtos_queue_storage_t;
+
+/* Macros *********************************************************************/
+
+/**
+ * @brief Storage declaration and reference macros.
+ *
+ * Each `*_define` macro declares file-scope static storage for one RTOS
+ * object, and `rtos_storage_ref` yields the pointer to pass to the matching
+ * `priv_rtos_*_create` function. Without `CONFIG_TOPOROBO_STATIC_ALLOCATION`
+ * the definitions reserve nothing and the reference is NULL, so call sites are
+ * identical in both modes:
+ *
+ * @code
+ * rtos_task_storage_define(s_example_task_storage, 4096);
+ * ...
+ * priv_rtos_task_create(priv_example_task, "Example", 4096, NULL, 5, NULL,
+ *                       tskNO_AFFINITY, rtos_storage_ref(s_example_task_storage));
+ * @endcode
+ */
+#if CONFIG_TOPOROBO_STATIC_ALLOCATION
+
+#define rtos_task_storage_define(name, stack_size_bytes)                          \
+  static StackType_t         name##_stack[(stack_size_bytes) / sizeof(StackType_t)]; \
+  static rtos_task_storage_t name = { .stack = name##_stack, .stack_bytes = (stack_size_bytes) }
+
+#define rtos_queue_storage_define(name, queue_length, queue_item_size)   \
+  static uint8_t              name##_buffer[(queue_length) * (queue_item_size)]; \
+  static rtos_queue_storage_t name = { .buffer = name##_buffer, .length = (queue_length), \
+                                       .item_size = (queue_item_size) }
+
+#define rtos_semaphore_storage_define(name)   static StaticSemaphore_t name
+#define rtos_event_group_storage_define(name) static StaticEventGroup_t name
+#define rtos_timer_storage_define(name)       static StaticTimer_t name
+
+#define rtos_storage_ref(name) (&(name))
+
+#else
+
+#define rtos_task_storage_define(name, stack_size_bytes) \
+  _Static_assert((stack_size_bytes) > 0, #name " needs a stack")
+
+#define rtos_queue_storage_define(name, queue_length, queue_item_size) \
+  _Static_assert((queue_length) > 0 && (queue_item_size) > 0, #name " needs items")
+
+#define rtos_semaphore_storage_define(name)   _Static_assert(1, #name)
+#define rtos_event_group_storage_define(name) _Static_assert(1, #name)
+#define rtos_timer_storage_define(name)       _Static_assert(1, #name)
+
+#define rtos_storage_ref(name) (NULL)
+
+#endif /* CONFIG_TOPOROBO_STATIC_ALLOCATION */
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Create a task, optionally pinned, from static or heap storage.
+ *
+ * With `CONFIG_TOPOROBO_STATIC_ALLOCATION` the task is created with
+ * `xTaskCreateStaticPinnedToCore` on the stack and TCB held in `storage`,
+ * otherwise with `xTaskCreatePinnedToCore` and `storage` is ignored.
+ *
+ * @param[in] task_function Task entry point.
+ * @param[in] name Task name.
+ * @param[in] stack_bytes Stack size in bytes (must fit `storage` in static mode).
+ * @param[in] param Argument passed to `task_function`.
+ * @param[in] priority Task priority.
+ * @param[out] handle Optional destination for the task handle, may be NULL.
+ * @param[in] core_id Core to pin to, or `tskNO_AFFINITY`.
+ * @param[in] storage Storage from `rtos_storage_ref`.
+ *
+ * @return
+ *   - ESP_OK if the task was created.
+ *   - ESP_ERR_INVALID_ARG if static storage is missing or too small.
+ *   - ESP_ERR_NO_MEM if the heap allocation failed.
+ */
+esp_err_t priv_rtos_task_create(TaskFunction_t task_function, const char *name,
+                                uint32_t stack_bytes, void *param, UBaseType_t priority,
+                                TaskHandle_t *handle, BaseType_t core_id,
+                                rtos_task_storage_t *storage);
+
+/**
+ * @brief Create a queue from static or heap storage.
+ *
+ * @param[in] length Maximum number of items in the queue.
+ * @param[in] item_size Size of each item in bytes.
+ * @param[in] storage Storage from `rtos_storage_ref`, sized for at least
+ *                    `length` items of `item_size` in static mode.
+ *
+ * @return The queue handle, or NULL on failure.
+ */
+QueueHandle_t priv_rtos_queue_create(uint32_t length, uint32_t item_size,
+                                     rtos_queue_storage_t *storage);
+
+/**
+ * @brief Create a mutex from static or heap storage.
+ *
+ * @param[in] storage Storage from `rtos_storage_ref`.
+ * @return The mutex handle, or NULL on failure.
+ */
+SemaphoreHandle_t priv_rtos_mutex_create(StaticSemaphore_t *storage);
+
+/**
+ * @brief Create a recursive mutex from static or heap storage.
+ *
+ * @param[in] storage Storage from `rtos_storage_ref`.
+ * @return The mutex handle, or NULL on failure.
+ */
+SemaphoreHandle_t priv_rtos_recursive_mutex_create(StaticSemaphore_t *storage);
+
+/**
+ * @brief Create a binary semaphore from static or heap storage.
+ *
+ * @param[in] storage Storage from `rtos_storage_ref`.
+ * @return The semaphore handle, or NULL on failure.
+ */
+SemaphoreHandle_t priv_rtos_binary_semaphore_create(StaticSemaphore_t *storage);
+
+/**
+ * @brief Create an event group from static or heap storage.
+ *
+ * @param[in] storage Storage from `rtos_storage_ref`.
+ * @return The event group handle, or NULL on failure.
+ */
+EventGroupHandle_t priv_rtos_event_group_create(StaticEventGroup_t *storage);
+
+/**
+ * @brief Create a software timer from static or heap storage.
+ *
+ * @param[in] name Timer name.
+ * @param[in] period_ticks Timer period in ticks.
+ * @param[in] auto_reload pdTRUE for a periodic timer, pdFALSE for one-shot.
+ * @param[in] timer_id Identifier passed back through `pvTimerGetTimerID`.
+ * @param[in] callback Function called when the timer expires.
+ * @param[in] storage Storage from `rtos_storage_ref`.
+ *
+ * @return The timer handle, or NULL on failure.
+ */
+TimerHandle_t priv_rtos_timer_create(const char *name, TickType_t period_ticks,
+                                     UBaseType_t auto_reload, void *timer_id,
+                                     TimerCallbackFunction_t callback,
+                                     StaticTimer_t *storage);
+
+#endif /* TOPOROBO_RTOS_ALLOC_H */
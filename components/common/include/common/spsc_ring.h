@@ -0,0 +1,151 @@
+/* components/common/include/common/spsc_ring.h */
+
+/* Lock-free single-producer/single-consumer ring of fixed-size items.
+ *
+ * Exactly one context (a task or an ISR) pushes and exactly one context pops;
+ * they may run on different cores. Neither side takes a lock, enters a
+ * critical section or blocks, so both ends are safe to call from ISRs and
+ * from code that must not be delayed by the other core.
+ *
+ * Indices run freely and are masked on access, so `capacity` must be a power
+ * of two and all of it is usable. The producer only writes `head`, the
+ * consumer only writes `tail`; each publishes its index with release
+ * semantics after touching the item, and reads the other's with acquire.
+ *
+ *******************************************************************************
+ *
+ *    producer: reserve -> fill item -> commit       (head++)
+ *    consumer: peek    -> use item  -> consume      (tail++)
+ *
+ *    occupancy = head - tail
+ *
+ *******************************************************************************/
+
+#ifndef TOPOROBO_SPSC_RING_H
+#define TOPOROBO_SPSC_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/* Structs ********************************************************************/
+
+/**
+ * @struct spsc_ring_t
+ * @brief Ring state. Initialize with `spsc_ring_init`; do not touch the fields.
+ */
+typedef struct {
+  uint8_t  *buffer;     /**< `capacity * item_size` bytes of item storage */
+  uint32_t  capacity;   /**< Number of items, a power of two */
+  uint32_t  item_size;  /**< Size of one item in bytes */
+  uint32_t  head;       /**< Items ever committed, written by the producer */
+  uint32_t  tail;       /**< Items ever consumed, written by the consumer */
+  uint32_t  overflows;  /**< Pushes rejected because the ring was full, producer side */
+  uint32_t  high_water; /**< Highest occupancy seen at commit, producer side */
+} spsc_ring_t;
+
+/**
+ * @struct spsc_ring_stats_t
+ * @brief Snapshot of a ring's occupancy and counters.
+ */
+typedef struct {
+  uint32_t capacity;   /**< Number of items the ring holds */
+  uint32_t occupancy;  /**< Items waiting to be consumed */
+  uint32_t high_water; /**< Highest occupancy seen */
+  uint32_t pushed;     /**< Items committed since init */
+  uint32_t overflows;  /**< Pushes rejected because the ring was full */
+} spsc_ring_stats_t;
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Prepares `ring` to use `buffer` as storage for `capacity` items.
+ *
+ * @param[out] ring Ring to initialize.
+ * @param[in] buffer Storage of at least `capacity * item_size` bytes, aligned
+ *                   for the item type.
+ * @param[in] capacity Number of items, a power of two.
+ * @param[in] item_size Size of one item in bytes.
+ *
+ * @return
+ * - ESP_OK on success.
+ * - ESP_ERR_INVALID_ARG if a pointer is NULL, `item_size` is zero or
+ *   `capacity` is not a power of two.
+ */
+esp_err_t spsc_ring_init(spsc_ring_t *ring, void *buffer, uint32_t capacity,
+                         uint32_t item_size);
+
+/**
+ * @brief Producer: returns the next free item to be filled in place.
+ *
+ * The item becomes visible to the consumer only after `spsc_ring_commit`.
+ *
+ * @param[in] ring Ring to write.
+ * @return The item, or NULL if the ring is full (counted as an overflow).
+ */
+void *spsc_ring_reserve(spsc_ring_t *ring);
+
+/**
+ * @brief Producer: publishes the item returned by the last `spsc_ring_reserve`.
+ *
+ * @param[in] ring Ring to write.
+ */
+void spsc_ring_commit(spsc_ring_t *ring);
+
+/**
+ * @brief Producer: copies `size` bytes of `item` into the ring.
+ *
+ * @param[in] ring Ring to write.
+ * @param[in] item Item to copy.
+ * @param[in] size Bytes to copy, at most the ring's item size.
+ *
+ * @return
+ * - ESP_OK on success.
+ * - ESP_ERR_INVALID_SIZE if `size` exceeds the item size.
+ * - ESP_ERR_NO_MEM if the ring is full (counted as an overflow).
+ */
+esp_err_t spsc_ring_push(spsc_ring_t *ring, const void *item, size_t size);
+
+/**
+ * @brief Consumer: returns the oldest item without removing it.
+ *
+ * @param[in] ring Ring to read.
+ * @return The item, valid until `spsc_ring_consume`, or NULL if empty.
+ */
+void *spsc_ring_peek(spsc_ring_t *ring);
+
+/**
+ * @brief Consumer: removes the item returned by the last `spsc_ring_peek`.
+ *
+ * @param[in] ring Ring to read.
+ */
+void spsc_ring_consume(spsc_ring_t *ring);
+
+/**
+ * @brief Consumer: copies the oldest item into `item` and removes it.
+ *
+ * @param[in] ring Ring to read.
+ * @param[out] item Destination of at least the ring's item size.
+ *
+ * @return
+ * - ESP_OK on success.
+ * - ESP_ERR_NOT_FOUND if the ring is empty.
+ */
+esp_err_t spsc_ring_pop(spsc_ring_t *ring, void *item);
+
+/**
+ * @brief Number of items waiting to be consumed. Safe from either side.
+ *
+ * @param[in] ring Ring to inspect.
+ */
+uint32_t spsc_ring_occupancy(const spsc_ring_t *ring);
+
+/**
+ * @brief Copies the ring's occupancy and counters. Safe from any context.
+ *
+ * @param[in] ring Ring to inspect.
+ * @param[out] stats Destination for the snapshot.
+ */
+void spsc_ring_get_stats(const spsc_ring_t *ring, spsc_ring_stats_t *stats);
+
+#endif /* TOPOROBO_SPSC_RING_H */
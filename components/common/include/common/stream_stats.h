@@ -0,0 +1,69 @@
+/* components/common/include/common/stream_stats.h */
+
+/* Streaming count/min/max/mean/variance of one channel.
+ *
+ * Mean and variance use Welford's update, which stays accurate over long runs
+ * where the naive sum-of-squares formula loses everything to cancellation.
+ * Two accumulators can be combined with `stream_stats_merge` (Chan et al.), so
+ * a sliding window is kept as a ring of short panes and merged on demand.
+ */
+
+#ifndef TOPOROBO_STREAM_STATS_H
+#define TOPOROBO_STREAM_STATS_H
+
+#include <stdint.h>
+
+/* Structs ********************************************************************/
+
+/**
+ * @struct stream_stats_t
+ * @brief Accumulator. Zero-initialized (or `stream_stats_reset`) means empty.
+ */
+typedef struct {
+  uint32_t count; /**< Values added */
+  float    min;   /**< Smallest value, valid if `count` > 0 */
+  float    max;   /**< Largest value, valid if `count` > 0 */
+  double   mean;  /**< Running mean */
+  double   m2;    /**< Sum of squared differences from the mean */
+} stream_stats_t;
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Empties an accumulator.
+ *
+ * @param[out] stats Accumulator to reset.
+ */
+void stream_stats_reset(stream_stats_t *stats);
+
+/**
+ * @brief Adds one value.
+ *
+ * @param[in,out] stats Accumulator.
+ * @param[in] value Value to add.
+ */
+void stream_stats_add(stream_stats_t *stats, float value);
+
+/**
+ * @brief Adds everything accumulated in `other` to `stats`.
+ *
+ * @param[in,out] stats Accumulator to merge into.
+ * @param[in] other Accumulator to merge from, unchanged.
+ */
+void stream_stats_merge(stream_stats_t *stats, const stream_stats_t *other);
+
+/**
+ * @brief Sample variance (divided by `count` - 1), 0 with fewer than two values.
+ *
+ * @param[in] stats Accumulator.
+ */
+float stream_stats_variance(const stream_stats_t *stats);
+
+/**
+ * @brief Sample standard deviation, 0 with fewer than two values.
+ *
+ * @param[in] stats Accumulator.
+ */
+float stream_stats_stddev(const stream_stats_t *stats);
+
+#endif /* TOPOROBO_STREAM_STATS_H */
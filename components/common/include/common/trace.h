@@ -0,0 +1,171 @@
+/* components/common/include/common/trace.h */
+
+/* Timeline of what every core and task was doing, viewable in Perfetto.
+ *
+ * With `CONFIG_TOPOROBO_TRACE` each core records events into its own
+ * circular buffer of `CONFIG_TOPOROBO_TRACE_RECORDS` 16-byte records, the
+ * oldest being overwritten, so the buffers always hold the last moments
+ * before a stall:
+ * - task switches, from the FreeRTOS `traceTASK_SWITCHED_IN` hook;
+ * - sends, receives, blocking and failed sends on queues, from the FreeRTOS
+ *   queue hooks (semaphores and mutexes are left out), see trace_hooks.h;
+ * - spans and instants marked in the code with `trace_begin`, `trace_end`
+ *   and `trace_instant`: I2C transactions, HTTP requests, SD appends and
+ *   event bus drops.
+ *
+ * `trace_export` writes the buffers as Chrome trace JSON, to be opened at
+ * https://ui.perfetto.dev: a "CPUs" process with one track per core showing
+ * the running task, and a "Tasks" process with one track per task holding
+ * its spans and queue events.
+ *
+ * Timestamps are esp_timer microseconds rather than CPU cycles: with dynamic
+ * frequency scaling and light sleep the cycle counter neither runs at a
+ * fixed rate nor keeps running.
+ */
+
+#ifndef TOPOROBO_TRACE_H
+#define TOPOROBO_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+/* Macros *********************************************************************/
+
+/**
+ * @brief Bit of a category in a category mask.
+ */
+#define trace_category_bit(category) (1UL << (category))
+
+/**
+ * @brief Mask of every category.
+ */
+#define trace_all_categories ((1UL << k_trace_category_count) - 1)
+
+/* Enums **********************************************************************/
+
+/**
+ * @enum trace_category_t
+ * @brief Source of an event, recording can be limited to some of them.
+ */
+typedef enum : uint8_t {
+  k_trace_category_task  = 0, /**< Task switches */
+  k_trace_category_queue = 1, /**< Queue operations and event bus drops */
+  k_trace_category_i2c   = 2, /**< I2C transactions, arg: bus << 8 | address */
+  k_trace_category_http  = 3, /**< HTTP requests, end arg: status code */
+  k_trace_category_sd    = 4, /**< SD card appends, arg: bytes */
+  k_trace_category_count,
+} trace_category_t;
+
+/**
+ * @enum trace_phase_t
+ * @brief Kind of a marked event, as in the Chrome trace format.
+ */
+typedef enum : uint8_t {
+  k_trace_phase_begin   = 0, /**< Start of a span */
+  k_trace_phase_end     = 1, /**< End of the span last begun by the same task */
+  k_trace_phase_instant = 2, /**< Point in time */
+} trace_phase_t;
+
+/* Structs ********************************************************************/
+
+/**
+ * @brief Sink of the exported JSON, called with consecutive pieces.
+ *
+ * @return ESP_OK to go on, anything else aborts the export.
+ */
+typedef esp_err_t (*trace_writer_t)(void *context, const char *data, size_t length);
+
+/* Public Functions ***********************************************************/
+
+#if CONFIG_TOPOROBO_TRACE
+
+/**
+ * @brief Records an event on the calling core, from a task or an ISR.
+ *
+ * @param[in] category Source of the event.
+ * @param[in] phase Begin, end or instant.
+ * @param[in] name Event name; must outlive the buffer (a string literal).
+ * @param[in] arg Number shown with the event, see `trace_category_t`.
+ */
+void trace_event(trace_category_t category, trace_phase_t phase, const char *name,
+                 uint16_t arg);
+
+#else
+
+static inline void trace_event(trace_category_t category, trace_phase_t phase,
+                               const char *name, uint16_t arg)
+{
+  (void)category;
+  (void)phase;
+  (void)name;
+  (void)arg;
+}
+
+#endif /* CONFIG_TOPOROBO_TRACE */
+
+/**
+ * @brief Marks the start of a span of the calling task.
+ */
+static inline void trace_begin(trace_category_t category, const char *name, uint16_t arg)
+{
+  trace_event(category, k_trace_phase_begin, name, arg);
+}
+
+/**
+ * @brief Marks the end of the span last begun by the calling task.
+ */
+static inline void trace_end(trace_category_t category, const char *name, uint16_t arg)
+{
+  trace_event(category, k_trace_phase_end, name, arg);
+}
+
+/**
+ * @brief Marks a point in time.
+ */
+static inline void trace_instant(trace_category_t category, const char *name, uint16_t arg)
+{
+  trace_event(category, k_trace_phase_instant, name, arg);
+}
+
+/**
+ * @brief Empties the buffers and records the given categories from now on.
+ *
+ * Every category is recorded from boot. A mask of 0 stops recording.
+ *
+ * @param[in] mask `trace_category_bit` of each category to record.
+ */
+void trace_set_categories(uint32_t mask);
+
+/**
+ * @brief Returns the mask of the categories being recorded, 0 when tracing is disabled.
+ */
+uint32_t trace_get_categories(void);
+
+/**
+ * @brief Name of a category ("task", "queue", "i2c", "http" or "sd").
+ */
+const char *trace_category_name(trace_category_t category);
+
+/**
+ * @brief Writes the buffers as Chrome trace JSON.
+ *
+ * Recording pauses during the export and resumes afterwards; the buffers
+ * keep their content. `otherData.task_switches` counts the task switches in
+ * the export; a warning is logged if there are none, which means FreeRTOS was
+ * built without trace_hooks.h.
+ *
+ * @param[in] writer Called with the JSON, piece by piece.
+ * @param[in] context Passed to `writer`.
+ *
+ * @return
+ * - ESP_OK if the whole trace was written.
+ * - ESP_ERR_NOT_SUPPORTED if tracing is disabled.
+ * - ESP_ERR_INVALID_STATE if another export is running.
+ * - ESP_ERR_NO_MEM if the task list could not be allocated.
+ * - The error returned by `writer` otherwise.
+ */
+esp_err_t trace_export(trace_writer_t writer, void *context);
+
+#endif /* TOPOROBO_TRACE_H */
@@ -0,0 +1,78 @@
+/* components/common/include/common/trace_hooks.h */
+
+/* FreeRTOS trace hook macros feeding common/trace.h.
+ *
+ * FreeRTOS only picks up trace macros defined before its own headers are
+ * read, in the kernel's sources too, so with `CONFIG_TOPOROBO_TRACE` this
+ * header is force-included into every component by
+ * components/common/project_include.cmake, which ESP-IDF reads before any
+ * component is configured. It is kept free of includes beyond
+ * <stdint.h> for that reason; do not include it directly.
+ */
+
+#ifndef TOPOROBO_TRACE_HOOKS_H
+#define TOPOROBO_TRACE_HOOKS_H
+
+#ifndef __ASSEMBLER__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Constants ******************************************************************/
+
+/* Queue operations recorded by the queue hooks. Plain macros rather than an
+ * enum with a fixed type: this header is also compiled as C17 and C++. */
+#define trace_queue_send            (0) /* Item queued */
+#define trace_queue_send_failed     (1) /* Queue full, item dropped */
+#define trace_queue_send_blocked    (2) /* Queue full, sender waits */
+#define trace_queue_receive         (3) /* Item taken */
+#define trace_queue_receive_blocked (4) /* Queue empty, receiver waits */
+#define trace_queue_op_count        (5)
+
+/* Macros *********************************************************************/
+
+/* Expanded inside queue.c, where `Queue_t` is complete. Semaphores and
+ * mutexes are queues too, but only plain queues are recorded. */
+#define priv_trace_hook_queue(queue, op)                                        \
+  do {                                                                          \
+    if ((queue)->ucQueueType == queueQUEUE_TYPE_BASE) {                         \
+      trace_hook_queue((queue), (op), (uint32_t)(queue)->uxMessagesWaiting);    \
+    }                                                                           \
+  } while (0)
+
+#define traceTASK_SWITCHED_IN()                  trace_hook_task_switched_in()
+#define traceQUEUE_SEND(pxQueue)                 priv_trace_hook_queue(pxQueue, trace_queue_send)
+#define traceQUEUE_SEND_FROM_ISR(pxQueue)        priv_trace_hook_queue(pxQueue, trace_queue_send)
+#define traceQUEUE_SEND_FAILED(pxQueue)          priv_trace_hook_queue(pxQueue, trace_queue_send_failed)
+#define traceQUEUE_SEND_FROM_ISR_FAILED(pxQueue) priv_trace_hook_queue(pxQueue, trace_queue_send_failed)
+#define traceBLOCKING_ON_QUEUE_SEND(pxQueue)     priv_trace_hook_queue(pxQueue, trace_queue_send_blocked)
+#define traceQUEUE_RECEIVE(pxQueue)              priv_trace_hook_queue(pxQueue, trace_queue_receive)
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue)     priv_trace_hook_queue(pxQueue, trace_queue_receive)
+#define traceBLOCKING_ON_QUEUE_RECEIVE(pxQueue)  priv_trace_hook_queue(pxQueue, trace_queue_receive_blocked)
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Records a switch to the task now running on the calling core.
+ */
+void trace_hook_task_switched_in(void);
+
+/**
+ * @brief Records an operation on a queue.
+ *
+ * @param[in] queue The queue.
+ * @param[in] op Operation, one of the `trace_queue_*` constants.
+ * @param[in] waiting Items in the queue before the operation.
+ */
+void trace_hook_queue(const void *queue, uint8_t op, uint32_t waiting);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ASSEMBLER__ */
+
+#endif /* TOPOROBO_TRACE_HOOKS_H */
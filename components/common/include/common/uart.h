@@ -63,5 +63,23 @@ esp_err_t priv_uart_init(uint8_t tx_io, uint8_t rx_io, uint32_t baud_rate,
 esp_err_t priv_uart_read(uint8_t *data, size_t len, int32_t *out_length,
                          uart_port_t uart_num, const char *tag);
 
+/**
+ * @brief Write data to the UART interface.
+ *
+ * Blocks until all `len` bytes have been handed to the UART hardware FIFO
+ * (the driver is installed without a TX buffer).
+ *
+ * @param[in] data Pointer to the bytes to send.
+ * @param[in] len Number of bytes to send.
+ * @param[in] uart_num UART port number to communicate over (e.g., UART_NUM_1).
+ * @param[in] tag The tag for logging errors and events.
+ *
+ * @return
+ *   - ESP_OK if all bytes were written.
+ *   - ESP_FAIL otherwise.
+ */
+esp_err_t priv_uart_write(const uint8_t *data, size_t len, uart_port_t uart_num,
+                          const char *tag);
+
 #endif /* TOPOROBO_UART_H */
 
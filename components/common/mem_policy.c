@@ -0,0 +1,240 @@
+/* components/common/mem_policy.c */
+
+#include "common/mem_policy.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "cJSON.h"
+#include "common/metrics.h"
+
+/* Constants ******************************************************************/
+
+static const char *mem_policy_tag = "MEM_POLICY";
+
+/* Macros *********************************************************************/
+
+#define mem_policy_max_choices (2)
+
+/* Structs ********************************************************************/
+
+/**
+ * @brief Where one class is placed, in order of preference.
+ */
+typedef struct {
+  const char *name;
+  const char *labels;                          /* Metric labels */
+  uint32_t    caps[mem_policy_max_choices];    /* 0 ends the list */
+} mem_policy_class_info_t;
+
+/* Globals (Constants) ********************************************************/
+
+static const mem_policy_class_info_t mem_policy_classes[k_mem_policy_count] = {
+  [k_mem_policy_internal] = {
+    .name   = "internal",
+    .labels = "class=\"internal\"",
+    .caps   = { MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, 0 },
+  },
+  [k_mem_policy_dma] = {
+    .name   = "dma",
+    .labels = "class=\"dma\"",
+    .caps   = { MALLOC_CAP_DMA | MALLOC_CAP_8BIT, 0 },
+  },
+  [k_mem_policy_bulk] = {
+    .name   = "bulk",
+    .labels = "class=\"bulk\"",
+    .caps   = { MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT },
+  },
+};
+
+/* Globals (Static) ***********************************************************/
+
+static mem_policy_stats_t s_stats[k_mem_policy_count]           = { 0 };
+static metrics_counter_t  s_failure_metrics[k_mem_policy_count] = { 0 };
+static portMUX_TYPE       s_lock                                = portMUX_INITIALIZER_UNLOCKED;
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Records a successful request served by choice `choice`.
+ */
+static void priv_mem_policy_count(mem_policy_class_t mem_class, size_t size, size_t choice)
+{
+  mem_policy_stats_t *stats = &s_stats[mem_class];
+
+  portENTER_CRITICAL(&s_lock);
+  stats->allocs++;
+  stats->bytes += size;
+  if (choice > 0) {
+    stats->fallbacks++;
+  }
+  if (size > stats->largest) {
+    stats->largest = size;
+  }
+  portEXIT_CRITICAL(&s_lock);
+}
+
+/**
+ * @brief Records and reports a request that no choice could serve.
+ */
+static void priv_mem_policy_fail(mem_policy_class_t mem_class, size_t size)
+{
+  const mem_policy_class_info_t *info = &mem_policy_classes[mem_class];
+
+  portENTER_CRITICAL(&s_lock);
+  s_stats[mem_class].failures++;
+  s_stats[mem_class].last_failed = size;
+  portEXIT_CRITICAL(&s_lock);
+  metrics_counter_inc(&s_failure_metrics[mem_class]);
+
+  for (size_t i = 0; i < mem_policy_max_choices && info->caps[i] != 0; i++) {
+    ESP_LOGE(mem_policy_tag, "%s: %u bytes failed, caps 0x%lx: %u free, largest block %u",
+             info->name, (unsigned)size, (unsigned long)info->caps[i],
+             (unsigned)heap_caps_get_free_size(info->caps[i]),
+             (unsigned)heap_caps_get_largest_free_block(info->caps[i]));
+  }
+
+#if CONFIG_TOPOROBO_MEM_POLICY_ABORT
+  heap_caps_print_heap_info(info->caps[0]);
+  abort();
+#endif
+}
+
+/**
+ * @brief Returns true if a heap with `caps` exists, so a board without PSRAM
+ *        does not count every bulk request as a fallback.
+ */
+static bool priv_mem_policy_caps_present(uint32_t caps)
+{
+  return heap_caps_get_total_size(caps) > 0;
+}
+
+/* Public Functions ***********************************************************/
+
+esp_err_t mem_policy_init(void)
+{
+  for (size_t i = 0; i < k_mem_policy_count; i++) {
+    metrics_counter_register(&s_failure_metrics[i], "toporobo_mem_alloc_failures_total",
+                             "Allocations that no memory of their class could serve.",
+                             mem_policy_classes[i].labels);
+  }
+  return ESP_OK;
+}
+
+void *mem_policy_malloc(mem_policy_class_t mem_class, size_t size)
+{
+  const mem_policy_class_info_t *info  = &mem_policy_classes[mem_class];
+  size_t                         tried = 0;
+
+  for (size_t i = 0; i < mem_policy_max_choices && info->caps[i] != 0; i++) {
+    if (!priv_mem_policy_caps_present(info->caps[i])) {
+      continue;
+    }
+    void *ptr = heap_caps_malloc(size, info->caps[i]);
+    if (ptr != NULL) {
+      priv_mem_policy_count(mem_class, size, tried);
+      return ptr;
+    }
+    tried++;
+  }
+
+  priv_mem_policy_fail(mem_class, size);
+  return NULL;
+}
+
+void *mem_policy_calloc(mem_policy_class_t mem_class, size_t count, size_t size)
+{
+  const mem_policy_class_info_t *info  = &mem_policy_classes[mem_class];
+  size_t                         tried = 0;
+
+  for (size_t i = 0; i < mem_policy_max_choices && info->caps[i] != 0; i++) {
+    if (!priv_mem_policy_caps_present(info->caps[i])) {
+      continue;
+    }
+    void *ptr = heap_caps_calloc(count, size, info->caps[i]);
+    if (ptr != NULL) {
+      priv_mem_policy_count(mem_class, count * size, tried);
+      return ptr;
+    }
+    tried++;
+  }
+
+  priv_mem_policy_fail(mem_class, count * size);
+  return NULL;
+}
+
+void *mem_policy_realloc(mem_policy_class_t mem_class, void *ptr, size_t size)
+{
+  const mem_policy_class_info_t *info  = &mem_policy_classes[mem_class];
+  size_t                         tried = 0;
+
+  if (ptr == NULL) {
+    return mem_policy_malloc(mem_class, size);
+  }
+
+  for (size_t i = 0; i < mem_policy_max_choices && info->caps[i] != 0; i++) {
+    if (!priv_mem_policy_caps_present(info->caps[i])) {
+      continue;
+    }
+    void *grown = heap_caps_realloc(ptr, size, info->caps[i]);
+    if (grown != NULL) {
+      priv_mem_policy_count(mem_class, size, tried);
+      return grown;
+    }
+    tried++;
+  }
+
+  priv_mem_policy_fail(mem_class, size);
+  return NULL;
+}
+
+const char *mem_policy_class_name(mem_policy_class_t mem_class)
+{
+  return (mem_class < k_mem_policy_count) ? mem_policy_classes[mem_class].name : "unknown";
+}
+
+void mem_policy_get_stats(mem_policy_stats_t stats[k_mem_policy_count])
+{
+  portENTER_CRITICAL(&s_lock);
+  for (size_t i = 0; i < k_mem_policy_count; i++) {
+    stats[i] = s_stats[i];
+  }
+  portEXIT_CRITICAL(&s_lock);
+}
+
+char *mem_policy_stats_to_json(void)
+{
+  mem_policy_stats_t stats[k_mem_policy_count];
+  mem_policy_get_stats(stats);
+
+  cJSON *json = cJSON_CreateObject();
+  if (json == NULL) {
+    return NULL;
+  }
+
+  for (size_t i = 0; i < k_mem_policy_count; i++) {
+    cJSON *mem_class = cJSON_AddObjectToObject(json, mem_policy_classes[i].name);
+    if (mem_class == NULL) {
+      cJSON_Delete(json);
+      return NULL;
+    }
+    cJSON_AddNumberToObject(mem_class, "allocs", stats[i].allocs);
+    cJSON_AddNumberToObject(mem_class, "fallbacks", stats[i].fallbacks);
+    cJSON_AddNumberToObject(mem_class, "failures", stats[i].failures);
+    cJSON_AddNumberToObject(mem_class, "bytes", (double)stats[i].bytes);
+    cJSON_AddNumberToObject(mem_class, "largest", stats[i].largest);
+    cJSON_AddNumberToObject(mem_class, "last_failed", stats[i].last_failed);
+
+    /* State of the preferred heap of the class, the first the policy tries */
+    uint32_t caps = mem_policy_classes[i].caps[0];
+    cJSON_AddNumberToObject(mem_class, "free", heap_caps_get_free_size(caps));
+    cJSON_AddNumberToObject(mem_class, "minimum_free", heap_caps_get_minimum_free_size(caps));
+    cJSON_AddNumberToObject(mem_class, "largest_block", heap_caps_get_largest_free_block(caps));
+  }
+
+  char *json_string = cJSON_PrintUnformatted(json);
+  cJSON_Delete(json);
+  return json_string;
+}
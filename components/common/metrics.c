@@ -0,0 +1,325 @@
+/* components/common/metrics.c */
+
+#include "common/metrics.h"
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_attr.h"
+
+/* Macros *********************************************************************/
+
+#define metrics_chunk_bytes (512) /* Text handed to the writer per call */
+#define metrics_line_bytes  (192) /* Longest sample line */
+
+/* Structs ********************************************************************/
+
+/**
+ * @brief Buffered text output of an export, on the caller's stack.
+ */
+typedef struct {
+  metrics_writer_t writer;
+  void            *context;
+  esp_err_t        ret;  /**< First error of the writer */
+  size_t           used; /**< Bytes in `chunk` */
+  char             chunk[metrics_chunk_bytes];
+  char             line[metrics_line_bytes];
+} metrics_output_t;
+
+/* Globals (Constants) ********************************************************/
+
+static const char *metrics_type_names[] = { "counter", "gauge", "histogram" };
+
+/* Globals (Static) ***********************************************************/
+
+static metrics_metric_t *s_head = NULL; /* Registered metrics, in registration order */
+static metrics_metric_t *s_tail = NULL;
+static portMUX_TYPE      s_lock = portMUX_INITIALIZER_UNLOCKED; /* Registration only */
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Links a metric into the registry.
+ */
+static esp_err_t priv_metrics_register(metrics_metric_t *metric, metrics_type_t type,
+                                       const char *name, const char *help, const char *labels)
+{
+  if (metric == NULL || name == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  portENTER_CRITICAL(&s_lock);
+  if (!metric->registered) {
+    metric->next       = NULL;
+    metric->name       = name;
+    metric->help       = (help != NULL) ? help : "";
+    metric->labels     = (labels != NULL && labels[0] != '\0') ? labels : NULL;
+    metric->type       = type;
+    metric->registered = true;
+    if (s_tail != NULL) {
+      s_tail->next = metric;
+    } else {
+      s_head = metric;
+    }
+    s_tail = metric;
+  }
+  portEXIT_CRITICAL(&s_lock);
+  return ESP_OK;
+}
+
+/**
+ * @brief Reads a 64-bit value another core may be updating, without tearing.
+ */
+static uint64_t priv_metrics_read_u64(const volatile uint64_t *value)
+{
+  uint64_t first;
+  uint64_t second;
+
+  do {
+    first  = *value;
+    second = *value;
+  } while (first != second);
+  return first;
+}
+
+/**
+ * @brief Hands the buffered text to the writer.
+ */
+static void priv_metrics_flush(metrics_output_t *output)
+{
+  if (output->ret == ESP_OK && output->used > 0) {
+    output->ret = output->writer(output->context, output->chunk, output->used);
+  }
+  output->used = 0;
+}
+
+/**
+ * @brief Formats a line into the output buffer.
+ */
+static void __attribute__((format(printf, 2, 3)))
+priv_metrics_print(metrics_output_t *output, const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(output->line, sizeof(output->line), format, args);
+  va_end(args);
+
+  if (length < 0 || output->ret != ESP_OK) {
+    return;
+  }
+  if ((size_t)length >= sizeof(output->line)) {
+    length = sizeof(output->line) - 1; /* Truncated by overlong labels */
+  }
+  if (output->used + length > sizeof(output->chunk)) {
+    priv_metrics_flush(output);
+  }
+  memcpy(&output->chunk[output->used], output->line, length);
+  output->used += length;
+}
+
+/**
+ * @brief Writes one sample line: `<name><suffix>{<labels>[,<extra>]} <value>[ <timestamp>]`.
+ */
+static void priv_metrics_print_sample(metrics_output_t *output, const metrics_metric_t *metric,
+                                      const char *suffix, const char *extra, const char *value,
+                                      int64_t timestamp_ms)
+{
+  const char *labels = (metric->labels != NULL) ? metric->labels : "";
+  const char *comma  = (metric->labels != NULL && extra != NULL) ? "," : "";
+  char        stamp[24] = "";
+
+  if (timestamp_ms > 0) {
+    snprintf(stamp, sizeof(stamp), " %lld", (long long)timestamp_ms);
+  }
+  if (metric->labels == NULL && extra == NULL) {
+    priv_metrics_print(output, "%s%s %s%s\n", metric->name, suffix, value, stamp);
+  } else {
+    priv_metrics_print(output, "%s%s{%s%s%s} %s%s\n", metric->name, suffix, labels, comma,
+                       (extra != NULL) ? extra : "", value, stamp);
+  }
+}
+
+/**
+ * @brief Writes the sample lines of one series.
+ */
+static void priv_metrics_print_series(metrics_output_t *output, const metrics_metric_t *metric,
+                                      int64_t timestamp_ms)
+{
+  char value[32];
+
+  switch (metric->type) {
+    case k_metrics_type_counter: {
+      snprintf(value, sizeof(value), "%" PRIu64,
+               metrics_counter_value((const metrics_counter_t *)metric));
+      priv_metrics_print_sample(output, metric, "", NULL, value, timestamp_ms);
+      break;
+    }
+    case k_metrics_type_gauge: {
+      snprintf(value, sizeof(value), "%.7g",
+               (double)metrics_gauge_value((const metrics_gauge_t *)metric));
+      priv_metrics_print_sample(output, metric, "", NULL, value, timestamp_ms);
+      break;
+    }
+    case k_metrics_type_histogram: {
+      const metrics_histogram_t *histogram = (const metrics_histogram_t *)metric;
+      uint64_t                   total     = 0;
+      double                     sum       = 0.0;
+      char                       le[32];
+
+      for (uint8_t bucket = 0; bucket <= histogram->bucket_count; bucket++) {
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+          total += ((const volatile uint32_t *)histogram->counts[core])[bucket];
+        }
+        if (bucket < histogram->bucket_count) {
+          snprintf(le, sizeof(le), "le=\"%g\"", (double)histogram->bounds[bucket]);
+        } else {
+          snprintf(le, sizeof(le), "le=\"+Inf\"");
+        }
+        snprintf(value, sizeof(value), "%" PRIu64, total);
+        priv_metrics_print_sample(output, metric, "_bucket", le, value, timestamp_ms);
+      }
+      for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        sum += histogram->sum[core];
+      }
+      snprintf(value, sizeof(value), "%.7g", sum);
+      priv_metrics_print_sample(output, metric, "_sum", NULL, value, timestamp_ms);
+      snprintf(value, sizeof(value), "%" PRIu64, total);
+      priv_metrics_print_sample(output, metric, "_count", NULL, value, timestamp_ms);
+      break;
+    }
+  }
+}
+
+/* Public Functions ***********************************************************/
+
+esp_err_t metrics_counter_register(metrics_counter_t *counter, const char *name,
+                                   const char *help, const char *labels)
+{
+  return priv_metrics_register((metrics_metric_t *)counter, k_metrics_type_counter, name, help,
+                               labels);
+}
+
+void IRAM_ATTR metrics_counter_add(metrics_counter_t *counter, uint32_t value)
+{
+  /* Masking interrupts pins the caller to this core and makes the 64-bit
+   * add atomic against anything else running on it */
+  UBaseType_t state                   = portSET_INTERRUPT_MASK_FROM_ISR();
+  counter->per_core[xPortGetCoreID()] += value;
+  portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+}
+
+uint64_t metrics_counter_value(const metrics_counter_t *counter)
+{
+  uint64_t total = 0;
+
+  for (int core = 0; core < portNUM_PROCESSORS; core++) {
+    total += priv_metrics_read_u64(&counter->per_core[core]);
+  }
+  return total;
+}
+
+esp_err_t metrics_gauge_register(metrics_gauge_t *gauge, const char *name, const char *help,
+                                 const char *labels)
+{
+  return priv_metrics_register((metrics_metric_t *)gauge, k_metrics_type_gauge, name, help,
+                               labels);
+}
+
+void metrics_gauge_set(metrics_gauge_t *gauge, float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  __atomic_store_n(&gauge->bits, bits, __ATOMIC_RELAXED);
+}
+
+void metrics_gauge_add(metrics_gauge_t *gauge, float delta)
+{
+  uint32_t expected = __atomic_load_n(&gauge->bits, __ATOMIC_RELAXED);
+  uint32_t desired;
+
+  do {
+    float value;
+    memcpy(&value, &expected, sizeof(value));
+    value += delta;
+    memcpy(&desired, &value, sizeof(desired));
+  } while (!__atomic_compare_exchange_n(&gauge->bits, &expected, desired, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+float metrics_gauge_value(const metrics_gauge_t *gauge)
+{
+  uint32_t bits = __atomic_load_n(&gauge->bits, __ATOMIC_RELAXED);
+  float    value;
+
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+esp_err_t metrics_histogram_register(metrics_histogram_t *histogram, const char *name,
+                                     const char *help, const char *labels,
+                                     const float *bounds, uint8_t bucket_count)
+{
+  if (histogram == NULL || bounds == NULL || bucket_count == 0 ||
+      bucket_count > metrics_max_buckets) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (uint8_t i = 1; i < bucket_count; i++) {
+    if (!(bounds[i] > bounds[i - 1])) {
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+
+  if (!histogram->metric.registered) {
+    histogram->bounds       = bounds;
+    histogram->bucket_count = bucket_count;
+  }
+  return priv_metrics_register((metrics_metric_t *)histogram, k_metrics_type_histogram, name,
+                               help, labels);
+}
+
+void metrics_histogram_observe(metrics_histogram_t *histogram, float value)
+{
+  uint8_t bucket = 0;
+  while (bucket < histogram->bucket_count && value > histogram->bounds[bucket]) {
+    bucket++;
+  }
+
+  UBaseType_t state = portSET_INTERRUPT_MASK_FROM_ISR();
+  int         core  = xPortGetCoreID();
+  histogram->counts[core][bucket]++;
+  histogram->sum[core] += value;
+  portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+}
+
+esp_err_t metrics_export(int64_t timestamp_ms, metrics_writer_t writer, void *context)
+{
+  metrics_output_t output = {
+    .writer  = writer,
+    .context = context,
+    .ret     = ESP_OK,
+    .used    = 0,
+  };
+
+  /* Metrics are only ever appended, so the list can be walked unlocked */
+  for (const metrics_metric_t *metric = s_head; metric != NULL; metric = metric->next) {
+    /* Series of a name are written together, under the first one's header */
+    const metrics_metric_t *first = s_head;
+    while (strcmp(first->name, metric->name) != 0) {
+      first = first->next;
+    }
+    if (first != metric) {
+      continue;
+    }
+
+    priv_metrics_print(&output, "# HELP %s %s\n# TYPE %s %s\n", metric->name, metric->help,
+                       metric->name, metrics_type_names[metric->type]);
+    for (const metrics_metric_t *series = metric; series != NULL; series = series->next) {
+      if (strcmp(series->name, metric->name) == 0) {
+        priv_metrics_print_series(&output, series, timestamp_ms);
+      }
+    }
+  }
+
+  priv_metrics_flush(&output);
+  return output.ret;
+}
@@ -0,0 +1,238 @@
+/* components/common/power.c */
+
+#include "common/power.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "cJSON.h"
+
+/* Macros *********************************************************************/
+
+#define power_dump_bytes (1024) /* Space for the esp_pm_dump_locks report */
+
+/* Globals (Constants) ********************************************************/
+
+const char *power_tag              = "POWER";
+const int   power_min_cpu_freq_mhz = 80;
+
+/**
+ * @brief Type and name of each `power_lock_t`.
+ */
+static const struct {
+  esp_pm_lock_type_t type;
+  const char        *name;
+} power_lock_configs[k_power_lock_count] = {
+  { ESP_PM_CPU_FREQ_MAX,    "dht22" }, /* k_power_lock_dht22 */
+  { ESP_PM_APB_FREQ_MAX,    "i2c"   }, /* k_power_lock_i2c */
+  { ESP_PM_APB_FREQ_MAX,    "servo" }, /* k_power_lock_servo */
+  { ESP_PM_NO_LIGHT_SLEEP,  "imu"   }, /* k_power_lock_imu */
+  { ESP_PM_NO_LIGHT_SLEEP,  "gps"   }, /* k_power_lock_gps */
+};
+
+/* Globals (Static) ***********************************************************/
+
+static esp_pm_lock_handle_t s_locks[k_power_lock_count];     /* NULL when PM is disabled */
+static power_lock_stats_t   s_lock_stats[k_power_lock_count];
+static uint32_t             s_lock_depth[k_power_lock_count];
+static int64_t              s_lock_since_us[k_power_lock_count];
+static portMUX_TYPE         s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Private Functions **********************************************************/
+
+#if CONFIG_PM_ENABLE
+
+/**
+ * @brief Add the per-mode residency from `esp_pm_dump_locks` to a JSON object.
+ *
+ * The dump is captured into a memory stream; its "Mode stats" rows
+ * (`<mode> <freq> <time_us> <percent>%`) are parsed into `modes`, and the
+ * whole text is kept as `pm_dump` for anything the parser does not cover.
+ */
+static void priv_power_add_residency(cJSON *json)
+{
+  static char dump[power_dump_bytes];
+
+  memset(dump, 0, sizeof(dump));
+  FILE *stream = fmemopen(dump, sizeof(dump) - 1, "w");
+  if (stream == NULL) {
+    ESP_LOGW(power_tag, "Failed to open memory stream for PM dump");
+    return;
+  }
+  esp_pm_dump_locks(stream);
+  fclose(stream);
+
+  cJSON_AddStringToObject(json, "pm_dump", dump);
+
+  cJSON *modes = cJSON_AddObjectToObject(json, "modes");
+  if (modes == NULL) {
+    return;
+  }
+
+  bool  in_modes = false;
+  char *save     = NULL;
+  for (char *line = strtok_r(dump, "\n", &save); line != NULL;
+       line = strtok_r(NULL, "\n", &save)) {
+    if (strstr(line, "Mode stats") != NULL) {
+      in_modes = true;
+      continue;
+    }
+    if (!in_modes) {
+      continue;
+    }
+
+    char     mode[16];
+    char     freq[16];
+    uint64_t time_us = 0;
+    uint32_t percent = 0;
+    if (sscanf(line, "%15s %15s %" SCNu64 " %" SCNu32, mode, freq, &time_us, &percent) == 4) {
+      cJSON *entry = cJSON_AddObjectToObject(modes, mode);
+      if (entry != NULL) {
+        cJSON_AddStringToObject(entry, "cpu_freq", freq);
+        cJSON_AddNumberToObject(entry, "time_us", (double)time_us);
+        cJSON_AddNumberToObject(entry, "percent", percent);
+      }
+    }
+  }
+}
+
+#endif /* CONFIG_PM_ENABLE */
+
+/* Public Functions ***********************************************************/
+
+esp_err_t power_init(void)
+{
+  esp_pm_config_t config = {
+    .max_freq_mhz       = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+    .min_freq_mhz       = power_min_cpu_freq_mhz,
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    .light_sleep_enable = true,
+#else
+    .light_sleep_enable = false,
+#endif
+  };
+
+  esp_err_t ret = esp_pm_configure(&config);
+  if (ret == ESP_ERR_NOT_SUPPORTED) {
+    ESP_LOGW(power_tag, "Power management disabled in this build (CONFIG_PM_ENABLE)");
+    return ESP_OK;
+  }
+  if (ret != ESP_OK) {
+    ESP_LOGE(power_tag, "Failed to configure power management: %s", esp_err_to_name(ret));
+    return ret;
+  }
+
+  for (uint8_t i = 0; i < k_power_lock_count; i++) {
+    ret = esp_pm_lock_create(power_lock_configs[i].type, 0, power_lock_configs[i].name,
+                             &s_locks[i]);
+    if (ret != ESP_OK) {
+      ESP_LOGE(power_tag, "Failed to create PM lock %s: %s", power_lock_configs[i].name,
+               esp_err_to_name(ret));
+      return ret;
+    }
+  }
+
+  ESP_LOGI(power_tag, "DFS %d-%d MHz, light sleep %s", config.min_freq_mhz,
+           config.max_freq_mhz, config.light_sleep_enable ? "enabled" : "disabled");
+  return ESP_OK;
+}
+
+void power_lock_acquire(power_lock_t lock)
+{
+  if (lock >= k_power_lock_count || s_locks[lock] == NULL) {
+    return;
+  }
+
+  esp_pm_lock_acquire(s_locks[lock]);
+
+  portENTER_CRITICAL(&s_stats_lock);
+  if (s_lock_depth[lock]++ == 0) {
+    s_lock_since_us[lock] = esp_timer_get_time();
+    s_lock_stats[lock].acquire_count++;
+  }
+  portEXIT_CRITICAL(&s_stats_lock);
+}
+
+void power_lock_release(power_lock_t lock)
+{
+  if (lock >= k_power_lock_count || s_locks[lock] == NULL) {
+    return;
+  }
+
+  portENTER_CRITICAL(&s_stats_lock);
+  if (s_lock_depth[lock] > 0 && --s_lock_depth[lock] == 0) {
+    s_lock_stats[lock].held_us += esp_timer_get_time() - s_lock_since_us[lock];
+  }
+  portEXIT_CRITICAL(&s_stats_lock);
+
+  esp_pm_lock_release(s_locks[lock]);
+}
+
+esp_err_t power_get_lock_stats(power_lock_t lock, power_lock_stats_t *stats)
+{
+  if (lock >= k_power_lock_count || stats == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  portENTER_CRITICAL(&s_stats_lock);
+  *stats = s_lock_stats[lock];
+  if (s_lock_depth[lock] > 0) {
+    stats->held_us += esp_timer_get_time() - s_lock_since_us[lock]; /* Still held */
+  }
+  portEXIT_CRITICAL(&s_stats_lock);
+
+  return ESP_OK;
+}
+
+char *power_stats_to_json(void)
+{
+  cJSON *json = cJSON_CreateObject();
+  if (!json) {
+    ESP_LOGE(power_tag, "Failed to create JSON object.");
+    return NULL;
+  }
+
+  cJSON_AddNumberToObject(json, "uptime_us", (double)esp_timer_get_time());
+  cJSON_AddNumberToObject(json, "min_freq_mhz", power_min_cpu_freq_mhz);
+  cJSON_AddNumberToObject(json, "max_freq_mhz", CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+
+  cJSON *locks = cJSON_AddObjectToObject(json, "locks");
+  if (!locks) {
+    ESP_LOGE(power_tag, "Failed to add locks to JSON.");
+    cJSON_Delete(json);
+    return NULL;
+  }
+
+  for (uint8_t i = 0; i < k_power_lock_count; i++) {
+    power_lock_stats_t stats;
+    power_get_lock_stats((power_lock_t)i, &stats);
+
+    cJSON *entry = cJSON_AddObjectToObject(locks, power_lock_configs[i].name);
+    if (!entry) {
+      ESP_LOGE(power_tag, "Failed to add lock %s to JSON.", power_lock_configs[i].name);
+      cJSON_Delete(json);
+      return NULL;
+    }
+    cJSON_AddNumberToObject(entry, "acquire_count", stats.acquire_count);
+    cJSON_AddNumberToObject(entry, "held_us", (double)stats.held_us);
+  }
+
+#if CONFIG_PM_ENABLE
+  priv_power_add_residency(json);
+#endif
+
+  char *json_string = cJSON_PrintUnformatted(json);
+  if (!json_string) {
+    ESP_LOGE(power_tag, "Failed to serialize JSON object.");
+    cJSON_Delete(json);
+    return NULL;
+  }
+
+  cJSON_Delete(json);
+  return json_string;
+}
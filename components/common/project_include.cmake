@@ -0,0 +1,11 @@
+# components/common/project_include.cmake
+
+# Included by ESP-IDF before any component is processed, so the options set
+# here reach every component, FreeRTOS (tasks.c, queue.c) included.
+
+if(CONFIG_TOPOROBO_TRACE)
+  # FreeRTOS reads its trace hook macros from FreeRTOS.h, so they have to be
+  # defined in every translation unit, the kernel's included
+  idf_build_set_property(COMPILE_OPTIONS
+    "-include${CMAKE_CURRENT_LIST_DIR}/include/common/trace_hooks.h" APPEND)
+endif()
@@ -0,0 +1,91 @@
+/* components/common/report_filter.c */
+
+#include "common/report_filter.h"
+#include <math.h>
+#include <string.h>
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Tells whether `value` left the deadband of `channel` around `last`.
+ *
+ * The deadband is the wider of the absolute and the relative one, so the
+ * absolute deadband is a floor near zero and the relative one takes over for
+ * large values.
+ */
+static bool priv_report_filter_exceeds(const report_filter_channel_t *channel, float last,
+                                       float value)
+{
+  float change   = fabsf(value - last);
+  float deadband = fmaxf(fmaxf(channel->abs_deadband, 0.0f),
+                         fmaxf(channel->rel_deadband, 0.0f) * fabsf(last));
+
+  return change > deadband;
+}
+
+/* Public Functions ***********************************************************/
+
+esp_err_t report_filter_init(report_filter_t *filter, const report_filter_channel_t *channels,
+                             uint8_t channel_count, uint32_t max_silence_ms)
+{
+  if (filter == NULL || channel_count > report_filter_max_channels ||
+      (channel_count > 0 && channels == NULL)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  memset(filter, 0, sizeof(*filter));
+  filter->channels       = channels;
+  filter->channel_count  = channel_count;
+  filter->max_silence_ms = max_silence_ms;
+  return ESP_OK;
+}
+
+float report_filter_read(report_filter_type_t type, const void *field)
+{
+  switch (type) {
+    case k_report_filter_float: {
+      float value;
+      memcpy(&value, field, sizeof(value));
+      return value;
+    }
+    case k_report_filter_uint16: {
+      uint16_t value;
+      memcpy(&value, field, sizeof(value));
+      return (float)value;
+    }
+    case k_report_filter_uint8:
+      return (float)*(const uint8_t *)field;
+    default:
+      return 0.0f;
+  }
+}
+
+bool report_filter_check(report_filter_t *filter, const void *sample, int64_t now_us)
+{
+  bool report = !filter->primed || filter->channel_count == 0;
+
+  float values[report_filter_max_channels];
+  for (uint8_t i = 0; i < filter->channel_count; i++) {
+    values[i] = report_filter_read(filter->channels[i].type,
+                                   (const uint8_t *)sample + filter->channels[i].offset);
+    if (!report && priv_report_filter_exceeds(&filter->channels[i], filter->last[i], values[i])) {
+      report = true;
+    }
+  }
+
+  if (!report && filter->max_silence_ms > 0 &&
+      now_us - filter->last_report_us >= (int64_t)filter->max_silence_ms * 1000) {
+    report = true; /* Heartbeat */
+  }
+
+  if (!report) {
+    filter->suppressed++;
+    return false;
+  }
+
+  memcpy(filter->last, values, filter->channel_count * sizeof(float));
+  filter->last_report_us = now_us;
+  filter->primed         = true;
+  filter->reported++;
+  return true;
+}
@@ -0,0 +1,136 @@
+/* components/common/rtos_alloc.c */
+
+#include "common/rtos_alloc.h"
+#include "esp_log.h"
+
+/* Globals (Constants) ********************************************************/
+
+static const char *rtos_alloc_tag = "RTOS_ALLOC";
+
+/* Private Functions **********************************************************/
+
+esp_err_t priv_rtos_task_create(TaskFunction_t task_function, const char *name,
+                                uint32_t stack_bytes, void *param, UBaseType_t priority,
+                                TaskHandle_t *handle, BaseType_t core_id,
+                                rtos_task_storage_t *storage)
+{
+  TaskHandle_t created = NULL;
+
+#if CONFIG_TOPOROBO_STATIC_ALLOCATION
+  if (storage == NULL || storage->stack_bytes < stack_bytes) {
+    ESP_LOGE(rtos_alloc_tag, "No static stack of %lu bytes for task %s",
+             (unsigned long)stack_bytes, name);
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  /* On the ESP32 StackType_t is a byte, so the depth is the size in bytes */
+  created = xTaskCreateStaticPinnedToCore(task_function, name, storage->stack_bytes,
+                                          param, priority, storage->stack,
+                                          &(storage->tcb), core_id);
+#else
+  (void)storage;
+  if (xTaskCreatePinnedToCore(task_function, name, stack_bytes, param, priority,
+                              &created, core_id) != pdPASS) {
+    created = NULL;
+  }
+#endif
+
+  if (created == NULL) {
+    ESP_LOGE(rtos_alloc_tag, "Failed to create task %s", name);
+    return ESP_ERR_NO_MEM;
+  }
+
+  if (handle != NULL) {
+    *handle = created;
+  }
+  return ESP_OK;
+}
+
+QueueHandle_t priv_rtos_queue_create(uint32_t length, uint32_t item_size,
+                                     rtos_queue_storage_t *storage)
+{
+#if CONFIG_TOPOROBO_STATIC_ALLOCATION
+  if (storage == NULL || storage->length < length || storage->item_size != item_size) {
+    ESP_LOGE(rtos_alloc_tag, "No static storage for a queue of %lu x %lu bytes",
+             (unsigned long)length, (unsigned long)item_size);
+    return NULL;
+  }
+  return xQueueCreateStatic(length, item_size, storage->buffer, &(storage->queue));
+#else
+  (void)storage;
+  return xQueueCreate(length, item_size);
+#endif
+}
+
+SemaphoreHandle_t priv_rtos_mutex_create(StaticSemaphore_t *storage)
+{
+#if CONFIG_TOPOROBO_STATIC_ALLOCATION
+  if (storage == NULL) {
+    ESP_LOGE(rtos_alloc_tag, "No static storage for a mutex");
+    return NULL;
+  }
+  return xSemaphoreCreateMutexStatic(storage);
+#else
+  (void)storage;
+  return xSemaphoreCreateMutex();
+#endif
+}
+
+SemaphoreHandle_t priv_rtos_recursive_mutex_create(StaticSemaphore_t *storage)
+{
+#if CONFIG_TOPOROBO_STATIC_ALLOCATION
+  if (storage == NULL) {
+    ESP_LOGE(rtos_alloc_tag, "No static storage for a recursive mutex");
+    return NULL;
+  }
+  return xSemaphoreCreateRecursiveMutexStatic(storage);
+#else
+  (void)storage;
+  return xSemaphoreCreateRecursiveMutex();
+#endif
+}
+
+SemaphoreHandle_t priv_rtos_binary_semaphore_create(StaticSemaphore_t *storage)
+{
+#if CONFIG_TOPOROBO_STATIC_ALLOCATION
+  if (storage == NULL) {
+    ESP_LOGE(rtos_alloc_tag, "No static storage for a binary semaphore");
+    return NULL;
+  }
+  return xSemaphoreCreateBinaryStatic(storage);
+#else
+  (void)storage;
+  return xSemaphoreCreateBinary();
+#endif
+}
+
+EventGroupHandle_t priv_rtos_event_group_create(StaticEventGroup_t *storage)
+{
+#if CONFIG_TOPOROBO_STATIC_ALLOCATION
+  if (storage == NULL) {
+    ESP_LOGE(rtos_alloc_tag, "No static storage for an event group");
+    return NULL;
+  }
+  return xEventGroupCreateStatic(storage);
+#else
+  (void)storage;
+  return xEventGroupCreate();
+#endif
+}
+
+TimerHandle_t priv_rtos_timer_create(const char *name, TickType_t period_ticks,
+                                     UBaseType_t auto_reload, void *timer_id,
+                                     TimerCallbackFunction_t callback,
+                                     StaticTimer_t *storage)
+{
+#if CONFIG_TOPOROBO_STATIC_ALLOCATION
+  if (storage == NULL) {
+    ESP_LOGE(rtos_alloc_tag, "No static storage for timer %s", name);
+    return NULL;
+  }
+  return xTimerCreateStatic(name, period_ticks, auto_reload, timer_id, callback, storage);
+#else
+  (void)storage;
+  return xTimerCreate(name, period_ticks, auto_reload, timer_id, callback);
+#endif
+}
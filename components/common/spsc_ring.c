@@ -0,0 +1,117 @@
+/* components/common/spsc_ring.c */
+
+#include "common/spsc_ring.h"
+#include <string.h>
+#include "esp_attr.h"
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Address of the item at free-running index `index`.
+ */
+static inline uint8_t *priv_spsc_ring_item(const spsc_ring_t *ring, uint32_t index)
+{
+  return ring->buffer + (size_t)(index & (ring->capacity - 1)) * ring->item_size;
+}
+
+/* Public Functions ***********************************************************/
+
+esp_err_t spsc_ring_init(spsc_ring_t *ring, void *buffer, uint32_t capacity,
+                         uint32_t item_size)
+{
+  if (ring == NULL || buffer == NULL || item_size == 0 || capacity == 0 ||
+      (capacity & (capacity - 1)) != 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  ring->buffer     = buffer;
+  ring->capacity   = capacity;
+  ring->item_size  = item_size;
+  ring->head       = 0;
+  ring->tail       = 0;
+  ring->overflows  = 0;
+  ring->high_water = 0;
+  return ESP_OK;
+}
+
+void *IRAM_ATTR spsc_ring_reserve(spsc_ring_t *ring)
+{
+  uint32_t head = ring->head; /* Only the producer writes it */
+  uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+  if (head - tail >= ring->capacity) {
+    ring->overflows++;
+    return NULL;
+  }
+  return priv_spsc_ring_item(ring, head);
+}
+
+void IRAM_ATTR spsc_ring_commit(spsc_ring_t *ring)
+{
+  uint32_t head      = ring->head + 1;
+  uint32_t occupancy = head - __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+
+  if (occupancy > ring->high_water) {
+    ring->high_water = occupancy;
+  }
+  __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE); /* Item is written first */
+}
+
+esp_err_t IRAM_ATTR spsc_ring_push(spsc_ring_t *ring, const void *item, size_t size)
+{
+  if (size > ring->item_size) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  void *slot = spsc_ring_reserve(ring);
+  if (slot == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  memcpy(slot, item, size);
+  spsc_ring_commit(ring);
+  return ESP_OK;
+}
+
+void *IRAM_ATTR spsc_ring_peek(spsc_ring_t *ring)
+{
+  uint32_t tail = ring->tail; /* Only the consumer writes it */
+  uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+  if (head == tail) {
+    return NULL;
+  }
+  return priv_spsc_ring_item(ring, tail);
+}
+
+void IRAM_ATTR spsc_ring_consume(spsc_ring_t *ring)
+{
+  /* Release so the producer cannot reuse the item before we are done with it */
+  __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
+
+esp_err_t IRAM_ATTR spsc_ring_pop(spsc_ring_t *ring, void *item)
+{
+  void *slot = spsc_ring_peek(ring);
+  if (slot == NULL) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  memcpy(item, slot, ring->item_size);
+  spsc_ring_consume(ring);
+  return ESP_OK;
+}
+
+uint32_t spsc_ring_occupancy(const spsc_ring_t *ring)
+{
+  uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  return head - tail;
+}
+
+void spsc_ring_get_stats(const spsc_ring_t *ring, spsc_ring_stats_t *stats)
+{
+  stats->capacity   = ring->capacity;
+  stats->occupancy  = spsc_ring_occupancy(ring);
+  stats->high_water = __atomic_load_n(&ring->high_water, __ATOMIC_RELAXED);
+  stats->pushed     = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+  stats->overflows  = __atomic_load_n(&ring->overflows, __ATOMIC_RELAXED);
+}
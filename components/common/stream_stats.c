@@ -0,0 +1,57 @@
+/* components/common/stream_stats.c */
+
+#include "common/stream_stats.h"
+#include <math.h>
+#include <string.h>
+
+/* Public Functions ***********************************************************/
+
+void stream_stats_reset(stream_stats_t *stats)
+{
+  memset(stats, 0, sizeof(*stats));
+}
+
+void stream_stats_add(stream_stats_t *stats, float value)
+{
+  if (stats->count == 0 || value < stats->min) {
+    stats->min = value;
+  }
+  if (stats->count == 0 || value > stats->max) {
+    stats->max = value;
+  }
+
+  stats->count++;
+  double delta  = (double)value - stats->mean;
+  stats->mean  += delta / stats->count;
+  stats->m2    += delta * ((double)value - stats->mean);
+}
+
+void stream_stats_merge(stream_stats_t *stats, const stream_stats_t *other)
+{
+  if (other->count == 0) {
+    return;
+  }
+  if (stats->count == 0) {
+    *stats = *other;
+    return;
+  }
+
+  double count = (double)stats->count + other->count;
+  double delta = other->mean - stats->mean;
+
+  stats->mean += delta * other->count / count;
+  stats->m2   += other->m2 + delta * delta * stats->count * other->count / count;
+  stats->min   = fminf(stats->min, other->min);
+  stats->max   = fmaxf(stats->max, other->max);
+  stats->count += other->count;
+}
+
+float stream_stats_variance(const stream_stats_t *stats)
+{
+  return (stats->count > 1) ? (float)(stats->m2 / (stats->count - 1)) : 0.0f;
+}
+
+float stream_stats_stddev(const stream_stats_t *stats)
+{
+  return sqrtf(stream_stats_variance(stats));
+}
@@ -0,0 +1,476 @@
+/* components/common/trace.c */
+
+#include "common/trace.h"
+#include "common/trace_hooks.h"
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "common/mem_policy.h"
+
+/* Globals (Constants) ********************************************************/
+
+static const char *trace_category_names[k_trace_category_count] = {
+  "task", "queue", "i2c", "http", "sd",
+};
+
+#if CONFIG_TOPOROBO_TRACE
+
+static const char *trace_tag = "TRACE";
+
+/* Macros *********************************************************************/
+
+#define trace_ring_records (CONFIG_TOPOROBO_TRACE_RECORDS)
+#define trace_kind_queue   (0x10) /* Kind of a queue hook record: trace_kind_queue | op */
+#define trace_chunk_bytes  (1024) /* JSON handed to the writer per call */
+#define trace_line_bytes   (224)  /* Longest JSON event */
+#define trace_pid_cpus     (1)    /* Chrome trace process of the per-core tracks */
+#define trace_pid_tasks    (2)    /* Chrome trace process of the per-task tracks */
+
+/* Structs ********************************************************************/
+
+/**
+ * @brief One event, 16 bytes.
+ */
+typedef struct {
+  uint32_t    time_us;  /**< Low 32 bits of the esp_timer time */
+  const void *subject;  /**< Event name, the queue of a queue event, NULL for a task switch */
+  const void *task;     /**< Running task (switched in for a switch), NULL in an ISR */
+  uint16_t    arg;      /**< Number shown with the event */
+  uint8_t     category; /**< trace_category_t */
+  uint8_t     kind;     /**< trace_phase_t, or trace_kind_queue | queue operation */
+} trace_record_t;
+
+/**
+ * @brief Circular buffer of the events of one core.
+ *
+ * `head` is free running, the newest `trace_ring_records` records are kept.
+ * Record times are only 32 bits, `last_us` anchors them: the export works
+ * back from it, so they wrap harmlessly as long as no core goes 71 minutes
+ * without an event.
+ */
+typedef struct {
+  portMUX_TYPE   lock;
+  uint32_t       head;    /**< Records written since the last clear */
+  int64_t        last_us; /**< Full time of the newest record */
+  trace_record_t records[trace_ring_records];
+} trace_ring_t;
+
+/**
+ * @brief Read position of the export in one ring.
+ */
+typedef struct {
+  uint32_t index;   /**< Next record, free running like `head` */
+  uint32_t end;     /**< `head` when the export started */
+  int64_t  time_us; /**< Full time of the record at `index` */
+} trace_cursor_t;
+
+/**
+ * @brief Buffered JSON output of an export.
+ */
+typedef struct {
+  trace_writer_t writer;
+  void          *context;
+  esp_err_t      ret;  /**< First error of the writer */
+  size_t         used; /**< Bytes in `chunk` */
+  char           chunk[trace_chunk_bytes];
+  char           line[trace_line_bytes];
+} trace_output_t;
+
+/* Globals (Static) ***********************************************************/
+
+static trace_ring_t   s_rings[portNUM_PROCESSORS] = {
+  [0 ... portNUM_PROCESSORS - 1] = { .lock = portMUX_INITIALIZER_UNLOCKED },
+};
+static uint32_t       s_categories = trace_all_categories; /* Recorded from boot */
+static bool           s_paused     = false;                /* An export is reading the rings */
+static portMUX_TYPE   s_lock       = portMUX_INITIALIZER_UNLOCKED;
+static trace_output_t s_output; /* Export only, guarded by `s_paused` */
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Appends a record to the ring of the calling core.
+ *
+ * Runs from the scheduler and from ISRs, possibly with the flash cache
+ * disabled, hence in IRAM and without anything but the ring lock.
+ */
+static void IRAM_ATTR priv_trace_write(uint8_t category, uint8_t kind, const void *subject,
+                                       const void *task, uint16_t arg)
+{
+  if ((s_categories & trace_category_bit(category)) == 0) {
+    return;
+  }
+
+  trace_ring_t *ring = &s_rings[xPortGetCoreID()];
+
+  portENTER_CRITICAL_SAFE(&ring->lock);
+  if (!s_paused && (s_categories & trace_category_bit(category))) {
+    int64_t         now    = esp_timer_get_time();
+    trace_record_t *record = &ring->records[ring->head % trace_ring_records];
+
+    record->time_us  = (uint32_t)now;
+    record->subject  = subject;
+    record->task     = task;
+    record->arg      = arg;
+    record->category = category;
+    record->kind     = kind;
+    ring->last_us    = now;
+    ring->head++;
+  }
+  portEXIT_CRITICAL_SAFE(&ring->lock);
+}
+
+/**
+ * @brief The running task, NULL in an ISR.
+ */
+FORCE_INLINE_ATTR const void *priv_trace_current_task(void)
+{
+  return xPortInIsrContext() ? NULL : (const void *)xTaskGetCurrentTaskHandle();
+}
+
+/**
+ * @brief Hands the buffered JSON to the writer.
+ */
+static void priv_trace_flush(trace_output_t *output)
+{
+  if (output->ret == ESP_OK && output->used > 0) {
+    output->ret = output->writer(output->context, output->chunk, output->used);
+  }
+  output->used = 0;
+}
+
+/**
+ * @brief Formats a piece of JSON into the output buffer.
+ */
+static void __attribute__((format(printf, 2, 3)))
+priv_trace_print(trace_output_t *output, const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(output->line, sizeof(output->line), format, args);
+  va_end(args);
+
+  if (length < 0 || output->ret != ESP_OK) {
+    return;
+  }
+  if ((size_t)length >= sizeof(output->line)) {
+    length = sizeof(output->line) - 1; /* Cannot happen with the formats below */
+  }
+  if (output->used + length > sizeof(output->chunk)) {
+    priv_trace_flush(output);
+  }
+  memcpy(&output->chunk[output->used], output->line, length);
+  output->used += length;
+}
+
+/**
+ * @brief Looks up a task in the task list of the export.
+ *
+ * @return The task, or NULL if it no longer exists.
+ */
+static const TaskStatus_t *priv_trace_find_task(const TaskStatus_t *tasks, UBaseType_t count,
+                                                const void *task)
+{
+  for (UBaseType_t i = 0; i < count; i++) {
+    if ((const void *)tasks[i].xHandle == task) {
+      return &tasks[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Chrome trace thread id of a task: its FreeRTOS task number, 0 for
+ *        ISRs and the TCB address for a task deleted since.
+ */
+static uint32_t priv_trace_tid(const TaskStatus_t *tasks, UBaseType_t count, const void *task)
+{
+  if (task == NULL) {
+    return 0;
+  }
+  const TaskStatus_t *status = priv_trace_find_task(tasks, count, task);
+  return (status != NULL) ? (uint32_t)status->xTaskNumber : (uint32_t)(uintptr_t)task;
+}
+
+/**
+ * @brief Writes the slice of `task` running on `core` from `start_us` to `end_us`.
+ */
+static void priv_trace_print_slice(trace_output_t *output, const TaskStatus_t *tasks,
+                                   UBaseType_t count, int core, const void *task,
+                                   int64_t start_us, int64_t end_us)
+{
+  const TaskStatus_t *status = priv_trace_find_task(tasks, count, task);
+
+  if (status != NULL) {
+    priv_trace_print(output, ",\n{\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%lld,\"dur\":%lld,"
+                     "\"name\":\"%s\",\"cat\":\"task\"}", trace_pid_cpus, core,
+                     (long long)start_us, (long long)(end_us - start_us), status->pcTaskName);
+  } else {
+    priv_trace_print(output, ",\n{\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%lld,\"dur\":%lld,"
+                     "\"name\":\"task 0x%08" PRIx32 "\",\"cat\":\"task\"}", trace_pid_cpus, core,
+                     (long long)start_us, (long long)(end_us - start_us),
+                     (uint32_t)(uintptr_t)task);
+  }
+}
+
+/**
+ * @brief Writes a marked event or a queue event on the track of its task.
+ */
+static void priv_trace_print_event(trace_output_t *output, const TaskStatus_t *tasks,
+                                   UBaseType_t count, const trace_record_t *record,
+                                   int64_t time_us)
+{
+  static const char *phases[]   = { "\"B\"", "\"E\"", "\"i\",\"s\":\"t\"" };
+  static const char *queue_ops[] = {
+    "send", "send failed", "send blocked", "receive", "receive blocked",
+  };
+  uint32_t           tid         = priv_trace_tid(tasks, count, record->task);
+  const char        *category    = trace_category_names[record->category];
+
+  if (record->kind >= trace_kind_queue) {
+    uint8_t op = record->kind - trace_kind_queue;
+    priv_trace_print(output, ",\n{\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%" PRIu32
+                     ",\"ts\":%lld,\"name\":\"%s\",\"cat\":\"%s\",\"args\":{\"queue\":\"0x%08"
+                     PRIx32 "\",\"waiting\":%u}}", trace_pid_tasks, tid, (long long)time_us,
+                     (op < trace_queue_op_count) ? queue_ops[op] : "?", category,
+                     (uint32_t)(uintptr_t)record->subject, record->arg);
+  } else if (record->kind <= k_trace_phase_instant) {
+    priv_trace_print(output, ",\n{\"ph\":%s,\"pid\":%d,\"tid\":%" PRIu32 ",\"ts\":%lld,"
+                     "\"name\":\"%s\",\"cat\":\"%s\",\"args\":{\"arg\":%u}}",
+                     phases[record->kind], trace_pid_tasks, tid, (long long)time_us,
+                     (const char *)record->subject, category, record->arg);
+  }
+}
+
+/**
+ * @brief Writes the process and thread names of the tracks.
+ */
+static void priv_trace_print_metadata(trace_output_t *output, const TaskStatus_t *tasks,
+                                      UBaseType_t count)
+{
+  priv_trace_print(output, "{\"ph\":\"M\",\"pid\":%d,\"name\":\"process_name\","
+                   "\"args\":{\"name\":\"CPUs\"}}", trace_pid_cpus);
+  for (int core = 0; core < portNUM_PROCESSORS; core++) {
+    priv_trace_print(output, ",\n{\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"thread_name\","
+                     "\"args\":{\"name\":\"CPU %d\"}}", trace_pid_cpus, core, core);
+  }
+
+  priv_trace_print(output, ",\n{\"ph\":\"M\",\"pid\":%d,\"name\":\"process_name\","
+                   "\"args\":{\"name\":\"Tasks\"}}", trace_pid_tasks);
+  priv_trace_print(output, ",\n{\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"name\":\"thread_name\","
+                   "\"args\":{\"name\":\"ISR\"}}", trace_pid_tasks);
+  for (UBaseType_t i = 0; i < count; i++) {
+    priv_trace_print(output, ",\n{\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"name\":\"thread_name\","
+                     "\"args\":{\"name\":\"%s\"}}", trace_pid_tasks,
+                     (unsigned)tasks[i].xTaskNumber, tasks[i].pcTaskName);
+  }
+}
+
+/**
+ * @brief Positions a cursor on the oldest record of a ring.
+ *
+ * The full time of the oldest record is found by walking back from the
+ * newest one, whose full time is known, over the 32-bit differences.
+ */
+static void priv_trace_cursor_init(const trace_ring_t *ring, trace_cursor_t *cursor)
+{
+  uint32_t count = (ring->head < trace_ring_records) ? ring->head : trace_ring_records;
+
+  cursor->end     = ring->head;
+  cursor->index   = ring->head - count;
+  cursor->time_us = ring->last_us;
+  for (uint32_t i = cursor->end - 1; count > 0 && i != cursor->index; i--) {
+    cursor->time_us -= (uint32_t)(ring->records[i % trace_ring_records].time_us -
+                                  ring->records[(i - 1) % trace_ring_records].time_us);
+  }
+}
+
+/**
+ * @brief Moves a cursor to the next record of its ring.
+ */
+static void priv_trace_cursor_next(const trace_ring_t *ring, trace_cursor_t *cursor)
+{
+  uint32_t index = cursor->index++;
+  if (cursor->index != cursor->end) {
+    cursor->time_us += (uint32_t)(ring->records[cursor->index % trace_ring_records].time_us -
+                                  ring->records[index % trace_ring_records].time_us);
+  }
+}
+
+/**
+ * @brief Writes the events of every ring, merged in time order.
+ *
+ * A task switch closes the slice of the task that ran before on that core;
+ * the slices still open are closed at the newest event of the trace.
+ *
+ * @return Number of task switches.
+ */
+static uint32_t priv_trace_print_events(trace_output_t *output, const TaskStatus_t *tasks,
+                                        UBaseType_t count)
+{
+  uint32_t       switches = 0;
+  trace_cursor_t cursors[portNUM_PROCESSORS];
+  const void    *running[portNUM_PROCESSORS];
+  int64_t        since_us[portNUM_PROCESSORS];
+  int64_t        end_us = 0;
+
+  for (int core = 0; core < portNUM_PROCESSORS; core++) {
+    priv_trace_cursor_init(&s_rings[core], &cursors[core]);
+    running[core] = NULL;
+    if (s_rings[core].head > 0 && s_rings[core].last_us > end_us) {
+      end_us = s_rings[core].last_us;
+    }
+  }
+
+  while (output->ret == ESP_OK) {
+    int core = -1;
+    for (int i = 0; i < portNUM_PROCESSORS; i++) {
+      if (cursors[i].index != cursors[i].end &&
+          (core < 0 || cursors[i].time_us < cursors[core].time_us)) {
+        core = i;
+      }
+    }
+    if (core < 0) {
+      break;
+    }
+
+    const trace_record_t *record  = &s_rings[core].records[cursors[core].index % trace_ring_records];
+    int64_t               time_us = cursors[core].time_us;
+
+    if (record->category == k_trace_category_task && record->subject == NULL) {
+      if (running[core] != NULL) {
+        priv_trace_print_slice(output, tasks, count, core, running[core], since_us[core], time_us);
+      }
+      running[core]  = record->task;
+      since_us[core] = time_us;
+      switches++;
+    } else {
+      priv_trace_print_event(output, tasks, count, record, time_us);
+    }
+    priv_trace_cursor_next(&s_rings[core], &cursors[core]);
+  }
+
+  for (int core = 0; core < portNUM_PROCESSORS; core++) {
+    if (running[core] != NULL) {
+      priv_trace_print_slice(output, tasks, count, core, running[core], since_us[core], end_us);
+    }
+  }
+  return switches;
+}
+
+/* Public Functions ***********************************************************/
+
+void IRAM_ATTR trace_event(trace_category_t category, trace_phase_t phase, const char *name,
+                           uint16_t arg)
+{
+  priv_trace_write(category, phase, name, priv_trace_current_task(), arg);
+}
+
+void IRAM_ATTR trace_hook_task_switched_in(void)
+{
+  /* Called by the scheduler once the new task is current on this core */
+  priv_trace_write(k_trace_category_task, 0, NULL, xTaskGetCurrentTaskHandle(), 0);
+}
+
+void IRAM_ATTR trace_hook_queue(const void *queue, uint8_t op, uint32_t waiting)
+{
+  priv_trace_write(k_trace_category_queue, trace_kind_queue | op, queue,
+                   priv_trace_current_task(), (waiting > UINT16_MAX) ? UINT16_MAX : waiting);
+}
+
+#endif /* CONFIG_TOPOROBO_TRACE */
+
+void trace_set_categories(uint32_t mask)
+{
+#if CONFIG_TOPOROBO_TRACE
+  for (int core = 0; core < portNUM_PROCESSORS; core++) {
+    portENTER_CRITICAL(&s_rings[core].lock);
+    s_rings[core].head    = 0;
+    s_rings[core].last_us = 0;
+    portEXIT_CRITICAL(&s_rings[core].lock);
+  }
+  s_categories = mask & trace_all_categories;
+#else
+  (void)mask;
+#endif
+}
+
+uint32_t trace_get_categories(void)
+{
+#if CONFIG_TOPOROBO_TRACE
+  return s_categories;
+#else
+  return 0;
+#endif
+}
+
+const char *trace_category_name(trace_category_t category)
+{
+  return (category < k_trace_category_count) ? trace_category_names[category] : "unknown";
+}
+
+esp_err_t trace_export(trace_writer_t writer, void *context)
+{
+#if CONFIG_TOPOROBO_TRACE
+  portENTER_CRITICAL(&s_lock);
+  bool busy = s_paused;
+  s_paused  = true;
+  portEXIT_CRITICAL(&s_lock);
+  if (busy) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  /* Writers check `s_paused` under their ring lock, so once each lock has
+   * been taken here no record is being written any more */
+  uint32_t records = 0;
+  for (int core = 0; core < portNUM_PROCESSORS; core++) {
+    portENTER_CRITICAL(&s_rings[core].lock);
+    records += (s_rings[core].head < trace_ring_records) ? s_rings[core].head : trace_ring_records;
+    portEXIT_CRITICAL(&s_rings[core].lock);
+  }
+
+  UBaseType_t   count = uxTaskGetNumberOfTasks() + 4; /* Room for tasks created meanwhile */
+  TaskStatus_t *tasks = mem_policy_malloc(k_mem_policy_bulk, count * sizeof(TaskStatus_t));
+  if (tasks == NULL) {
+    s_paused = false;
+    return ESP_ERR_NO_MEM;
+  }
+  count = uxTaskGetSystemState(tasks, count, NULL);
+
+  trace_output_t *output = &s_output;
+  output->writer         = writer;
+  output->context        = context;
+  output->ret            = ESP_OK;
+  output->used           = 0;
+
+  priv_trace_print(output, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  priv_trace_print_metadata(output, tasks, count);
+  uint32_t switches = priv_trace_print_events(output, tasks, count);
+  priv_trace_print(output, "\n],\"otherData\":{\"records\":%" PRIu32 ",\"capacity\":%d,"
+                   "\"categories\":%" PRIu32 ",\"task_switches\":%" PRIu32 "}}\n", records,
+                   portNUM_PROCESSORS * trace_ring_records, s_categories, switches);
+  priv_trace_flush(output);
+
+  /* The scheduler switches tasks many times a second, so none at all means
+   * the kernel was built without trace_hooks.h */
+  if (switches == 0 && records > 0 && (s_categories & trace_category_bit(k_trace_category_task))) {
+    ESP_LOGW(trace_tag, "No task switches recorded, FreeRTOS was built without the trace hooks");
+  }
+
+  free(tasks);
+  s_paused = false;
+  return output->ret;
+#else
+  (void)writer;
+  (void)context;
+  return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
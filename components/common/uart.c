@@ -3,6 +3,7 @@
 #include "common/uart.h"
 #include "driver/uart.h"
 #include "esp_log.h"
+#include "common/deferred_log.h"
 
 /* Constants ******************************************************************/
 
@@ -52,7 +53,9 @@ esp_err_t priv_uart_read(uint8_t *data, size_t len, int32_t *out_length,
 
   if (length > 0) {
     *out_length = length; /* Store the length of data read */
-    ESP_LOGI(tag, "Received UART data: %.*s", (int)length, data); /* Log the received data */
+    /* Only the size is recorded; callers log the decoded content (e.g. NMEA
+     * sentences) and formatting the raw buffer here dominated the read path */
+    DEFERRED_LOGI(tag, "Received %d bytes of UART data", (int)length);
     return ESP_OK;
   } else {
     ESP_LOGE(tag, "UART read failed or timed out");
@@ -61,3 +64,13 @@ esp_err_t priv_uart_read(uint8_t *data, size_t len, int32_t *out_length,
   }
 }
 
+esp_err_t priv_uart_write(const uint8_t *data, size_t len, uart_port_t uart_num,
+                          const char *tag)
+{
+  int written = uart_write_bytes(uart_num, data, len);
+  if (written != (int)len) {
+    ESP_LOGE(tag, "UART write failed (%d of %u bytes)", written, (unsigned)len);
+    return ESP_FAIL;
+  }
+  return ESP_OK;
+}
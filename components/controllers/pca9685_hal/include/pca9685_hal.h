@@ -13,8 +13,8 @@
  *     |-----------------------|
  *     | VCC    | 3.3V to 5V   |----------> VCC
  *     | GND    | Ground       |----------> GND
- *     | SCL    | I2C Clock    |----------> GPIO_NUM_22 (100,000Hz)
- *     | SDA    | I2C Data     |----------> GPIO_NUM_21 (100,000Hz)
+ *     | SCL    | I2C Clock    |----------> GPIO_NUM_27 (I2C bus 1, 400,000Hz)
+ *     | SDA    | I2C Data     |----------> GPIO_NUM_13 (I2C bus 1, 400,000Hz)
  *     | OE     | Output Enable|----------> GND (optional, enables PWM output)
  *     | A0-A5  | Address Pins |----------> Floating or GND/VCC to set address
  *     | V+     | Servo Power  |----------> External Power (e.g., 5-6V for servos)
@@ -67,6 +67,14 @@ extern const uint16_t pca9685_max_pwm_value;    /**< Maximum value for PWM duty
 extern const uint16_t pca9685_pwm_period_us;    /**< Total PWM period for 50Hz (20000 µs) */
 extern const char    *pca9685_tag;              /**< Tag for logs */
 
+/* Macros *********************************************************************/
+
+/**
+ * @brief Number of board structs reserved when `CONFIG_TOPOROBO_STATIC_ALLOCATION`
+ *        is set; `pca9685_init` fails with ESP_ERR_NO_MEM beyond this count.
+ */
+#define pca9685_max_boards (4)
+
 /* Enums **********************************************************************/
 
 /**
@@ -2,17 +2,20 @@
 
 #include "pca9685_hal.h"
 #include "common/i2c.h"
+#include "common/power.h"
 #include "esp_log.h"
+#include "sdkconfig.h"
 #include <stdlib.h>
+#include <stdbool.h>
 
 /* Constants ******************************************************************/
 
 /* GPIO and I2C configuration */
-const uint8_t  pca9685_scl_io           = GPIO_NUM_22;
-const uint8_t  pca9685_sda_io           = GPIO_NUM_21;
-const uint32_t pca9685_i2c_freq_hz      = 100000;
+const uint8_t  pca9685_scl_io           = i2c_bus_scl_io(i2c_bus_pca9685);
+const uint8_t  pca9685_sda_io           = i2c_bus_sda_io(i2c_bus_pca9685);
+const uint32_t pca9685_i2c_freq_hz      = i2c_bus_freq_hz(i2c_bus_pca9685);
 const uint8_t  pca9685_i2c_address      = 0x40;
-const uint8_t  pca9685_i2c_bus          = I2C_NUM_0;
+const uint8_t  pca9685_i2c_bus          = i2c_bus_pca9685;
 const uint32_t pca9685_osc_freq         = 25000000;   /* 25MHz internal osc */
 const uint16_t pca9685_pwm_resolution   = 4096;       /* 12-bit resolution */
 const uint16_t pca9685_default_pwm_freq = 50;         /* Standard servo freq */
@@ -25,8 +28,54 @@ const char    *pca9685_tag              = "PCA9685";
 static const uint16_t servo_min_pulse_us = 500;   /* ~0.5ms for 0° */
 static const uint16_t servo_max_pulse_us = 2750;  /* ~2.5ms for 180° */
 
+/* Globals (Static) ***********************************************************/
+
+#if CONFIG_TOPOROBO_STATIC_ALLOCATION
+static pca9685_board_t s_board_pool[pca9685_max_boards]; /* Link-time board storage */
+static bool            s_board_in_use[pca9685_max_boards];
+#endif
+
 /* Private Functions (Static) *************************************************/
 
+/**
+ * @brief Allocate a board struct from the static pool or the heap.
+ *
+ * @return Pointer to an unused board struct, or NULL if none is available.
+ */
+static pca9685_board_t *priv_pca9685_board_alloc(void)
+{
+#if CONFIG_TOPOROBO_STATIC_ALLOCATION
+  for (uint8_t i = 0; i < pca9685_max_boards; i++) {
+    if (!s_board_in_use[i]) {
+      s_board_in_use[i] = true;
+      return &(s_board_pool[i]);
+    }
+  }
+  return NULL;
+#else
+  return (pca9685_board_t *)malloc(sizeof(pca9685_board_t));
+#endif
+}
+
+/**
+ * @brief Return a board struct obtained from `priv_pca9685_board_alloc`.
+ *
+ * @param[in] board Board struct to release.
+ */
+static void priv_pca9685_board_free(pca9685_board_t *board)
+{
+#if CONFIG_TOPOROBO_STATIC_ALLOCATION
+  for (uint8_t i = 0; i < pca9685_max_boards; i++) {
+    if (board == &(s_board_pool[i])) {
+      s_board_in_use[i] = false;
+      return;
+    }
+  }
+#else
+  free(board);
+#endif
+}
+
 /**
  * @brief Calculate the prescaler value based on the desired PWM frequency.
  *
@@ -75,6 +124,101 @@ static inline uint16_t priv_angle_to_pulse_length(float angle)
   return steps;
 }
 
+/**
+ * @brief Writes the pulse length for `angle` to every channel in `motor_mask`.
+ *
+ * Body of `pca9685_set_angle`, which wraps it in the servo power lock.
+ */
+static esp_err_t priv_pca9685_set_angle(pca9685_board_t *controller_data,
+                                        uint16_t motor_mask, uint8_t board_id,
+                                        float angle)
+{
+  if (controller_data == NULL) {
+    ESP_LOGE(pca9685_tag, "Controller data is NULL");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  /* Check if board_id is within the valid range */
+  if (board_id >= controller_data->num_boards) {
+    ESP_LOGE(pca9685_tag, "Invalid board_id: %d. Number of boards: %d", board_id,
+             controller_data->num_boards);
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  /* Find the correct board based on board_id */
+  pca9685_board_t *current_board = controller_data;
+  while (current_board != NULL) {
+    if (current_board->board_id == board_id) {
+      if (current_board->state != k_pca9685_ready) {
+        ESP_LOGE(pca9685_tag, "PCA9685 board %d is not ready for communication",
+                 current_board->board_id);
+        return ESP_FAIL;
+      }
+
+      /* Convert angle to the appropriate pulse length using working snippet logic */
+      uint16_t pulse_length = priv_angle_to_pulse_length(angle);
+
+      /* Set the angle for each motor in the mask */
+      for (uint8_t channel = 0; channel < 16; ++channel) {
+        if (motor_mask & (1 << channel)) {
+          uint8_t led_on_l_reg  = k_pca9685_channel0_on_l_cmd  + 4 * channel;
+          uint8_t led_on_h_reg  = k_pca9685_channel0_on_h_cmd  + 4 * channel;
+          uint8_t led_off_l_reg = k_pca9685_channel0_off_l_cmd + 4 * channel;
+          uint8_t led_off_h_reg = k_pca9685_channel0_off_h_cmd + 4 * channel;
+
+          /* Log operation for debugging */
+          ESP_LOGD(pca9685_tag, "Setting channel %d on board %d to %.2f°, pulse %u",
+                   channel, current_board->board_id, angle, pulse_length);
+
+          /* Set ON time to 0 */
+          esp_err_t ret = priv_i2c_write_reg_byte(led_on_l_reg, 0x00, pca9685_i2c_bus,
+                                                  current_board->i2c_address,
+                                                  pca9685_tag);
+          if (ret != ESP_OK) {
+            ESP_LOGE(pca9685_tag, "Failed to set ON_L for motor %d on PCA9685 board %d",
+                     channel, current_board->board_id);
+            return ret;
+          }
+          ret = priv_i2c_write_reg_byte(led_on_h_reg, 0x00, pca9685_i2c_bus,
+                                        current_board->i2c_address,
+                                        pca9685_tag);
+          if (ret != ESP_OK) {
+            ESP_LOGE(pca9685_tag, "Failed to set ON_H for motor %d on PCA9685 board %d",
+                     channel, current_board->board_id);
+            return ret;
+          }
+
+          /* Set OFF time to pulse_length */
+          ret = priv_i2c_write_reg_byte(led_off_l_reg, pulse_length & 0xFF,
+                                        pca9685_i2c_bus, current_board->i2c_address,
+                                        pca9685_tag);
+          if (ret != ESP_OK) {
+            ESP_LOGE(pca9685_tag, "Failed to set OFF_L for motor %d on PCA9685 board %d",
+                     channel, current_board->board_id);
+            return ret;
+          }
+
+          ret = priv_i2c_write_reg_byte(led_off_h_reg, (pulse_length >> 8) & 0xFF,
+                                        pca9685_i2c_bus, current_board->i2c_address,
+                                        pca9685_tag);
+          if (ret != ESP_OK) {
+            ESP_LOGE(pca9685_tag, "Failed to set OFF_H for motor %d on PCA9685 board %d",
+                     channel, current_board->board_id);
+            return ret;
+          }
+
+          /* Update the stored angle */
+          current_board->degrees[channel] = angle;
+        }
+      }
+      return ESP_OK;
+    }
+    current_board = current_board->next;
+  }
+
+  ESP_LOGE(pca9685_tag, "PCA9685 board with board_id %d not found", board_id);
+  return ESP_ERR_NOT_FOUND;
+}
 
 /* Public Functions ***********************************************************/
 
@@ -100,7 +244,7 @@ esp_err_t pca9685_init(pca9685_board_t **controller_data, uint8_t num_boards)
     }
 
     /* Allocate memory for the new board */
-    pca9685_board_t *new_board = (pca9685_board_t *)malloc(sizeof(pca9685_board_t));
+    pca9685_board_t *new_board = priv_pca9685_board_alloc();
     if (new_board == NULL) {
       ESP_LOGE(pca9685_tag, "Failed to allocate memory for PCA9685 board %d", i);
       return ESP_ERR_NO_MEM;
@@ -115,7 +259,7 @@ esp_err_t pca9685_init(pca9685_board_t **controller_data, uint8_t num_boards)
                         pca9685_i2c_bus, pca9685_tag);
     if (ret != ESP_OK) {
       ESP_LOGE(pca9685_tag, "Failed to initialize I2C for PCA9685 board %d", i);
-      free(new_board);
+      priv_pca9685_board_free(new_board);
       return ret;
     }
 
@@ -124,7 +268,7 @@ esp_err_t pca9685_init(pca9685_board_t **controller_data, uint8_t num_boards)
                                   pca9685_i2c_bus, new_board->i2c_address, pca9685_tag);
     if (ret != ESP_OK) {
       ESP_LOGE(pca9685_tag, "Failed to put PCA9685 board %d into sleep mode", i);
-      free(new_board);
+      priv_pca9685_board_free(new_board);
       return ret;
     }
 
@@ -135,7 +279,7 @@ esp_err_t pca9685_init(pca9685_board_t **controller_data, uint8_t num_boards)
                                                 pca9685_tag);
     if (ret != ESP_OK) {
       ESP_LOGE(pca9685_tag, "Failed to set prescaler value for PCA9685 board %d", i);
-      free(new_board);
+      priv_pca9685_board_free(new_board);
       return ret;
     }
 
@@ -145,7 +289,7 @@ esp_err_t pca9685_init(pca9685_board_t **controller_data, uint8_t num_boards)
                                   pca9685_tag);
     if (ret != ESP_OK) {
       ESP_LOGE(pca9685_tag, "Failed to restart PCA9685 board %d", i);
-      free(new_board);
+      priv_pca9685_board_free(new_board);
       return ret;
     }
 
@@ -155,7 +299,7 @@ esp_err_t pca9685_init(pca9685_board_t **controller_data, uint8_t num_boards)
                                   pca9685_tag);
     if (ret != ESP_OK) {
       ESP_LOGE(pca9685_tag, "Failed to set MODE2 for PCA9685 board %d", i);
-      free(new_board);
+      priv_pca9685_board_free(new_board);
       return ret;
     }
 
@@ -169,7 +313,7 @@ esp_err_t pca9685_init(pca9685_board_t **controller_data, uint8_t num_boards)
     ret = pca9685_set_angle(new_board, 0xFFFF, i, 90.0f); /* 0xFFFF sets all motors */
     if (ret != ESP_OK) {
       ESP_LOGE(pca9685_tag, "Failed to set all motors to 90 degrees on PCA9685 board %d", i);
-      free(new_board);
+      priv_pca9685_board_free(new_board);
       return ret;
     }
 
@@ -182,89 +326,10 @@ esp_err_t pca9685_init(pca9685_board_t **controller_data, uint8_t num_boards)
 esp_err_t pca9685_set_angle(pca9685_board_t *controller_data, uint16_t motor_mask,
                             uint8_t board_id, float angle)
 {
-  if (controller_data == NULL) {
-    ESP_LOGE(pca9685_tag, "Controller data is NULL");
-    return ESP_ERR_INVALID_ARG;
-  }
-
-  /* Check if board_id is within the valid range */
-  if (board_id >= controller_data->num_boards) {
-    ESP_LOGE(pca9685_tag, "Invalid board_id: %d. Number of boards: %d", board_id,
-             controller_data->num_boards);
-    return ESP_ERR_INVALID_ARG;
-  }
-
-  /* Find the correct board based on board_id */
-  pca9685_board_t *current_board = controller_data;
-  while (current_board != NULL) {
-    if (current_board->board_id == board_id) {
-      if (current_board->state != k_pca9685_ready) {
-        ESP_LOGE(pca9685_tag, "PCA9685 board %d is not ready for communication",
-                 current_board->board_id);
-        return ESP_FAIL;
-      }
-
-      /* Convert angle to the appropriate pulse length using working snippet logic */
-      uint16_t pulse_length = priv_angle_to_pulse_length(angle);
-
-      /* Set the angle for each motor in the mask */
-      for (uint8_t channel = 0; channel < 16; ++channel) {
-        if (motor_mask & (1 << channel)) {
-          uint8_t led_on_l_reg  = k_pca9685_channel0_on_l_cmd  + 4 * channel;
-          uint8_t led_on_h_reg  = k_pca9685_channel0_on_h_cmd  + 4 * channel;
-          uint8_t led_off_l_reg = k_pca9685_channel0_off_l_cmd + 4 * channel;
-          uint8_t led_off_h_reg = k_pca9685_channel0_off_h_cmd + 4 * channel;
-
-          /* Log operation for debugging */
-          ESP_LOGD(pca9685_tag, "Setting channel %d on board %d to %.2f°, pulse %u",
-                   channel, current_board->board_id, angle, pulse_length);
-
-          /* Set ON time to 0 */
-          esp_err_t ret = priv_i2c_write_reg_byte(led_on_l_reg, 0x00, pca9685_i2c_bus,
-                                                  current_board->i2c_address,
-                                                  pca9685_tag);
-          if (ret != ESP_OK) {
-            ESP_LOGE(pca9685_tag, "Failed to set ON_L for motor %d on PCA9685 board %d",
-                     channel, current_board->board_id);
-            return ret;
-          }
-          ret = priv_i2c_write_reg_byte(led_on_h_reg, 0x00, pca9685_i2c_bus,
-                                        current_board->i2c_address,
-                                        pca9685_tag);
-          if (ret != ESP_OK) {
-            ESP_LOGE(pca9685_tag, "Failed to set ON_H for motor %d on PCA9685 board %d",
-                     channel, current_board->board_id);
-            return ret;
-          }
-
-          /* Set OFF time to pulse_length */
-          ret = priv_i2c_write_reg_byte(led_off_l_reg, pulse_length & 0xFF,
-                                        pca9685_i2c_bus, current_board->i2c_address,
-                                        pca9685_tag);
-          if (ret != ESP_OK) {
-            ESP_LOGE(pca9685_tag, "Failed to set OFF_L for motor %d on PCA9685 board %d",
-                     channel, current_board->board_id);
-            return ret;
-          }
-
-          ret = priv_i2c_write_reg_byte(led_off_h_reg, (pulse_length >> 8) & 0xFF,
-                                        pca9685_i2c_bus, current_board->i2c_address,
-                                        pca9685_tag);
-          if (ret != ESP_OK) {
-            ESP_LOGE(pca9685_tag, "Failed to set OFF_H for motor %d on PCA9685 board %d",
-                     channel, current_board->board_id);
-            return ret;
-          }
-
-          /* Update the stored angle */
-          current_board->degrees[channel] = angle;
-        }
-      }
-      return ESP_OK;
-    }
-    current_board = current_board->next;
-  }
-
-  ESP_LOGE(pca9685_tag, "PCA9685 board with board_id %d not found", board_id);
-  return ESP_ERR_NOT_FOUND;
+  /* Keep the APB clock up so the register writes are not stretched by a
+   * frequency switch halfway through a multi-channel update */
+  power_lock_acquire(k_power_lock_servo);
+  esp_err_t ret = priv_pca9685_set_angle(controller_data, motor_mask, board_id, angle);
+  power_lock_release(k_power_lock_servo);
+  return ret;
 }
@@ -1,19 +1,20 @@
 /* components/sensors/bh1750_hal/bh1750_hal.c */
 
 #include "bh1750_hal.h"
-#include "webserver_tasks.h"
-#include "cJSON.h"
+#include "common/event_bus.h"
+#include "sensor_schema.h"
 #include "common/i2c.h"
+#include "common/deferred_log.h"
 #include "esp_log.h"
 
 /* Constants ******************************************************************/
 
 const uint8_t  bh1750_i2c_address            = 0x23;
-const uint8_t  bh1750_i2c_bus                = I2C_NUM_0;
+const uint8_t  bh1750_i2c_bus                = i2c_bus_bh1750;
 const char    *bh1750_tag                    = "BH1750";
-const uint8_t  bh1750_scl_io                 = GPIO_NUM_22;
-const uint8_t  bh1750_sda_io                 = GPIO_NUM_21;
-const uint32_t bh1750_i2c_freq_hz            = 100000;
+const uint8_t  bh1750_scl_io                 = i2c_bus_scl_io(i2c_bus_bh1750);
+const uint8_t  bh1750_sda_io                 = i2c_bus_sda_io(i2c_bus_bh1750);
+const uint32_t bh1750_i2c_freq_hz            = i2c_bus_freq_hz(i2c_bus_bh1750);
 const uint32_t bh1750_polling_rate_ticks     = pdMS_TO_TICKS(1 * 1000);
 const uint8_t  bh1750_max_retries            = 4;
 const uint32_t bh1750_initial_retry_interval = pdMS_TO_TICKS(15);
@@ -23,33 +24,7 @@ const uint32_t bh1750_max_backoff_interval   = pdMS_TO_TICKS(8 * 60);
 
 char *bh1750_data_to_json(const bh1750_data_t *data)
 {
-  cJSON *json = cJSON_CreateObject();
-  if (!json) {
-    ESP_LOGE(bh1750_tag, "Failed to create JSON object.");
-    return NULL;
-  }
-
-  if (!cJSON_AddStringToObject(json, "sensor_type", "light")) {
-    ESP_LOGE(bh1750_tag, "Failed to add sensor_type to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "lux", data->lux)) {
-    ESP_LOGE(bh1750_tag, "Failed to add lux to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  char *json_string = cJSON_PrintUnformatted(json);
-  if (!json_string) {
-    ESP_LOGE(bh1750_tag, "Failed to serialize JSON object.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  cJSON_Delete(json);
-  return json_string;
+  return sensor_schema_to_json(&bh1750_schema, data);
 }
 
 esp_err_t bh1750_init(void *sensor_data)
@@ -124,7 +99,7 @@ esp_err_t bh1750_read(bh1750_data_t *sensor_data)
 
   uint16_t raw_light_intensity = (data[0] << 8) | data[1];
   sensor_data->lux             = raw_light_intensity / 1.2;
-  ESP_LOGI(bh1750_tag, "Measured light intensity: %f lux", sensor_data->lux);
+  DEFERRED_LOGI(bh1750_tag, "Measured light intensity: %f lux", sensor_data->lux);
 
   sensor_data->state = k_bh1750_data_updated;
   return ESP_OK;
@@ -160,9 +135,7 @@ void bh1750_tasks(void *sensor_data)
   bh1750_data_t *bh1750_data = (bh1750_data_t *)sensor_data;
   while (1) {
     if (bh1750_read(bh1750_data) == ESP_OK) {
-      char *json = bh1750_data_to_json(bh1750_data);
-      send_sensor_data_to_webserver(json);
-      free(json);
+      event_bus_publish_sample(k_event_bus_topic_bh1750, bh1750_data);
     } else {
       bh1750_reset_on_error(bh1750_data);
     }
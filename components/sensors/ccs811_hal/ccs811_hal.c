@@ -3,22 +3,22 @@
 /* TODO: Test this */
 
 #include "ccs811_hal.h"
-#include "webserver_tasks.h"
-#include "cJSON.h"
+#include "common/event_bus.h"
+#include "sensor_schema.h"
 #include "common/i2c.h"
 #include "esp_log.h"
 
 /* Constants ******************************************************************/
 
 const uint8_t  ccs811_i2c_address            = 0x5A;
-const uint8_t  ccs811_i2c_bus                = I2C_NUM_0;
+const uint8_t  ccs811_i2c_bus                = i2c_bus_ccs811;
 const char    *ccs811_tag                    = "CCS811";
-const uint8_t  ccs811_scl_io                 = GPIO_NUM_22;
-const uint8_t  ccs811_sda_io                 = GPIO_NUM_21;
+const uint8_t  ccs811_scl_io                 = i2c_bus_scl_io(i2c_bus_ccs811);
+const uint8_t  ccs811_sda_io                 = i2c_bus_sda_io(i2c_bus_ccs811);
 const uint8_t  ccs811_wake_io                = GPIO_NUM_33;
 const uint8_t  ccs811_rst_io                 = GPIO_NUM_32;
 const uint8_t  ccs811_int_io                 = GPIO_NUM_25;
-const uint32_t ccs811_i2c_freq_hz            = 100000;
+const uint32_t ccs811_i2c_freq_hz            = i2c_bus_freq_hz(i2c_bus_ccs811);
 const uint32_t ccs811_polling_rate_ticks     = pdMS_TO_TICKS(1 * 1000);
 const uint8_t  ccs811_max_retries            = 4;
 const uint32_t ccs811_initial_retry_interval = pdMS_TO_TICKS(15 * 1000);
@@ -28,39 +28,7 @@ const uint32_t ccs811_max_backoff_interval   = pdMS_TO_TICKS(8 * 60 * 1000);
 
 char *ccs811_data_to_json(const ccs811_data_t *data)
 {
-  cJSON *json = cJSON_CreateObject();
-  if (!json) {
-    ESP_LOGE(ccs811_tag, "Failed to create JSON object.");
-    return NULL;
-  }
-
-  if (!cJSON_AddStringToObject(json, "sensor_type", "air_quality")) {
-    ESP_LOGE(ccs811_tag, "Failed to add sensor_type to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "eCO2", data->eco2)) {
-    ESP_LOGE(ccs811_tag, "Failed to add eCO2 to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "TVOC", data->tvoc)) {
-    ESP_LOGE(ccs811_tag, "Failed to add TVOC to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  char *json_string = cJSON_PrintUnformatted(json);
-  if (!json_string) {
-    ESP_LOGE(ccs811_tag, "Failed to serialize JSON object.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  cJSON_Delete(json);
-  return json_string;
+  return sensor_schema_to_json(&ccs811_schema, data);
 }
 
 esp_err_t ccs811_init(void *sensor_data)
@@ -159,9 +127,7 @@ void ccs811_tasks(void *sensor_data)
   ccs811_data_t *ccs811_data = (ccs811_data_t *)sensor_data;
   while (1) {
     if (ccs811_read(ccs811_data) == ESP_OK) {
-      char *json = ccs811_data_to_json(ccs811_data);
-      send_sensor_data_to_webserver(json);
-      free(json);
+      event_bus_publish_sample(k_event_bus_topic_ccs811, ccs811_data);
     } else {
       ccs811_reset_on_error(ccs811_data);
     }
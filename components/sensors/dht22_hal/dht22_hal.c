@@ -3,8 +3,9 @@
 #include "dht22_hal.h"
 #include <stdio.h>
 #include <string.h>
-#include "webserver_tasks.h"
-#include "cJSON.h"
+#include "common/event_bus.h"
+#include "common/power.h"
+#include "sensor_schema.h"
 #include "esp_log.h"
 #include "driver/gpio.h"
 #include "esp_timer.h"
@@ -266,39 +267,7 @@ static esp_err_t priv_dht22_verify_checksum(uint8_t *data_buffer)
 
 char *dht22_data_to_json(const dht22_data_t *data)
 {
-  cJSON *json = cJSON_CreateObject();
-  if (!json) {
-    ESP_LOGE(dht22_tag, "Failed to create JSON object.");
-    return NULL;
-  }
-
-  if (!cJSON_AddStringToObject(json, "sensor_type", "temperature_humidity")) {
-    ESP_LOGE(dht22_tag, "Failed to add sensor_type to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "temperature_c", data->temperature_c)) {
-    ESP_LOGE(dht22_tag, "Failed to add temperature_c to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "humidity", data->humidity)) {
-    ESP_LOGE(dht22_tag, "Failed to add humidity to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  char *json_string = cJSON_PrintUnformatted(json);
-  if (!json_string) {
-    ESP_LOGE(dht22_tag, "Failed to serialize JSON object.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  cJSON_Delete(json);
-  return json_string;
+  return sensor_schema_to_json(&dht22_schema, data);
 }
 
 esp_err_t dht22_init(void *sensor_data)
@@ -336,12 +305,17 @@ esp_err_t dht22_read(dht22_data_t *sensor_data)
   uint8_t   data_buffer[5] = {0};
   esp_err_t ret;
 
+  /* Hold the CPU at full speed and out of light sleep for the bit-banged
+   * exchange, a frequency switch mid-transfer corrupts the pulse timing */
+  power_lock_acquire(k_power_lock_dht22);
+
   /* Send start signal and wait for response */
   priv_dht22_send_start_signal();
   gpio_set_direction(dht22_data_io, GPIO_MODE_INPUT);
 
   ret = priv_dht22_wait_for_response();
   if (ret != ESP_OK) {
+    power_lock_release(k_power_lock_dht22);
     sensor_data->state = k_dht22_error;
     ESP_LOGE(dht22_tag, "Failed to receive response from DHT22");
     return ESP_FAIL;
@@ -349,6 +323,7 @@ esp_err_t dht22_read(dht22_data_t *sensor_data)
 
   /* Read data bits */
   ret = priv_dht22_read_data_bits(data_buffer);
+  power_lock_release(k_power_lock_dht22);
   if (ret != ESP_OK) {
     sensor_data->state = k_dht22_error;
     ESP_LOGE(dht22_tag, "Failed to read data bits from DHT22");
@@ -418,9 +393,7 @@ void dht22_tasks(void *sensor_data)
   dht22_data_t *dht22_data = (dht22_data_t *)sensor_data;
   while (1) {
     if (dht22_read(dht22_data) == ESP_OK) {
-      char *json = dht22_data_to_json(dht22_data);
-      send_sensor_data_to_webserver(json);
-      free(json);
+      event_bus_publish_sample(k_event_bus_topic_dht22, dht22_data);
     } else {
       dht22_reset_on_error(dht22_data);
     }
@@ -5,13 +5,28 @@
 #include "gy_neo6mv2_hal.h"
 #include <string.h>
 #include <stdlib.h>
+#include <inttypes.h>
 #include "esp_err.h"
-#include "webserver_tasks.h"
-#include "cJSON.h"
+#include "common/event_bus.h"
+#include "sensor_schema.h"
 #include "common/uart.h"
+#include "common/deferred_log.h"
+#include "common/power.h"
+#include "common/arena.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
 
+/* Macros *********************************************************************/
+
+#define gy_neo6mv2_aid_ini_payload_len  (48)
+#define gy_neo6mv2_aid_ini_flag_pos     (0x01) /* Position fields are valid */
+#define gy_neo6mv2_aid_ini_flag_time    (0x02) /* Week and time of week are valid */
+#define gy_neo6mv2_aid_ini_flag_lla     (0x20) /* Position is lat/lon/alt, not ECEF */
+#define gy_neo6mv2_aid_ini_flag_alt_inv (0x40) /* Altitude is not known */
+#define gy_neo6mv2_gps_epoch_unix       (315964800) /* 1980-01-06T00:00:00Z */
+#define gy_neo6mv2_gps_leap_seconds     (18)        /* GPS - UTC since 2017 */
+#define gy_neo6mv2_seconds_per_week     (604800)
+
 /* Constants *******************************************************************/
 
 const char    *gy_neo6mv2_tag                    = "GY-NEO6MV2";
@@ -56,6 +71,15 @@ static satellite_t s_gy_neo6mv2_satellites[gy_neo6mv2_max_satellites];
  */
 static uint8_t s_gy_neo6mv2_satellite_count = 0;
 
+/**
+ * @brief Scratch memory of one `gy_neo6mv2_read` call (GPS task only).
+ *
+ * Holds the UART receive buffer and the satellite copy, which would
+ * otherwise sit on the task stack; emptied when the call returns.
+ */
+arena_define(s_gy_neo6mv2_arena, "gps",
+             gy_neo6mv2_sentence_buffer_size + 8 + gy_neo6mv2_max_satellites * sizeof(satellite_t));
+
 /* Static (Private) Functions *************************************************/
 
 /**
@@ -172,8 +196,8 @@ static void priv_gy_neo6mv2_add_satellite(uint8_t prn, uint8_t elevation, uint16
     sat->snr         = snr;
     s_gy_neo6mv2_satellite_count++;
 
-    ESP_LOGI(gy_neo6mv2_tag, "Satellite added: PRN=%d, Elevation=%d, Azimuth=%d, SNR=%d",
-             prn, elevation, azimuth, snr);
+    DEFERRED_LOGI(gy_neo6mv2_tag, "Satellite added: PRN=%d, Elevation=%d, Azimuth=%d, SNR=%d",
+                  prn, elevation, azimuth, snr);
   } else {
     ESP_LOGW(gy_neo6mv2_tag, "Satellite buffer full, cannot add PRN=%d", prn);
   }
@@ -189,7 +213,7 @@ static void priv_gy_neo6mv2_clear_satellites(void)
 {
   s_gy_neo6mv2_satellite_count = 0;
   memset(s_gy_neo6mv2_satellites, 0, sizeof(s_gy_neo6mv2_satellites));
-  ESP_LOGI(gy_neo6mv2_tag, "Satellite buffer cleared.");
+  DEFERRED_LOGI(gy_neo6mv2_tag, "Satellite buffer cleared.");
 }
 
 /**
@@ -208,89 +232,26 @@ static uint8_t priv_gy_neo6mv2_get_satellites(satellite_t *satellites, uint8_t m
                    s_gy_neo6mv2_satellite_count : max_count;
 
   memcpy(satellites, s_gy_neo6mv2_satellites, count * sizeof(satellite_t));
-  ESP_LOGI(gy_neo6mv2_tag, "Retrieved %d satellites from the buffer.", count);
+  DEFERRED_LOGI(gy_neo6mv2_tag, "Retrieved %d satellites from the buffer.", count);
   return count;
 }
 
+/**
+ * @brief Stores a little-endian 32-bit value into a UBX payload.
+ */
+static void priv_gy_neo6mv2_put_u32(uint8_t *buffer, uint32_t value)
+{
+  buffer[0] = value & 0xFF;
+  buffer[1] = (value >> 8) & 0xFF;
+  buffer[2] = (value >> 16) & 0xFF;
+  buffer[3] = (value >> 24) & 0xFF;
+}
+
 /* Public Functions ***********************************************************/
 
 char *gy_neo6mv2_data_to_json(const gy_neo6mv2_data_t *gy_neo6mv2_data)
 {
-  cJSON *json = cJSON_CreateObject();
-  if (!json) {
-    ESP_LOGE(gy_neo6mv2_tag, "Failed to create JSON object.");
-    return NULL;
-  }
-
-  if (!cJSON_AddStringToObject(json, "sensor_type", "gps")) {
-    ESP_LOGE(gy_neo6mv2_tag, "Failed to add sensor_type to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "latitude", gy_neo6mv2_data->latitude)) {
-    ESP_LOGE(gy_neo6mv2_tag, "Failed to add latitude to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "longitude", gy_neo6mv2_data->longitude)) {
-    ESP_LOGE(gy_neo6mv2_tag, "Failed to add longitude to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "speed", gy_neo6mv2_data->speed)) {
-    ESP_LOGE(gy_neo6mv2_tag, "Failed to add speed to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddStringToObject(json, "time", gy_neo6mv2_data->time)) {
-    ESP_LOGE(gy_neo6mv2_tag, "Failed to add time to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "fix_status", gy_neo6mv2_data->fix_status)) {
-    ESP_LOGE(gy_neo6mv2_tag, "Failed to add fix_status to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "satellite_count", gy_neo6mv2_data->satellite_count)) {
-    ESP_LOGE(gy_neo6mv2_tag, "Failed to add satellite_count to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "hdop", gy_neo6mv2_data->hdop)) {
-    ESP_LOGE(gy_neo6mv2_tag, "Failed to add hdop to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "retry_count", gy_neo6mv2_data->retry_count)) {
-    ESP_LOGE(gy_neo6mv2_tag, "Failed to add retry_count to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "retry_interval", gy_neo6mv2_data->retry_interval)) {
-    ESP_LOGE(gy_neo6mv2_tag, "Failed to add retry_interval to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  char *json_string = cJSON_PrintUnformatted(json);
-  if (!json_string) {
-    ESP_LOGE(gy_neo6mv2_tag, "Failed to serialize JSON object.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  cJSON_Delete(json);
-  return json_string;
+  return sensor_schema_to_json(&gy_neo6mv2_schema, gy_neo6mv2_data);
 }
 
 esp_err_t gy_neo6mv2_init(void *sensor_data)
@@ -305,6 +266,10 @@ esp_err_t gy_neo6mv2_init(void *sensor_data)
     return ret;
   }
 
+  /* The UART cannot receive during light sleep; NMEA sentences arrive
+   * unsolicited every second, so stay awake while the GPS is in use */
+  power_lock_acquire(k_power_lock_gps);
+
   /* Allow time for the GPS module to warm up */
   vTaskDelay(pdMS_TO_TICKS(5000));
 
@@ -328,11 +293,15 @@ esp_err_t gy_neo6mv2_init(void *sensor_data)
 
 esp_err_t gy_neo6mv2_read(gy_neo6mv2_data_t *sensor_data)
 {
-  uint8_t uart_rx_buffer[gy_neo6mv2_sentence_buffer_size];
-  int32_t length = 0;
+  arena_begin(&s_gy_neo6mv2_arena);
+
+  uint8_t     *uart_rx_buffer   = arena_alloc(&s_gy_neo6mv2_arena, gy_neo6mv2_sentence_buffer_size);
+  satellite_t *local_satellites = arena_alloc(&s_gy_neo6mv2_arena,
+                                              gy_neo6mv2_max_satellites * sizeof(satellite_t));
+  int32_t      length           = 0;
 
   /* Read from UART */
-  esp_err_t ret = priv_uart_read(uart_rx_buffer, sizeof(uart_rx_buffer),
+  esp_err_t ret = priv_uart_read(uart_rx_buffer, gy_neo6mv2_sentence_buffer_size,
                                  &length, gy_neo6mv2_uart_num, gy_neo6mv2_tag);
 
   if (ret == ESP_OK && length > 0) {
@@ -356,7 +325,7 @@ esp_err_t gy_neo6mv2_read(gy_neo6mv2_data_t *sensor_data)
         }
 
         /* Log raw sentence */
-        ESP_LOGI(gy_neo6mv2_tag, "Raw NMEA sentence: %s", s_gy_neo6mv2_sentence_buffer);
+        DEFERRED_LOGI(gy_neo6mv2_tag, "Raw NMEA sentence: %s", s_gy_neo6mv2_sentence_buffer);
 
         /* Validate checksum */
         if (!priv_gy_neo6mv2_validate_nmea_checksum(s_gy_neo6mv2_sentence_buffer)) {
@@ -374,8 +343,8 @@ esp_err_t gy_neo6mv2_read(gy_neo6mv2_data_t *sensor_data)
           /* Extract and log status */
           if (fields[2]) {
             const char *status = fields[2];
-            ESP_LOGI(gy_neo6mv2_tag, "GPRMC Status: %s (%s)",
-                     status, (status[0] == 'A') ? "Fix acquired" : "No fix");
+            DEFERRED_LOGI(gy_neo6mv2_tag, "GPRMC Status: %s (%s)",
+                          status, (status[0] == 'A') ? "Fix acquired" : "No fix");
 
             /* Process only valid readings */
             if (status[0] == 'A') {
@@ -388,9 +357,9 @@ esp_err_t gy_neo6mv2_read(gy_neo6mv2_data_t *sensor_data)
               sensor_data->fix_status = 1; /* Fix acquired */
               strncpy(sensor_data->time, fields[1], sizeof(sensor_data->time) - 1);
 
-              ESP_LOGI(gy_neo6mv2_tag, "Valid fix: Lat=%f, Lon=%f, Speed=%f",
-                       sensor_data->latitude, sensor_data->longitude, 
-                       sensor_data->speed);
+              DEFERRED_LOGI(gy_neo6mv2_tag, "Valid fix: Lat=%f, Lon=%f, Speed=%f",
+                            sensor_data->latitude, sensor_data->longitude, 
+                            sensor_data->speed);
             } else {
               sensor_data->fix_status = 0; /* No fix */
               ESP_LOGW(gy_neo6mv2_tag, "Skipping invalid GPS reading.");
@@ -405,8 +374,8 @@ esp_err_t gy_neo6mv2_read(gy_neo6mv2_data_t *sensor_data)
           uint8_t sentence_number  = fields[2] ? (uint8_t)atoi(fields[2]) : 0;
           uint8_t total_satellites = fields[3] ? (uint8_t)atoi(fields[3]) : 0;
 
-          ESP_LOGI(gy_neo6mv2_tag, "GPGSV: Sentence %u of %u, Total Satellites in view: %u",
-                   sentence_number, total_sentences, total_satellites);
+          DEFERRED_LOGI(gy_neo6mv2_tag, "GPGSV: Sentence %u of %u, Total Satellites in view: %u",
+                        sentence_number, total_sentences, total_satellites);
 
           /* Clear satellite data if this is the first sentence */
           if (sentence_number == 1) {
@@ -433,7 +402,6 @@ esp_err_t gy_neo6mv2_read(gy_neo6mv2_data_t *sensor_data)
     }
 
     /* After processing sentences, retrieve satellite data */
-    satellite_t local_satellites[gy_neo6mv2_max_satellites];
     uint8_t     satellite_count = priv_gy_neo6mv2_get_satellites(local_satellites, 
                                                                  gy_neo6mv2_max_satellites);
 
@@ -442,19 +410,76 @@ esp_err_t gy_neo6mv2_read(gy_neo6mv2_data_t *sensor_data)
 
     /* Process satellite data as needed */
     for (uint8_t i = 0; i < satellite_count; i++) {
-      ESP_LOGI(gy_neo6mv2_tag, "Retrieved Satellite PRN=%d, Elevation=%d, Azimuth=%d, SNR=%d",
-               local_satellites[i].prn, local_satellites[i].elevation,
-               local_satellites[i].azimuth, local_satellites[i].snr);
+      DEFERRED_LOGI(gy_neo6mv2_tag, "Retrieved Satellite PRN=%d, Elevation=%d, Azimuth=%d, SNR=%d",
+                    local_satellites[i].prn, local_satellites[i].elevation,
+                    local_satellites[i].azimuth, local_satellites[i].snr);
     }
 
+    arena_end(&s_gy_neo6mv2_arena);
     return ESP_OK;
   } else {
     ESP_LOGE(gy_neo6mv2_tag, "Failed to read from GPS module");
     sensor_data->state = k_gy_neo6mv2_error;
+    arena_end(&s_gy_neo6mv2_arena);
     return ESP_FAIL;
   }
 }
 
+esp_err_t gy_neo6mv2_send_aiding(float latitude, float longitude, uint32_t position_acc_m,
+                                 time_t utc_time, uint32_t time_acc_ms)
+{
+  /* UBX frame: sync (2), class (1), id (1), length (2), payload (48), checksum (2) */
+  uint8_t  frame[2 + 4 + gy_neo6mv2_aid_ini_payload_len + 2] = {0};
+  uint8_t *payload = &frame[6];
+  uint32_t flags   = gy_neo6mv2_aid_ini_flag_pos | gy_neo6mv2_aid_ini_flag_lla |
+                     gy_neo6mv2_aid_ini_flag_alt_inv;
+
+  frame[0] = 0xB5;
+  frame[1] = 0x62;
+  frame[2] = 0x0B; /* AID */
+  frame[3] = 0x01; /* INI */
+  frame[4] = gy_neo6mv2_aid_ini_payload_len;
+  frame[5] = 0;
+
+  priv_gy_neo6mv2_put_u32(&payload[0], (uint32_t)(int32_t)(latitude * 1e7f));
+  priv_gy_neo6mv2_put_u32(&payload[4], (uint32_t)(int32_t)(longitude * 1e7f));
+  priv_gy_neo6mv2_put_u32(&payload[12], position_acc_m * 100); /* cm */
+
+  if (utc_time > gy_neo6mv2_gps_epoch_unix) {
+    uint32_t gps_seconds = (uint32_t)(utc_time - gy_neo6mv2_gps_epoch_unix) +
+                           gy_neo6mv2_gps_leap_seconds;
+    uint16_t week        = gps_seconds / gy_neo6mv2_seconds_per_week;
+    uint32_t tow_ms      = (gps_seconds % gy_neo6mv2_seconds_per_week) * 1000;
+
+    payload[18] = week & 0xFF;
+    payload[19] = (week >> 8) & 0xFF;
+    priv_gy_neo6mv2_put_u32(&payload[20], tow_ms);
+    priv_gy_neo6mv2_put_u32(&payload[28], time_acc_ms);
+    flags |= gy_neo6mv2_aid_ini_flag_time;
+  }
+  priv_gy_neo6mv2_put_u32(&payload[44], flags);
+
+  /* 8-bit Fletcher checksum over class, id, length and payload */
+  uint8_t ck_a = 0;
+  uint8_t ck_b = 0;
+  for (size_t i = 2; i < sizeof(frame) - 2; i++) {
+    ck_a += frame[i];
+    ck_b += ck_a;
+  }
+  frame[sizeof(frame) - 2] = ck_a;
+  frame[sizeof(frame) - 1] = ck_b;
+
+  esp_err_t ret = priv_uart_write(frame, sizeof(frame), gy_neo6mv2_uart_num, gy_neo6mv2_tag);
+  if (ret != ESP_OK) {
+    ESP_LOGE(gy_neo6mv2_tag, "Failed to send aiding data");
+    return ret;
+  }
+
+  ESP_LOGI(gy_neo6mv2_tag, "Sent aiding: %.5f, %.5f (+/- %" PRIu32 " m)%s", latitude, longitude,
+           position_acc_m, (flags & gy_neo6mv2_aid_ini_flag_time) ? " with time" : "");
+  return ESP_OK;
+}
+
 void gy_neo6mv2_reset_on_error(gy_neo6mv2_data_t *sensor_data)
 {
   if (sensor_data->state == k_gy_neo6mv2_error) {
@@ -488,9 +513,7 @@ void gy_neo6mv2_tasks(void *sensor_data)
   gy_neo6mv2_data_t *gy_neo6mv2_data = (gy_neo6mv2_data_t *)sensor_data;
   while (1) {
     if (gy_neo6mv2_read(gy_neo6mv2_data) == ESP_OK) {
-      char *json = gy_neo6mv2_data_to_json(gy_neo6mv2_data);
-      send_sensor_data_to_webserver(json);
-      free(json);
+      event_bus_publish_sample(k_event_bus_topic_gy_neo6mv2, gy_neo6mv2_data);
     } else {
       ESP_LOGW(gy_neo6mv2_tag, "Error reading GPS data, resetting...");
       gy_neo6mv2_reset_on_error(gy_neo6mv2_data);
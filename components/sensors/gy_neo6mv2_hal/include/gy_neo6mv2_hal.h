@@ -46,6 +46,7 @@
 #define TOPOROBO_GY_NEO6MV2_HAL_H
 
 #include <stdint.h>
+#include <time.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "esp_err.h"
@@ -290,6 +291,28 @@ esp_err_t gy_neo6mv2_init(void *sensor_data);
  */
 esp_err_t gy_neo6mv2_read(gy_neo6mv2_data_t *sensor_data);
 
+/**
+ * @brief Sends position and time aiding to the GPS module (UBX-AID-INI).
+ *
+ * Giving the receiver its approximate position and the current time lets it
+ * predict visible satellites and hot start instead of searching the whole sky,
+ * which shortens the time to first fix considerably after a power cycle.
+ *
+ * @param[in] latitude Approximate latitude in decimal degrees.
+ * @param[in] longitude Approximate longitude in decimal degrees.
+ * @param[in] position_acc_m Accuracy of the position in meters.
+ * @param[in] utc_time Current UTC time, or 0 if unknown (time is then not aided).
+ * @param[in] time_acc_ms Accuracy of `utc_time` in milliseconds.
+ *
+ * @return
+ * - `ESP_OK` if the message was sent.
+ * - `ESP_FAIL` if the UART write failed.
+ *
+ * @note Call after `gy_neo6mv2_init`. The module does not acknowledge AID-INI.
+ */
+esp_err_t gy_neo6mv2_send_aiding(float latitude, float longitude, uint32_t position_acc_m,
+                                 time_t utc_time, uint32_t time_acc_ms);
+
 /**
  * @brief Manages error detection and recovery for the GY-NEO6MV2 GPS module using exponential backoff.
  *
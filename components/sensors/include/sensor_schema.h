@@ -0,0 +1,223 @@
+/* components/sensors/include/sensor_schema.h */
+
+/* One description of every reported field of every sensor's `*_data_t`.
+ *
+ * Each sensor lists its fields once, as an X-macro `<name>_schema_fields`.
+ * `sensor_schema_define` expands that list into a `sensor_schema_t` field
+ * table, and the table-driven encoders below turn any described struct into
+ * JSON, a packed little-endian binary record or a CSV row. Adding a field or
+ * a sensor is a one-line change here, and every format picks it up.
+ *
+ * `tools/telemetry_decode.py` parses the same macros to decode binary records
+ * on the host, so the wire layout has a single source of truth.
+ *
+ * Field entries are `field(struct type, member, "key", kind)` where kind is one
+ * of `f32`, `u8`, `u16`, `u32`, `i64` or `str` (a fixed `char` array, encoded
+ * up to its NUL). In the binary format, fields follow each other in list order
+ * without padding; numbers are little-endian and strings are a `u8` length
+ * followed by the characters.
+ */
+
+#ifndef TOPOROBO_SENSOR_SCHEMA_H
+#define TOPOROBO_SENSOR_SCHEMA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Macros *********************************************************************/
+
+#define bh1750_schema_fields(field)                                           \
+  field(bh1750_data_t, lux, "lux", f32)
+
+#define dht22_schema_fields(field)                                            \
+  field(dht22_data_t, temperature_c, "temperature_c", f32)                    \
+  field(dht22_data_t, humidity,      "humidity",      f32)
+
+#define mpu6050_schema_fields(field)                                          \
+  field(mpu6050_data_t, accel_x, "accel_x", f32)                              \
+  field(mpu6050_data_t, accel_y, "accel_y", f32)                              \
+  field(mpu6050_data_t, accel_z, "accel_z", f32)                              \
+  field(mpu6050_data_t, gyro_x,  "gyro_x",  f32)                              \
+  field(mpu6050_data_t, gyro_y,  "gyro_y",  f32)                              \
+  field(mpu6050_data_t, gyro_z,  "gyro_z",  f32)
+
+#define qmc5883l_schema_fields(field)                                         \
+  field(qmc5883l_data_t, mag_x,   "mag_x",   f32)                             \
+  field(qmc5883l_data_t, mag_y,   "mag_y",   f32)                             \
+  field(qmc5883l_data_t, mag_z,   "mag_z",   f32)                             \
+  field(qmc5883l_data_t, heading, "heading", f32)
+
+#define gy_neo6mv2_schema_fields(field)                                       \
+  field(gy_neo6mv2_data_t, latitude,        "latitude",        f32)           \
+  field(gy_neo6mv2_data_t, longitude,       "longitude",       f32)           \
+  field(gy_neo6mv2_data_t, speed,           "speed",           f32)           \
+  field(gy_neo6mv2_data_t, time,            "time",            str)           \
+  field(gy_neo6mv2_data_t, fix_status,      "fix_status",      u8)            \
+  field(gy_neo6mv2_data_t, satellite_count, "satellite_count", u8)            \
+  field(gy_neo6mv2_data_t, hdop,            "hdop",            f32)           \
+  field(gy_neo6mv2_data_t, retry_count,     "retry_count",     u8)            \
+  field(gy_neo6mv2_data_t, retry_interval,  "retry_interval",  u32)
+
+#define ccs811_schema_fields(field)                                           \
+  field(ccs811_data_t, eco2, "eCO2", u16)                                     \
+  field(ccs811_data_t, tvoc, "TVOC", u16)
+
+#define mq135_schema_fields(field)                                            \
+  field(mq135_data_t, gas_concentration, "gas_concentration", f32)
+
+/**
+ * @brief Every sensor schema as `schema(name, struct type, "sensor_type")`.
+ *
+ * `name` selects `<name>_schema_fields` and names the `<name>_schema` table;
+ * `sensor_type` is the value of the `sensor_type` key in JSON.
+ */
+#define sensor_schema_list(schema)                                            \
+  schema(bh1750,     bh1750_data_t,     "light")                              \
+  schema(dht22,      dht22_data_t,      "temperature_humidity")               \
+  schema(mpu6050,    mpu6050_data_t,    "accelerometer_gyroscope")            \
+  schema(qmc5883l,   qmc5883l_data_t,   "magnetometer")                       \
+  schema(gy_neo6mv2, gy_neo6mv2_data_t, "gps")                                \
+  schema(ccs811,     ccs811_data_t,     "air_quality")                        \
+  schema(mq135,      mq135_data_t,      "gas")
+
+/* Packed binary size of one field of each kind, `n` being the member's size */
+#define sensor_schema_bytes_f32(n) 4
+#define sensor_schema_bytes_u8(n)  1
+#define sensor_schema_bytes_u16(n) 2
+#define sensor_schema_bytes_u32(n) 4
+#define sensor_schema_bytes_i64(n) 8
+#define sensor_schema_bytes_str(n) (1 + (n))
+
+#define sensor_schema_member_size(type, member) sizeof(((type *)0)->member)
+
+#define sensor_schema_field_entry(type, member, key, kind)                    \
+  { (key), offsetof(type, member), sensor_schema_member_size(type, member),   \
+    k_sensor_schema_##kind },
+
+#define sensor_schema_field_bytes(type, member, key, kind)                    \
+  + sensor_schema_bytes_##kind(sensor_schema_member_size(type, member))
+
+#define sensor_schema_field_check(type, member, key, kind)                    \
+  _Static_assert(sensor_schema_member_size(type, member) ==                   \
+                   sensor_schema_bytes_##kind(0) ||                           \
+                   k_sensor_schema_##kind == k_sensor_schema_str,             \
+                 "schema kind of " #type "." #member " does not match its size");
+
+/**
+ * @brief Defines `const sensor_schema_t <name>_schema` from `<name>_schema_fields`.
+ *
+ * Also checks at compile time that every numeric member has the size of its
+ * declared kind. Use at file scope in the translation unit that owns `type`.
+ */
+#define sensor_schema_define(schema_name, type, type_name)                    \
+  schema_name##_schema_fields(sensor_schema_field_check)                      \
+  static const sensor_schema_field_t schema_name##_schema_field_table[] = {   \
+    schema_name##_schema_fields(sensor_schema_field_entry)                    \
+  };                                                                          \
+  const sensor_schema_t schema_name##_schema = {                              \
+    .name        = #schema_name,                                              \
+    .sensor_type = (type_name),                                               \
+    .fields      = schema_name##_schema_field_table,                          \
+    .field_count = sizeof(schema_name##_schema_field_table) /                 \
+                   sizeof(schema_name##_schema_field_table[0]),               \
+    .binary_size = 0 schema_name##_schema_fields(sensor_schema_field_bytes),  \
+  };
+
+#define sensor_schema_declare(name, type, sensor_type)                        \
+  extern const sensor_schema_t name##_schema;
+
+/* Enums **********************************************************************/
+
+/**
+ * @enum sensor_schema_kind_t
+ * @brief Storage type of a described field.
+ */
+typedef enum : uint8_t {
+  k_sensor_schema_f32 = 0, /**< `float` */
+  k_sensor_schema_u8  = 1, /**< `uint8_t` */
+  k_sensor_schema_u16 = 2, /**< `uint16_t` */
+  k_sensor_schema_u32 = 3, /**< `uint32_t` */
+  k_sensor_schema_i64 = 4, /**< `int64_t` */
+  k_sensor_schema_str = 5, /**< `char[]`, NUL terminated or full */
+} sensor_schema_kind_t;
+
+/* Structs ********************************************************************/
+
+/**
+ * @struct sensor_schema_field_t
+ * @brief One described member of a data struct.
+ */
+typedef struct {
+  const char          *key;    /**< JSON key and CSV column */
+  uint16_t             offset; /**< `offsetof` the member */
+  uint16_t             size;   /**< `sizeof` the member */
+  sensor_schema_kind_t kind;   /**< Storage type */
+} sensor_schema_field_t;
+
+/**
+ * @struct sensor_schema_t
+ * @brief Field table of one data struct, from `sensor_schema_define`.
+ */
+typedef struct {
+  const char                  *name;        /**< Schema name, e.g. "bh1750" */
+  const char                  *sensor_type; /**< `sensor_type` value in JSON */
+  const sensor_schema_field_t *fields;      /**< Fields in encoding order */
+  uint8_t                      field_count; /**< Entries in `fields` */
+  uint16_t                     binary_size; /**< Largest packed binary record, in bytes */
+} sensor_schema_t;
+
+/* Globals (Constants) ********************************************************/
+
+sensor_schema_list(sensor_schema_declare)
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Encodes `data` as a JSON object, `sensor_type` first, then every
+ *        field in schema order.
+ *
+ * Non-finite floats are written as `null`.
+ *
+ * @param[in] schema Schema of `data`.
+ * @param[in] data Struct described by `schema`.
+ * @return A dynamically allocated JSON string, or NULL on failure. The caller
+ *         frees it.
+ */
+char *sensor_schema_to_json(const sensor_schema_t *schema, const void *data);
+
+/**
+ * @brief Packs `data` into the binary record format.
+ *
+ * @param[in] schema Schema of `data`.
+ * @param[in] data Struct described by `schema`.
+ * @param[out] out Destination, `schema->binary_size` bytes always suffice.
+ * @param[in] out_size Size of `out`.
+ * @return Bytes written, or 0 if `out` is too small.
+ */
+size_t sensor_schema_to_binary(const sensor_schema_t *schema, const void *data,
+                               uint8_t *out, size_t out_size);
+
+/**
+ * @brief Writes `data` as one CSV row ending in a newline, fields in schema
+ *        order.
+ *
+ * @param[in] schema Schema of `data`.
+ * @param[in] data Struct described by `schema`.
+ * @param[out] out Destination, NUL terminated on success.
+ * @param[in] out_size Size of `out`.
+ * @return Length of the row, or 0 if `out` is too small.
+ */
+size_t sensor_schema_to_csv(const sensor_schema_t *schema, const void *data, char *out,
+                            size_t out_size);
+
+/**
+ * @brief Writes the CSV header row matching `sensor_schema_to_csv`.
+ *
+ * @param[in] schema Schema to describe.
+ * @param[out] out Destination, NUL terminated on success.
+ * @param[in] out_size Size of `out`.
+ * @return Length of the row, or 0 if `out` is too small.
+ */
+size_t sensor_schema_csv_header(const sensor_schema_t *schema, char *out, size_t out_size);
+
+#endif /* TOPOROBO_SENSOR_SCHEMA_H */
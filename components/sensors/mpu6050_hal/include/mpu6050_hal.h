@@ -24,8 +24,8 @@
  *     |-----------------------|
  *     | VCC  | 3.3V or 5V     |----------> VCC
  *     | GND  | Ground         |----------> GND
- *     | SDA  | I2C Data       |----------> GPIO_NUM_21 (100,000Hz)
- *     | SCL  | I2C Clock      |----------> GPIO_NUM_22 (100,000Hz)
+ *     | SDA  | I2C Data       |----------> GPIO_NUM_13 (I2C bus 1, 400,000Hz)
+ *     | SCL  | I2C Clock      |----------> GPIO_NUM_27 (I2C bus 1, 400,000Hz)
  *     | XDA  | Aux I2C Data   |----------> Floating (leave unconnected if unused)
  *     | XCL  | Aux I2C Clock  |----------> Floating (leave unconnected if unused)
  *     | ADD  | I2C Address Pin|----------> GND (or VCC for 0x69 address)
@@ -120,9 +120,9 @@ extern const uint8_t mpu6050_sda_io;
 /**
  * @brief I2C bus frequency in Hertz for communication with the MPU6050 sensor.
  *
- * Defines the frequency of the I2C bus used for communication. The standard
- * frequency of 100,000 Hz (100 kHz) ensures reliable data transfer. Higher
- * frequencies might be achievable depending on wiring and sensor quality.
+ * Defines the frequency of the I2C bus used for communication. The MPU6050
+ * supports 400 kHz fast mode, the default of its dedicated bus 1; lower it in
+ * menuconfig if the wiring does not allow it.
  */
 extern const uint32_t mpu6050_i2c_freq_hz;
 
@@ -3,20 +3,23 @@
 /* TODO: Test this */
 
 #include "mpu6050_hal.h"
-#include "webserver_tasks.h"
-#include "cJSON.h"
+#include "common/event_bus.h"
+#include "sensor_schema.h"
 #include "common/i2c.h"
+#include "common/rtos_alloc.h"
+#include "common/deferred_log.h"
+#include "common/power.h"
 #include "esp_log.h"
 #include "driver/gpio.h"
 
 /* Constants ******************************************************************/
 
 const uint8_t  mpu6050_i2c_address        = 0x68;
-const uint8_t  mpu6050_i2c_bus            = I2C_NUM_0;
+const uint8_t  mpu6050_i2c_bus            = i2c_bus_mpu6050;
 const char    *mpu6050_tag                = "MPU6050";
-const uint8_t  mpu6050_scl_io             = GPIO_NUM_22;
-const uint8_t  mpu6050_sda_io             = GPIO_NUM_21;
-const uint32_t mpu6050_i2c_freq_hz        = 100000;
+const uint8_t  mpu6050_scl_io             = i2c_bus_scl_io(i2c_bus_mpu6050);
+const uint8_t  mpu6050_sda_io             = i2c_bus_sda_io(i2c_bus_mpu6050);
+const uint32_t mpu6050_i2c_freq_hz        = i2c_bus_freq_hz(i2c_bus_mpu6050);
 const uint32_t mpu6050_polling_rate_ticks = pdMS_TO_TICKS(0.5 * 1000);
 const uint8_t  mpu6050_sample_rate_div    = 9;
 const uint8_t  mpu6050_config_dlpf        = k_mpu6050_config_dlpf_44hz;
@@ -92,6 +95,10 @@ static const uint8_t mpu6050_gyro_config_idx  = 3; /* Index of chosen values fro
  */
 static const uint8_t mpu6050_accel_config_idx = 3; /* Index of chosen values from above (0: ±2g, 1: ±4g, etc.) */
 
+/* Globals (Static) ***********************************************************/
+
+rtos_semaphore_storage_define(s_mpu6050_data_ready_sem_storage);
+
 /* Static (Private) Functions **************************************************/
 
 /**
@@ -120,63 +127,7 @@ static void IRAM_ATTR priv_mpu6050_interrupt_handler(void *arg)
 
 char *mpu6050_data_to_json(const mpu6050_data_t *data)
 {
-  cJSON *json = cJSON_CreateObject();
-  if (!json) {
-    ESP_LOGE(mpu6050_tag, "Failed to create JSON object.");
-    return NULL;
-  }
-
-  if (!cJSON_AddStringToObject(json, "sensor_type", "accelerometer_gyroscope")) {
-    ESP_LOGE(mpu6050_tag, "Failed to add sensor_type to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "accel_x", data->accel_x)) {
-    ESP_LOGE(mpu6050_tag, "Failed to add accel_x to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "accel_y", data->accel_y)) {
-    ESP_LOGE(mpu6050_tag, "Failed to add accel_y to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "accel_z", data->accel_z)) {
-    ESP_LOGE(mpu6050_tag, "Failed to add accel_z to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "gyro_x", data->gyro_x)) {
-    ESP_LOGE(mpu6050_tag, "Failed to add gyro_x to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "gyro_y", data->gyro_y)) {
-    ESP_LOGE(mpu6050_tag, "Failed to add gyro_y to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "gyro_z", data->gyro_z)) {
-    ESP_LOGE(mpu6050_tag, "Failed to add gyro_z to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  char *json_string = cJSON_PrintUnformatted(json);
-  if (!json_string) {
-    ESP_LOGE(mpu6050_tag, "Failed to serialize JSON object.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  cJSON_Delete(json);
-  return json_string;
+  return sensor_schema_to_json(&mpu6050_schema, data);
 }
 
 esp_err_t mpu6050_init(void *sensor_data)
@@ -279,7 +230,8 @@ esp_err_t mpu6050_init(void *sensor_data)
   }
 
   /* Create a binary semaphore for data readiness */
-  mpu6050_data->data_ready_sem = xSemaphoreCreateBinary();
+  mpu6050_data->data_ready_sem = priv_rtos_binary_semaphore_create(
+    rtos_storage_ref(s_mpu6050_data_ready_sem_storage));
   if (mpu6050_data->data_ready_sem == NULL) {
     ESP_LOGE(mpu6050_tag, "Failed to create semaphore");
     return ESP_FAIL;
@@ -321,6 +273,10 @@ esp_err_t mpu6050_init(void *sensor_data)
     return ret;
   }
 
+  /* Edge interrupts cannot wake the chip from light sleep, and at the
+   * configured data rate there is little idle time to gain anyway */
+  power_lock_acquire(k_power_lock_imu);
+
   mpu6050_data->state = k_mpu6050_ready; /* Sensor is initialized */
   ESP_LOGI(mpu6050_tag, "Sensor Configuration Complete");
   return ESP_OK;
@@ -336,11 +292,15 @@ esp_err_t mpu6050_read(mpu6050_data_t *sensor_data)
   uint8_t accel_data[6];
   uint8_t gyro_data[6];
 
+  /* Keep the APB clock up across both transactions of this burst */
+  power_lock_acquire(k_power_lock_i2c);
+
   /* Read accelerometer data starting from ACCEL_XOUT_H */
   esp_err_t ret = priv_i2c_read_reg_bytes(k_mpu6050_accel_xout_h_cmd, accel_data, 6,
                                           sensor_data->i2c_bus, sensor_data->i2c_address,
                                           mpu6050_tag);
   if (ret != ESP_OK) {
+    power_lock_release(k_power_lock_i2c);
     ESP_LOGE(mpu6050_tag, "Failed to read accelerometer data from MPU6050");
     sensor_data->state = k_mpu6050_error;
     return ESP_FAIL;
@@ -350,6 +310,7 @@ esp_err_t mpu6050_read(mpu6050_data_t *sensor_data)
   ret = priv_i2c_read_reg_bytes(k_mpu6050_gyro_xout_h_cmd, gyro_data, 6,
                                 sensor_data->i2c_bus, 
                                 sensor_data->i2c_address, mpu6050_tag);
+  power_lock_release(k_power_lock_i2c);
   if (ret != ESP_OK) {
     ESP_LOGE(mpu6050_tag, "Failed to read gyroscope data from MPU6050");
     sensor_data->state = k_mpu6050_error;
@@ -378,9 +339,9 @@ esp_err_t mpu6050_read(mpu6050_data_t *sensor_data)
   sensor_data->gyro_y = gyro_y_raw / gyro_sensitivity;
   sensor_data->gyro_z = gyro_z_raw / gyro_sensitivity;
 
-  ESP_LOGI(mpu6050_tag, "Accel: [%f, %f, %f] g, Gyro: [%f, %f, %f] deg/s",
-           sensor_data->accel_x, sensor_data->accel_y, sensor_data->accel_z,
-           sensor_data->gyro_x, sensor_data->gyro_y, sensor_data->gyro_z);
+  DEFERRED_LOGI(mpu6050_tag, "Accel: [%f, %f, %f] g, Gyro: [%f, %f, %f] deg/s",
+                sensor_data->accel_x, sensor_data->accel_y, sensor_data->accel_z,
+                sensor_data->gyro_x, sensor_data->gyro_y, sensor_data->gyro_z);
 
   sensor_data->state = k_mpu6050_data_updated;
   return ESP_OK;
@@ -412,9 +373,7 @@ void mpu6050_tasks(void *sensor_data)
     /* Wait indefinitely for the data_ready_sem semaphore */
     if (xSemaphoreTake(mpu6050_data->data_ready_sem, portMAX_DELAY) == pdTRUE) {
       if (mpu6050_read(mpu6050_data) == ESP_OK) {
-        char *json = mpu6050_data_to_json(mpu6050_data);
-        send_sensor_data_to_webserver(json);
-        free(json);
+        event_bus_publish_sample(k_event_bus_topic_mpu6050, mpu6050_data);
       } else {
         mpu6050_reset_on_error(mpu6050_data);
       }
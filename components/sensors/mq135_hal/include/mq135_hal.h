@@ -203,6 +203,17 @@ esp_err_t mq135_init(void *sensor_data);
  */
 esp_err_t mq135_read(mq135_data_t *sensor_data);
 
+/**
+ * @brief Convert a raw MQ135 ADC reading to a gas concentration.
+ *
+ * Applies the same curve as `mq135_read`. Used for readings taken outside the
+ * HAL, e.g. by the ULP coprocessor in survey mode.
+ *
+ * @param[in] raw_adc_value 12-bit raw ADC reading (12 dB attenuation).
+ * @return Gas concentration in ppm.
+ */
+float mq135_raw_to_ppm(uint16_t raw_adc_value);
+
 /**
  * @brief Reset the MQ135 sensor on error.
  *
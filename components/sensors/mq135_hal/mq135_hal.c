@@ -5,8 +5,8 @@
 
 #include "mq135_hal.h"
 #include <math.h>
-#include "webserver_tasks.h"
-#include "cJSON.h"
+#include "common/event_bus.h"
+#include "sensor_schema.h"
 #include "esp_log.h"
 #include "esp_adc/adc_oneshot.h"
 #include "driver/gpio.h"
@@ -58,33 +58,7 @@ static float priv_mq135_calculate_ppm(int raw_adc_value)
 
 char *mq135_data_to_json(const mq135_data_t *data)
 {
-  cJSON *json = cJSON_CreateObject();
-  if (!json) {
-    ESP_LOGE(mq135_tag, "Failed to create JSON object.");
-    return NULL;
-  }
-
-  if (!cJSON_AddStringToObject(json, "sensor_type", "gas")) {
-    ESP_LOGE(mq135_tag, "Failed to add sensor_type to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "gas_concentration", data->gas_concentration)) {
-    ESP_LOGE(mq135_tag, "Failed to add gas_concentration to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  char *json_string = cJSON_PrintUnformatted(json);
-  if (!json_string) {
-    ESP_LOGE(mq135_tag, "Failed to serialize JSON object.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  cJSON_Delete(json);
-  return json_string;
+  return sensor_schema_to_json(&mq135_schema, data);
 }
 
 esp_err_t mq135_init(void *sensor_data)
@@ -146,6 +120,11 @@ esp_err_t mq135_read(mq135_data_t *sensor_data)
   return ESP_OK;
 }
 
+float mq135_raw_to_ppm(uint16_t raw_adc_value)
+{
+  return priv_mq135_calculate_ppm(raw_adc_value);
+}
+
 void mq135_reset_on_error(mq135_data_t *sensor_data)
 {
   if (sensor_data->state == k_mq135_read_error) {
@@ -178,9 +157,7 @@ void mq135_tasks(void *sensor_data)
   mq135_data_t *mq135_data = (mq135_data_t *)sensor_data;
   while (1) {
     if (mq135_read(mq135_data) == ESP_OK) {
-      char *json = mq135_data_to_json(mq135_data);
-      send_sensor_data_to_webserver(json);
-      free(json);
+      event_bus_publish_sample(k_event_bus_topic_mq135, mq135_data);
     } else {
       mq135_reset_on_error(mq135_data);
     }
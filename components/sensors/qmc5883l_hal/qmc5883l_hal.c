@@ -2,19 +2,20 @@
 
 #include "qmc5883l_hal.h"
 #include <math.h>
-#include "webserver_tasks.h"
-#include "cJSON.h"
+#include "common/event_bus.h"
+#include "sensor_schema.h"
 #include "common/i2c.h"
+#include "common/deferred_log.h"
 #include "esp_log.h"
 
 /* Constants ******************************************************************/
 
 const uint8_t  qmc5883l_i2c_address            = 0x0D;
-const uint8_t  qmc5883l_i2c_bus                = I2C_NUM_0;
+const uint8_t  qmc5883l_i2c_bus                = i2c_bus_qmc5883l;
 const char    *qmc5883l_tag                    = "QMC5883L";
-const uint8_t  qmc5883l_scl_io                 = GPIO_NUM_22;
-const uint8_t  qmc5883l_sda_io                 = GPIO_NUM_21;
-const uint32_t qmc5883l_i2c_freq_hz            = 100000;
+const uint8_t  qmc5883l_scl_io                 = i2c_bus_scl_io(i2c_bus_qmc5883l);
+const uint8_t  qmc5883l_sda_io                 = i2c_bus_sda_io(i2c_bus_qmc5883l);
+const uint32_t qmc5883l_i2c_freq_hz            = i2c_bus_freq_hz(i2c_bus_qmc5883l);
 const uint32_t qmc5883l_polling_rate_ticks     = pdMS_TO_TICKS(5 * 1000);
 const uint8_t  qmc5883l_odr_setting            = k_qmc5883l_odr_100hz;
 const uint8_t  qmc5883l_max_retries            = 4;
@@ -32,51 +33,7 @@ static const uint8_t qmc5883l_scale_config_idx = 0; /* Index of chosen values (0
 
 char *qmc5883l_data_to_json(const qmc5883l_data_t *data)
 {
-  cJSON *json = cJSON_CreateObject();
-  if (!json) {
-    ESP_LOGE(qmc5883l_tag, "Failed to create JSON object.");
-    return NULL;
-  }
-
-  if (!cJSON_AddStringToObject(json, "sensor_type", "magnetometer")) {
-    ESP_LOGE(qmc5883l_tag, "Failed to add sensor_type to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "mag_x", data->mag_x)) {
-    ESP_LOGE(qmc5883l_tag, "Failed to add mag_x to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "mag_y", data->mag_y)) {
-    ESP_LOGE(qmc5883l_tag, "Failed to add mag_y to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "mag_z", data->mag_z)) {
-    ESP_LOGE(qmc5883l_tag, "Failed to add mag_z to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  if (!cJSON_AddNumberToObject(json, "heading", data->heading)) {
-    ESP_LOGE(qmc5883l_tag, "Failed to add heading to JSON.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  char *json_string = cJSON_PrintUnformatted(json);
-  if (!json_string) {
-    ESP_LOGE(qmc5883l_tag, "Failed to serialize JSON object.");
-    cJSON_Delete(json);
-    return NULL;
-  }
-
-  cJSON_Delete(json);
-  return json_string;
+  return sensor_schema_to_json(&qmc5883l_schema, data);
 }
 
 esp_err_t qmc5883l_init(void *sensor_data)
@@ -155,9 +112,9 @@ esp_err_t qmc5883l_read(qmc5883l_data_t *sensor_data)
   }
   sensor_data->heading = heading;
 
-  ESP_LOGI(qmc5883l_tag, "Mag X: %f, Mag Y: %f, Mag Z: %f, Heading: %f degrees",
-           sensor_data->mag_x, sensor_data->mag_y, sensor_data->mag_z,
-           sensor_data->heading);
+  DEFERRED_LOGI(qmc5883l_tag, "Mag X: %f, Mag Y: %f, Mag Z: %f, Heading: %f degrees",
+                sensor_data->mag_x, sensor_data->mag_y, sensor_data->mag_z,
+                sensor_data->heading);
   sensor_data->state = k_qmc5883l_data_updated;
   return ESP_OK;
 }
@@ -192,9 +149,7 @@ void qmc5883l_tasks(void *sensor_data)
   qmc5883l_data_t *qmc5883l_data = (qmc5883l_data_t *)sensor_data;
   while (1) {
     if (qmc5883l_read(qmc5883l_data) == ESP_OK) {
-      char *json = qmc5883l_data_to_json(qmc5883l_data);
-      send_sensor_data_to_webserver(json);
-      free(json);
+      event_bus_publish_sample(k_event_bus_topic_qmc5883l, qmc5883l_data);
     } else {
       qmc5883l_reset_on_error(qmc5883l_data);
     }
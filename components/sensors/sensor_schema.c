@@ -0,0 +1,218 @@
+/* components/sensors/sensor_schema.c */
+
+#include "sensor_schema.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sensor_hal.h"
+
+/* Macros *********************************************************************/
+
+#define sensor_schema_max_number_chars (24) /* "%.7g" float, or any 64-bit integer */
+
+/* Globals (Constants) ********************************************************/
+
+sensor_schema_list(sensor_schema_define)
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Tells whether a string character is dropped from text encodings.
+ *
+ * Dropping quotes, backslashes, commas and control characters keeps strings
+ * valid in both JSON and CSV without escaping.
+ */
+static bool priv_sensor_schema_drop_char(char c)
+{
+  return c == '"' || c == '\\' || c == ',' || (unsigned char)c < 0x20;
+}
+
+/**
+ * @brief Formats one field as text at `out`.
+ *
+ * @param[in] json Quote strings and write non-finite floats as `null`;
+ *                 otherwise (CSV) strings are bare and non-finite floats empty.
+ * @return Characters written, or a negative value if `size` is too small.
+ */
+static int priv_sensor_schema_format(const sensor_schema_field_t *field, const uint8_t *data,
+                                     char *out, size_t size, bool json)
+{
+  const uint8_t *member = data + field->offset;
+  int            written;
+
+  switch (field->kind) {
+    case k_sensor_schema_f32: {
+      float value;
+      memcpy(&value, member, sizeof(value));
+      if (!isfinite(value)) {
+        written = snprintf(out, size, "%s", json ? "null" : "");
+      } else {
+        written = snprintf(out, size, "%.7g", (double)value);
+      }
+      break;
+    }
+    case k_sensor_schema_u8:
+      written = snprintf(out, size, "%u", (unsigned)*member);
+      break;
+    case k_sensor_schema_u16: {
+      uint16_t value;
+      memcpy(&value, member, sizeof(value));
+      written = snprintf(out, size, "%u", (unsigned)value);
+      break;
+    }
+    case k_sensor_schema_u32: {
+      uint32_t value;
+      memcpy(&value, member, sizeof(value));
+      written = snprintf(out, size, "%lu", (unsigned long)value);
+      break;
+    }
+    case k_sensor_schema_i64: {
+      int64_t value;
+      memcpy(&value, member, sizeof(value));
+      written = snprintf(out, size, "%lld", (long long)value);
+      break;
+    }
+    case k_sensor_schema_str: {
+      size_t pos = 0;
+      if (json && pos < size) {
+        out[pos++] = '"';
+      }
+      for (uint16_t i = 0; i < field->size && member[i] != '\0'; i++) {
+        if (!priv_sensor_schema_drop_char((char)member[i]) && pos < size) {
+          out[pos++] = (char)member[i];
+        }
+      }
+      if (json && pos < size) {
+        out[pos++] = '"';
+      }
+      if (pos >= size) {
+        return -1;
+      }
+      out[pos] = '\0';
+      written  = (int)pos;
+      break;
+    }
+    default:
+      return -1;
+  }
+
+  return (written >= 0 && (size_t)written < size) ? written : -1;
+}
+
+/**
+ * @brief Upper bound of the text length of one field's value.
+ */
+static size_t priv_sensor_schema_text_bound(const sensor_schema_field_t *field)
+{
+  return (field->kind == k_sensor_schema_str) ? field->size + 2
+                                              : sensor_schema_max_number_chars;
+}
+
+/* Public Functions ***********************************************************/
+
+char *sensor_schema_to_json(const sensor_schema_t *schema, const void *data)
+{
+  size_t size = strlen("{\"sensor_type\":\"\"}") + strlen(schema->sensor_type) + 1;
+  for (uint8_t i = 0; i < schema->field_count; i++) {
+    size += strlen(schema->fields[i].key) + 4 + priv_sensor_schema_text_bound(&schema->fields[i]);
+  }
+
+  char *json = malloc(size);
+  if (json == NULL) {
+    return NULL;
+  }
+
+  int pos = snprintf(json, size, "{\"sensor_type\":\"%s\"", schema->sensor_type);
+  for (uint8_t i = 0; i < schema->field_count && pos > 0; i++) {
+    int written = snprintf(json + pos, size - pos, ",\"%s\":", schema->fields[i].key);
+    pos         = (written > 0) ? pos + written : -1;
+    if (pos > 0) {
+      written = priv_sensor_schema_format(&schema->fields[i], data, json + pos, size - pos, true);
+      pos     = (written >= 0) ? pos + written : -1;
+    }
+  }
+
+  if (pos < 0 || (size_t)pos + 2 > size) {
+    free(json);
+    return NULL;
+  }
+  json[pos++] = '}';
+  json[pos]   = '\0';
+  return json;
+}
+
+size_t sensor_schema_to_binary(const sensor_schema_t *schema, const void *data,
+                               uint8_t *out, size_t out_size)
+{
+  size_t pos = 0;
+
+  for (uint8_t i = 0; i < schema->field_count; i++) {
+    const sensor_schema_field_t *field  = &schema->fields[i];
+    const uint8_t               *member = (const uint8_t *)data + field->offset;
+
+    if (field->kind == k_sensor_schema_str) {
+      size_t length = strnlen((const char *)member, field->size);
+      if (pos + 1 + length > out_size) {
+        return 0;
+      }
+      out[pos++] = (uint8_t)length;
+      memcpy(out + pos, member, length);
+      pos += length;
+    } else {
+      if (pos + field->size > out_size) {
+        return 0;
+      }
+      memcpy(out + pos, member, field->size); /* Little-endian, as on the host */
+      pos += field->size;
+    }
+  }
+  return pos;
+}
+
+size_t sensor_schema_to_csv(const sensor_schema_t *schema, const void *data, char *out,
+                            size_t out_size)
+{
+  size_t pos = 0;
+
+  for (uint8_t i = 0; i < schema->field_count; i++) {
+    if (i > 0) {
+      if (pos + 1 >= out_size) {
+        return 0;
+      }
+      out[pos++] = ',';
+    }
+    int written = priv_sensor_schema_format(&schema->fields[i], data, out + pos,
+                                            out_size - pos, false);
+    if (written < 0) {
+      return 0;
+    }
+    pos += written;
+  }
+
+  if (pos + 2 > out_size) {
+    return 0;
+  }
+  out[pos++] = '\n';
+  out[pos]   = '\0';
+  return pos;
+}
+
+size_t sensor_schema_csv_header(const sensor_schema_t *schema, char *out, size_t out_size)
+{
+  size_t pos = 0;
+
+  for (uint8_t i = 0; i < schema->field_count; i++) {
+    int written = snprintf(out + pos, out_size - pos, "%s%s", (i > 0) ? "," : "",
+                           schema->fields[i].key);
+    if (written < 0 || pos + written + 2 > out_size) {
+      return 0;
+    }
+    pos += written;
+  }
+
+  out[pos++] = '\n';
+  out[pos]   = '\0';
+  return pos;
+}
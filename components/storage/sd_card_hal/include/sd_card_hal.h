@@ -49,11 +49,17 @@
 #ifndef TOPOROBO_SD_CARD_HAL_H
 #define TOPOROBO_SD_CARD_HAL_H
 
+#include <stdbool.h>
 #include "esp_err.h"
 #include "driver/spi_common.h"
 
 /* Constants ******************************************************************/
 
+/**
+ * @brief Mount point of the SD card file system ("/sdcard").
+ */
+extern const char *sd_card_mount;
+
 /**
  * @brief GPIO pin used for the Chip Select (CS) signal of the SPI interface.
  *
@@ -143,6 +149,11 @@ extern const uint8_t sd_card_max_files;
  * Note: The FAT driver reads the cluster size from the SD card's FAT boot sector when
  * mounting an existing filesystem. This ensures compatibility, but if the existing
  * cluster size is incompatible with the application or hardware, mounting may fail.
+ *
+ * Set by `CONFIG_TOPOROBO_SD_ALLOCATION_PROFILE`: 16 KB for general use, or 64 KB
+ * for sequential logging, where larger clusters mean fewer FAT lookups per append.
+ * `sd_card_init` logs a card formatted with another cluster size, and with
+ * `CONFIG_TOPOROBO_SD_FORMAT_ON_PROFILE_MISMATCH` reformats it with this one.
  */
 extern const uint32_t sd_card_allocation_unit_size;
 
@@ -153,7 +164,9 @@ extern const uint32_t sd_card_allocation_unit_size;
  *
  * Mounts the SD card filesystem using FATFS. The card must be properly formatted
  * with a FAT filesystem for successful mounting. Uses the SPI host configured in
- * `sd_card_spi_host`.
+ * `sd_card_spi_host`. Returns at once if the card is already mounted, and may
+ * be called again after a failure to retry. Checks the card's cluster size
+ * against `sd_card_allocation_unit_size` once mounted.
  *
  * @return
  * - `ESP_OK` if the initialization is successful.
@@ -161,5 +174,23 @@ extern const uint32_t sd_card_allocation_unit_size;
  */
 esp_err_t sd_card_init(void);
 
+/**
+ * @brief Returns true once `sd_card_init` has mounted the card.
+ */
+bool sd_card_is_mounted(void);
+
+/**
+ * @brief Reformats the mounted SD card with `sd_card_allocation_unit_size`.
+ *
+ * Erases every file on the card. Called by `sd_card_init` on a cluster size
+ * mismatch with `CONFIG_TOPOROBO_SD_FORMAT_ON_PROFILE_MISMATCH`.
+ *
+ * @return
+ * - `ESP_OK` if the card was formatted.
+ * - `ESP_ERR_INVALID_STATE` if `sd_card_init` has not mounted the card.
+ * - `ESP_FAIL` if formatting fails.
+ */
+esp_err_t sd_card_format(void);
+
 #endif /* TOPOROBO_SD_CARD_HAL_H */
 
@@ -3,10 +3,13 @@
 /* TODO: Test this */
 
 #include "sd_card_hal.h"
+#include "sdkconfig.h"
 #include "common/spi.h"
 #include "esp_vfs_fat.h"
 #include "esp_log.h"
 #include "sdmmc_cmd.h"
+#include "ff.h"
+#include "diskio_sdmmc.h"
 
 /* Constants ******************************************************************/
 
@@ -18,13 +21,62 @@ const uint8_t           sd_card_miso_io              = GPIO_NUM_19;
 const uint8_t           sd_card_clk_io               = GPIO_NUM_14;
 const uint32_t          sd_card_spi_freq_hz          = 1000000; /* 1 MHz SPI frequency */
 const spi_host_device_t sd_card_spi_host             = SPI2_HOST;
-const uint8_t           sd_card_max_files            = 5;
-const uint32_t          sd_card_allocation_unit_size = 16 * 1024;
+const uint8_t           sd_card_max_files            = 8;
+const uint32_t          sd_card_allocation_unit_size = CONFIG_TOPOROBO_SD_ALLOCATION_UNIT;
+
+/* Globals (Static) ***********************************************************/
+
+static sdmmc_card_t *s_card = NULL;
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Returns the cluster size of the mounted card in bytes, 0 if it
+ *        cannot be read.
+ */
+static uint32_t priv_sd_card_cluster_size(void)
+{
+    char   drive[3] = { (char)('0' + ff_diskio_get_pdrv_card(s_card)), ':', '\0' };
+    FATFS *fs;
+    DWORD  free_clusters;
+
+    if (f_getfree(drive, &free_clusters, &fs) != FR_OK) {
+        return 0;
+    }
+    return (uint32_t)fs->csize * s_card->csd.sector_size;
+}
+
+/**
+ * @brief Compares the card's cluster size with the allocation unit profile,
+ *        and reformats the card on a mismatch if
+ *        `CONFIG_TOPOROBO_SD_FORMAT_ON_PROFILE_MISMATCH` is set.
+ */
+static void priv_sd_card_check_profile(void)
+{
+    uint32_t cluster_size = priv_sd_card_cluster_size();
+    if (cluster_size == 0 || cluster_size == sd_card_allocation_unit_size) {
+        return;
+    }
+
+#if CONFIG_TOPOROBO_SD_FORMAT_ON_PROFILE_MISMATCH
+    ESP_LOGW(sd_card_tag, "Card uses %u byte clusters, reformatting for the %u byte profile",
+             (unsigned)cluster_size, (unsigned)sd_card_allocation_unit_size);
+    sd_card_format();
+#else
+    ESP_LOGW(sd_card_tag, "Card uses %u byte clusters, the profile wants %u; "
+             "format it or enable CONFIG_TOPOROBO_SD_FORMAT_ON_PROFILE_MISMATCH",
+             (unsigned)cluster_size, (unsigned)sd_card_allocation_unit_size);
+#endif
+}
 
 /* Public Functions ***********************************************************/
 
 esp_err_t sd_card_init(void)
 {
+    if (s_card != NULL) {
+        return ESP_OK; /* Already mounted */
+    }
+
     ESP_LOGI(sd_card_tag, "Starting SD card initialization...");
 
     /* Initialize the SPI bus */
@@ -37,8 +89,9 @@ esp_err_t sd_card_init(void)
         .max_transfer_sz = 4000,
     };
 
+    /* The bus stays initialized after a failed mount, so a retry reuses it */
     esp_err_t ret = spi_bus_initialize(sd_card_spi_host, &bus_cfg, SPI_DMA_CH_AUTO);
-    if (ret != ESP_OK) {
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
         ESP_LOGE(sd_card_tag, "Failed to initialize SPI bus: %s", esp_err_to_name(ret));
         return ESP_FAIL;
     }
@@ -65,11 +118,34 @@ esp_err_t sd_card_init(void)
         return ESP_FAIL;
     }
 
+    s_card = card;
     ESP_LOGI(sd_card_tag, "SD card mounted at %s", sd_card_mount);
 
     /* Optional: Print card info for debugging */
     sdmmc_card_print_info(stdout, card);
 
+    priv_sd_card_check_profile();
     return ESP_OK;
 }
 
+bool sd_card_is_mounted(void)
+{
+    return s_card != NULL;
+}
+
+esp_err_t sd_card_format(void)
+{
+    if (s_card == NULL) {
+        ESP_LOGE(sd_card_tag, "SD card is not mounted");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    ESP_LOGW(sd_card_tag, "Formatting SD card with %u byte allocation units",
+             (unsigned)sd_card_allocation_unit_size);
+    esp_err_t ret = esp_vfs_fat_sdcard_format(sd_card_mount, s_card);
+    if (ret != ESP_OK) {
+        ESP_LOGE(sd_card_tag, "Failed to format SD card: %s", esp_err_to_name(ret));
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
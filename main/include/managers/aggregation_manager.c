@@ -0,0 +1,277 @@
+/* main/include/managers/aggregation_manager.c */
+
+#include "aggregation_manager.h"
+#include <stddef.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+#include "sensor_hal.h"
+#include "common/rtos_alloc.h"
+#include "common/report_filter.h"
+#include "common/stream_stats.h"
+
+/* Macros *********************************************************************/
+
+#define aggregation_queue_length     (16)
+#define aggregation_task_stack_bytes (3072)
+#define aggregation_task_priority    (3)  /* Below the telemetry router */
+#define aggregation_task_core_id     (0)  /* Processing core */
+#define aggregation_channel(topic, type, field, value_type) \
+  { (topic), #field, offsetof(type, field), (value_type) }
+
+/* Globals (Constants) ********************************************************/
+
+const char *aggregation_tag = "AGGREGATION";
+
+/**
+ * @brief Channels summarized per window, grouped by topic. A summary lists the
+ *        channels of its topic in this order.
+ */
+static const struct {
+  event_bus_topic_t    topic;
+  const char          *name;
+  uint16_t             offset;
+  report_filter_type_t type;
+} aggregation_channels[] = {
+  aggregation_channel(k_event_bus_topic_bh1750,     bh1750_data_t,     lux,               k_report_filter_float),
+  aggregation_channel(k_event_bus_topic_qmc5883l,   qmc5883l_data_t,   heading,           k_report_filter_float),
+  aggregation_channel(k_event_bus_topic_mpu6050,    mpu6050_data_t,    accel_x,           k_report_filter_float),
+  aggregation_channel(k_event_bus_topic_mpu6050,    mpu6050_data_t,    accel_y,           k_report_filter_float),
+  aggregation_channel(k_event_bus_topic_mpu6050,    mpu6050_data_t,    accel_z,           k_report_filter_float),
+  aggregation_channel(k_event_bus_topic_dht22,      dht22_data_t,      temperature_c,     k_report_filter_float),
+  aggregation_channel(k_event_bus_topic_dht22,      dht22_data_t,      humidity,          k_report_filter_float),
+  aggregation_channel(k_event_bus_topic_gy_neo6mv2, gy_neo6mv2_data_t, speed,             k_report_filter_float),
+  aggregation_channel(k_event_bus_topic_gy_neo6mv2, gy_neo6mv2_data_t, hdop,              k_report_filter_float),
+  aggregation_channel(k_event_bus_topic_ccs811,     ccs811_data_t,     eco2,              k_report_filter_uint16),
+  aggregation_channel(k_event_bus_topic_ccs811,     ccs811_data_t,     tvoc,              k_report_filter_uint16),
+  aggregation_channel(k_event_bus_topic_mq135,      mq135_data_t,      gas_concentration, k_report_filter_float),
+};
+
+#define aggregation_channel_count (sizeof(aggregation_channels) / sizeof(aggregation_channels[0]))
+
+#if CONFIG_TOPOROBO_AGGREGATION
+
+#define aggregation_panes   (CONFIG_TOPOROBO_AGGREGATION_PANES)
+#define aggregation_pane_us ((int64_t)CONFIG_TOPOROBO_AGGREGATION_WINDOW_MS * 1000 / aggregation_panes)
+
+/* Globals (Static) ***********************************************************/
+
+static QueueHandle_t  s_aggregation_queue = NULL;
+static uint32_t       s_topic_mask        = 0; /**< `event_bus_topic_bit` of every aggregated topic */
+static stream_stats_t s_panes[aggregation_channel_count][aggregation_panes]; /* Aggregation task only */
+static uint8_t        s_pane              = 0; /**< Pane currently filling */
+static uint8_t        s_panes_closed      = 0; /**< Closed panes, up to `aggregation_panes` */
+
+rtos_queue_storage_define(s_aggregation_queue_storage, aggregation_queue_length,
+                          sizeof(event_bus_msg_t *));
+rtos_task_storage_define(s_aggregation_task_storage, aggregation_task_stack_bytes);
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Adds the channels of one bus message to the current pane.
+ */
+static void priv_aggregation_add(const event_bus_msg_t *msg)
+{
+  for (size_t i = 0; i < aggregation_channel_count; i++) {
+    if (aggregation_channels[i].topic == msg->topic) {
+      float value = report_filter_read(aggregation_channels[i].type,
+                                       msg->payload + aggregation_channels[i].offset);
+      stream_stats_add(&s_panes[i][s_pane], value);
+    }
+  }
+}
+
+/**
+ * @brief Publishes the summary of `topic` over the last full window.
+ */
+static void priv_aggregation_publish(event_bus_topic_t topic, int64_t window_end_us)
+{
+  aggregation_summary_t summary = {
+    .window_end_us = window_end_us,
+    .window_ms     = CONFIG_TOPOROBO_AGGREGATION_WINDOW_MS,
+    .topic         = topic,
+  };
+  uint32_t samples = 0;
+
+  for (size_t i = 0; i < aggregation_channel_count; i++) {
+    if (aggregation_channels[i].topic != topic) {
+      continue;
+    }
+
+    stream_stats_t window;
+    stream_stats_reset(&window);
+    for (uint8_t pane = 0; pane < aggregation_panes; pane++) {
+      stream_stats_merge(&window, &s_panes[i][pane]);
+    }
+
+    aggregation_channel_summary_t *channel = &summary.channels[summary.channel_count++];
+    channel->count  = window.count;
+    channel->min    = window.min;
+    channel->max    = window.max;
+    channel->mean   = (float)window.mean;
+    channel->stddev = stream_stats_stddev(&window);
+    samples        += window.count;
+  }
+
+  if (samples == 0) {
+    return; /* Sensor disabled or silent, nothing to report */
+  }
+  if (event_bus_publish_sample(k_event_bus_topic_summary, &summary) != ESP_OK) {
+    ESP_LOGW(aggregation_tag, "Dropped %s summary", event_bus_topic_name(topic));
+  }
+}
+
+/**
+ * @brief Closes the current pane, publishes once a full window has been seen
+ *        and starts the next pane.
+ */
+static void priv_aggregation_close_pane(int64_t pane_end_us)
+{
+  if (s_panes_closed < aggregation_panes) {
+    s_panes_closed++;
+  }
+  if (s_panes_closed == aggregation_panes) {
+    for (uint8_t topic = 0; topic < k_event_bus_topic_count; topic++) {
+      if (s_topic_mask & event_bus_topic_bit(topic)) {
+        priv_aggregation_publish((event_bus_topic_t)topic, pane_end_us);
+      }
+    }
+  }
+
+  s_pane = (s_pane + 1) % aggregation_panes;
+  for (size_t i = 0; i < aggregation_channel_count; i++) {
+    stream_stats_reset(&s_panes[i][s_pane]);
+  }
+}
+
+/**
+ * @brief Accumulates bus messages and closes a pane every pane period.
+ */
+static void priv_aggregation_task(void *param)
+{
+  int64_t          pane_end_us = esp_timer_get_time() + aggregation_pane_us;
+  event_bus_msg_t *msg;
+
+  while (1) {
+    int64_t now_us = esp_timer_get_time();
+    if (now_us >= pane_end_us) {
+      priv_aggregation_close_pane(pane_end_us);
+      pane_end_us += aggregation_pane_us;
+      continue;
+    }
+
+    TickType_t wait = pdMS_TO_TICKS((pane_end_us - now_us + 999) / 1000);
+    if (xQueueReceive(s_aggregation_queue, &msg, (wait > 0) ? wait : 1) == pdTRUE) {
+      priv_aggregation_add(msg);
+      event_bus_release(msg);
+    }
+  }
+}
+
+#endif /* CONFIG_TOPOROBO_AGGREGATION */
+
+/* Public Functions ***********************************************************/
+
+esp_err_t aggregation_manager_init(void)
+{
+#if CONFIG_TOPOROBO_AGGREGATION
+  uint8_t per_topic[k_event_bus_topic_count] = { 0 };
+
+  for (size_t i = 0; i < aggregation_channel_count; i++) {
+    event_bus_topic_t topic = aggregation_channels[i].topic;
+    if (topic >= k_event_bus_topic_count || topic == k_event_bus_topic_summary ||
+        ++per_topic[topic] > aggregation_max_channels) {
+      ESP_LOGE(aggregation_tag, "Invalid channel %s", aggregation_channels[i].name);
+      return ESP_ERR_INVALID_ARG;
+    }
+    s_topic_mask |= event_bus_topic_bit(topic);
+  }
+  for (size_t i = 0; i < aggregation_channel_count; i++) {
+    for (uint8_t pane = 0; pane < aggregation_panes; pane++) {
+      stream_stats_reset(&s_panes[i][pane]);
+    }
+  }
+
+  s_aggregation_queue = priv_rtos_queue_create(aggregation_queue_length,
+                                               event_bus_queue_item_size,
+                                               rtos_storage_ref(s_aggregation_queue_storage));
+  if (s_aggregation_queue == NULL) {
+    ESP_LOGE(aggregation_tag, "Failed to create aggregation queue");
+    return ESP_FAIL;
+  }
+
+  if (event_bus_subscribe(s_topic_mask, s_aggregation_queue) != ESP_OK) {
+    ESP_LOGE(aggregation_tag, "Failed to subscribe to the event bus");
+    return ESP_FAIL;
+  }
+
+  if (priv_rtos_task_create(priv_aggregation_task, "Aggregation", aggregation_task_stack_bytes,
+                            NULL, aggregation_task_priority, NULL, aggregation_task_core_id,
+                            rtos_storage_ref(s_aggregation_task_storage)) != ESP_OK) {
+    ESP_LOGE(aggregation_tag, "Failed to create aggregation task");
+    return ESP_FAIL;
+  }
+
+  ESP_LOGI(aggregation_tag, "Aggregating %u channels over %d ms windows in %d panes",
+           (unsigned)aggregation_channel_count, CONFIG_TOPOROBO_AGGREGATION_WINDOW_MS,
+           aggregation_panes);
+#endif
+  return ESP_OK;
+}
+
+bool aggregation_manager_raw_local_only(event_bus_topic_t topic)
+{
+#if CONFIG_TOPOROBO_AGGREGATION && CONFIG_TOPOROBO_AGGREGATION_RAW_LOCAL_ONLY
+  return (s_topic_mask & event_bus_topic_bit(topic)) != 0;
+#else
+  return false;
+#endif
+}
+
+char *aggregation_summary_to_json(const aggregation_summary_t *summary)
+{
+  cJSON *json = cJSON_CreateObject();
+  if (!json) {
+    ESP_LOGE(aggregation_tag, "Failed to create JSON object.");
+    return NULL;
+  }
+
+  cJSON_AddStringToObject(json, "sensor_type", "summary");
+  cJSON_AddStringToObject(json, "sensor", event_bus_topic_name(summary->topic));
+  cJSON_AddNumberToObject(json, "window_end_us", (double)summary->window_end_us);
+  cJSON_AddNumberToObject(json, "window_ms", summary->window_ms);
+
+  uint8_t channel = 0;
+  for (size_t i = 0; i < aggregation_channel_count && channel < summary->channel_count; i++) {
+    if (aggregation_channels[i].topic != summary->topic) {
+      continue;
+    }
+
+    const aggregation_channel_summary_t *stats = &summary->channels[channel++];
+    cJSON *object = cJSON_AddObjectToObject(json, aggregation_channels[i].name);
+    if (object) {
+      cJSON_AddNumberToObject(object, "count", stats->count);
+      if (stats->count > 0) {
+        cJSON_AddNumberToObject(object, "min", stats->min);
+        cJSON_AddNumberToObject(object, "max", stats->max);
+        cJSON_AddNumberToObject(object, "mean", stats->mean);
+        cJSON_AddNumberToObject(object, "stddev", stats->stddev);
+      }
+    }
+  }
+
+  char *json_string = cJSON_PrintUnformatted(json);
+  if (!json_string) {
+    ESP_LOGE(aggregation_tag, "Failed to serialize JSON object.");
+    cJSON_Delete(json);
+    return NULL;
+  }
+
+  cJSON_Delete(json);
+  return json_string;
+}
@@ -0,0 +1,432 @@
+/* main/include/managers/columnar_manager.c */
+
+#include "columnar_manager.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sensor_schema.h"
+#include "file_write_manager.h"
+#include "sd_card_hal.h"
+#include "common/gorilla.h"
+#include "common/mem_policy.h"
+
+/* Macros *********************************************************************/
+
+#define columnar_min_valid_time_s  (1672531200) /* 2023-01-01, earlier clocks are not set yet */
+#define columnar_min_valid_time_us ((int64_t)columnar_min_valid_time_s * 1000000)
+
+/* Structs ********************************************************************/
+
+/**
+ * @brief Block being filled for one topic.
+ */
+typedef struct {
+  uint8_t *block;      /**< Header, column headers and columns sized for the full block */
+  uint32_t count;      /**< Rows added so far */
+  int64_t  t_min_us;   /**< Timestamp of the first row */
+  int64_t  t_max_us;   /**< Timestamp of the last row */
+  int64_t  created_us; /**< Time since boot of the first row, for the age checks */
+} columnar_topic_t;
+
+/* Globals (Constants) ********************************************************/
+
+const char *columnar_tag = "COLUMNAR";
+
+#if CONFIG_TOPOROBO_COLUMNAR_EXPORT
+
+/* Globals (Static) ***********************************************************/
+
+static columnar_topic_t s_topics[k_event_bus_topic_count]; /* Telemetry router task only */
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Returns the column headers of `block`.
+ */
+static columnar_column_header_t *priv_columnar_columns(uint8_t *block)
+{
+  return (columnar_column_header_t *)(block + sizeof(columnar_block_header_t));
+}
+
+/**
+ * @brief Allocates an empty block for `schema`, laid out for the full row count.
+ */
+static uint8_t *priv_columnar_block_create(const sensor_schema_t *schema)
+{
+  uint8_t column_count = schema->field_count + 1;
+  size_t  offset       = sizeof(columnar_block_header_t) +
+                         column_count * sizeof(columnar_column_header_t);
+
+  uint8_t *block = mem_policy_calloc(k_mem_policy_bulk, 1, columnar_manager_block_bytes(schema));
+  if (block == NULL) {
+    return NULL;
+  }
+
+  columnar_column_header_t *columns = priv_columnar_columns(block);
+  columns[0] = (columnar_column_header_t) {
+    .kind   = k_sensor_schema_i64,
+    .width  = sizeof(int64_t),
+    .field  = columnar_timestamp_field,
+    .offset = offset,
+  };
+  offset += sizeof(int64_t) * CONFIG_TOPOROBO_COLUMNAR_BLOCK_ROWS;
+
+  for (uint8_t i = 0; i < schema->field_count; i++) {
+    columns[i + 1] = (columnar_column_header_t) {
+      .kind   = schema->fields[i].kind,
+      .width  = schema->fields[i].size,
+      .field  = i,
+      .offset = offset,
+    };
+    offset += schema->fields[i].size * CONFIG_TOPOROBO_COLUMNAR_BLOCK_ROWS;
+  }
+  return block;
+}
+
+/**
+ * @brief Reads a numeric column value as a float for the min/max statistics.
+ */
+static float priv_columnar_value(sensor_schema_kind_t kind, const uint8_t *value)
+{
+  switch (kind) {
+    case k_sensor_schema_f32: {
+      float v;
+      memcpy(&v, value, sizeof(v));
+      return v;
+    }
+    case k_sensor_schema_u8:
+      return *value;
+    case k_sensor_schema_u16: {
+      uint16_t v;
+      memcpy(&v, value, sizeof(v));
+      return v;
+    }
+    case k_sensor_schema_u32: {
+      uint32_t v;
+      memcpy(&v, value, sizeof(v));
+      return (float)v;
+    }
+    case k_sensor_schema_i64: {
+      int64_t v;
+      memcpy(&v, value, sizeof(v));
+      return (float)v;
+    }
+    default:
+      return 0.0f;
+  }
+}
+
+#if CONFIG_TOPOROBO_COLUMNAR_GORILLA
+
+/**
+ * @brief Reads an integer column value for an integer gorilla stream.
+ */
+static int64_t priv_columnar_int(sensor_schema_kind_t kind, const uint8_t *value)
+{
+  switch (kind) {
+    case k_sensor_schema_u8:
+      return *value;
+    case k_sensor_schema_u16: {
+      uint16_t v;
+      memcpy(&v, value, sizeof(v));
+      return v;
+    }
+    case k_sensor_schema_u32: {
+      uint32_t v;
+      memcpy(&v, value, sizeof(v));
+      return v;
+    }
+    case k_sensor_schema_i64: {
+      int64_t v;
+      memcpy(&v, value, sizeof(v));
+      return v;
+    }
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief Encodes the contiguous columns of `block` as gorilla streams into
+ *        `output`, column headers included.
+ *
+ * @return Size of the encoded block, or 0 if it would not be smaller than
+ *         `capacity`.
+ */
+static size_t priv_columnar_compress(uint8_t *block, uint8_t column_count, uint32_t count,
+                                     uint8_t *output, size_t capacity)
+{
+  columnar_column_header_t *columns = priv_columnar_columns(output);
+  size_t                    offset  = sizeof(columnar_block_header_t) +
+                                      column_count * sizeof(columnar_column_header_t);
+
+  memcpy(columns, priv_columnar_columns(block), column_count * sizeof(columnar_column_header_t));
+  for (uint8_t i = 0; i < column_count; i++) {
+    const uint8_t *values = block + columns[i].offset;
+    columns[i].offset     = offset;
+    if (offset >= capacity) {
+      return 0;
+    }
+
+    if (columns[i].kind == k_sensor_schema_str) {
+      size_t size = (size_t)count * columns[i].width;
+      if (offset + size >= capacity) {
+        return 0;
+      }
+      memcpy(output + offset, values, size);
+      offset += size;
+      continue;
+    }
+
+    gorilla_encoder_t encoder;
+    gorilla_encoder_init(&encoder, output + offset, capacity - offset);
+    for (uint32_t row = 0; row < count; row++) {
+      const uint8_t *cell = values + (size_t)row * columns[i].width;
+      bool           fits = (columns[i].kind == k_sensor_schema_f32)
+                          ? gorilla_put_float(&encoder, priv_columnar_value(columns[i].kind, cell))
+                          : gorilla_put_int(&encoder, priv_columnar_int(columns[i].kind, cell));
+      if (!fits) {
+        return 0;
+      }
+    }
+    offset += gorilla_encoder_size(&encoder);
+  }
+  return (offset < capacity) ? offset : 0;
+}
+
+#endif /* CONFIG_TOPOROBO_COLUMNAR_GORILLA */
+
+/**
+ * @brief Unpacks one schema-packed record into row `row` of the columns.
+ *
+ * @return false if the record is shorter than its schema says.
+ */
+static bool priv_columnar_add_row(const sensor_schema_t *schema, uint8_t *block, uint32_t row,
+                                  const uint8_t *record, size_t length)
+{
+  columnar_column_header_t *columns = priv_columnar_columns(block);
+  size_t                    pos     = 0;
+
+  for (uint8_t i = 0; i < schema->field_count; i++) {
+    columnar_column_header_t *column = &columns[i + 1];
+    uint8_t                  *cell   = block + column->offset + (size_t)row * column->width;
+
+    if (column->kind == k_sensor_schema_str) {
+      if (pos >= length || pos + 1 + record[pos] > length || record[pos] > column->width) {
+        return false;
+      }
+      memset(cell, 0, column->width);
+      memcpy(cell, record + pos + 1, record[pos]);
+      pos += 1 + record[pos];
+      continue;
+    }
+
+    if (pos + column->width > length) {
+      return false;
+    }
+    memcpy(cell, record + pos, column->width);
+    pos += column->width;
+
+    float value = priv_columnar_value(column->kind, cell);
+    if (row == 0 || value < column->min) {
+      column->min = value;
+    }
+    if (row == 0 || value > column->max) {
+      column->max = value;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Converts a sample time since boot to Unix time, so rollups bucket
+ *        on the wall clock and rows of different boots do not collide.
+ *
+ * @return The Unix time in microseconds, or `timestamp_us` unchanged while
+ *         the clock is not set.
+ */
+static int64_t priv_columnar_wall_time(int64_t timestamp_us)
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  if (now.tv_sec < columnar_min_valid_time_s) {
+    return timestamp_us;
+  }
+  int64_t now_us = (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+  return timestamp_us + (now_us - esp_timer_get_time());
+}
+
+/**
+ * @brief Closes the block of `topic` and queues it for writing.
+ */
+static esp_err_t priv_columnar_flush(event_bus_topic_t topic, const sensor_schema_t *schema)
+{
+  columnar_topic_t *state = &s_topics[topic];
+
+  columnar_block_header_t header = {
+    .magic        = columnar_block_magic,
+    .version      = columnar_block_version,
+    .topic        = topic,
+    .column_count = schema->field_count + 1,
+    .count        = state->count,
+    .t_min_us     = state->t_min_us,
+    .t_max_us     = state->t_max_us,
+  };
+  memcpy(state->block, &header, sizeof(header));
+
+  size_t   size  = 0;
+  uint8_t *block = columnar_manager_finish_block(state->block, &size);
+
+  char path[max_file_path_length];
+#if CONFIG_TOPOROBO_RETENTION
+  /* One segment file per period, so the retention job can roll up and delete old data */
+  snprintf(path, sizeof(path), "%s/%s-%lld.col", sd_card_mount, event_bus_topic_name(topic),
+           (long long)(time(NULL) / CONFIG_TOPOROBO_RETENTION_SEGMENT_S));
+  state->block = NULL; /* Owned by the file writer from here on */
+  state->count = 0;
+  return file_write_enqueue_segment(path, block, size);
+#else
+  snprintf(path, sizeof(path), "%s/%s.col", sd_card_mount, event_bus_topic_name(topic));
+  state->block = NULL; /* Owned by the file writer from here on */
+  state->count = 0;
+  return file_write_enqueue_block(path, block, size);
+#endif
+}
+
+#endif /* CONFIG_TOPOROBO_COLUMNAR_EXPORT */
+
+/* Public Functions ***********************************************************/
+
+#if CONFIG_TOPOROBO_COLUMNAR_EXPORT
+
+size_t columnar_manager_block_bytes(const sensor_schema_t *schema)
+{
+  size_t size = sizeof(columnar_block_header_t) +
+                (schema->field_count + 1) * sizeof(columnar_column_header_t) +
+                sizeof(int64_t) * CONFIG_TOPOROBO_COLUMNAR_BLOCK_ROWS;
+  for (uint8_t i = 0; i < schema->field_count; i++) {
+    size += schema->fields[i].size * CONFIG_TOPOROBO_COLUMNAR_BLOCK_ROWS;
+  }
+  return size;
+}
+
+uint8_t *columnar_manager_finish_block(uint8_t *block, size_t *size)
+{
+  columnar_block_header_t header;
+  memcpy(&header, block, sizeof(header));
+  columnar_column_header_t *columns = priv_columnar_columns(block);
+
+  /* Move the columns down so they are contiguous for the rows actually filled */
+  size_t offset = sizeof(columnar_block_header_t) +
+                  header.column_count * sizeof(columnar_column_header_t);
+  for (uint8_t i = 0; i < header.column_count; i++) {
+    memmove(block + offset, block + columns[i].offset, (size_t)header.count * columns[i].width);
+    columns[i].offset = offset;
+    offset           += (size_t)header.count * columns[i].width;
+  }
+
+  header.encoding = k_columnar_encoding_raw;
+#if CONFIG_TOPOROBO_COLUMNAR_GORILLA
+  uint8_t *compressed = mem_policy_malloc(k_mem_policy_dma, offset);
+  size_t   packed     = (compressed != NULL)
+                      ? priv_columnar_compress(block, header.column_count, header.count,
+                                               compressed, offset)
+                      : 0;
+  if (packed > 0) {
+    free(block);
+    block           = compressed;
+    offset          = packed;
+    header.encoding = k_columnar_encoding_gorilla;
+  } else {
+    free(compressed); /* Out of memory or incompressible, written raw */
+  }
+#endif
+
+  header.block_size = offset;
+  memcpy(block, &header, sizeof(header));
+  *size = offset;
+  return block;
+}
+
+#endif /* CONFIG_TOPOROBO_COLUMNAR_EXPORT */
+
+esp_err_t columnar_manager_append(const telemetry_buffer_t *buffer)
+{
+#if CONFIG_TOPOROBO_COLUMNAR_EXPORT
+  const sensor_schema_t *schema = telemetry_manager_schema(buffer->topic);
+  if (schema == NULL || buffer->format != k_telemetry_format_binary ||
+      buffer->length < sizeof(telemetry_binary_header_t)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  /* The wall clock may be set while a block fills; a block never mixes the two time bases */
+  columnar_topic_t *state        = &s_topics[buffer->topic];
+  int64_t           timestamp_us = priv_columnar_wall_time(buffer->timestamp_us);
+  if (state->block != NULL && state->count > 0 &&
+      (state->t_min_us < columnar_min_valid_time_us) != (timestamp_us < columnar_min_valid_time_us)) {
+    esp_err_t ret = priv_columnar_flush(buffer->topic, schema);
+    if (ret != ESP_OK) {
+      return ret;
+    }
+  }
+
+  if (state->block == NULL) {
+    state->block = priv_columnar_block_create(schema);
+    if (state->block == NULL) {
+      ESP_LOGE(columnar_tag, "No memory for a %s block", event_bus_topic_name(buffer->topic));
+      return ESP_ERR_NO_MEM;
+    }
+    state->count = 0;
+  }
+
+  if (!priv_columnar_add_row(schema, state->block, state->count,
+                             buffer->data + sizeof(telemetry_binary_header_t),
+                             buffer->length - sizeof(telemetry_binary_header_t))) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  columnar_column_header_t *timestamps = priv_columnar_columns(state->block);
+  memcpy(state->block + timestamps->offset + (size_t)state->count * sizeof(int64_t),
+         &timestamp_us, sizeof(int64_t));
+  if (state->count == 0) {
+    state->t_min_us   = timestamp_us;
+    state->created_us = buffer->timestamp_us;
+  }
+  state->t_max_us = timestamp_us;
+  state->count++;
+
+  if (state->count >= CONFIG_TOPOROBO_COLUMNAR_BLOCK_ROWS ||
+      buffer->timestamp_us - state->created_us >= CONFIG_TOPOROBO_COLUMNAR_BLOCK_MAX_AGE_MS * 1000LL) {
+    return priv_columnar_flush(buffer->topic, schema);
+  }
+  return ESP_OK;
+#else
+  return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void columnar_manager_flush_stale(int64_t now_us)
+{
+#if CONFIG_TOPOROBO_COLUMNAR_EXPORT
+  for (uint8_t topic = 0; topic < k_event_bus_topic_count; topic++) {
+    columnar_topic_t *state = &s_topics[topic];
+    if (state->block == NULL || state->count == 0 ||
+        now_us - state->created_us < CONFIG_TOPOROBO_COLUMNAR_BLOCK_MAX_AGE_MS * 1000LL) {
+      continue;
+    }
+
+    esp_err_t ret = priv_columnar_flush(topic, telemetry_manager_schema(topic));
+    if (ret != ESP_OK) {
+      ESP_LOGW(columnar_tag, "Stale %s block not written: %s", event_bus_topic_name(topic),
+               esp_err_to_name(ret));
+    }
+  }
+#else
+  (void)now_us;
+#endif
+}
@@ -4,21 +4,89 @@
 
 #include "file_write_manager.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_vfs_fat.h"
+#include "sd_card_hal.h"
+#include "common/rtos_alloc.h"
+#include "common/deferred_log.h"
+#include "common/stream_stats.h"
+#include "common/trace.h"
+#include "common/metrics.h"
+#include "common/mem_policy.h"
+
+/* Macros *********************************************************************/
+
+#define file_write_queue_length      (10)   /* Maximum queued write operations */
+#define file_write_task_stack_bytes  (4096)
+#define file_write_max_open          (4)    /* Files kept open between writes */
+#define file_write_idle_close_ms     (5000) /* Open files unused this long are closed */
+#define file_write_terminator_bytes  (32)   /* Zeroed end marker after the data of a preallocated segment */
+#define file_write_max_continuations (9)    /* `<name>~1` .. `<name>~9` for segments that cannot be resumed */
+#define file_write_mount_retry_ms    (30000) /* Mount attempts while no card is mounted */
+#define file_write_max_parked        (8)    /* Closed preallocated segments remembered for reopening */
+
+#define file_write_append_bucket_count (10) /* Entries of `file_write_append_bounds` */
+
+#if CONFIG_TOPOROBO_RETENTION
+#define file_write_prealloc_bytes ((size_t)CONFIG_TOPOROBO_SD_SEGMENT_PREALLOC_KB * 1024)
+#define file_write_retire_ms      ((uint32_t)CONFIG_TOPOROBO_RETENTION_SEGMENT_S * 1000) /* Unused this long, a segment has rolled over */
+#else
+#define file_write_prealloc_bytes ((size_t)0)
+#define file_write_retire_ms      ((uint32_t)0)
+#endif
+
+/* Structs ********************************************************************/
+
+/**
+ * @brief A file kept open by the file write task.
+ */
+typedef struct {
+  char           path[max_file_path_length]; /**< Path requested by the writers */
+  FILE          *file;                       /**< Open file, NULL if the slot is free */
+  TickType_t     last_used;                  /**< Tick of the last write */
+  bool           preallocated;               /**< Created contiguous, `end` is the data size */
+  size_t         end;                        /**< Bytes of data in a preallocated segment */
+  stream_stats_t latency;                    /**< Append latency in microseconds */
+  uint16_t       buckets[file_write_append_bucket_count + 1]; /**< Appends per `file_write_append_bounds` bucket, last unbounded */
+} file_write_handle_t;
 
 /* Globals (Constants) ********************************************************/
 
 const char    *file_manager_tag   = "FILE_MANAGER";
-const uint32_t max_pending_writes = 10; /* Maximum queued write operations */
+const uint32_t max_pending_writes = file_write_queue_length;
+
+/**
+ * @brief Bucket bounds of the append duration metric (s), write and fsync.
+ */
+static const float file_write_append_bounds[file_write_append_bucket_count] = {
+  0.001f, 0.0025f, 0.005f, 0.01f, 0.025f, 0.05f, 0.1f, 0.25f, 0.5f, 1.0f,
+};
 
 /* Globals (Static) ***********************************************************/
 
-static QueueHandle_t s_file_write_queue;
+static QueueHandle_t       s_file_write_queue;
+static volatile uint32_t   s_file_writing = 0; /**< 1 while the task holds a dequeued request */
+static file_write_handle_t s_handles[file_write_max_open]; /* File write task only */
+static file_write_handle_t s_parked[file_write_max_parked]; /* Closed segments, `file` NULL; file write task only */
+static metrics_histogram_t s_append_contiguous_metric; /* Preallocated segments */
+static metrics_histogram_t s_append_chained_metric;    /* Files grown cluster by cluster */
+static metrics_counter_t   s_append_error_metric;
+static metrics_counter_t   s_unmounted_metric;
+static metrics_gauge_t     s_mounted_metric;
+
+rtos_queue_storage_define(s_file_write_queue_storage, file_write_queue_length,
+                          sizeof(file_write_request_t));
+rtos_task_storage_define(s_file_write_task_storage, file_write_task_stack_bytes);
 
 /* Private Functions **********************************************************/
 
@@ -40,44 +108,360 @@ static void priv_get_timestamp(char *buffer, size_t buffer_len)
   strftime(buffer, buffer_len, "%Y-%m-%d %H:%M:%S", &timeinfo);
 }
 
+/**
+ * @brief Logs the append latency and latency histogram of a file, over
+ *        every open of a preallocated segment.
+ */
+static void priv_file_write_log_latency(const file_write_handle_t *handle)
+{
+  if (handle->latency.count > 0) {
+    const uint16_t *b = handle->buckets;
+    ESP_LOGI(file_manager_tag, "Closed %s (%s): %lu appends, latency mean %.0f us, max %.0f us",
+             handle->path, handle->preallocated ? "contiguous" : "chained",
+             (unsigned long)handle->latency.count, handle->latency.mean,
+             (double)handle->latency.max);
+    ESP_LOGI(file_manager_tag, "  ms <=1:%u <=2.5:%u <=5:%u <=10:%u <=25:%u <=50:%u "
+             "<=100:%u <=250:%u <=500:%u <=1000:%u >1000:%u",
+             b[0], b[1], b[2], b[3], b[4], b[5], b[6], b[7], b[8], b[9], b[10]);
+  }
+}
+
+/**
+ * @brief Trims a parked segment to its data and forgets it; it is not
+ *        written again.
+ */
+static void priv_file_write_retire(file_write_handle_t *parked)
+{
+  FILE *file = fopen(parked->path, "r+b");
+  if (file == NULL || ftruncate(fileno(file), parked->end) != 0) {
+    ESP_LOGW(file_manager_tag, "Failed to trim %s", parked->path);
+  }
+  if (file != NULL) {
+    fclose(file);
+  }
+  priv_file_write_log_latency(parked);
+  parked->path[0] = '\0';
+}
+
+/**
+ * @brief Closes an open file.
+ *
+ * A preallocated segment keeps its extent, its data ended by the zeroed
+ * terminator, and is parked: reopened at its end by the next write to it,
+ * so idle closes and evictions do not give up the contiguous space. It is
+ * trimmed once unused for a segment period, or when its parking slot is
+ * needed.
+ */
+static void priv_file_write_close(file_write_handle_t *handle)
+{
+  fclose(handle->file);
+  handle->file = NULL;
+
+  if (!handle->preallocated) {
+    priv_file_write_log_latency(handle);
+    return;
+  }
+
+  file_write_handle_t *slot = &s_parked[0];
+  for (int i = 0; i < file_write_max_parked; i++) {
+    if (s_parked[i].path[0] == '\0') {
+      slot = &s_parked[i];
+      break;
+    }
+    if (s_parked[i].last_used < slot->last_used) {
+      slot = &s_parked[i];
+    }
+  }
+  if (slot->path[0] != '\0') {
+    priv_file_write_retire(slot);
+  }
+  *slot = *handle;
+}
+
+/**
+ * @brief Reopens a parked segment at the end of its data.
+ *
+ * @return true if `path` was parked, `handle` then holds it (open, or with
+ *         a NULL file if it could not be reopened).
+ */
+static bool priv_file_write_unpark(file_write_handle_t *handle, const char *path)
+{
+  for (int i = 0; i < file_write_max_parked; i++) {
+    file_write_handle_t *parked = &s_parked[i];
+    if (parked->path[0] == '\0' || strcmp(parked->path, path) != 0) {
+      continue;
+    }
+    *handle         = *parked;
+    parked->path[0] = '\0';
+    handle->file    = fopen(path, "r+b");
+    if (handle->file != NULL && fseek(handle->file, (long)handle->end, SEEK_SET) != 0) {
+      fclose(handle->file);
+      handle->file = NULL;
+    }
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Opens a log segment, preallocating it as one contiguous extent.
+ *
+ * A segment left at its full preallocated size was not closed cleanly, so
+ * the end of its data is unknown; writing continues in `<name>~N<ext>`.
+ */
+static FILE *priv_file_write_open_segment(file_write_handle_t *handle)
+{
+  char        path[max_file_path_length];
+  const char *extension = strrchr(handle->path, '.');
+  int         stem      = (extension != NULL) ? (int)(extension - handle->path)
+                                              : (int)strlen(handle->path);
+
+  snprintf(path, sizeof(path), "%s", handle->path);
+  for (int n = 1; n <= file_write_max_continuations + 1; n++) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+      if (esp_vfs_fat_create_contiguous_file(sd_card_mount, path, file_write_prealloc_bytes,
+                                             true) != ESP_OK) {
+        ESP_LOGW(file_manager_tag, "No contiguous space for %s", path);
+        return fopen(path, "a");
+      }
+      FILE *file = fopen(path, "r+b");
+      if (file != NULL) {
+        handle->preallocated = true;
+        handle->end          = 0;
+      }
+      return file;
+    }
+    if ((size_t)st.st_size < file_write_prealloc_bytes) {
+      return fopen(path, "a"); /* Closed cleanly, appended to normally */
+    }
+    snprintf(path, sizeof(path), "%.*s~%d%s", stem, handle->path, n,
+             (extension != NULL) ? extension : "");
+  }
+
+  ESP_LOGE(file_manager_tag, "No continuation left for %s", handle->path);
+  return NULL;
+}
+
+/**
+ * @brief Returns the open handle of `path`, opening the file if needed and
+ *        closing the least recently used one to make room.
+ */
+static file_write_handle_t *priv_file_write_handle(const char *path, bool segment)
+{
+  file_write_handle_t *slot = &s_handles[0];
+
+  for (int i = 0; i < file_write_max_open; i++) {
+    if (s_handles[i].file != NULL && strcmp(s_handles[i].path, path) == 0) {
+      return &s_handles[i];
+    }
+    if (slot->file != NULL &&
+        (s_handles[i].file == NULL || s_handles[i].last_used < slot->last_used)) {
+      slot = &s_handles[i];
+    }
+  }
+  if (slot->file != NULL) {
+    priv_file_write_close(slot);
+  }
+
+  memset(slot, 0, sizeof(*slot));
+  if (priv_file_write_unpark(slot, path)) {
+    return (slot->file != NULL) ? slot : NULL;
+  }
+  snprintf(slot->path, sizeof(slot->path), "%s", path);
+  stream_stats_reset(&slot->latency);
+  slot->file = (segment && file_write_prealloc_bytes > 0) ? priv_file_write_open_segment(slot)
+                                                          : fopen(path, "a");
+  return (slot->file != NULL) ? slot : NULL;
+}
+
+/**
+ * @brief Appends `length` bytes to an open file and syncs it to the card.
+ *
+ * In a preallocated segment the data is followed by a zeroed terminator,
+ * overwritten by the next append, so readers stop at the end of the data
+ * rather than reading the unwritten rest of the extent.
+ */
+static bool priv_file_write_append(file_write_handle_t *handle, const void *bytes, size_t length)
+{
+  static const uint8_t terminator[file_write_terminator_bytes] = { 0 };
+  int64_t              start_us = esp_timer_get_time();
+  uint16_t             traced   = (length > UINT16_MAX) ? UINT16_MAX : (uint16_t)length;
+
+  trace_begin(k_trace_category_sd, "sd append", traced);
+  bool ok = (fwrite(bytes, 1, length, handle->file) == length);
+  if (ok && handle->preallocated) {
+    handle->end += length;
+    if (handle->end + sizeof(terminator) <= file_write_prealloc_bytes &&
+        fwrite(terminator, 1, sizeof(terminator), handle->file) == sizeof(terminator)) {
+      fseek(handle->file, -(long)sizeof(terminator), SEEK_CUR);
+    }
+  }
+  ok = ok && fflush(handle->file) == 0 && fsync(fileno(handle->file)) == 0;
+  trace_end(k_trace_category_sd, "sd append", traced);
+
+  float  elapsed_us = (float)(esp_timer_get_time() - start_us);
+  size_t bucket     = 0;
+  while (bucket < file_write_append_bucket_count &&
+         elapsed_us / 1e6f > file_write_append_bounds[bucket]) {
+    bucket++;
+  }
+  if (handle->buckets[bucket] < UINT16_MAX) {
+    handle->buckets[bucket]++;
+  }
+  stream_stats_add(&handle->latency, elapsed_us);
+  metrics_histogram_observe(handle->preallocated ? &s_append_contiguous_metric
+                                                 : &s_append_chained_metric,
+                            elapsed_us / 1e6f);
+  if (!ok) {
+    metrics_counter_inc(&s_append_error_metric);
+  }
+  handle->last_used = xTaskGetTickCount();
+  return ok;
+}
+
 /**
  * @brief File writing task to handle queued write requests.
+ *
+ * Files stay open between writes, so an append does not walk the cluster
+ * chain from the start of the file again, and are closed once idle. While
+ * no card is mounted, mounting is retried every `file_write_mount_retry_ms`.
  */
 static void priv_file_write_task(void *param)
 {
   file_write_request_t request;
+  TickType_t           last_mount_try = xTaskGetTickCount();
 
   while (1) {
-    if (xQueueReceive(s_file_write_queue, &request, portMAX_DELAY) == pdTRUE) {
-      FILE *file = fopen(request.file_path, "a");
-      if (file == NULL) {
+    if (xQueueReceive(s_file_write_queue, &request,
+                      pdMS_TO_TICKS(file_write_idle_close_ms)) == pdTRUE) {
+      s_file_writing = 1;
+
+      file_write_handle_t *handle = priv_file_write_handle(request.file_path, request.segment);
+      if (handle == NULL) {
         ESP_LOGE(file_manager_tag, "Failed to open file: %s", request.file_path);
+        free(request.block);
+        s_file_writing = 0;
         continue;
       }
 
-      size_t bytes_written = fwrite(request.data, 1, strlen(request.data), file);
-      fclose(file);
+      const void *bytes = (request.block != NULL) ? (const void *)request.block : request.data;
+      bool        ok    = priv_file_write_append(handle, bytes, request.length);
+      free(request.block);
+      s_file_writing = 0;
 
-      if (bytes_written != strlen(request.data)) {
+      if (!ok) {
         ESP_LOGE(file_manager_tag, "Failed to write all data to file: %s", request.file_path);
+        priv_file_write_close(handle); /* Reopened on the next request */
       } else {
-        ESP_LOGI(file_manager_tag, "Data written to file: %s", request.file_path);
+        DEFERRED_LOGI(file_manager_tag, "Data written to file: %s", request.file_path);
+      }
+    }
+
+    TickType_t now = xTaskGetTickCount();
+    if (!sd_card_is_mounted() && now - last_mount_try >= pdMS_TO_TICKS(file_write_mount_retry_ms)) {
+      last_mount_try = now;
+      if (sd_card_init() == ESP_OK) {
+        ESP_LOGI(file_manager_tag, "SD card mounted, writes resume");
+        metrics_gauge_set(&s_mounted_metric, 1.0f);
+      }
+    }
+
+    for (int i = 0; i < file_write_max_open; i++) {
+      if (s_handles[i].file != NULL &&
+          now - s_handles[i].last_used >= pdMS_TO_TICKS(file_write_idle_close_ms)) {
+        priv_file_write_close(&s_handles[i]);
       }
     }
+    for (int i = 0; i < file_write_max_parked; i++) {
+      if (s_parked[i].path[0] != '\0' &&
+          now - s_parked[i].last_used >= pdMS_TO_TICKS(file_write_retire_ms)) {
+        priv_file_write_retire(&s_parked[i]);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Returns false, counting the dropped write, while no card is mounted.
+ */
+static bool priv_file_write_mounted(void)
+{
+  if (sd_card_is_mounted()) {
+    return true;
   }
+  metrics_counter_inc(&s_unmounted_metric);
+  return false;
+}
+
+/**
+ * @brief Queues a write of an owned heap buffer; frees it if it cannot be queued.
+ */
+static esp_err_t priv_file_write_enqueue_owned(const char *file_path, uint8_t *block,
+                                               size_t length, bool segment)
+{
+  if (file_path == NULL || block == NULL) {
+    ESP_LOGE(file_manager_tag, "Invalid file path or data");
+    free(block);
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (!priv_file_write_mounted()) {
+    free(block);
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  file_write_request_t request;
+
+  snprintf(request.file_path, max_file_path_length, "%s", file_path);
+  request.length  = length;
+  request.block   = block;
+  request.segment = segment;
+
+  if (xQueueSend(s_file_write_queue, &request, 0) != pdTRUE) {
+    ESP_LOGE(file_manager_tag, "File write queue is full");
+    free(block);
+    return ESP_FAIL;
+  }
+
+  DEFERRED_LOGI(file_manager_tag, "Block write of %u bytes queued for file: %s",
+                (unsigned)length, file_path);
+  return ESP_OK;
 }
 
 /* Public Functions ***********************************************************/
 
 esp_err_t file_write_manager_init(void)
 {
-  s_file_write_queue = xQueueCreate(max_pending_writes, sizeof(file_write_request_t));
+  s_file_write_queue = priv_rtos_queue_create(max_pending_writes, sizeof(file_write_request_t),
+                                              rtos_storage_ref(s_file_write_queue_storage));
   if (s_file_write_queue == NULL) {
     ESP_LOGE(file_manager_tag, "Failed to create file write queue");
     return ESP_FAIL;
   }
 
-  xTaskCreate(priv_file_write_task, "priv_file_write_task", 4096, NULL, 5, NULL);
+  metrics_histogram_register(&s_append_contiguous_metric, "toporobo_sd_append_duration_seconds",
+                             "Time to append and sync a write on the card.",
+                             "layout=\"contiguous\"", file_write_append_bounds,
+                             file_write_append_bucket_count);
+  metrics_histogram_register(&s_append_chained_metric, "toporobo_sd_append_duration_seconds",
+                             "Time to append and sync a write on the card.",
+                             "layout=\"chained\"", file_write_append_bounds,
+                             file_write_append_bucket_count);
+  metrics_counter_register(&s_append_error_metric, "toporobo_sd_append_errors_total",
+                           "Appends to the card that failed.", NULL);
+  metrics_counter_register(&s_unmounted_metric, "toporobo_sd_unmounted_drops_total",
+                           "Writes dropped because no card was mounted.", NULL);
+  metrics_gauge_register(&s_mounted_metric, "toporobo_sd_mounted",
+                         "1 while the SD card is mounted.", NULL);
+  metrics_gauge_set(&s_mounted_metric, sd_card_is_mounted() ? 1.0f : 0.0f);
+
+  if (priv_rtos_task_create(priv_file_write_task, "priv_file_write_task",
+                            file_write_task_stack_bytes, NULL, 5, NULL, 0,
+                            rtos_storage_ref(s_file_write_task_storage)) != ESP_OK) {
+    ESP_LOGE(file_manager_tag, "Failed to create file write task");
+    return ESP_FAIL;
+  }
+
   ESP_LOGI(file_manager_tag, "File write manager initialized");
   return ESP_OK;
 }
@@ -88,20 +472,89 @@ esp_err_t file_write_enqueue(const char *file_path, const char *data)
     ESP_LOGE(file_manager_tag, "Invalid file path or data");
     return ESP_ERR_INVALID_ARG;
   }
+  if (!priv_file_write_mounted()) {
+    return ESP_ERR_INVALID_STATE;
+  }
 
   file_write_request_t request;
 
   char timestamp[32];
   priv_get_timestamp(timestamp, sizeof(timestamp));
+  int written = snprintf(request.data, max_data_length, "%s %s\n", timestamp, data);
+  if (written < 0) {
+    return ESP_FAIL;
+  }
+
+  /* A line longer than the request goes out whole as an owned block */
+  if ((size_t)written >= max_data_length) {
+    uint8_t *line = mem_policy_malloc(k_mem_policy_dma, (size_t)written + 1);
+    if (line == NULL) {
+      return ESP_ERR_NO_MEM;
+    }
+    snprintf((char *)line, (size_t)written + 1, "%s %s\n", timestamp, data);
+    return priv_file_write_enqueue_owned(file_path, line, (size_t)written, false);
+  }
+
+  snprintf(request.file_path, max_file_path_length, "%s", file_path);
+  request.length  = (size_t)written;
+  request.block   = NULL;
+  request.segment = false;
+
+  if (xQueueSend(s_file_write_queue, &request, 0) != pdTRUE) {
+    ESP_LOGE(file_manager_tag, "File write queue is full");
+    return ESP_FAIL;
+  }
+
+  DEFERRED_LOGI(file_manager_tag, "Write request queued for file: %s", file_path);
+  return ESP_OK;
+}
+
+
+esp_err_t file_write_enqueue_bytes(const char *file_path, const void *data, size_t length)
+{
+  if (file_path == NULL || data == NULL) {
+    ESP_LOGE(file_manager_tag, "Invalid file path or data");
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (length > max_data_length) {
+    ESP_LOGE(file_manager_tag, "Write of %u bytes exceeds request size", (unsigned)length);
+    return ESP_ERR_INVALID_SIZE;
+  }
+  if (!priv_file_write_mounted()) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  file_write_request_t request;
+
   snprintf(request.file_path, max_file_path_length, "%s", file_path);
-  snprintf(request.data, max_data_length, "%s %s\n", timestamp, data);
+  memcpy(request.data, data, length);
+  request.length  = length;
+  request.block   = NULL;
+  request.segment = false;
 
   if (xQueueSend(s_file_write_queue, &request, 0) != pdTRUE) {
     ESP_LOGE(file_manager_tag, "File write queue is full");
     return ESP_FAIL;
   }
 
-  ESP_LOGI(file_manager_tag, "Write request queued for file: %s", file_path);
+  DEFERRED_LOGI(file_manager_tag, "Write request queued for file: %s", file_path);
   return ESP_OK;
 }
 
+esp_err_t file_write_enqueue_block(const char *file_path, uint8_t *block, size_t length)
+{
+  return priv_file_write_enqueue_owned(file_path, block, length, false);
+}
+
+esp_err_t file_write_enqueue_segment(const char *file_path, uint8_t *block, size_t length)
+{
+  return priv_file_write_enqueue_owned(file_path, block, length, true);
+}
+
+uint32_t file_write_pending(void)
+{
+  if (s_file_write_queue == NULL) {
+    return 0;
+  }
+  return uxQueueMessagesWaiting(s_file_write_queue) + s_file_writing;
+}
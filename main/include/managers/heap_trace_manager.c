@@ -0,0 +1,338 @@
+/* main/include/managers/heap_trace_manager.c */
+
+#include "heap_trace_manager.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "cJSON.h"
+#include "common/rtos_alloc.h"
+#if CONFIG_TOPOROBO_HEAP_TRACE
+#include "esp_heap_trace.h"
+#endif
+
+/* Macros *********************************************************************/
+
+#define heap_trace_task_stack_bytes (4096)
+#define heap_trace_task_priority    (1)      /* Just above idle, the window is mostly a delay */
+#define heap_trace_task_core_id     (0)      /* Processing core */
+#define heap_trace_max_sites        (96)     /* Distinct call stacks per report, the rest is "other" */
+#define heap_trace_max_window_ms    (600000)
+
+/* Enums **********************************************************************/
+
+/**
+ * @brief Progress of the trace task.
+ */
+typedef enum : uint8_t {
+  k_heap_trace_state_idle    = 0, /**< No window traced yet */
+  k_heap_trace_state_running = 1, /**< A window is being recorded */
+  k_heap_trace_state_done    = 2, /**< The report of the last window is ready */
+} heap_trace_state_t;
+
+/* Globals (Constants) ********************************************************/
+
+const char *heap_trace_tag = "HEAP_TRACE";
+
+#if CONFIG_TOPOROBO_HEAP_TRACE
+
+#define heap_trace_depth (sizeof(((heap_trace_record_t *)0)->alloced_by) / sizeof(void *))
+
+/* Structs ********************************************************************/
+
+/**
+ * @brief Allocations made from one call stack during the window.
+ */
+typedef struct {
+  void    *callers[heap_trace_depth]; /**< Return addresses, innermost first; all NULL for "other" */
+  uint32_t allocs;                    /**< Allocations */
+  uint32_t freed;                     /**< Of those, freed before the window ended */
+  uint32_t bytes;                     /**< Bytes requested */
+} heap_trace_site_t;
+
+/**
+ * @brief Result of one window.
+ */
+typedef struct {
+  uint32_t          window_ms;                                /**< Window length */
+  uint32_t          records;                                  /**< Records kept by heap_trace */
+  uint32_t          capacity;                                 /**< Record buffer size */
+  bool              overflowed;                               /**< Records were lost, totals are low */
+  uint32_t          allocs;                                   /**< Allocations over all sites */
+  uint32_t          bytes;                                    /**< Bytes over all sites */
+  uint32_t          site_count;                               /**< Distinct call stacks */
+  uint8_t           top_count;                                /**< Valid entries of `top` */
+  heap_trace_site_t top[CONFIG_TOPOROBO_HEAP_TRACE_TOP_N];    /**< Sites by allocation count */
+} heap_trace_report_t;
+
+/* Globals (Static) ***********************************************************/
+
+static QueueHandle_t               s_window_queue = NULL;
+static SemaphoreHandle_t           s_report_mutex = NULL; /**< Guards `s_report` */
+static volatile heap_trace_state_t s_state        = k_heap_trace_state_idle;
+static heap_trace_report_t         s_report;
+
+/* Trace task only */
+static heap_trace_record_t s_records[CONFIG_TOPOROBO_HEAP_TRACE_RECORDS];
+static heap_trace_site_t   s_sites[heap_trace_max_sites + 1]; /* Last entry: "other" */
+static uint32_t            s_site_count = 0;
+
+rtos_queue_storage_define(s_window_queue_storage, 1, sizeof(uint32_t));
+rtos_semaphore_storage_define(s_report_mutex_storage);
+rtos_task_storage_define(s_heap_trace_task_storage, heap_trace_task_stack_bytes);
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Returns the site of `callers`, adding it if new, or "other" once
+ *        the table is full.
+ */
+static heap_trace_site_t *priv_heap_trace_site(void *const *callers)
+{
+  for (uint32_t i = 0; i < s_site_count; i++) {
+    if (memcmp(s_sites[i].callers, callers, sizeof(s_sites[i].callers)) == 0) {
+      return &s_sites[i];
+    }
+  }
+
+  if (s_site_count == heap_trace_max_sites) {
+    return &s_sites[heap_trace_max_sites];
+  }
+
+  heap_trace_site_t *site = &s_sites[s_site_count++];
+  memcpy(site->callers, callers, sizeof(site->callers));
+  return site;
+}
+
+/**
+ * @brief Groups the records of the finished window by call stack and keeps
+ *        the sites with the most allocations in `report`.
+ */
+static void priv_heap_trace_aggregate(heap_trace_report_t *report)
+{
+  heap_trace_summary_t summary;
+  heap_trace_record_t  record;
+
+  memset(s_sites, 0, sizeof(s_sites));
+  s_site_count = 0;
+
+  size_t count = heap_trace_get_count();
+  for (size_t i = 0; i < count; i++) {
+    if (heap_trace_get(i, &record) != ESP_OK || record.address == NULL) {
+      continue;
+    }
+    heap_trace_site_t *site = priv_heap_trace_site(record.alloced_by);
+    site->allocs++;
+    site->bytes += record.size;
+    if (record.freed_by[0] != NULL) {
+      site->freed++;
+    }
+    report->allocs++;
+    report->bytes += record.size;
+  }
+
+  if (heap_trace_summary(&summary) == ESP_OK) {
+    report->capacity   = summary.capacity;
+    report->overflowed = summary.has_overflowed;
+  }
+  report->records    = count;
+  report->site_count = s_site_count + (s_sites[heap_trace_max_sites].allocs > 0 ? 1 : 0);
+
+  /* Partial selection sort: only the top N are needed, in order */
+  uint32_t total = heap_trace_max_sites + 1;
+  for (uint8_t n = 0; n < CONFIG_TOPOROBO_HEAP_TRACE_TOP_N; n++) {
+    heap_trace_site_t *best = NULL;
+    for (uint32_t i = 0; i < total; i++) {
+      if (s_sites[i].allocs > 0 &&
+          (best == NULL || s_sites[i].allocs > best->allocs ||
+           (s_sites[i].allocs == best->allocs && s_sites[i].bytes > best->bytes))) {
+        best = &s_sites[i];
+      }
+    }
+    if (best == NULL) {
+      break;
+    }
+    report->top[report->top_count++] = *best;
+    best->allocs                     = 0; /* Taken */
+  }
+}
+
+/**
+ * @brief Prints `report` to the console, one line per site.
+ */
+static void priv_heap_trace_log(const heap_trace_report_t *report)
+{
+  ESP_LOGI(heap_trace_tag, "%" PRIu32 " allocations, %" PRIu32 " bytes in %" PRIu32 " ms from %"
+           PRIu32 " call sites%s", report->allocs, report->bytes, report->window_ms,
+           report->site_count, report->overflowed ? " (record buffer overflowed)" : "");
+
+  for (uint8_t i = 0; i < report->top_count; i++) {
+    const heap_trace_site_t *site = &report->top[i];
+    char                     callers[heap_trace_depth * 11 + 1] = "other";
+
+    if (site->callers[0] != NULL) {
+      size_t length = 0;
+      for (size_t d = 0; d < heap_trace_depth && site->callers[d] != NULL; d++) {
+        length += snprintf(callers + length, sizeof(callers) - length, " %p", site->callers[d]);
+      }
+    }
+    ESP_LOGI(heap_trace_tag, "#%-2u %6" PRIu32 " allocs %8" PRIu32 " bytes %6" PRIu32 " freed  %s",
+             i + 1, site->allocs, site->bytes, site->freed, callers);
+  }
+}
+
+/**
+ * @brief Runs requested windows: records, waits, then aggregates and reports.
+ */
+static void priv_heap_trace_task(void *param)
+{
+  static heap_trace_report_t report; /* Too large for the stack */
+  uint32_t                   window_ms;
+
+  while (1) {
+    if (xQueueReceive(s_window_queue, &window_ms, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+
+    if (heap_trace_start(HEAP_TRACE_ALL) != ESP_OK) {
+      ESP_LOGE(heap_trace_tag, "Failed to start heap tracing");
+      s_state = k_heap_trace_state_idle;
+      continue;
+    }
+    vTaskDelay(pdMS_TO_TICKS(window_ms));
+    heap_trace_stop();
+
+    memset(&report, 0, sizeof(report));
+    report.window_ms = window_ms;
+    priv_heap_trace_aggregate(&report);
+    priv_heap_trace_log(&report);
+
+    xSemaphoreTake(s_report_mutex, portMAX_DELAY);
+    s_report = report;
+    s_state  = k_heap_trace_state_done;
+    xSemaphoreGive(s_report_mutex);
+  }
+}
+
+#endif /* CONFIG_TOPOROBO_HEAP_TRACE */
+
+/* Public Functions ***********************************************************/
+
+esp_err_t heap_trace_manager_init(void)
+{
+#if CONFIG_TOPOROBO_HEAP_TRACE
+  if (heap_trace_init_standalone(s_records, CONFIG_TOPOROBO_HEAP_TRACE_RECORDS) != ESP_OK) {
+    ESP_LOGE(heap_trace_tag, "Failed to initialize heap tracing");
+    return ESP_FAIL;
+  }
+
+  s_window_queue = priv_rtos_queue_create(1, sizeof(uint32_t),
+                                          rtos_storage_ref(s_window_queue_storage));
+  s_report_mutex = priv_rtos_mutex_create(rtos_storage_ref(s_report_mutex_storage));
+  if (s_window_queue == NULL || s_report_mutex == NULL) {
+    ESP_LOGE(heap_trace_tag, "Failed to create heap trace queue or mutex");
+    return ESP_FAIL;
+  }
+
+  if (priv_rtos_task_create(priv_heap_trace_task, "HeapTrace", heap_trace_task_stack_bytes, NULL,
+                            heap_trace_task_priority, NULL, heap_trace_task_core_id,
+                            rtos_storage_ref(s_heap_trace_task_storage)) != ESP_OK) {
+    ESP_LOGE(heap_trace_tag, "Failed to create heap trace task");
+    return ESP_FAIL;
+  }
+
+  if (CONFIG_TOPOROBO_HEAP_TRACE_BOOT_WINDOW_S > 0) {
+    heap_trace_manager_start(CONFIG_TOPOROBO_HEAP_TRACE_BOOT_WINDOW_S * 1000);
+  }
+#endif
+  return ESP_OK;
+}
+
+esp_err_t heap_trace_manager_start(uint32_t window_ms)
+{
+#if CONFIG_TOPOROBO_HEAP_TRACE
+  if (window_ms == 0 || window_ms > heap_trace_max_window_ms) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (s_window_queue == NULL || s_state == k_heap_trace_state_running) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  s_state = k_heap_trace_state_running;
+  if (xQueueSend(s_window_queue, &window_ms, 0) != pdTRUE) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  ESP_LOGI(heap_trace_tag, "Tracing allocations for %" PRIu32 " ms", window_ms);
+  return ESP_OK;
+#else
+  (void)window_ms;
+  return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t heap_trace_manager_report_to_json(char **json_string)
+{
+  if (json_string == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *json_string = NULL;
+
+#if CONFIG_TOPOROBO_HEAP_TRACE
+  static const char *state_names[] = { "idle", "running", "done" };
+  static heap_trace_report_t report; /* Copy, too large for the httpd stack */
+
+  if (s_report_mutex == NULL) {
+    return ESP_ERR_INVALID_STATE; /* Not initialized, or init failed */
+  }
+#endif
+
+  cJSON *root = cJSON_CreateObject();
+  if (root == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+
+#if CONFIG_TOPOROBO_HEAP_TRACE
+  xSemaphoreTake(s_report_mutex, portMAX_DELAY);
+  heap_trace_state_t state = s_state;
+  report                   = s_report;
+  xSemaphoreGive(s_report_mutex);
+
+  cJSON_AddStringToObject(root, "state", state_names[state]);
+  if (report.window_ms > 0) {
+    cJSON_AddNumberToObject(root, "window_ms", report.window_ms);
+    cJSON_AddNumberToObject(root, "records", report.records);
+    cJSON_AddNumberToObject(root, "capacity", report.capacity);
+    cJSON_AddBoolToObject(root, "overflowed", report.overflowed);
+    cJSON_AddNumberToObject(root, "allocs", report.allocs);
+    cJSON_AddNumberToObject(root, "bytes", report.bytes);
+    cJSON_AddNumberToObject(root, "sites", report.site_count);
+
+    cJSON *top = cJSON_AddArrayToObject(root, "top");
+    for (uint8_t i = 0; i < report.top_count && top != NULL; i++) {
+      const heap_trace_site_t *site  = &report.top[i];
+      cJSON                   *entry = cJSON_CreateObject();
+      cJSON                   *stack = cJSON_AddArrayToObject(entry, "callers");
+      for (size_t d = 0; d < heap_trace_depth && site->callers[d] != NULL && stack != NULL; d++) {
+        char address[12];
+        snprintf(address, sizeof(address), "%p", site->callers[d]);
+        cJSON_AddItemToArray(stack, cJSON_CreateString(address));
+      }
+      cJSON_AddNumberToObject(entry, "allocs", site->allocs);
+      cJSON_AddNumberToObject(entry, "bytes", site->bytes);
+      cJSON_AddNumberToObject(entry, "freed", site->freed);
+      cJSON_AddItemToArray(top, entry);
+    }
+  }
+#else
+  cJSON_AddStringToObject(root, "state", "disabled");
+#endif
+
+  *json_string = cJSON_PrintUnformatted(root);
+  cJSON_Delete(root);
+  return (*json_string != NULL) ? ESP_OK : ESP_ERR_NO_MEM;
+}
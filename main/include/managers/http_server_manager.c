@@ -0,0 +1,433 @@
+/* main/include/managers/http_server_manager.c */
+
+#include "http_server_manager.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "system_monitor_manager.h"
+#include "telemetry_manager.h"
+#include "upload_manager.h"
+#include "heap_trace_manager.h"
+#include "webserver_tasks.h"
+#include "common/power.h"
+#include "common/event_bus.h"
+#include "common/trace.h"
+#include "common/metrics.h"
+#include "common/arena.h"
+#include "common/mem_policy.h"
+#include "cJSON.h"
+#include "sd_card_hal.h"
+
+/* Globals (Constants) ********************************************************/
+
+const char *http_server_tag = "HTTP_SERVER";
+
+/* Globals (Static) ***********************************************************/
+
+static httpd_handle_t            s_server = NULL;   /**< Handle of the running server */
+static system_monitor_snapshot_t s_system_snapshot; /**< Scratch copy, too large for the httpd stack */
+
+/* httpd task only: JSON trees and strings of one request. A larger response
+ * (the system snapshot) spills over to the heap */
+arena_define(s_http_arena, "httpd", 4096);
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Sends a string from one of the `*_to_json` functions and frees it.
+ */
+static esp_err_t priv_send_json(httpd_req_t *req, char *json_string)
+{
+  if (json_string == NULL) {
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Serialization failed");
+    return ESP_FAIL;
+  }
+
+  httpd_resp_set_type(req, "application/json");
+  esp_err_t ret = httpd_resp_sendstr(req, json_string);
+  cJSON_free(json_string);
+  return ret;
+}
+
+/**
+ * @brief Handler for `GET /api/system`, returns the system monitor snapshot.
+ */
+static esp_err_t priv_system_handler(httpd_req_t *req)
+{
+  if (system_monitor_get_snapshot(&s_system_snapshot) != ESP_OK) {
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Snapshot unavailable");
+    return ESP_FAIL;
+  }
+
+  arena_begin(&s_http_arena);
+  esp_err_t ret = priv_send_json(req, system_monitor_snapshot_to_json(&s_system_snapshot));
+  arena_end(&s_http_arena);
+  return ret;
+}
+
+/**
+ * @brief Handler for `GET /api/power`, returns PM lock and mode residency stats.
+ */
+static esp_err_t priv_power_handler(httpd_req_t *req)
+{
+  arena_begin(&s_http_arena);
+  esp_err_t ret = priv_send_json(req, power_stats_to_json());
+  arena_end(&s_http_arena);
+  return ret;
+}
+
+/**
+ * @brief Handler for `GET /api/pipeline`, returns event bus and ingress ring stats.
+ */
+static esp_err_t priv_pipeline_handler(httpd_req_t *req)
+{
+  arena_begin(&s_http_arena);
+  esp_err_t ret = priv_send_json(req, event_bus_stats_to_json());
+  arena_end(&s_http_arena);
+  return ret;
+}
+
+/**
+ * @brief Handler for `GET /api/telemetry`, returns router and reporting filter counters.
+ */
+static esp_err_t priv_telemetry_handler(httpd_req_t *req)
+{
+  arena_begin(&s_http_arena);
+  esp_err_t ret = priv_send_json(req, telemetry_manager_stats_to_json());
+  arena_end(&s_http_arena);
+  return ret;
+}
+
+/**
+ * @brief Handler for `GET /api/upload`, returns the upload counters.
+ */
+static esp_err_t priv_upload_stats_handler(httpd_req_t *req)
+{
+  arena_begin(&s_http_arena);
+  esp_err_t ret = priv_send_json(req, upload_manager_stats_to_json());
+  arena_end(&s_http_arena);
+  return ret;
+}
+
+/**
+ * @brief Handler for `GET /api/http_sink`, returns the web server sink delivery counters.
+ */
+static esp_err_t priv_http_sink_handler(httpd_req_t *req)
+{
+  arena_begin(&s_http_arena);
+  esp_err_t ret = priv_send_json(req, webserver_tasks_stats_to_json());
+  arena_end(&s_http_arena);
+  return ret;
+}
+
+/**
+ * @brief Handler for `POST /api/upload?file=<name>`, queues a file of the card for upload.
+ *
+ * Only plain names are accepted, so requests cannot reach outside the mount point.
+ */
+static esp_err_t priv_upload_handler(httpd_req_t *req)
+{
+  char query[64];
+  char name[48];
+  char path[80];
+
+  if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+      httpd_query_key_value(query, "file", name, sizeof(name)) != ESP_OK ||
+      name[0] == '\0' || strchr(name, '/') != NULL || strstr(name, "..") != NULL) {
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Expected ?file=<name>");
+    return ESP_FAIL;
+  }
+
+  snprintf(path, sizeof(path), "%s/%s", sd_card_mount, name);
+  esp_err_t ret = upload_manager_enqueue(path);
+  if (ret == ESP_ERR_NOT_SUPPORTED) {
+    httpd_resp_send_err(req, HTTPD_501_METHOD_NOT_IMPLEMENTED, "Uploads disabled");
+    return ESP_FAIL;
+  }
+  if (ret != ESP_OK) {
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Upload not queued");
+    return ESP_FAIL;
+  }
+
+  httpd_resp_set_status(req, "202 Accepted");
+  return httpd_resp_sendstr(req, "queued");
+}
+
+/**
+ * @brief Handler for `GET /api/heap_trace`, returns the last allocation hot spot report.
+ */
+static esp_err_t priv_heap_trace_report_handler(httpd_req_t *req)
+{
+  char *json_string = NULL;
+
+  arena_begin(&s_http_arena);
+  esp_err_t ret = heap_trace_manager_report_to_json(&json_string);
+  if (ret == ESP_ERR_INVALID_STATE) {
+    arena_end(&s_http_arena);
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Heap tracing not initialized");
+    return ESP_FAIL;
+  }
+  ret = priv_send_json(req, json_string);
+  arena_end(&s_http_arena);
+  return ret;
+}
+
+/**
+ * @brief Handler for `POST /api/heap_trace?window_ms=<ms>`, starts an allocation trace window.
+ */
+static esp_err_t priv_heap_trace_start_handler(httpd_req_t *req)
+{
+  char     query[32];
+  char     value[12];
+  uint32_t window_ms = 10000;
+
+  if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+      httpd_query_key_value(query, "window_ms", value, sizeof(value)) == ESP_OK) {
+    window_ms = strtoul(value, NULL, 10);
+  }
+
+  esp_err_t ret = heap_trace_manager_start(window_ms);
+  if (ret == ESP_ERR_NOT_SUPPORTED) {
+    httpd_resp_send_err(req, HTTPD_501_METHOD_NOT_IMPLEMENTED, "Heap tracing disabled");
+    return ESP_FAIL;
+  }
+  if (ret == ESP_ERR_INVALID_ARG) {
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "window_ms out of range");
+    return ESP_FAIL;
+  }
+  if (ret != ESP_OK) {
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "A window is already running");
+    return ESP_FAIL;
+  }
+
+  httpd_resp_set_status(req, "202 Accepted");
+  return httpd_resp_sendstr(req, "tracing");
+}
+
+/**
+ * @brief Trace and metrics writer sending each piece as one chunk of the response.
+ */
+static esp_err_t priv_http_send_chunk(void *context, const char *data, size_t length)
+{
+  return httpd_resp_send_chunk((httpd_req_t *)context, data, length);
+}
+
+/**
+ * @brief Trace writer appending to a file.
+ */
+static esp_err_t priv_trace_write_file(void *context, const char *data, size_t length)
+{
+  return (fwrite(data, 1, length, (FILE *)context) == length) ? ESP_OK : ESP_FAIL;
+}
+
+/**
+ * @brief Handler for `GET /api/trace`, streams the event trace as Chrome trace JSON.
+ */
+static esp_err_t priv_trace_handler(httpd_req_t *req)
+{
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"trace.json\"");
+
+  /* These fail before anything is sent, the others once the response is under way */
+  esp_err_t ret = trace_export(priv_http_send_chunk, req);
+  if (ret == ESP_ERR_NOT_SUPPORTED) {
+    httpd_resp_send_err(req, HTTPD_501_METHOD_NOT_IMPLEMENTED, "Tracing disabled");
+    return ESP_FAIL;
+  }
+  if (ret == ESP_ERR_INVALID_STATE || ret == ESP_ERR_NO_MEM) {
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Trace export unavailable");
+    return ESP_FAIL;
+  }
+  if (ret != ESP_OK) {
+    ESP_LOGW(http_server_tag, "Trace export failed: %s", esp_err_to_name(ret));
+    return ESP_FAIL; /* The connection is closed */
+  }
+  return httpd_resp_sendstr_chunk(req, NULL);
+}
+
+/**
+ * @brief Handler for `POST /api/trace`.
+ *
+ * With `?save=1` writes the event trace to `/sdcard/trace-<time>.json` and
+ * returns the file name (for `POST /api/upload?file=`). Otherwise empties
+ * the trace and records the comma-separated `categories` from now on (all
+ * of them if none are given, "none" to stop).
+ */
+static esp_err_t priv_trace_control_handler(httpd_req_t *req)
+{
+  char query[80] = "";
+  char value[64];
+  char name[32];
+  char path[64];
+
+  httpd_req_get_url_query_str(req, query, sizeof(query));
+
+  if (httpd_query_key_value(query, "save", value, sizeof(value)) == ESP_OK) {
+    snprintf(name, sizeof(name), "trace-%lld.json", (long long)time(NULL));
+    snprintf(path, sizeof(path), "%s/%s", sd_card_mount, name);
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+      httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Cannot create the file");
+      return ESP_FAIL;
+    }
+    esp_err_t ret = trace_export(priv_trace_write_file, file);
+    fclose(file);
+    if (ret == ESP_ERR_NOT_SUPPORTED) {
+      remove(path);
+      httpd_resp_send_err(req, HTTPD_501_METHOD_NOT_IMPLEMENTED, "Tracing disabled");
+      return ESP_FAIL;
+    }
+    if (ret != ESP_OK) {
+      remove(path);
+      httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Trace export failed");
+      return ESP_FAIL;
+    }
+    return httpd_resp_sendstr(req, name);
+  }
+
+  uint32_t mask = trace_all_categories;
+  if (httpd_query_key_value(query, "categories", value, sizeof(value)) == ESP_OK) {
+    mask = 0;
+    for (char *token = strtok(value, ","); token != NULL; token = strtok(NULL, ",")) {
+      uint8_t i = 0;
+      while (i < k_trace_category_count && strcmp(token, trace_category_name(i)) != 0) {
+        i++;
+      }
+      if (i == k_trace_category_count && strcmp(token, "none") != 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown category");
+        return ESP_FAIL;
+      }
+      mask |= (i < k_trace_category_count) ? trace_category_bit(i) : 0;
+    }
+  }
+
+  trace_set_categories(mask);
+  if (trace_get_categories() != mask) {
+    httpd_resp_send_err(req, HTTPD_501_METHOD_NOT_IMPLEMENTED, "Tracing disabled");
+    return ESP_FAIL;
+  }
+  return httpd_resp_sendstr(req, (mask != 0) ? "recording" : "stopped");
+}
+
+/**
+ * @brief Handler for `GET /metrics`, streams the metrics registry in the
+ *        Prometheus text format.
+ */
+static esp_err_t priv_metrics_handler(httpd_req_t *req)
+{
+  httpd_resp_set_type(req, "text/plain; version=0.0.4; charset=utf-8");
+
+  esp_err_t ret = metrics_export(0, priv_http_send_chunk, req);
+  if (ret != ESP_OK) {
+    ESP_LOGW(http_server_tag, "Metrics export failed: %s", esp_err_to_name(ret));
+    return ESP_FAIL; /* The connection is closed */
+  }
+  return httpd_resp_sendstr_chunk(req, NULL);
+}
+
+/**
+ * @brief Handler for `GET /api/arenas`, returns the size and high-water mark of every arena.
+ */
+static esp_err_t priv_arenas_handler(httpd_req_t *req)
+{
+  arena_begin(&s_http_arena);
+  esp_err_t ret = priv_send_json(req, arena_stats_to_json());
+  arena_end(&s_http_arena);
+  return ret;
+}
+
+/**
+ * @brief Handler for `GET /api/memory`, returns the placement counters and heap state per class.
+ */
+static esp_err_t priv_memory_handler(httpd_req_t *req)
+{
+  arena_begin(&s_http_arena);
+  esp_err_t ret = priv_send_json(req, mem_policy_stats_to_json());
+  arena_end(&s_http_arena);
+  return ret;
+}
+
+/**
+ * @brief Handler for `GET /api/live`, returns the latest sample of every sensor.
+ *
+ * The response is `{"<sensor>":<sample>,...}`, streamed in chunks straight
+ * from the router's shared JSON buffers so nothing is re-serialized here.
+ */
+static esp_err_t priv_live_handler(httpd_req_t *req)
+{
+  bool first = true;
+
+  httpd_resp_set_type(req, "application/json");
+  esp_err_t ret = httpd_resp_sendstr_chunk(req, "{");
+
+  for (uint8_t i = 0; i < k_event_bus_topic_count && ret == ESP_OK; i++) {
+    telemetry_buffer_t *buffer = telemetry_manager_live_acquire((event_bus_topic_t)i);
+    if (buffer == NULL) {
+      continue;
+    }
+
+    char key[32];
+    snprintf(key, sizeof(key), "%s\"%s\":", first ? "" : ",",
+             event_bus_topic_name((event_bus_topic_t)i));
+    ret = httpd_resp_sendstr_chunk(req, key);
+    if (ret == ESP_OK) {
+      ret = httpd_resp_send_chunk(req, (const char *)buffer->data, buffer->length);
+    }
+    telemetry_buffer_release(buffer);
+    first = false;
+  }
+
+  if (ret == ESP_OK) {
+    ret = httpd_resp_sendstr_chunk(req, "}");
+  }
+  if (ret == ESP_OK) {
+    ret = httpd_resp_sendstr_chunk(req, NULL);
+  }
+  return ret;
+}
+
+/* Public Functions ***********************************************************/
+
+esp_err_t http_server_manager_init(void)
+{
+  httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+  config.core_id          = 0;  /* Keep network I/O off the acquisition core */
+  config.max_uri_handlers = 16; /* Default of 8 is too few for the routes below */
+
+  if (httpd_start(&s_server, &config) != ESP_OK) {
+    ESP_LOGE(http_server_tag, "Failed to start HTTP server");
+    return ESP_FAIL;
+  }
+
+  const httpd_uri_t uris[] = {
+    { .uri = "/api/system",     .method = HTTP_GET,  .handler = priv_system_handler,            .user_ctx = NULL },
+    { .uri = "/api/power",      .method = HTTP_GET,  .handler = priv_power_handler,             .user_ctx = NULL },
+    { .uri = "/api/live",       .method = HTTP_GET,  .handler = priv_live_handler,              .user_ctx = NULL },
+    { .uri = "/api/pipeline",   .method = HTTP_GET,  .handler = priv_pipeline_handler,          .user_ctx = NULL },
+    { .uri = "/api/telemetry",  .method = HTTP_GET,  .handler = priv_telemetry_handler,         .user_ctx = NULL },
+    { .uri = "/api/http_sink",  .method = HTTP_GET,  .handler = priv_http_sink_handler,         .user_ctx = NULL },
+    { .uri = "/api/upload",     .method = HTTP_GET,  .handler = priv_upload_stats_handler,      .user_ctx = NULL },
+    { .uri = "/api/upload",     .method = HTTP_POST, .handler = priv_upload_handler,            .user_ctx = NULL },
+    { .uri = "/api/heap_trace", .method = HTTP_GET,  .handler = priv_heap_trace_report_handler, .user_ctx = NULL },
+    { .uri = "/api/heap_trace", .method = HTTP_POST, .handler = priv_heap_trace_start_handler,  .user_ctx = NULL },
+    { .uri = "/api/trace",      .method = HTTP_GET,  .handler = priv_trace_handler,             .user_ctx = NULL },
+    { .uri = "/api/trace",      .method = HTTP_POST, .handler = priv_trace_control_handler,     .user_ctx = NULL },
+    { .uri = "/metrics",        .method = HTTP_GET,  .handler = priv_metrics_handler,           .user_ctx = NULL },
+    { .uri = "/api/arenas",     .method = HTTP_GET,  .handler = priv_arenas_handler,            .user_ctx = NULL },
+    { .uri = "/api/memory",     .method = HTTP_GET,  .handler = priv_memory_handler,            .user_ctx = NULL },
+  };
+  for (size_t i = 0; i < sizeof(uris) / sizeof(uris[0]); i++) {
+    if (httpd_register_uri_handler(s_server, &uris[i]) != ESP_OK) {
+      ESP_LOGE(http_server_tag, "Failed to register %s", uris[i].uri);
+      httpd_stop(s_server);
+      s_server = NULL;
+      return ESP_FAIL;
+    }
+  }
+
+  ESP_LOGI(http_server_tag, "HTTP server started on port %d", config.server_port);
+  return ESP_OK;
+}
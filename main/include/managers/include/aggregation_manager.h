@@ -0,0 +1,106 @@
+/* main/include/managers/include/aggregation_manager.h */
+
+/* Windowed statistics of selected sensor channels.
+ *
+ * The aggregation task subscribes to the raw sensor topics on the event bus
+ * and keeps a Welford accumulator (`common/stream_stats.h`) per channel. At
+ * the end of every window it publishes one `aggregation_summary_t` per sensor
+ * on `k_event_bus_topic_summary`, which the telemetry router sends through the
+ * normal sinks like any other sample.
+ *
+ * Windows are `CONFIG_TOPOROBO_AGGREGATION_WINDOW_MS` long. With one pane they
+ * tumble; with N panes the window slides, a summary of the last full window
+ * being published every window / N.
+ *
+ *******************************************************************************
+ *
+ *    time  |---pane 0---|---pane 1---|---pane 2---|---pane 0---|
+ *                                                 ^ summary of panes 0..2
+ *                                                              ^ summary of panes 1, 2, 0
+ *
+ *******************************************************************************/
+
+#ifndef TOPOROBO_AGGREGATION_MANAGER_H
+#define TOPOROBO_AGGREGATION_MANAGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "common/event_bus.h"
+
+/* Constants ******************************************************************/
+
+/**
+ * @brief Logging tag for the aggregation task.
+ */
+extern const char *aggregation_tag;
+
+/* Macros *********************************************************************/
+
+/**
+ * @brief Most channels summarized per sensor.
+ */
+#define aggregation_max_channels (4)
+
+/* Structs ********************************************************************/
+
+/**
+ * @struct aggregation_channel_summary_t
+ * @brief Statistics of one channel over one window.
+ */
+typedef struct {
+  uint32_t count;  /**< Samples in the window, 0 if the channel had none */
+  float    min;    /**< Smallest value */
+  float    max;    /**< Largest value */
+  float    mean;   /**< Mean */
+  float    stddev; /**< Sample standard deviation */
+} aggregation_channel_summary_t;
+
+/**
+ * @struct aggregation_summary_t
+ * @brief Statistics of one sensor over one window, published on
+ *        `k_event_bus_topic_summary`.
+ */
+typedef struct {
+  int64_t                       window_end_us; /**< esp_timer time the window closed */
+  uint32_t                      window_ms;     /**< Window length */
+  uint8_t                       topic;         /**< `event_bus_topic_t` of the summarized sensor */
+  uint8_t                       channel_count; /**< Valid entries in `channels` */
+  aggregation_channel_summary_t channels[aggregation_max_channels]; /**< Per channel, in table order */
+} aggregation_summary_t;
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Subscribes to the aggregated topics and starts the aggregation task
+ *        on core 0.
+ *
+ * @return
+ * - ESP_OK on success, or when aggregation is disabled.
+ * - ESP_ERR_INVALID_ARG if the channel table is invalid.
+ * - ESP_FAIL if the queue, subscription or task could not be created.
+ *
+ * @note Call after `event_bus_init`.
+ */
+esp_err_t aggregation_manager_init(void);
+
+/**
+ * @brief Tells whether raw samples of `topic` should only be kept locally.
+ *
+ * @param[in] topic Sensor topic.
+ * @return true if `topic` is aggregated and
+ *         `CONFIG_TOPOROBO_AGGREGATION_RAW_LOCAL_ONLY` is set, in which case
+ *         only its summaries leave the robot.
+ */
+bool aggregation_manager_raw_local_only(event_bus_topic_t topic);
+
+/**
+ * @brief Converts a summary to JSON, naming each channel.
+ *
+ * @param[in] summary Summary to convert.
+ * @return A dynamically allocated JSON string, or NULL on failure. The caller
+ *         frees it.
+ */
+char *aggregation_summary_to_json(const aggregation_summary_t *summary);
+
+#endif /* TOPOROBO_AGGREGATION_MANAGER_H */
@@ -0,0 +1,199 @@
+/* main/include/managers/include/columnar_manager.h */
+
+/* Columnar export of sensor samples for offline analysis.
+ *
+ * The telemetry router hands every sample routed to `k_telemetry_sink_columnar`
+ * to this writer, which collects the samples of each topic into a block with
+ * one fixed-width column per schema field (plus a timestamp column) and
+ * appends full blocks to `/sdcard/<topic>.col`. Analysis tools read only the
+ * columns they need, and skip whole blocks by time using the block header
+ * (`tools/columnar_read.py`).
+ *
+ *******************************************************************************
+ *
+ *    <topic>.col: [ block ][ block ] ...
+ *
+ *    block: columnar_block_header_t
+ *           columnar_column_header_t x column_count   (timestamp column first)
+ *           column 0: int64_t timestamp_us x count
+ *           column 1: field 0 x count, `width` bytes each
+ *           ...
+ *
+ *******************************************************************************
+ *
+ * Timestamps are Unix time in microseconds, or microseconds since boot in
+ * blocks written before the clock was set (values before 2023); a block never
+ * mixes the two. The age limit of a block is measured since boot either way.
+ *
+ * All values are little-endian. Strings are NUL-padded to the column width.
+ * Column offsets are from the start of the block, and `block_size` is the
+ * distance to the next block.
+ *
+ * With `CONFIG_TOPOROBO_COLUMNAR_GORILLA` the block `encoding` is
+ * `k_columnar_encoding_gorilla`: each numeric column is then one gorilla
+ * stream (common/gorilla.h) running up to the next column's offset, floats as
+ * a float stream and the timestamps and integers as an integer stream.
+ * Strings stay fixed-width.
+ *
+ * With `CONFIG_TOPOROBO_RETENTION` the files are segmented by wall-clock
+ * period, `/sdcard/<topic>-<time / CONFIG_TOPOROBO_RETENTION_SEGMENT_S>.col`,
+ * and old segments are replaced by rollups (retention_manager.h). A rollup
+ * block has the same layout: the timestamp column holds the start of each
+ * interval, a `columnar_count_field` column its sample count, and each numeric
+ * field has a min, mean and max column (`columnar_stat_field`).
+ */
+
+#ifndef TOPOROBO_COLUMNAR_MANAGER_H
+#define TOPOROBO_COLUMNAR_MANAGER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "telemetry_manager.h"
+
+/* Constants ******************************************************************/
+
+/**
+ * @brief Logging tag for the columnar writer.
+ */
+extern const char *columnar_tag;
+
+/* Macros *********************************************************************/
+
+/**
+ * @brief First bytes of every block, "TCOL".
+ */
+#define columnar_block_magic (0x4C4F4354)
+
+/**
+ * @brief Block layout version.
+ */
+#define columnar_block_version (1)
+
+/**
+ * @brief `field` of the rollup sample count column (u32).
+ */
+#define columnar_count_field (0xFFFE)
+
+/**
+ * @brief `field` of the timestamp column.
+ */
+#define columnar_timestamp_field (0xFFFF)
+
+/**
+ * @brief `field` of a rollup column holding statistic `stat` of schema field
+ *        `index`.
+ */
+#define columnar_stat_field(index, stat) ((uint16_t)((index) | ((stat) << 12)))
+
+/* Enums **********************************************************************/
+
+/**
+ * @enum columnar_encoding_t
+ * @brief How the columns of a block are stored.
+ */
+typedef enum : uint8_t {
+  k_columnar_encoding_raw     = 0, /**< Fixed-width values */
+  k_columnar_encoding_gorilla = 1, /**< Gorilla streams, see common/gorilla.h */
+} columnar_encoding_t;
+
+/**
+ * @enum columnar_stat_t
+ * @brief What a column holds per row, bits 12..13 of its `field`.
+ */
+typedef enum : uint8_t {
+  k_columnar_stat_value = 0, /**< The sample itself */
+  k_columnar_stat_min   = 1, /**< Smallest sample of a rollup interval */
+  k_columnar_stat_mean  = 2, /**< Mean of a rollup interval */
+  k_columnar_stat_max   = 3, /**< Largest sample of a rollup interval */
+} columnar_stat_t;
+
+/* Structs ********************************************************************/
+
+/**
+ * @struct columnar_block_header_t
+ * @brief Start of every block.
+ */
+typedef struct __attribute__((packed)) {
+  uint32_t magic;        /**< `columnar_block_magic` */
+  uint8_t  version;      /**< `columnar_block_version` */
+  uint8_t  topic;        /**< `event_bus_topic_t` of the samples */
+  uint8_t  column_count; /**< Columns, including the timestamp column */
+  uint8_t  encoding;     /**< `columnar_encoding_t` of the columns */
+  uint32_t count;        /**< Rows in every column */
+  uint32_t block_size;   /**< Bytes from the start of this block to the next */
+  int64_t  t_min_us;     /**< Earliest timestamp in the block */
+  int64_t  t_max_us;     /**< Latest timestamp in the block */
+} columnar_block_header_t;
+
+/**
+ * @struct columnar_column_header_t
+ * @brief Description of one column of a block.
+ */
+typedef struct __attribute__((packed)) {
+  uint8_t  kind;   /**< `sensor_schema_kind_t`, `k_sensor_schema_i64` for the timestamps */
+  uint8_t  width;  /**< Bytes per value */
+  uint16_t field;  /**< Schema field index, see `columnar_stat_field` and the other field macros */
+  uint32_t offset; /**< Start of the column from the start of the block */
+  float    min;    /**< Smallest value, 0 for strings and timestamps */
+  float    max;    /**< Largest value, 0 for strings and timestamps */
+} columnar_column_header_t;
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Adds one binary-encoded sample to its topic's block, writing the
+ *        block out once it is full or its oldest row is older than
+ *        `CONFIG_TOPOROBO_COLUMNAR_BLOCK_MAX_AGE_MS`.
+ *
+ * The block of a topic is allocated with its first sample. Called by the
+ * telemetry router only.
+ *
+ * @param[in] buffer `k_telemetry_format_binary` buffer of a topic with a schema.
+ *
+ * @return
+ * - ESP_OK on success.
+ * - ESP_ERR_INVALID_ARG if the buffer is not a decodable binary record.
+ * - ESP_ERR_NO_MEM if the topic's block could not be allocated.
+ * - ESP_FAIL if a full block could not be queued for writing.
+ */
+esp_err_t columnar_manager_append(const telemetry_buffer_t *buffer);
+
+/**
+ * @brief Writes out every block whose oldest row is older than
+ *        `CONFIG_TOPOROBO_COLUMNAR_BLOCK_MAX_AGE_MS` at `now_us`.
+ *
+ * `columnar_manager_append` only checks the age of a block when a row
+ * arrives, so a topic that goes quiet would keep its rows in RAM; the
+ * telemetry router calls this periodically to cover that case. Does nothing
+ * without `CONFIG_TOPOROBO_COLUMNAR_EXPORT`.
+ *
+ * @param[in] now_us Current time, from `esp_timer_get_time` like the sample
+ *                   timestamps.
+ */
+void columnar_manager_flush_stale(int64_t now_us);
+
+/**
+ * @brief Size of a block of `schema` at `CONFIG_TOPOROBO_COLUMNAR_BLOCK_ROWS`
+ *        rows, uncompressed: the largest block written for the topic.
+ *
+ * Only available with `CONFIG_TOPOROBO_COLUMNAR_EXPORT`.
+ */
+size_t columnar_manager_block_bytes(const sensor_schema_t *schema);
+
+/**
+ * @brief Finishes a block built with its columns at capacity offsets: moves
+ *        the columns together, compresses them with
+ *        `CONFIG_TOPOROBO_COLUMNAR_GORILLA` and completes the header.
+ *
+ * The caller fills in `magic`, `version`, `topic`, `column_count`, `count`
+ * and the time range of the header first. Only available with
+ * `CONFIG_TOPOROBO_COLUMNAR_EXPORT`.
+ *
+ * @param[in] block Heap block, freed if the finished block is a new buffer.
+ * @param[out] size Size of the finished block.
+ *
+ * @return The finished heap block, to be freed by the caller.
+ */
+uint8_t *columnar_manager_finish_block(uint8_t *block, size_t *size);
+
+#endif /* TOPOROBO_COLUMNAR_MANAGER_H */
@@ -3,6 +3,9 @@
 #ifndef TOPOROBO_FILE_WRITE_MANAGER_H
 #define TOPOROBO_FILE_WRITE_MANAGER_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include "esp_err.h"
 
 /* Constants ******************************************************************/
@@ -57,6 +60,11 @@ extern const uint32_t max_pending_writes;
  *   by the `max_file_path_length` constant to ensure proper memory allocation and avoid overflow.
  * - `data`: The content to be written to the file. The length is defined by the
  *   `max_data_length` constant to ensure proper memory allocation and avoid overflow.
+ * - `length`: Number of bytes of `data` to write; binary data may contain NULs.
+ * - `block`: Heap buffer written instead of `data` when not NULL, freed by the
+ *   file write task (see `file_write_enqueue_block`).
+ * - `segment`: The file is a log segment, preallocated contiguously when created
+ *   (see `file_write_enqueue_segment`).
  *
  * **Usage Notes:**
  * - Ensure that `file_path` is null-terminated and points to a valid path.
@@ -65,6 +73,9 @@ extern const uint32_t max_pending_writes;
 typedef struct {
   char file_path[max_file_path_length]; /**< Path to the target file. */
   char data[max_data_length];           /**< Data to be written to the file. */
+  size_t length;                        /**< Bytes of `data` (or `block`) to write. */
+  uint8_t *block;                       /**< Owned heap buffer to write instead of `data`, or NULL. */
+  bool segment;                         /**< Preallocate the file when it is created. */
 } file_write_request_t;
 
 /* Public Functions ***********************************************************/
@@ -76,7 +87,22 @@ typedef struct {
  * file write requests and starts a background task to handle the queued
  * requests. Files are always opened in append mode, creating them
  * if they do not exist. Each line of data written will include a
- * timestamp at the start.
+ * timestamp at the start. Up to four files are kept open between
+ * writes and closed after 5 s without one; the append latency of each
+ * (mean, max and a histogram) is logged when it is closed, or for a log
+ * segment once it is trimmed.
+ *
+ * Append latency, write plus fsync, is also exported as the
+ * `toporobo_sd_append_duration_seconds` histogram, split by
+ * `layout="contiguous"` (preallocated segments) and `layout="chained"`
+ * (files grown cluster by cluster), so the effect of the preallocation and
+ * of the allocation unit profile can be compared on a given card from
+ * `GET /metrics`. No reference numbers are recorded here yet; they depend
+ * on the card and should be taken on the target hardware.
+ *
+ * The card is mounted by `sd_card_init` beforehand. If it is not, writes are
+ * refused and mounting is retried every 30 s from the write task, so a card
+ * inserted later is picked up.
  *
  * @return
  * - ESP_OK if the initialization is successful.
@@ -91,7 +117,8 @@ esp_err_t file_write_manager_init(void);
  * be written to the specified file in the background by the file write task.
  * If the file does not exist, it will be created automatically. All writes
  * append data to the file. Each line written includes a timestamp at the
- * beginning in the format `YYYY-MM-DD HH:MM:SS`.
+ * beginning in the format `YYYY-MM-DD HH:MM:SS`. A line that does not fit
+ * in `max_data_length` is copied to the heap and written whole.
  *
  * @param[in] file_path Path to the file (e.g., "/sdcard/sensor1.txt").
  * @param[in] data Null-terminated string to write to the file.
@@ -99,9 +126,84 @@ esp_err_t file_write_manager_init(void);
  * @return
  * - ESP_OK if the request was successfully enqueued.
  * - ESP_ERR_INVALID_ARG if arguments are invalid.
+ * - ESP_ERR_NO_MEM if a long line could not be copied.
+ * - ESP_ERR_INVALID_STATE if no SD card is mounted (counted, not logged).
  * - ESP_FAIL if the queue is full.
  */
 esp_err_t file_write_enqueue(const char *file_path, const char *data);
 
+/**
+ * @brief Enqueues a binary file write request.
+ *
+ * Like `file_write_enqueue`, but appends `length` bytes exactly as given,
+ * without a timestamp or newline, so fixed-size records stay aligned.
+ *
+ * @param[in] file_path Path to the file (e.g., "/sdcard/sensor1.bin").
+ * @param[in] data Bytes to append.
+ * @param[in] length Number of bytes, at most `max_data_length`.
+ *
+ * @return
+ * - ESP_OK if the request was successfully enqueued.
+ * - ESP_ERR_INVALID_ARG if arguments are invalid.
+ * - ESP_ERR_INVALID_STATE if no SD card is mounted (counted, not logged).
+ * - ESP_ERR_INVALID_SIZE if `length` exceeds `max_data_length`.
+ * - ESP_FAIL if the queue is full.
+ */
+esp_err_t file_write_enqueue_bytes(const char *file_path, const void *data, size_t length);
+
+/**
+ * @brief Enqueues a write of a heap buffer of any size, taking ownership of it.
+ *
+ * Like `file_write_enqueue_bytes` without the `max_data_length` limit; the
+ * buffer is not copied and is freed once written, or here if the request
+ * cannot be queued.
+ *
+ * @param[in] file_path Path to the file (e.g., "/sdcard/sensor1.col").
+ * @param[in] block Buffer from `malloc`, owned by the file write manager after the call.
+ * @param[in] length Number of bytes to append.
+ *
+ * @return
+ * - ESP_OK if the request was successfully enqueued.
+ * - ESP_ERR_INVALID_ARG if arguments are invalid.
+ * - ESP_ERR_INVALID_STATE if no SD card is mounted (counted, not logged).
+ * - ESP_FAIL if the queue is full.
+ */
+esp_err_t file_write_enqueue_block(const char *file_path, uint8_t *block, size_t length);
+
+/**
+ * @brief Enqueues a write of a heap buffer to a log segment, taking ownership of it.
+ *
+ * Like `file_write_enqueue_block`, except that a segment file created by the
+ * write is preallocated with `CONFIG_TOPOROBO_SD_SEGMENT_PREALLOC_KB` of
+ * contiguous clusters, so appends never have to allocate and link clusters.
+ * The data is followed by a zeroed 32-byte terminator until the segment is
+ * trimmed to its data. Closing an idle or evicted segment keeps its extent,
+ * and the next write reopens it at the end of its data; it is trimmed once
+ * unused for `CONFIG_TOPOROBO_RETENTION_SEGMENT_S`, when it has rolled over.
+ * A segment that was not trimmed before a reset (at its full preallocated
+ * size) is continued in `<name>~1<ext>`, `<name>~2<ext>`, ...
+ *
+ * @param[in] file_path Path to the segment (e.g., "/sdcard/dht22-493128.col").
+ * @param[in] block Buffer from `malloc`, owned by the file write manager after the call.
+ * @param[in] length Number of bytes to append.
+ *
+ * @return
+ * - ESP_OK if the request was successfully enqueued.
+ * - ESP_ERR_INVALID_ARG if arguments are invalid.
+ * - ESP_ERR_INVALID_STATE if no SD card is mounted (counted, not logged).
+ * - ESP_FAIL if the queue is full.
+ */
+esp_err_t file_write_enqueue_segment(const char *file_path, uint8_t *block, size_t length);
+
+/**
+ * @brief Returns the number of write requests queued or being written.
+ *
+ * Background jobs that access the SD card directly use this to stay out of
+ * the way of live writes.
+ *
+ * @return Requests not yet written.
+ */
+uint32_t file_write_pending(void);
+
 #endif /* TOPOROBO_FILE_WRITE_MANAGER_H */
 
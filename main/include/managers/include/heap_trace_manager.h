@@ -0,0 +1,75 @@
+/* main/include/managers/include/heap_trace_manager.h */
+
+/* Allocation hot spots over a sampling window.
+ *
+ * With `CONFIG_TOPOROBO_HEAP_TRACE` (which needs ESP-IDF's standalone heap
+ * tracing, `CONFIG_HEAP_TRACING_STANDALONE`) a window can be traced on
+ * request: every malloc and free during the window is recorded with its
+ * call stack by `heap_trace`, then the records are grouped by call stack
+ * and the `CONFIG_TOPOROBO_HEAP_TRACE_TOP_N` sites with the most
+ * allocations are reported:
+ * - on the serial console, one line per site;
+ * - at `GET /api/heap_trace`, as JSON.
+ *
+ * Call sites are return addresses, `CONFIG_HEAP_TRACING_STACK_DEPTH` deep
+ * (use 4 or more, so sites are not all inside cJSON or esp_http_client).
+ * `idf.py monitor` decodes them on the console; for the JSON report use
+ * `xtensa-esp32-elf-addr2line -pfiaC -e build/<project>.elf <address>...`.
+ * Allocations freed within the window are counted as churn, the others may
+ * be long-lived or leaked.
+ */
+
+#ifndef TOPOROBO_HEAP_TRACE_MANAGER_H
+#define TOPOROBO_HEAP_TRACE_MANAGER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/* Constants ******************************************************************/
+
+/**
+ * @brief Logging tag for the allocation trace reports.
+ */
+extern const char *heap_trace_tag;
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Starts the trace task, and a first window if
+ *        `CONFIG_TOPOROBO_HEAP_TRACE_BOOT_WINDOW_S` is set.
+ *
+ * @return
+ * - ESP_OK on success, or when tracing is disabled.
+ * - ESP_FAIL if heap tracing or the task could not be set up.
+ */
+esp_err_t heap_trace_manager_init(void);
+
+/**
+ * @brief Traces allocations for `window_ms`, then publishes a new report.
+ *
+ * Returns at once; the window runs in the trace task.
+ *
+ * @param[in] window_ms Window length, 1 ms to 10 min.
+ *
+ * @return
+ * - ESP_OK if the window was started.
+ * - ESP_ERR_INVALID_ARG if `window_ms` is out of range.
+ * - ESP_ERR_INVALID_STATE if a window is already running.
+ * - ESP_ERR_NOT_SUPPORTED if tracing is disabled.
+ */
+esp_err_t heap_trace_manager_start(uint32_t window_ms);
+
+/**
+ * @brief Serializes the state and the last report to a JSON string.
+ *
+ * @param[out] json_string Heap string the caller must free, NULL on failure.
+ *
+ * @return
+ * - ESP_OK on success, also when tracing is disabled (state "disabled").
+ * - ESP_ERR_INVALID_ARG if `json_string` is NULL.
+ * - ESP_ERR_INVALID_STATE if `heap_trace_manager_init` did not succeed.
+ * - ESP_ERR_NO_MEM if serialization failed.
+ */
+esp_err_t heap_trace_manager_report_to_json(char **json_string);
+
+#endif /* TOPOROBO_HEAP_TRACE_MANAGER_H */
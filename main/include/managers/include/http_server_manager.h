@@ -0,0 +1,50 @@
+/* main/include/managers/include/http_server_manager.h */
+
+#ifndef TOPOROBO_HTTP_SERVER_MANAGER_H
+#define TOPOROBO_HTTP_SERVER_MANAGER_H
+
+#include "esp_err.h"
+
+/* Constants ******************************************************************/
+
+/**
+ * @brief Logging tag for the on-robot HTTP server.
+ *
+ * Used in ESP_LOG messages emitted while starting the server and while
+ * serving its diagnostic endpoints.
+ */
+extern const char *http_server_tag;
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Starts the on-robot HTTP server and registers its endpoints.
+ *
+ * The server exposes diagnostic endpoints so the robot can be
+ * inspected live over Wi-Fi without a serial console:
+ * - `GET /api/system`: latest system monitor snapshot (tasks, cores, heaps).
+ * - `GET /api/power`: PM lock hold times and CPU frequency mode residency.
+ * - `GET /api/live`: latest sample of every sensor, from the telemetry router.
+ * - `GET /api/pipeline`: event bus counters and ingress ring occupancy/overflows.
+ * - `GET /api/telemetry`: router counters and reported/suppressed samples per topic.
+ * - `GET /api/http_sink`: web server sink sent/resent/dropped batches and resend window.
+ * - `GET /api/upload`: upload task counters (see upload_manager.h).
+ * - `POST /api/upload?file=<name>`: queues `/sdcard/<name>` for upload.
+ * - `GET /api/heap_trace`: last allocation hot spot report (see heap_trace_manager.h).
+ * - `POST /api/heap_trace?window_ms=<ms>`: traces allocations for a window (default 10 s).
+ * - `GET /api/trace`: event trace as Chrome trace JSON, for Perfetto (see common/trace.h).
+ * - `POST /api/trace?save=1`: writes the event trace to the card, returns the file name.
+ * - `POST /api/trace?categories=i2c,http`: empties the trace and records only those categories.
+ * - `GET /metrics`: counters, gauges and histograms for Prometheus (see common/metrics.h).
+ * - `GET /api/arenas`: size, high-water mark and overflows of every scratch arena (see common/arena.h).
+ * - `GET /api/memory`: allocations, fallbacks, failures and free memory per memory class (see common/mem_policy.h).
+ *
+ * @return
+ * - ESP_OK if the server was started and all handlers registered.
+ * - ESP_FAIL otherwise.
+ *
+ * @note Call this function once, after Wi-Fi has been initialized.
+ */
+esp_err_t http_server_manager_init(void);
+
+#endif /* TOPOROBO_HTTP_SERVER_MANAGER_H */
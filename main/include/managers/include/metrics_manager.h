@@ -0,0 +1,38 @@
+/* main/include/managers/include/metrics_manager.h */
+
+/* Periodic snapshots of the metrics registry (see common/metrics.h).
+ *
+ * Every `CONFIG_TOPOROBO_METRICS_SNAPSHOT_S` seconds the registry is
+ * rendered in the Prometheus text format, with the sample time (Unix ms) on
+ * every line, and appended to `/sdcard/metrics-<Unix day>.prom`, so the
+ * history of a robot that was out of reach of the scraper can be collected
+ * from the card later. Snapshots wait until the clock has been set. The
+ * live values are served at `GET /metrics`.
+ */
+
+#ifndef TOPOROBO_METRICS_MANAGER_H
+#define TOPOROBO_METRICS_MANAGER_H
+
+#include "esp_err.h"
+
+/* Constants ******************************************************************/
+
+/**
+ * @brief Logging tag for the metrics snapshots.
+ */
+extern const char *metrics_manager_tag;
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Starts the snapshot task.
+ *
+ * @return
+ * - ESP_OK on success, or when snapshots are disabled.
+ * - ESP_FAIL if the task could not be created.
+ *
+ * @note Call after `file_write_manager_init`.
+ */
+esp_err_t metrics_manager_init(void);
+
+#endif /* TOPOROBO_METRICS_MANAGER_H */
@@ -0,0 +1,51 @@
+/* main/include/managers/include/retention_manager.h */
+
+/* Retention of the columnar export on the SD card.
+ *
+ * With `CONFIG_TOPOROBO_RETENTION` the columnar writer starts a new segment
+ * file per `CONFIG_TOPOROBO_RETENTION_SEGMENT_S` of wall-clock time. A low
+ * priority task scans the card periodically and rewrites every segment that
+ * has not been modified for the configured age into a rollup of the next
+ * level, deleting the original once the rollup is complete:
+ *
+ *******************************************************************************
+ *
+ *    <topic>-<segment>.col      full rate       after RAW_AGE_H   -> 1 s rollup
+ *    <topic>-<segment>-1s.col   1 s rollups     after FINE_AGE_H  -> 1 min rollup
+ *    <topic>-<segment>-1m.col   1 min rollups   kept
+ *
+ *******************************************************************************
+ *
+ * Rollup rows hold the sample count and the min, mean and max of every
+ * numeric field per interval (see columnar_manager.h); string fields are
+ * dropped. The job reads and writes in small chunks, paced to
+ * `CONFIG_TOPOROBO_RETENTION_IO_BYTES_PER_S`, and waits whenever the file
+ * write manager has live writes pending, so it never delays them.
+ */
+
+#ifndef TOPOROBO_RETENTION_MANAGER_H
+#define TOPOROBO_RETENTION_MANAGER_H
+
+#include "esp_err.h"
+
+/* Constants ******************************************************************/
+
+/**
+ * @brief Logging tag for the retention job.
+ */
+extern const char *retention_tag;
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Starts the retention task on core 0.
+ *
+ * @return
+ * - ESP_OK on success, or when retention is disabled.
+ * - ESP_FAIL if the task could not be created.
+ *
+ * @note Call after `file_write_manager_init` and `time_manager_init`.
+ */
+esp_err_t retention_manager_init(void);
+
+#endif /* TOPOROBO_RETENTION_MANAGER_H */
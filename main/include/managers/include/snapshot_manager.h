@@ -0,0 +1,150 @@
+/* main/include/managers/include/snapshot_manager.h */
+
+#ifndef TOPOROBO_SNAPSHOT_MANAGER_H
+#define TOPOROBO_SNAPSHOT_MANAGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sensor_hal.h"
+#include "sensor_schema.h"
+
+/* Constants ******************************************************************/
+
+/**
+ * @brief Tag for logging snapshot mode messages.
+ */
+extern const char *snapshot_tag;
+
+/* Macros *********************************************************************/
+
+/**
+ * @brief Encoded fields of `snapshot_record_t`, see `sensor_schema.h`.
+ *
+ * Every member is always encoded; readers check `valid_mask` for the members
+ * that were actually read in the sweep.
+ */
+#define snapshot_schema_fields(field)                                         \
+  field(snapshot_record_t, timestamp_us, "timestamp_us", i64)                 \
+  field(snapshot_record_t, sweep_us,     "sweep_us",     u32)                 \
+  field(snapshot_record_t, sequence,     "sequence",     u32)                 \
+  field(snapshot_record_t, triggers,     "triggers",     u8)                  \
+  field(snapshot_record_t, valid_mask,   "valid_mask",   u8)                  \
+  field(snapshot_record_t, accel[0],     "accel_x",      f32)                 \
+  field(snapshot_record_t, accel[1],     "accel_y",      f32)                 \
+  field(snapshot_record_t, accel[2],     "accel_z",      f32)                 \
+  field(snapshot_record_t, gyro[0],      "gyro_x",       f32)                 \
+  field(snapshot_record_t, gyro[1],      "gyro_y",       f32)                 \
+  field(snapshot_record_t, gyro[2],      "gyro_z",       f32)                 \
+  field(snapshot_record_t, mag[0],       "mag_x",        f32)                 \
+  field(snapshot_record_t, mag[1],       "mag_y",        f32)                 \
+  field(snapshot_record_t, mag[2],       "mag_z",        f32)                 \
+  field(snapshot_record_t, heading,      "heading",      f32)                 \
+  field(snapshot_record_t, lux,          "lux",          f32)
+
+/* Enums **********************************************************************/
+
+/**
+ * @enum snapshot_member_t
+ * @brief Sensors that can take part in a snapshot, as bits of `valid_mask`.
+ */
+typedef enum : uint8_t {
+  k_snapshot_member_mpu6050  = 0, /**< Acceleration and angular rate */
+  k_snapshot_member_qmc5883l = 1, /**< Magnetic field and heading */
+  k_snapshot_member_bh1750   = 2, /**< Illuminance */
+  k_snapshot_member_count,        /**< Number of members, not a member */
+} snapshot_member_t;
+
+/**
+ * @enum snapshot_trigger_t
+ * @brief Events that start a sweep, as bits of `triggers`.
+ */
+typedef enum : uint8_t {
+  k_snapshot_trigger_timer  = (1 << 0), /**< Periodic `CONFIG_TOPOROBO_SNAPSHOT_PERIOD_MS` timer */
+  k_snapshot_trigger_servo  = (1 << 1), /**< Servos settled after `snapshot_manager_servo_moved` */
+  k_snapshot_trigger_manual = (1 << 2), /**< `snapshot_manager_trigger` */
+} snapshot_trigger_t;
+
+/* Structs ********************************************************************/
+
+/**
+ * @struct snapshot_record_t
+ * @brief One time-aligned reading of every snapshot member.
+ *
+ * All members are read back to back inside a single locked I2C sweep, so the
+ * whole record shares `timestamp_us` to within `sweep_us`. Published on the
+ * event bus as `k_event_bus_topic_snapshot`.
+ */
+typedef struct {
+  int64_t  timestamp_us; /**< esp_timer time at the middle of the sweep */
+  uint32_t sweep_us;     /**< Time from the first to the last bus read */
+  uint32_t sequence;     /**< Sweep counter since boot */
+  uint8_t  triggers;     /**< `snapshot_trigger_t` bits that caused the sweep */
+  uint8_t  valid_mask;   /**< Bit `snapshot_member_t` set for every member read successfully */
+  float    accel[3];     /**< MPU6050 acceleration X/Y/Z in g */
+  float    gyro[3];      /**< MPU6050 angular rate X/Y/Z in deg/s */
+  float    mag[3];       /**< QMC5883L field X/Y/Z in gauss */
+  float    heading;      /**< QMC5883L heading in degrees */
+  float    lux;          /**< BH1750 illuminance in lux */
+} snapshot_record_t;
+
+/* Globals (Constants) ********************************************************/
+
+/**
+ * @brief Schema of `snapshot_record_t`, from `snapshot_schema_fields`.
+ */
+extern const sensor_schema_t snapshot_schema;
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Claims the configured members and starts the snapshot task and timers.
+ *
+ * Members are the sensors selected with `CONFIG_TOPOROBO_SNAPSHOT_*`. Their
+ * free-running sensor tasks are not started (see `snapshot_manager_claims`);
+ * the snapshot task on the acquisition core reads them instead, on the
+ * periodic timer, a servo-settled event or a manual trigger.
+ *
+ * @param[in] sensor_data Sensor data initialized by `sensors_init`.
+ *
+ * @return
+ * - ESP_OK on success, or when snapshot mode is disabled.
+ * - ESP_FAIL if the task or a timer could not be created.
+ *
+ * @note Call after `sensors_init` and `event_bus_init`, before `sensor_tasks`.
+ */
+esp_err_t snapshot_manager_init(sensor_data_t *sensor_data);
+
+/**
+ * @brief Tells whether a sensor is sampled by snapshot mode.
+ *
+ * @param[in] sensor_data Pointer to one sensor's `*_data_t` inside the
+ *                        `sensor_data_t` given to `snapshot_manager_init`.
+ * @return true if its sensor task must not be started.
+ */
+bool snapshot_manager_claims(const void *sensor_data);
+
+/**
+ * @brief Requests a sweep as soon as possible.
+ */
+void snapshot_manager_trigger(void);
+
+/**
+ * @brief Requests a sweep once the servos have settled.
+ *
+ * Call after every servo command; the sweep starts
+ * `CONFIG_TOPOROBO_SNAPSHOT_SERVO_SETTLE_MS` after the last call, so a burst
+ * of moves yields one snapshot.
+ */
+void snapshot_manager_servo_moved(void);
+
+/**
+ * @brief Converts a snapshot record to JSON with `snapshot_schema`.
+ *
+ * @param[in] record Record to convert.
+ * @return A dynamically allocated JSON string, or NULL on failure. The caller
+ *         frees it.
+ */
+char *snapshot_record_to_json(const snapshot_record_t *record);
+
+#endif /* TOPOROBO_SNAPSHOT_MANAGER_H */
@@ -0,0 +1,68 @@
+/* main/include/managers/include/survey_manager.h */
+
+#ifndef TOPOROBO_SURVEY_MANAGER_H
+#define TOPOROBO_SURVEY_MANAGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+/* Constants ******************************************************************/
+
+/**
+ * @brief Tag for logging survey mode messages.
+ */
+extern const char *survey_tag;
+
+/* Structs ********************************************************************/
+
+/**
+ * @struct survey_warm_state_t
+ * @brief State kept in RTC slow memory across deep sleep cycles.
+ *
+ * Everything the main CPU needs to resume quickly after a wake without
+ * redoing slow start-up work: how long the MQ135 heater has been running,
+ * whether system time was set by SNTP (the RTC keeps counting in deep sleep),
+ * and the last GPS fix used to aid the receiver.
+ *
+ * The state is reset on every cold boot; it is only trusted when `magic`
+ * matches and the wake was caused by the ULP.
+ */
+typedef struct {
+  uint32_t magic;             /**< `survey_warm_state_magic` once initialized */
+  uint32_t wake_count;        /**< Batches flushed since the survey started */
+  uint64_t survey_ms;         /**< Survey time covered by ULP samples (samples * period) */
+  uint64_t time_sync_ms;      /**< `survey_ms` at the last successful SNTP sync */
+  bool     time_synced;       /**< System time came from SNTP rather than the default */
+  bool     gps_fix_valid;     /**< `latitude`/`longitude` hold a real fix */
+  float    latitude;          /**< Last fix latitude in decimal degrees */
+  float    longitude;         /**< Last fix longitude in decimal degrees */
+  time_t   gps_fix_time;      /**< System time of the last fix, 0 if unknown */
+  uint32_t upload_failures;   /**< Batches that were written to SD but not uploaded */
+} survey_warm_state_t;
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Runs one survey mode cycle and puts the chip into deep sleep.
+ *
+ * In survey mode the main cores only wake to move data. The ULP coprocessor
+ * samples the MQ135 every `CONFIG_TOPOROBO_SURVEY_SAMPLE_PERIOD_MS` into RTC
+ * memory and wakes the main CPU once `CONFIG_TOPOROBO_SURVEY_BATCH_SAMPLES`
+ * readings are buffered. Each wake then:
+ * - takes one DHT22 and BH1750 reading,
+ * - refreshes the GPS fix every `CONFIG_TOPOROBO_SURVEY_GPS_FIX_INTERVAL`
+ *   wakes, aiding the receiver with the last fix,
+ * - appends the batch as one JSON line to `CONFIG_TOPOROBO_SURVEY_PATH`,
+ * - uploads the same JSON to the web server,
+ * - restarts the ULP program and enters deep sleep.
+ *
+ * On a cold boot the warm state is reset, time is synchronized over SNTP and
+ * the ULP program is loaded before the first sleep.
+ *
+ * @note Only available with `CONFIG_TOPOROBO_SURVEY_MODE`. Call it first in
+ *       `app_main`; it does not return.
+ */
+void survey_manager_run(void);
+
+#endif /* TOPOROBO_SURVEY_MANAGER_H */
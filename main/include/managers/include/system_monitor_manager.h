@@ -0,0 +1,155 @@
+/* main/include/managers/include/system_monitor_manager.h */
+
+#ifndef TOPOROBO_SYSTEM_MONITOR_MANAGER_H
+#define TOPOROBO_SYSTEM_MONITOR_MANAGER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+/* Constants ******************************************************************/
+
+/**
+ * @brief Logging tag for the system monitor.
+ *
+ * Used in ESP_LOG messages emitted by the periodic monitor task so that
+ * stack, CPU and heap reports can be filtered out of the console output.
+ */
+extern const char *system_monitor_tag;
+
+/**
+ * @brief Interval between two samples of the system monitor, in ticks.
+ *
+ * Each sample walks every task in the system, so the period should stay in
+ * the range of seconds. CPU usage is computed over this interval.
+ */
+extern const uint32_t system_monitor_period_ticks;
+
+/**
+ * @brief Stack head-room (in bytes) below which a task is reported as a warning.
+ *
+ * Any task whose stack high-water mark drops under this value is logged with
+ * ESP_LOGW so undersized stacks can be spotted before they overflow.
+ */
+extern const uint32_t system_monitor_stack_warn_bytes;
+
+/* Macros *********************************************************************/
+
+/**
+ * @brief Maximum number of tasks tracked in a single snapshot.
+ *
+ * The task status array is statically reserved, so tasks beyond this count
+ * are not reported (the snapshot's `task_count` is clamped).
+ */
+#define system_monitor_max_tasks (32)
+
+/* Enums **********************************************************************/
+
+/**
+ * @enum system_monitor_heap_t
+ * @brief Heap capability classes sampled by the system monitor.
+ *
+ * Each class maps to a `MALLOC_CAP_*` mask passed to the `heap_caps_*` API.
+ * The PSRAM class reports zeros on boards without external RAM.
+ */
+typedef enum : uint8_t {
+  k_system_monitor_heap_internal = 0, /**< Internal RAM (MALLOC_CAP_INTERNAL) */
+  k_system_monitor_heap_dma      = 1, /**< DMA-capable RAM (MALLOC_CAP_DMA) */
+  k_system_monitor_heap_psram    = 2, /**< External PSRAM (MALLOC_CAP_SPIRAM) */
+  k_system_monitor_heap_count    = 3, /**< Number of heap classes */
+} system_monitor_heap_t;
+
+/* Structs ********************************************************************/
+
+/**
+ * @struct system_monitor_task_stats_t
+ * @brief Per-task statistics captured in a system monitor snapshot.
+ *
+ * **Fields:**
+ * - `name`: Task name as given to `xTaskCreate`.
+ * - `stack_high_water_mark`: Minimum free stack ever observed, in bytes.
+ * - `runtime`: Raw FreeRTOS run time counter for the task.
+ * - `cpu_percent`: Share of one core used during the last interval.
+ * - `core_id`: Core the task is pinned to, or -1 if it floats.
+ * - `priority`: Current priority of the task.
+ */
+typedef struct {
+  char     name[configMAX_TASK_NAME_LEN]; /**< Task name */
+  uint32_t stack_high_water_mark;         /**< Minimum free stack in bytes */
+  uint32_t runtime;                       /**< Run time counter (ticks of the stats timer) */
+  float    cpu_percent;                   /**< CPU usage over the last interval in percent */
+  int8_t   core_id;                       /**< Pinned core, -1 for no affinity */
+  uint8_t  priority;                      /**< Current task priority */
+} system_monitor_task_stats_t;
+
+/**
+ * @struct system_monitor_heap_stats_t
+ * @brief Heap statistics for one capability class.
+ *
+ * The gap between `free_bytes` and `largest_free_block` is a direct measure
+ * of fragmentation: a large free total with a small largest block means
+ * allocations of that size will fail even though memory is available.
+ */
+typedef struct {
+  size_t total_bytes;        /**< Total size of all heaps with this capability */
+  size_t free_bytes;         /**< Currently free bytes */
+  size_t minimum_free_bytes; /**< Lowest free value since boot (heap high-water mark) */
+  size_t largest_free_block; /**< Largest block that can currently be allocated */
+} system_monitor_heap_stats_t;
+
+/**
+ * @struct system_monitor_snapshot_t
+ * @brief A complete sample of task, CPU and heap usage.
+ */
+typedef struct {
+  uint32_t                    uptime_ms;                           /**< Time of the sample since boot */
+  uint8_t                     task_count;                          /**< Number of valid entries in `tasks` */
+  system_monitor_task_stats_t tasks[system_monitor_max_tasks];     /**< Per-task statistics */
+  float                       core_load_percent[portNUM_PROCESSORS]; /**< Non-idle time per core in percent */
+  system_monitor_heap_stats_t heaps[k_system_monitor_heap_count];  /**< Heap statistics per capability */
+} system_monitor_snapshot_t;
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Starts the system monitor task.
+ *
+ * The task wakes up every `system_monitor_period_ticks`, samples the stack
+ * high-water mark and run time of every task, the per-core load and the free,
+ * minimum-free and largest-free-block values of each heap class, logs them and
+ * stores them as the latest snapshot.
+ *
+ * @note Per-task run time requires `CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS`
+ *       and core affinity requires `CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID`
+ *       (both set in `sdkconfig.defaults`).
+ *
+ * @return
+ * - ESP_OK if the monitor task was started.
+ * - ESP_FAIL if the task or its mutex could not be created.
+ */
+esp_err_t system_monitor_init(void);
+
+/**
+ * @brief Copies the most recent snapshot taken by the monitor task.
+ *
+ * @param[out] snapshot Destination for the snapshot.
+ *
+ * @return
+ * - ESP_OK on success.
+ * - ESP_ERR_INVALID_ARG if `snapshot` is NULL.
+ * - ESP_ERR_INVALID_STATE if the monitor has not been started.
+ * - ESP_ERR_TIMEOUT if the snapshot is being updated for too long.
+ */
+esp_err_t system_monitor_get_snapshot(system_monitor_snapshot_t *snapshot);
+
+/**
+ * @brief Convert a system monitor snapshot to JSON.
+ *
+ * @param[in] snapshot Pointer to the snapshot to serialize.
+ * @return A JSON-formatted string, or NULL on failure.
+ * @note The returned string should be freed by the caller to prevent memory leaks.
+ */
+char *system_monitor_snapshot_to_json(const system_monitor_snapshot_t *snapshot);
+
+#endif /* TOPOROBO_SYSTEM_MONITOR_MANAGER_H */
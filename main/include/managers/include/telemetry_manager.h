@@ -0,0 +1,189 @@
+/* main/include/managers/include/telemetry_manager.h */
+
+/* Routes sensor samples from the event bus to the telemetry sinks (web server
+ * upload, SD card, live view) according to a static rule table.
+ *
+ * Each rule names a topic, a sink, a wire format and a decimation factor. For
+ * every sample the router works out which rules fire, encodes the sample once
+ * per distinct format among them and hands the same reference-counted buffer
+ * to every sink that asked for that format.
+ *
+ * Before routing, each sample passes its topic's reporting filter (see
+ * `common/report_filter.h`): slow environmental streams are only forwarded
+ * when a value leaves its deadband or a heartbeat interval expires, and the
+ * held-back samples are counted as suppressed.
+ *
+ *******************************************************************************
+ *
+ *    event bus --msg--> filter --> router --encode once per format--> [ json buffer, refs = N ]
+ *                                                            --> http sink
+ *                                                            --> sd sink
+ *                                                            --> live view
+ *                                                        [ binary buffer, refs = M ]
+ *                                                            --> ...
+ *
+ *******************************************************************************/
+
+#ifndef TOPOROBO_TELEMETRY_MANAGER_H
+#define TOPOROBO_TELEMETRY_MANAGER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "common/event_bus.h"
+#include "sensor_schema.h"
+
+/* Constants ******************************************************************/
+
+/**
+ * @brief Logging tag for the telemetry router.
+ */
+extern const char *telemetry_tag;
+
+/* Enums **********************************************************************/
+
+/**
+ * @enum telemetry_format_t
+ * @brief Wire formats a sample can be encoded into.
+ */
+typedef enum : uint8_t {
+  k_telemetry_format_json   = 0, /**< NUL terminated JSON object, from the topic's schema */
+  k_telemetry_format_binary = 1, /**< `telemetry_binary_header_t` followed by the packed record */
+  k_telemetry_format_csv    = 2, /**< NUL terminated CSV row: `timestamp_us`, then the columns of `sensor_schema_csv_header` */
+  k_telemetry_format_count,      /**< Number of formats, not a format */
+} telemetry_format_t;
+
+/**
+ * @enum telemetry_sink_t
+ * @brief Destinations a sample can be routed to.
+ */
+typedef enum : uint8_t {
+  k_telemetry_sink_http     = 0, /**< POST to the web server (JSON only) */
+  k_telemetry_sink_sd       = 1, /**< Append to the topic's `.txt` (JSON), `.bin` or `.csv` file on the SD card, a new `.csv` starting with its header row */
+  k_telemetry_sink_live     = 2, /**< Latest sample per topic, served on `GET /api/live` (JSON only) */
+  k_telemetry_sink_columnar = 3, /**< Column blocks in the topic's `.col` file (binary only), see columnar_manager.h */
+  k_telemetry_sink_count,        /**< Number of sinks, not a sink */
+} telemetry_sink_t;
+
+/* Structs ********************************************************************/
+
+/**
+ * @struct telemetry_route_t
+ * @brief One routing rule.
+ */
+typedef struct {
+  event_bus_topic_t  topic;      /**< Sensor topic the rule applies to */
+  telemetry_sink_t   sink;       /**< Where matching samples go */
+  telemetry_format_t format;     /**< Encoding the sink receives */
+  uint16_t           decimation; /**< Forward one in every `decimation` samples (1 = all) */
+} telemetry_route_t;
+
+/**
+ * @struct telemetry_binary_header_t
+ * @brief Prefix of every `k_telemetry_format_binary` buffer.
+ *
+ * The payload is the sample packed per its `sensor_schema_t` (see
+ * `sensor_schema.h` and `tools/telemetry_decode.py`), or the raw struct for
+ * topics without a schema.
+ */
+typedef struct __attribute__((packed)) {
+  uint8_t  topic;        /**< `event_bus_topic_t` of the payload */
+  uint8_t  reserved;     /**< Zero */
+  uint16_t size;         /**< Bytes of payload following the header */
+  int64_t  timestamp_us; /**< esp_timer time the sample was published */
+} telemetry_binary_header_t;
+
+/**
+ * @struct telemetry_buffer_t
+ * @brief One encoded sample shared by every sink that uses its format.
+ *
+ * Buffers are read-only once handed to a sink. A sink that keeps a buffer
+ * beyond the call holds a reference and gives it back with
+ * `telemetry_buffer_release`.
+ */
+typedef struct {
+  uint8_t           *data;         /**< Encoded bytes, owned by the buffer */
+  size_t             length;       /**< Valid bytes in `data`, excluding any NUL */
+  int64_t            timestamp_us; /**< esp_timer time the sample was published */
+  event_bus_topic_t  topic;        /**< Sensor topic of the sample */
+  telemetry_format_t format;       /**< Encoding of `data` */
+  uint8_t            refs;         /**< Holders of the buffer, internal */
+} telemetry_buffer_t;
+
+/**
+ * @struct telemetry_stats_t
+ * @brief Router counters since boot.
+ */
+typedef struct {
+  uint32_t samples;    /**< Samples received from the event bus */
+  uint32_t suppressed; /**< Samples held back by the reporting filter */
+  uint32_t encodes;    /**< Buffers encoded (at most one per format per sample) */
+  uint32_t deliveries; /**< Buffers handed to sinks */
+  uint32_t decimated;  /**< Route matches skipped by decimation */
+  uint32_t failures;   /**< Encodes or deliveries that failed */
+} telemetry_stats_t;
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Validates the routing table, subscribes to the event bus and starts
+ *        the router task on core 0.
+ *
+ * @return
+ * - ESP_OK on success.
+ * - ESP_ERR_INVALID_ARG if a rule pairs a sink with a format it cannot take.
+ * - ESP_FAIL if the queue, subscription or task could not be created.
+ *
+ * @note Call after `event_bus_init`, `webserver_tasks_init` and
+ *       `file_write_manager_init`, before the sensor tasks start.
+ */
+esp_err_t telemetry_manager_init(void);
+
+/**
+ * @brief Returns the schema of the payload of `topic`.
+ *
+ * @param[in] topic Event bus topic.
+ * @return The schema, or NULL for topics without one (e.g. summaries).
+ */
+const sensor_schema_t *telemetry_manager_schema(event_bus_topic_t topic);
+
+/**
+ * @brief Takes an extra reference to `buffer`.
+ *
+ * @param[in] buffer Buffer to retain.
+ */
+void telemetry_buffer_retain(telemetry_buffer_t *buffer);
+
+/**
+ * @brief Drops a reference to `buffer`, freeing it with the last one.
+ *
+ * @param[in] buffer Buffer to release, may be NULL.
+ */
+void telemetry_buffer_release(telemetry_buffer_t *buffer);
+
+/**
+ * @brief Returns the latest live-view sample for `topic` with a reference held.
+ *
+ * @param[in] topic Sensor topic.
+ * @return The buffer, to be released with `telemetry_buffer_release`, or NULL
+ *         if no sample has been routed to the live view yet.
+ */
+telemetry_buffer_t *telemetry_manager_live_acquire(event_bus_topic_t topic);
+
+/**
+ * @brief Copies the router counters.
+ *
+ * @param[out] stats Destination for the counters.
+ */
+void telemetry_manager_get_stats(telemetry_stats_t *stats);
+
+/**
+ * @brief Converts the router counters and the per-topic reported/suppressed
+ *        counts of the reporting filter to JSON.
+ *
+ * @return A dynamically allocated JSON string, or NULL on failure. The caller
+ *         frees it.
+ */
+char *telemetry_manager_stats_to_json(void);
+
+#endif /* TOPOROBO_TELEMETRY_MANAGER_H */
@@ -0,0 +1,97 @@
+/* main/include/managers/include/upload_manager.h */
+
+/* Streaming upload of stored files from the SD card.
+ *
+ * With `CONFIG_TOPOROBO_UPLOAD` a task uploads queued files (typically
+ * columnar segments) to `CONFIG_TOPOROBO_UPLOAD_URL`. A file is never held
+ * in RAM: it is read in `CONFIG_TOPOROBO_UPLOAD_CHUNK_BYTES` pieces and sent
+ * with chunked transfer encoding, one HTTP chunk per piece.
+ *
+ * Each attempt first asks the server how much of the file it already holds,
+ * then sends only the rest, so a transfer cut by a Wi-Fi drop resumes from
+ * the last acknowledged byte instead of restarting:
+ *
+ *******************************************************************************
+ *
+ *    HEAD  <url>/<name>                   -> 200, Upload-Offset: <n>  (404: n = 0)
+ *    PATCH <url>/<name>                      Upload-Offset: <n>
+ *          Transfer-Encoding: chunked        Upload-Length: <file size>
+ *          <file bytes n .. size>         -> 204, Upload-Offset: <size>
+ *
+ *******************************************************************************
+ *
+ * The server must append a PATCH body at `Upload-Offset` only if that is the
+ * length it holds (409 otherwise). `tools/upload_server.py` implements the
+ * receiving side. A file modified in the last few seconds is still being
+ * written; it waits at the back of the queue without using up its attempts.
+ * A file that grows later can be queued again; only the new tail is sent.
+ */
+
+#ifndef TOPOROBO_UPLOAD_MANAGER_H
+#define TOPOROBO_UPLOAD_MANAGER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/* Structs ********************************************************************/
+
+/**
+ * @struct upload_stats_t
+ * @brief Counters of the upload task since boot.
+ */
+typedef struct {
+  uint32_t queued;    /**< Files accepted by `upload_manager_enqueue` */
+  uint32_t completed; /**< Files the server acknowledged in full */
+  uint32_t resumed;   /**< Attempts that started past offset 0 */
+  uint32_t retries;   /**< Attempts that failed and were retried */
+  uint32_t deferred;  /**< Times a file still being written went back in the queue */
+  uint32_t failed;    /**< Files given up after all retries */
+  uint64_t bytes;     /**< File bytes sent, excluding chunk framing */
+} upload_stats_t;
+
+/* Constants ******************************************************************/
+
+/**
+ * @brief Logging tag for the upload task.
+ */
+extern const char *upload_tag;
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Starts the upload task on core 0.
+ *
+ * @return
+ * - ESP_OK on success, or when uploads are disabled.
+ * - ESP_FAIL if the queue or task could not be created.
+ */
+esp_err_t upload_manager_init(void);
+
+/**
+ * @brief Queues a stored file for upload.
+ *
+ * @param[in] path Full path of the file (e.g., "/sdcard/dht22-493128.col").
+ *
+ * @return
+ * - ESP_OK if the file was queued.
+ * - ESP_ERR_INVALID_ARG if `path` is NULL or too long.
+ * - ESP_ERR_NOT_SUPPORTED if uploads are disabled.
+ * - ESP_FAIL if the queue is full.
+ */
+esp_err_t upload_manager_enqueue(const char *path);
+
+/**
+ * @brief Copies the upload counters.
+ *
+ * @param[out] stats Destination, zeroed when uploads are disabled.
+ */
+void upload_manager_get_stats(upload_stats_t *stats);
+
+/**
+ * @brief Serializes the upload counters to a JSON string.
+ *
+ * @return Heap string the caller must free, or NULL on failure.
+ */
+char *upload_manager_stats_to_json(void);
+
+#endif /* TOPOROBO_UPLOAD_MANAGER_H */
@@ -0,0 +1,142 @@
+/* main/include/managers/metrics_manager.c */
+
+#include "metrics_manager.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "common/mem_policy.h"
+#include "common/metrics.h"
+#include "common/rtos_alloc.h"
+#include "file_write_manager.h"
+#include "sd_card_hal.h"
+
+/* Macros *********************************************************************/
+
+#define metrics_task_stack_bytes  (4096)
+#define metrics_task_priority     (1)          /* Just above idle */
+#define metrics_task_core_id      (0)          /* Processing core */
+#define metrics_initial_bytes     (2048)       /* First size of the snapshot buffer */
+#define metrics_min_valid_time_s  (1600000000) /* Earlier clocks have not been set yet */
+
+/* Structs ********************************************************************/
+
+/**
+ * @brief Heap buffer the snapshot is rendered into, grown as needed.
+ */
+typedef struct {
+  char  *data;
+  size_t length;
+  size_t capacity;
+} metrics_buffer_t;
+
+/* Globals (Constants) ********************************************************/
+
+const char *metrics_manager_tag = "METRICS";
+
+#if CONFIG_TOPOROBO_METRICS_SNAPSHOT_S > 0
+
+/* Globals (Static) ***********************************************************/
+
+rtos_task_storage_define(s_metrics_task_storage, metrics_task_stack_bytes);
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief `metrics_writer_t` appending to a `metrics_buffer_t`.
+ */
+static esp_err_t priv_metrics_buffer_write(void *context, const char *data, size_t length)
+{
+  metrics_buffer_t *buffer = context;
+
+  if (buffer->length + length > buffer->capacity) {
+    size_t capacity = buffer->capacity * 2;
+    while (capacity < buffer->length + length) {
+      capacity *= 2;
+    }
+    char *grown = mem_policy_realloc(k_mem_policy_dma, buffer->data, capacity);
+    if (grown == NULL) {
+      return ESP_ERR_NO_MEM;
+    }
+    buffer->data     = grown;
+    buffer->capacity = capacity;
+  }
+  memcpy(buffer->data + buffer->length, data, length);
+  buffer->length += length;
+  return ESP_OK;
+}
+
+/**
+ * @brief Renders the registry and queues it for appending to the day's file.
+ */
+static void priv_metrics_snapshot(void)
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  if (now.tv_sec < metrics_min_valid_time_s) {
+    return; /* The lines would carry a 1970 timestamp */
+  }
+
+  metrics_buffer_t buffer = {
+    .data     = mem_policy_malloc(k_mem_policy_dma, metrics_initial_bytes),
+    .length   = 0,
+    .capacity = metrics_initial_bytes,
+  };
+  if (buffer.data == NULL) {
+    ESP_LOGE(metrics_manager_tag, "Failed to allocate snapshot buffer");
+    return;
+  }
+
+  int64_t   timestamp_ms = (int64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+  esp_err_t ret          = metrics_export(timestamp_ms, priv_metrics_buffer_write, &buffer);
+  if (ret != ESP_OK || buffer.length == 0) {
+    ESP_LOGE(metrics_manager_tag, "Failed to render snapshot: %s", esp_err_to_name(ret));
+    free(buffer.data);
+    return;
+  }
+
+  char path[max_file_path_length];
+  snprintf(path, sizeof(path), "%s/metrics-%lld.prom", sd_card_mount,
+           (long long)(now.tv_sec / 86400));
+  ret = file_write_enqueue_block(path, (uint8_t *)buffer.data, buffer.length);
+  if (ret != ESP_OK) {
+    ESP_LOGW(metrics_manager_tag, "Snapshot dropped: %s", esp_err_to_name(ret));
+  }
+}
+
+/**
+ * @brief Takes a snapshot every `CONFIG_TOPOROBO_METRICS_SNAPSHOT_S`.
+ */
+static void priv_metrics_task(void *param)
+{
+  TickType_t last_wake = xTaskGetTickCount();
+
+  while (1) {
+    vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(CONFIG_TOPOROBO_METRICS_SNAPSHOT_S * 1000));
+    priv_metrics_snapshot();
+  }
+}
+
+#endif /* CONFIG_TOPOROBO_METRICS_SNAPSHOT_S > 0 */
+
+/* Public Functions ***********************************************************/
+
+esp_err_t metrics_manager_init(void)
+{
+#if CONFIG_TOPOROBO_METRICS_SNAPSHOT_S > 0
+  if (priv_rtos_task_create(priv_metrics_task, "Metrics", metrics_task_stack_bytes, NULL,
+                            metrics_task_priority, NULL, metrics_task_core_id,
+                            rtos_storage_ref(s_metrics_task_storage)) != ESP_OK) {
+    ESP_LOGE(metrics_manager_tag, "Failed to create metrics task");
+    return ESP_FAIL;
+  }
+
+  ESP_LOGI(metrics_manager_tag, "Snapshot to %s every %d s", sd_card_mount,
+           CONFIG_TOPOROBO_METRICS_SNAPSHOT_S);
+#endif
+  return ESP_OK;
+}
@@ -0,0 +1,767 @@
+/* main/include/managers/retention_manager.c */
+
+#include "retention_manager.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "sensor_schema.h"
+#include "common/rtos_alloc.h"
+#include "common/gorilla.h"
+#include "common/mem_policy.h"
+#include "common/stream_stats.h"
+#include "columnar_manager.h"
+#include "file_write_manager.h"
+#include "sd_card_hal.h"
+
+/* Macros *********************************************************************/
+
+#define retention_task_stack_bytes (4096)
+#define retention_task_priority    (1)          /* Just above idle */
+#define retention_task_core_id     (0)          /* Processing core */
+#define retention_chunk_bytes      (4096)       /* Largest single read or write */
+#define retention_block_rows       (64)         /* Rows per rollup block */
+#define retention_max_fields       (16)         /* Numeric fields per topic */
+#define retention_max_columns      (2 + 3 * retention_max_fields)
+#define retention_backoff_ms       (20)         /* Poll period while live writes are pending */
+#define retention_valid_time       (1672531200) /* 2023-01-01, earlier clocks are not set yet */
+
+/* Structs ********************************************************************/
+
+/**
+ * @brief Read position in one column of an input block.
+ */
+typedef struct {
+  const uint8_t           *data;     /**< Column bytes */
+  size_t                   length;   /**< Size of `data` */
+  columnar_column_header_t header;   /**< Copy of the column header */
+  columnar_encoding_t      encoding; /**< Encoding of the block */
+  uint32_t                 row;      /**< Next row of a raw column */
+  gorilla_decoder_t        decoder;  /**< Stream of a gorilla column */
+} retention_cursor_t;
+
+/**
+ * @brief Columns of an input block holding one numeric field, -1 if absent.
+ */
+typedef struct {
+  uint16_t index; /**< Schema field index */
+  int16_t  value; /**< Samples, in full-rate segments */
+  int16_t  min;   /**< Interval minimum, in rollups */
+  int16_t  mean;  /**< Interval mean, in rollups */
+  int16_t  max;   /**< Interval maximum, in rollups */
+} retention_field_t;
+
+/**
+ * @brief Rollup being written from one segment.
+ */
+typedef struct {
+  FILE          *file;                          /**< Temporary output file */
+  int64_t        interval_us;                   /**< Rollup interval */
+  uint8_t        topic;                         /**< `event_bus_topic_t` of the segment */
+  uint8_t        field_count;                   /**< Valid entries of `fields` */
+  uint16_t       fields[retention_max_fields];  /**< Schema index of each rolled up field */
+  uint8_t       *block;                         /**< Output block at capacity layout, or NULL */
+  uint32_t       count;                         /**< Rows in `block` */
+  int64_t        t_min_us;                      /**< First interval start in `block` */
+  int64_t        t_max_us;                      /**< Last interval start in `block` */
+  int64_t        bucket_us;                     /**< Start of the interval being accumulated */
+  uint32_t       samples;                       /**< Samples in that interval, 0 if none yet */
+  stream_stats_t stats[retention_max_fields];   /**< Per field statistics of that interval */
+} retention_rollup_t;
+
+/* Globals (Constants) ********************************************************/
+
+const char *retention_tag = "RETENTION";
+
+#if CONFIG_TOPOROBO_RETENTION
+
+/**
+ * @brief Segment file levels, from full rate to the coarsest rollup.
+ */
+static const struct {
+  const char *suffix;      /**< Appended to `<topic>-<segment>` */
+  int64_t     interval_us; /**< Rollup interval, 0 for full-rate samples */
+  uint32_t    age_s;       /**< Unmodified age that moves a file to the next level, 0 to keep */
+} retention_levels[] = {
+  { ".col",    0,        CONFIG_TOPOROBO_RETENTION_RAW_AGE_H * 3600  },
+  { "-1s.col", 1000000,  CONFIG_TOPOROBO_RETENTION_FINE_AGE_H * 3600 },
+  { "-1m.col", 60000000, 0                                            },
+};
+
+#define retention_level_count (sizeof(retention_levels) / sizeof(retention_levels[0]))
+
+/* Globals (Static) ***********************************************************/
+
+static retention_cursor_t s_cursors[retention_max_columns]; /* Retention task only */
+static retention_rollup_t s_rollup;                         /* Retention task only */
+
+rtos_task_storage_define(s_retention_task_storage, retention_task_stack_bytes);
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Paces card I/O to `CONFIG_TOPOROBO_RETENTION_IO_BYTES_PER_S`, then
+ *        waits until no live write is pending, before `bytes` are transferred.
+ */
+static void priv_retention_pace(size_t bytes)
+{
+  TickType_t delay = pdMS_TO_TICKS((uint64_t)bytes * 1000 / CONFIG_TOPOROBO_RETENTION_IO_BYTES_PER_S);
+  vTaskDelay((delay > 0) ? delay : 1);
+  while (file_write_pending() > 0) {
+    vTaskDelay(pdMS_TO_TICKS(retention_backoff_ms));
+  }
+}
+
+/**
+ * @brief Reads `length` bytes in paced chunks.
+ *
+ * @return Bytes read, less than `length` at the end of the file.
+ */
+static size_t priv_retention_read(FILE *file, uint8_t *buffer, size_t length)
+{
+  size_t done = 0;
+  while (done < length) {
+    size_t chunk = (length - done < retention_chunk_bytes) ? length - done : retention_chunk_bytes;
+    priv_retention_pace(chunk);
+    size_t got = fread(buffer + done, 1, chunk, file);
+    done      += got;
+    if (got != chunk) {
+      break;
+    }
+  }
+  return done;
+}
+
+/**
+ * @brief Writes `length` bytes in paced chunks.
+ */
+static bool priv_retention_write(FILE *file, const uint8_t *buffer, size_t length)
+{
+  size_t done = 0;
+  while (done < length) {
+    size_t chunk = (length - done < retention_chunk_bytes) ? length - done : retention_chunk_bytes;
+    priv_retention_pace(chunk);
+    if (fwrite(buffer + done, 1, chunk, file) != chunk) {
+      return false;
+    }
+    done += chunk;
+  }
+  return true;
+}
+
+/**
+ * @brief Converts a float sample to an integer, saturating; a NaN (a failed
+ *        reading) gives 0, as the cast is undefined for it and for values
+ *        out of range.
+ */
+static int64_t priv_retention_float_to_int(float real)
+{
+  if (!isfinite(real)) {
+    return isinf(real) ? ((real > 0.0f) ? INT64_MAX : INT64_MIN) : 0;
+  }
+  if (real >= 9223372036854775807.0f) { /* Rounds to 2^63 */
+    return INT64_MAX;
+  }
+  if (real < -9223372036854775808.0f) {
+    return INT64_MIN;
+  }
+  return (int64_t)real;
+}
+
+/**
+ * @brief Reads the next value of a column, as an integer and as a float.
+ *
+ * @return false if the column ends early.
+ */
+static bool priv_retention_next(retention_cursor_t *cursor, int64_t *integer, float *real)
+{
+  sensor_schema_kind_t kind = cursor->header.kind;
+
+  if (cursor->encoding == k_columnar_encoding_gorilla) {
+    bool ok = (kind == k_sensor_schema_f32) ? gorilla_get_float(&cursor->decoder, real)
+                                            : gorilla_get_int(&cursor->decoder, integer);
+    if (!ok) {
+      return false;
+    }
+  } else {
+    size_t at = (size_t)cursor->row * cursor->header.width;
+    if (at + cursor->header.width > cursor->length) {
+      return false;
+    }
+
+    const uint8_t *cell = cursor->data + at;
+    switch (kind) {
+      case k_sensor_schema_f32:
+        memcpy(real, cell, sizeof(*real));
+        break;
+      case k_sensor_schema_u8:
+        *integer = *cell;
+        break;
+      case k_sensor_schema_u16: {
+        uint16_t v;
+        memcpy(&v, cell, sizeof(v));
+        *integer = v;
+        break;
+      }
+      case k_sensor_schema_u32: {
+        uint32_t v;
+        memcpy(&v, cell, sizeof(v));
+        *integer = v;
+        break;
+      }
+      case k_sensor_schema_i64:
+        memcpy(integer, cell, sizeof(*integer));
+        break;
+      default:
+        return false;
+    }
+    cursor->row++;
+  }
+
+  if (kind == k_sensor_schema_f32) {
+    *integer = priv_retention_float_to_int(*real);
+  } else {
+    *real = (float)*integer;
+  }
+  return true;
+}
+
+/**
+ * @brief Size of a rollup block of `field_count` fields at capacity.
+ */
+static size_t priv_retention_rollup_bytes(uint8_t field_count)
+{
+  return sizeof(columnar_block_header_t) +
+         (2 + 3 * field_count) * sizeof(columnar_column_header_t) +
+         retention_block_rows * (sizeof(int64_t) + sizeof(uint32_t) + 3 * field_count * sizeof(float));
+}
+
+/**
+ * @brief Largest valid block of `topic`, full-rate or rollup; a larger
+ *        `block_size` means the header is corrupt.
+ *
+ * @return The size, or 0 for a topic without a schema.
+ */
+static size_t priv_retention_max_block_bytes(uint8_t topic)
+{
+  const sensor_schema_t *schema = (topic < k_event_bus_topic_count)
+                                ? telemetry_manager_schema(topic) : NULL;
+  if (schema == NULL) {
+    return 0;
+  }
+  size_t raw    = columnar_manager_block_bytes(schema);
+  size_t rollup = priv_retention_rollup_bytes(schema->field_count);
+  return (raw > rollup) ? raw : rollup;
+}
+
+/**
+ * @brief Allocates an empty rollup block for the fields of `rollup`.
+ */
+static uint8_t *priv_retention_block_create(const retention_rollup_t *rollup)
+{
+  uint8_t column_count = 2 + 3 * rollup->field_count;
+  size_t  offset       = sizeof(columnar_block_header_t) +
+                         column_count * sizeof(columnar_column_header_t);
+  size_t  size         = priv_retention_rollup_bytes(rollup->field_count);
+
+  uint8_t *block = mem_policy_calloc(k_mem_policy_bulk, 1, size);
+  if (block == NULL) {
+    return NULL;
+  }
+
+  columnar_column_header_t *columns = (columnar_column_header_t *)(block + sizeof(columnar_block_header_t));
+  columns[0] = (columnar_column_header_t) {
+    .kind   = k_sensor_schema_i64,
+    .width  = sizeof(int64_t),
+    .field  = columnar_timestamp_field,
+    .offset = offset,
+  };
+  offset    += sizeof(int64_t) * retention_block_rows;
+  columns[1] = (columnar_column_header_t) {
+    .kind   = k_sensor_schema_u32,
+    .width  = sizeof(uint32_t),
+    .field  = columnar_count_field,
+    .offset = offset,
+  };
+  offset += sizeof(uint32_t) * retention_block_rows;
+
+  for (uint8_t i = 0; i < rollup->field_count; i++) {
+    for (uint8_t stat = k_columnar_stat_min; stat <= k_columnar_stat_max; stat++) {
+      columns[2 + 3 * i + stat - k_columnar_stat_min] = (columnar_column_header_t) {
+        .kind   = k_sensor_schema_f32,
+        .width  = sizeof(float),
+        .field  = columnar_stat_field(rollup->fields[i], stat),
+        .offset = offset,
+      };
+      offset += sizeof(float) * retention_block_rows;
+    }
+  }
+  return block;
+}
+
+/**
+ * @brief Finishes the rollup block and writes it to the output file.
+ */
+static bool priv_retention_flush(retention_rollup_t *rollup)
+{
+  if (rollup->block == NULL) {
+    return true;
+  }
+
+  columnar_block_header_t header = {
+    .magic        = columnar_block_magic,
+    .version      = columnar_block_version,
+    .topic        = rollup->topic,
+    .column_count = 2 + 3 * rollup->field_count,
+    .count        = rollup->count,
+    .t_min_us     = rollup->t_min_us,
+    .t_max_us     = rollup->t_max_us,
+  };
+  memcpy(rollup->block, &header, sizeof(header));
+
+  size_t   size  = 0;
+  uint8_t *block = columnar_manager_finish_block(rollup->block, &size);
+  bool     ok    = priv_retention_write(rollup->file, block, size);
+
+  free(block);
+  rollup->block = NULL;
+  rollup->count = 0;
+  return ok;
+}
+
+/**
+ * @brief Appends the interval being accumulated as one row of the rollup.
+ */
+static bool priv_retention_emit(retention_rollup_t *rollup)
+{
+  if (rollup->samples == 0) {
+    return true;
+  }
+  if (rollup->block == NULL) {
+    rollup->block = priv_retention_block_create(rollup);
+    if (rollup->block == NULL) {
+      ESP_LOGE(retention_tag, "No memory for a rollup block");
+      return false;
+    }
+    rollup->count    = 0;
+    rollup->t_min_us = rollup->bucket_us;
+  }
+
+  columnar_column_header_t *columns = (columnar_column_header_t *)(rollup->block +
+                                                                   sizeof(columnar_block_header_t));
+  uint32_t                  row     = rollup->count;
+
+  memcpy(rollup->block + columns[0].offset + row * sizeof(int64_t), &rollup->bucket_us,
+         sizeof(int64_t));
+  memcpy(rollup->block + columns[1].offset + row * sizeof(uint32_t), &rollup->samples,
+         sizeof(uint32_t));
+
+  for (uint8_t i = 0; i < rollup->field_count; i++) {
+    const stream_stats_t *stats     = &rollup->stats[i];
+    float                 values[3] = { stats->min, (float)stats->mean, stats->max };
+
+    for (uint8_t j = 0; j < 3; j++) {
+      columnar_column_header_t *column = &columns[2 + 3 * i + j];
+      memcpy(rollup->block + column->offset + row * sizeof(float), &values[j], sizeof(float));
+      if (row == 0 || values[j] < column->min) {
+        column->min = values[j];
+      }
+      if (row == 0 || values[j] > column->max) {
+        column->max = values[j];
+      }
+    }
+    stream_stats_reset(&rollup->stats[i]);
+  }
+
+  rollup->t_max_us = rollup->bucket_us;
+  rollup->samples  = 0;
+  rollup->count++;
+  return (rollup->count < retention_block_rows) ? true : priv_retention_flush(rollup);
+}
+
+/**
+ * @brief Sets up the cursors and field map of an input block.
+ *
+ * @return Number of numeric fields, or -1 if the block is not usable.
+ */
+static int priv_retention_map(uint8_t *block, const columnar_block_header_t *header,
+                              retention_field_t *fields, int16_t *timestamps, int16_t *counts)
+{
+  const columnar_column_header_t *columns = (const columnar_column_header_t *)(block +
+                                                                               sizeof(*header));
+  size_t                          end     = sizeof(*header) +
+                                            header->column_count * sizeof(columnar_column_header_t);
+  int                             count   = 0;
+
+  if (header->column_count > retention_max_columns || end > header->block_size) {
+    return -1;
+  }
+
+  *timestamps = -1;
+  *counts     = -1;
+  for (uint8_t i = 0; i < header->column_count; i++) {
+    size_t next = (i + 1 < header->column_count) ? columns[i + 1].offset : header->block_size;
+    if (columns[i].offset < end || next < columns[i].offset || next > header->block_size) {
+      return -1;
+    }
+    end = columns[i].offset;
+
+    retention_cursor_t *cursor = &s_cursors[i];
+    memcpy(&cursor->header, &columns[i], sizeof(cursor->header));
+    cursor->data     = block + columns[i].offset;
+    cursor->length   = next - columns[i].offset;
+    cursor->encoding = header->encoding;
+    cursor->row      = 0;
+    gorilla_decoder_init(&cursor->decoder, cursor->data, cursor->length);
+
+    uint16_t field = cursor->header.field;
+    if (field == columnar_timestamp_field) {
+      *timestamps = i;
+      continue;
+    }
+    if (field == columnar_count_field) {
+      *counts = i;
+      continue;
+    }
+    if (cursor->header.kind == k_sensor_schema_str) {
+      continue; /* Not rolled up */
+    }
+
+    uint16_t index = field & 0x0FFF;
+    uint8_t  stat  = field >> 12;
+    int      k     = 0;
+    while (k < count && fields[k].index != index) {
+      k++;
+    }
+    if (k == count) {
+      if (count == retention_max_fields) {
+        return -1;
+      }
+      fields[count++] = (retention_field_t) { index, -1, -1, -1, -1 };
+    }
+
+    switch (stat) {
+      case k_columnar_stat_value: fields[k].value = i; break;
+      case k_columnar_stat_min:   fields[k].min   = i; break;
+      case k_columnar_stat_mean:  fields[k].mean  = i; break;
+      case k_columnar_stat_max:   fields[k].max   = i; break;
+      default:                    return -1;
+    }
+  }
+  return (*timestamps < 0) ? -1 : count;
+}
+
+/**
+ * @brief Adds every row of one input block to the rollup.
+ */
+static bool priv_retention_add_block(retention_rollup_t *rollup, uint8_t *block,
+                                     const columnar_block_header_t *header)
+{
+  retention_field_t fields[retention_max_fields];
+  int16_t           timestamps, counts;
+  int               field_count = priv_retention_map(block, header, fields, &timestamps, &counts);
+  if (field_count < 0) {
+    ESP_LOGW(retention_tag, "Skipping a malformed block");
+    return true;
+  }
+
+  /* All blocks of a segment normally share one layout; start a new rollup block if not */
+  bool same = (field_count == rollup->field_count);
+  for (int k = 0; same && k < field_count; k++) {
+    same = (fields[k].index == rollup->fields[k]);
+  }
+  if (!same) {
+    if (!priv_retention_emit(rollup) || !priv_retention_flush(rollup)) {
+      return false;
+    }
+    rollup->field_count = field_count;
+    for (int k = 0; k < field_count; k++) {
+      rollup->fields[k] = fields[k].index;
+      stream_stats_reset(&rollup->stats[k]);
+    }
+  }
+  rollup->topic = header->topic;
+
+  for (uint32_t row = 0; row < header->count; row++) {
+    int64_t timestamp_us, samples = 1;
+    float   real;
+    if (!priv_retention_next(&s_cursors[timestamps], &timestamp_us, &real) ||
+        (counts >= 0 && !priv_retention_next(&s_cursors[counts], &samples, &real))) {
+      ESP_LOGW(retention_tag, "Truncated block");
+      return true;
+    }
+
+    /* Unix time once the clock was set (see columnar_manager.h), so intervals
+     * line up with the wall clock across reboots */
+    int64_t bucket_us = timestamp_us - timestamp_us % rollup->interval_us;
+    if (rollup->samples > 0 && bucket_us != rollup->bucket_us && !priv_retention_emit(rollup)) {
+      return false;
+    }
+    rollup->bucket_us  = bucket_us;
+    rollup->samples   += (uint32_t)samples;
+
+    for (int k = 0; k < field_count; k++) {
+      int64_t integer;
+      if (fields[k].value >= 0) {
+        /* A failed reading is stored as NaN; it would poison the mean, min and max */
+        if (priv_retention_next(&s_cursors[fields[k].value], &integer, &real) && isfinite(real)) {
+          stream_stats_add(&rollup->stats[k], real);
+        }
+        continue;
+      }
+
+      float          min = 0.0f, mean = 0.0f, max = 0.0f;
+      stream_stats_t part;
+      if (fields[k].min < 0 || fields[k].mean < 0 || fields[k].max < 0 ||
+          !priv_retention_next(&s_cursors[fields[k].min], &integer, &min) ||
+          !priv_retention_next(&s_cursors[fields[k].mean], &integer, &mean) ||
+          !priv_retention_next(&s_cursors[fields[k].max], &integer, &max) ||
+          !isfinite(min) || !isfinite(mean) || !isfinite(max)) {
+        continue;
+      }
+      stream_stats_reset(&part);
+      part.count = (uint32_t)samples;
+      part.min   = min;
+      part.max   = max;
+      part.mean  = mean;
+      stream_stats_merge(&rollup->stats[k], &part);
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Appends the file at `source` to `target`, in paced chunks.
+ */
+static bool priv_retention_append(const char *source, const char *target)
+{
+  FILE *in  = fopen(source, "rb");
+  FILE *out = fopen(target, "ab");
+  bool  ok  = (in != NULL && out != NULL);
+
+  uint8_t *buffer = ok ? mem_policy_malloc(k_mem_policy_dma, retention_chunk_bytes) : NULL;
+  ok              = ok && (buffer != NULL);
+  while (ok) {
+    size_t got = priv_retention_read(in, buffer, retention_chunk_bytes);
+    ok         = priv_retention_write(out, buffer, got);
+    if (got < retention_chunk_bytes) {
+      break;
+    }
+  }
+
+  free(buffer);
+  if (in != NULL) {
+    fclose(in);
+  }
+  if (out != NULL && fclose(out) != 0) {
+    ok = false;
+  }
+  return ok;
+}
+
+/**
+ * @brief Rolls the segment at `source` up into `target` at `interval_us`
+ *        and deletes the segment.
+ *
+ * The rollup is built in a temporary file first, so an interrupted run leaves
+ * the segment in place to be rolled up again. A segment whose scan stops
+ * before its end (a corrupt or truncated block) is not deleted: the blocks
+ * read up to there are rolled up and the segment is renamed to
+ * `<source>.bad`, out of the retention scan, with the rest of its data.
+ */
+static esp_err_t priv_retention_compact(const char *source, const char *target, int64_t interval_us)
+{
+  char temporary[max_file_path_length + 4];
+  snprintf(temporary, sizeof(temporary), "%s.tmp", target);
+
+  FILE *in = fopen(source, "rb");
+  if (in == NULL) {
+    ESP_LOGE(retention_tag, "Failed to open %s", source);
+    return ESP_FAIL;
+  }
+  memset(&s_rollup, 0, sizeof(s_rollup));
+  s_rollup.file        = fopen(temporary, "wb");
+  s_rollup.interval_us = interval_us;
+  if (s_rollup.file == NULL) {
+    ESP_LOGE(retention_tag, "Failed to create %s", temporary);
+    fclose(in);
+    return ESP_FAIL;
+  }
+
+  bool ok         = true;
+  bool quarantine = false; /* The scan stopped before the end of the data */
+  while (ok) {
+    columnar_block_header_t header;
+    size_t got = priv_retention_read(in, (uint8_t *)&header, sizeof(header));
+    if (got == 0 || (got == sizeof(header) && header.magic == 0)) {
+      break; /* End of the file, or the zeroed terminator of an unclosed segment */
+    }
+    if (got < sizeof(header) || header.magic != columnar_block_magic ||
+        header.version != columnar_block_version || header.block_size < sizeof(header) ||
+        header.block_size > priv_retention_max_block_bytes(header.topic)) {
+      ESP_LOGW(retention_tag, "%s has a partial or unknown block", source);
+      quarantine = true;
+      break;
+    }
+
+    uint8_t *block = mem_policy_malloc(k_mem_policy_dma, header.block_size);
+    if (block == NULL) {
+      ESP_LOGE(retention_tag, "No memory for a %u byte block", (unsigned)header.block_size);
+      ok = false;
+      break;
+    }
+    memcpy(block, &header, sizeof(header));
+    size_t rest = header.block_size - sizeof(header);
+    if (priv_retention_read(in, block + sizeof(header), rest) != rest) {
+      ESP_LOGW(retention_tag, "%s ends in a partial block", source);
+      free(block);
+      quarantine = true;
+      break;
+    }
+    ok = priv_retention_add_block(&s_rollup, block, &header);
+    free(block);
+  }
+
+  ok = ok && priv_retention_emit(&s_rollup) && priv_retention_flush(&s_rollup);
+  free(s_rollup.block);
+  fclose(in);
+  if (fclose(s_rollup.file) != 0) {
+    ok = false;
+  }
+
+  /* A rollup may already exist if the segment was appended to after its first roll up */
+  struct stat st;
+  if (ok) {
+    ok = (stat(target, &st) == 0) ? priv_retention_append(temporary, target)
+                                  : (rename(temporary, target) == 0);
+  }
+  remove(temporary);
+  if (!ok) {
+    ESP_LOGE(retention_tag, "Failed to roll up %s", source);
+    return ESP_FAIL;
+  }
+
+  if (quarantine) {
+    char kept[max_file_path_length + 4];
+    snprintf(kept, sizeof(kept), "%s.bad", source);
+    if (rename(source, kept) != 0) {
+      ESP_LOGE(retention_tag, "Failed to set %s aside", source);
+      return ESP_FAIL;
+    }
+    ESP_LOGW(retention_tag, "Kept the unread rest of %s in %s", source, kept);
+    return ESP_OK;
+  }
+
+  remove(source);
+  return ESP_OK;
+}
+
+/**
+ * @brief Finds one segment old enough to move to its next level.
+ *
+ * @param[in] now Current wall-clock time.
+ * @param[out] source Path of the segment.
+ * @param[out] target Path of its rollup.
+ * @param[out] level Level of the rollup.
+ * @return false if there is none.
+ */
+static bool priv_retention_find(time_t now, char *source, char *target, size_t *level)
+{
+  DIR *dir = opendir(sd_card_mount);
+  if (dir == NULL) {
+    return false;
+  }
+
+  bool           found = false;
+  struct dirent *entry;
+  while (!found && (entry = readdir(dir)) != NULL) {
+    const char *name   = entry->d_name;
+    size_t      length = strlen(name);
+
+    /* Most specific suffix first, ".col" matches every level */
+    size_t current = retention_level_count;
+    while (current-- > 0) {
+      size_t suffix = strlen(retention_levels[current].suffix);
+      if (length > suffix && strcmp(name + length - suffix, retention_levels[current].suffix) == 0) {
+        break;
+      }
+    }
+    if (current >= retention_level_count || retention_levels[current].age_s == 0) {
+      continue;
+    }
+
+    int base = (int)(length - strlen(retention_levels[current].suffix));
+    if (memchr(name, '-', base) == NULL) {
+      continue; /* Written without retention, not a segment */
+    }
+
+    struct stat st;
+    snprintf(source, max_file_path_length, "%s/%s", sd_card_mount, name);
+    if (stat(source, &st) != 0 || now - st.st_mtime < (time_t)retention_levels[current].age_s) {
+      continue;
+    }
+
+    snprintf(target, max_file_path_length, "%s/%.*s%s", sd_card_mount, base, name,
+             retention_levels[current + 1].suffix);
+    *level = current + 1;
+    found  = true;
+  }
+
+  closedir(dir);
+  return found;
+}
+
+/**
+ * @brief Scans the card every `CONFIG_TOPOROBO_RETENTION_SCAN_S` and rolls up
+ *        every segment that has aged out of its level.
+ */
+static void priv_retention_task(void *param)
+{
+  char   source[max_file_path_length];
+  char   target[max_file_path_length];
+  size_t level;
+
+  while (1) {
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_TOPOROBO_RETENTION_SCAN_S * 1000));
+
+    time_t now = time(NULL);
+    if (now < retention_valid_time) {
+      continue; /* File ages are meaningless until the clock is set */
+    }
+
+    while (priv_retention_find(now, source, target, &level)) {
+      if (priv_retention_compact(source, target, retention_levels[level].interval_us) != ESP_OK) {
+        break; /* Retried on the next scan */
+      }
+      ESP_LOGI(retention_tag, "Rolled up %s into %s", source, target);
+    }
+  }
+}
+
+#endif /* CONFIG_TOPOROBO_RETENTION */
+
+/* Public Functions ***********************************************************/
+
+esp_err_t retention_manager_init(void)
+{
+#if CONFIG_TOPOROBO_RETENTION
+  if (priv_rtos_task_create(priv_retention_task, "Retention", retention_task_stack_bytes,
+                            NULL, retention_task_priority, NULL, retention_task_core_id,
+                            rtos_storage_ref(s_retention_task_storage)) != ESP_OK) {
+    ESP_LOGE(retention_tag, "Failed to create retention task");
+    return ESP_FAIL;
+  }
+
+  ESP_LOGI(retention_tag, "Rolling up segments older than %d h to 1 s and %d h to 1 min",
+           CONFIG_TOPOROBO_RETENTION_RAW_AGE_H, CONFIG_TOPOROBO_RETENTION_FINE_AGE_H);
+#endif
+  return ESP_OK;
+}
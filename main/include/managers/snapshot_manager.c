@@ -0,0 +1,319 @@
+/* main/include/managers/snapshot_manager.c */
+
+#include "snapshot_manager.h"
+#include <stdint.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "common/i2c.h"
+#include "common/power.h"
+#include "common/event_bus.h"
+#include "common/rtos_alloc.h"
+
+/* Macros *********************************************************************/
+
+#define snapshot_task_stack_bytes   (4096)
+#define snapshot_task_priority      (6)                   /* Above the sensor tasks */
+#define snapshot_task_core_id       (1)                   /* Acquisition core */
+#define snapshot_bus_timeout_ticks  (pdMS_TO_TICKS(100))  /* Wait for other bus traffic */
+#define snapshot_member_bit(member) (1U << (member))
+
+/* Globals (Constants) ********************************************************/
+
+const char *snapshot_tag = "SNAPSHOT";
+
+sensor_schema_define(snapshot, snapshot_record_t, "snapshot")
+
+#if CONFIG_TOPOROBO_SNAPSHOT_MODE
+
+/**
+ * @brief Members selected in menuconfig, as `snapshot_member_bit` flags.
+ */
+static const uint8_t snapshot_configured_members =
+#if CONFIG_TOPOROBO_SNAPSHOT_MPU6050
+  snapshot_member_bit(k_snapshot_member_mpu6050) |
+#endif
+#if CONFIG_TOPOROBO_SNAPSHOT_QMC5883L
+  snapshot_member_bit(k_snapshot_member_qmc5883l) |
+#endif
+#if CONFIG_TOPOROBO_SNAPSHOT_BH1750
+  snapshot_member_bit(k_snapshot_member_bh1750) |
+#endif
+  0;
+
+/* Globals (Static) ***********************************************************/
+
+static sensor_data_t     *s_sensor_data   = NULL;
+static TaskHandle_t       s_snapshot_task = NULL;
+static esp_timer_handle_t s_period_timer  = NULL;
+static esp_timer_handle_t s_settle_timer  = NULL;
+static uint32_t           s_sequence      = 0;
+
+rtos_task_storage_define(s_snapshot_task_storage, snapshot_task_stack_bytes);
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Returns the `*_data_t` of `member` inside the shared sensor data.
+ */
+static void *priv_snapshot_member_data(snapshot_member_t member)
+{
+  switch (member) {
+    case k_snapshot_member_mpu6050:  return &s_sensor_data->mpu6050_data;
+    case k_snapshot_member_qmc5883l: return &s_sensor_data->qmc5883l_data;
+    case k_snapshot_member_bh1750:   return &s_sensor_data->bh1750_data;
+    default:                         return NULL;
+  }
+}
+
+/**
+ * @brief Returns the I2C bus `member` is wired to.
+ */
+static uint8_t priv_snapshot_member_bus(snapshot_member_t member)
+{
+  switch (member) {
+    case k_snapshot_member_mpu6050:  return s_sensor_data->mpu6050_data.i2c_bus;
+    case k_snapshot_member_qmc5883l: return s_sensor_data->qmc5883l_data.i2c_bus;
+    case k_snapshot_member_bh1750:   return bh1750_i2c_bus;
+    default:                         return I2C_NUM_0;
+  }
+}
+
+/**
+ * @brief Locks every bus used by a member, in bus order.
+ *
+ * @return A mask of the locked buses, or 0 if one could not be taken in time
+ *         (nothing is left locked in that case).
+ */
+static uint32_t priv_snapshot_lock_buses(void)
+{
+  uint32_t buses = 0;
+  for (uint8_t member = 0; member < k_snapshot_member_count; member++) {
+    if (snapshot_configured_members & snapshot_member_bit(member)) {
+      buses |= 1U << priv_snapshot_member_bus((snapshot_member_t)member);
+    }
+  }
+
+  uint32_t locked = 0;
+  for (uint8_t bus = 0; bus < I2C_NUM_MAX; bus++) {
+    if ((buses & (1U << bus)) == 0) {
+      continue;
+    }
+    if (priv_i2c_bus_lock(bus, snapshot_bus_timeout_ticks) != ESP_OK) {
+      for (uint8_t held = 0; held < bus; held++) {
+        if (locked & (1U << held)) {
+          priv_i2c_bus_unlock(held);
+        }
+      }
+      return 0;
+    }
+    locked |= 1U << bus;
+  }
+  return locked;
+}
+
+/**
+ * @brief Reads every member back to back and publishes one record.
+ */
+static void priv_snapshot_sweep(uint8_t triggers)
+{
+  snapshot_record_t record = {
+    .sequence = s_sequence++,
+    .triggers = triggers,
+  };
+
+  uint32_t buses = priv_snapshot_lock_buses();
+  if (buses == 0) {
+    ESP_LOGW(snapshot_tag, "I2C bus busy, skipping snapshot %lu", (unsigned long)record.sequence);
+    return;
+  }
+  power_lock_acquire(k_power_lock_i2c);
+
+  /* Nothing but bus reads between the two timestamps */
+  int64_t start_us = esp_timer_get_time();
+
+  if ((snapshot_configured_members & snapshot_member_bit(k_snapshot_member_mpu6050)) &&
+      mpu6050_read(&s_sensor_data->mpu6050_data) == ESP_OK) {
+    record.valid_mask |= snapshot_member_bit(k_snapshot_member_mpu6050);
+  }
+  if ((snapshot_configured_members & snapshot_member_bit(k_snapshot_member_qmc5883l)) &&
+      qmc5883l_read(&s_sensor_data->qmc5883l_data) == ESP_OK) {
+    record.valid_mask |= snapshot_member_bit(k_snapshot_member_qmc5883l);
+  }
+  if ((snapshot_configured_members & snapshot_member_bit(k_snapshot_member_bh1750)) &&
+      bh1750_read(&s_sensor_data->bh1750_data) == ESP_OK) {
+    record.valid_mask |= snapshot_member_bit(k_snapshot_member_bh1750);
+  }
+
+  int64_t end_us = esp_timer_get_time();
+
+  power_lock_release(k_power_lock_i2c);
+  for (int8_t bus = I2C_NUM_MAX - 1; bus >= 0; bus--) {
+    if (buses & (1U << bus)) {
+      priv_i2c_bus_unlock(bus);
+    }
+  }
+
+  record.timestamp_us = start_us + (end_us - start_us) / 2;
+  record.sweep_us     = (uint32_t)(end_us - start_us);
+
+  if (record.valid_mask & snapshot_member_bit(k_snapshot_member_mpu6050)) {
+    const mpu6050_data_t *mpu6050 = &s_sensor_data->mpu6050_data;
+    record.accel[0] = mpu6050->accel_x;
+    record.accel[1] = mpu6050->accel_y;
+    record.accel[2] = mpu6050->accel_z;
+    record.gyro[0]  = mpu6050->gyro_x;
+    record.gyro[1]  = mpu6050->gyro_y;
+    record.gyro[2]  = mpu6050->gyro_z;
+  }
+  if (record.valid_mask & snapshot_member_bit(k_snapshot_member_qmc5883l)) {
+    const qmc5883l_data_t *qmc5883l = &s_sensor_data->qmc5883l_data;
+    record.mag[0]  = qmc5883l->mag_x;
+    record.mag[1]  = qmc5883l->mag_y;
+    record.mag[2]  = qmc5883l->mag_z;
+    record.heading = qmc5883l->heading;
+  }
+  if (record.valid_mask & snapshot_member_bit(k_snapshot_member_bh1750)) {
+    record.lux = s_sensor_data->bh1750_data.lux;
+  }
+
+  event_bus_publish_sample(k_event_bus_topic_snapshot, &record);
+
+  /* Re-initialization involves delays, so recover only after the bus is free */
+  if ((snapshot_configured_members & snapshot_member_bit(k_snapshot_member_mpu6050)) &&
+      !(record.valid_mask & snapshot_member_bit(k_snapshot_member_mpu6050))) {
+    mpu6050_reset_on_error(&s_sensor_data->mpu6050_data);
+  }
+  if ((snapshot_configured_members & snapshot_member_bit(k_snapshot_member_qmc5883l)) &&
+      !(record.valid_mask & snapshot_member_bit(k_snapshot_member_qmc5883l))) {
+    qmc5883l_reset_on_error(&s_sensor_data->qmc5883l_data);
+  }
+  if ((snapshot_configured_members & snapshot_member_bit(k_snapshot_member_bh1750)) &&
+      !(record.valid_mask & snapshot_member_bit(k_snapshot_member_bh1750))) {
+    bh1750_reset_on_error(&s_sensor_data->bh1750_data);
+  }
+}
+
+/**
+ * @brief Runs one sweep per batch of trigger notifications.
+ */
+static void priv_snapshot_task(void *param)
+{
+  uint32_t triggers = 0;
+
+  while (1) {
+    if (xTaskNotifyWait(0, UINT32_MAX, &triggers, portMAX_DELAY) == pdTRUE) {
+      priv_snapshot_sweep((uint8_t)triggers);
+    }
+  }
+}
+
+/**
+ * @brief esp_timer callback, `arg` carries the `snapshot_trigger_t` bit.
+ */
+static void priv_snapshot_timer_callback(void *arg)
+{
+  xTaskNotify(s_snapshot_task, (uint32_t)(uintptr_t)arg, eSetBits);
+}
+
+/**
+ * @brief Creates an esp_timer that notifies the snapshot task with `trigger`.
+ */
+static esp_err_t priv_snapshot_timer_create(const char *name, snapshot_trigger_t trigger,
+                                            esp_timer_handle_t *timer)
+{
+  const esp_timer_create_args_t args = {
+    .callback = priv_snapshot_timer_callback,
+    .arg      = (void *)(uintptr_t)trigger,
+    .name     = name,
+  };
+  return esp_timer_create(&args, timer);
+}
+
+#endif /* CONFIG_TOPOROBO_SNAPSHOT_MODE */
+
+/* Public Functions ***********************************************************/
+
+esp_err_t snapshot_manager_init(sensor_data_t *sensor_data)
+{
+#if CONFIG_TOPOROBO_SNAPSHOT_MODE
+  if (snapshot_configured_members == 0) {
+    ESP_LOGW(snapshot_tag, "Snapshot mode enabled without members, not started");
+    return ESP_OK;
+  }
+  s_sensor_data = sensor_data;
+
+  if (priv_rtos_task_create(priv_snapshot_task, "Snapshot", snapshot_task_stack_bytes, NULL,
+                            snapshot_task_priority, &s_snapshot_task, snapshot_task_core_id,
+                            rtos_storage_ref(s_snapshot_task_storage)) != ESP_OK) {
+    ESP_LOGE(snapshot_tag, "Failed to create snapshot task");
+    return ESP_FAIL;
+  }
+
+  if (CONFIG_TOPOROBO_SNAPSHOT_PERIOD_MS > 0) {
+    if (priv_snapshot_timer_create("snapshot_period", k_snapshot_trigger_timer,
+                                   &s_period_timer) != ESP_OK ||
+        esp_timer_start_periodic(s_period_timer,
+                                 CONFIG_TOPOROBO_SNAPSHOT_PERIOD_MS * 1000ULL) != ESP_OK) {
+      ESP_LOGE(snapshot_tag, "Failed to start snapshot timer");
+      return ESP_FAIL;
+    }
+  }
+
+  if (CONFIG_TOPOROBO_SNAPSHOT_SERVO_SETTLE_MS > 0) {
+    if (priv_snapshot_timer_create("snapshot_settle", k_snapshot_trigger_servo,
+                                   &s_settle_timer) != ESP_OK) {
+      ESP_LOGE(snapshot_tag, "Failed to create servo settle timer");
+      return ESP_FAIL;
+    }
+  }
+
+  ESP_LOGI(snapshot_tag, "Snapshot mode: members 0x%02x, period %d ms, servo settle %d ms",
+           snapshot_configured_members, CONFIG_TOPOROBO_SNAPSHOT_PERIOD_MS,
+           CONFIG_TOPOROBO_SNAPSHOT_SERVO_SETTLE_MS);
+#endif
+  return ESP_OK;
+}
+
+bool snapshot_manager_claims(const void *sensor_data)
+{
+#if CONFIG_TOPOROBO_SNAPSHOT_MODE
+  if (s_sensor_data == NULL) {
+    return false;
+  }
+  for (uint8_t member = 0; member < k_snapshot_member_count; member++) {
+    if ((snapshot_configured_members & snapshot_member_bit(member)) &&
+        priv_snapshot_member_data((snapshot_member_t)member) == sensor_data) {
+      return true;
+    }
+  }
+#endif
+  return false;
+}
+
+void snapshot_manager_trigger(void)
+{
+#if CONFIG_TOPOROBO_SNAPSHOT_MODE
+  if (s_snapshot_task != NULL) {
+    xTaskNotify(s_snapshot_task, k_snapshot_trigger_manual, eSetBits);
+  }
+#endif
+}
+
+void snapshot_manager_servo_moved(void)
+{
+#if CONFIG_TOPOROBO_SNAPSHOT_MODE
+  if (s_settle_timer != NULL) {
+    esp_timer_stop(s_settle_timer); /* Restart the settle time on every move */
+    esp_timer_start_once(s_settle_timer, CONFIG_TOPOROBO_SNAPSHOT_SERVO_SETTLE_MS * 1000ULL);
+  }
+#endif
+}
+
+char *snapshot_record_to_json(const snapshot_record_t *record)
+{
+  return sensor_schema_to_json(&snapshot_schema, record);
+}
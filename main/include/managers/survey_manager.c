@@ -0,0 +1,336 @@
+/* main/include/managers/survey_manager.c */
+
+#include "survey_manager.h"
+#include "sdkconfig.h"
+
+#if CONFIG_TOPOROBO_SURVEY_MODE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
+#include "cJSON.h"
+#include "esp32/ulp.h"
+#include "ulp_adc.h"
+#include "ulp_survey.h"
+#include "sensor_hal.h"
+#include "sd_card_hal.h"
+#include "time_manager.h"
+#include "webserver_tasks.h"
+#include "wifi_tasks.h"
+
+/* Macros *********************************************************************/
+
+#define survey_warm_state_magic       (0x53525659) /* "SRVY" */
+#define survey_gps_fix_timeout_ms     (90000)      /* Give up on a fix after this */
+#define survey_gps_position_acc_m     (10000)      /* Aiding position accuracy */
+#define survey_rtc_drift_ppm          (10000)      /* Worst case RTC drift in deep sleep */
+#define survey_time_resync_ms         (6 * 60 * 60 * 1000ULL)
+#define survey_bh1750_conversion_ms   (24)         /* Longest low resolution measurement */
+
+/* Globals (Constants) ********************************************************/
+
+const char *survey_tag = "SURVEY";
+
+extern const uint8_t ulp_survey_bin_start[] asm("_binary_ulp_survey_bin_start");
+extern const uint8_t ulp_survey_bin_end[]   asm("_binary_ulp_survey_bin_end");
+
+/* Globals (Static) ***********************************************************/
+
+static RTC_DATA_ATTR survey_warm_state_t s_warm_state;
+
+static bh1750_data_t     s_bh1750_data;
+static dht22_data_t      s_dht22_data;
+static gy_neo6mv2_data_t s_gps_data;
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Loads the ULP program and configures ADC1 for ULP sampling.
+ *
+ * Only needed on a cold boot; the program and the ADC configuration survive
+ * deep sleep.
+ */
+static esp_err_t priv_survey_load_ulp(void)
+{
+  esp_err_t ret = ulp_load_binary(0, ulp_survey_bin_start,
+                                  (ulp_survey_bin_end - ulp_survey_bin_start) / sizeof(uint32_t));
+  if (ret != ESP_OK) {
+    ESP_LOGE(survey_tag, "Failed to load ULP program: %s", esp_err_to_name(ret));
+    return ret;
+  }
+
+  /* Same channel and attenuation as the MQ135 HAL, so mq135_raw_to_ppm applies */
+  ulp_adc_cfg_t adc_cfg = {
+    .adc_n    = ADC_UNIT_1,
+    .channel  = ADC_CHANNEL_6,
+    .width    = ADC_BITWIDTH_DEFAULT,
+    .atten    = ADC_ATTEN_DB_12,
+    .ulp_mode = ADC_ULP_MODE_FSM,
+  };
+  ret = ulp_adc_init(&adc_cfg);
+  if (ret != ESP_OK) {
+    ESP_LOGE(survey_tag, "Failed to configure ULP ADC: %s", esp_err_to_name(ret));
+  }
+  return ret;
+}
+
+/**
+ * @brief Synchronizes system time over SNTP when it is missing or stale.
+ *
+ * `time_manager_init` falls back to a fixed default date when SNTP fails,
+ * which would throw away the time the RTC kept through deep sleep; in that
+ * case the previous time is restored.
+ */
+static void priv_survey_sync_time(void)
+{
+  if (s_warm_state.time_synced &&
+      s_warm_state.survey_ms - s_warm_state.time_sync_ms < survey_time_resync_ms) {
+    return;
+  }
+
+  struct timeval before;
+  gettimeofday(&before, NULL);
+  int64_t start_us = esp_timer_get_time();
+
+  if (time_manager_init() == ESP_OK) {
+    s_warm_state.time_synced  = true;
+    s_warm_state.time_sync_ms = s_warm_state.survey_ms;
+    return;
+  }
+
+  if (s_warm_state.time_synced) {
+    int64_t        elapsed_us = esp_timer_get_time() - start_us;
+    struct timeval restored   = {
+      .tv_sec  = before.tv_sec + (before.tv_usec + elapsed_us) / 1000000,
+      .tv_usec = (before.tv_usec + elapsed_us) % 1000000,
+    };
+    settimeofday(&restored, NULL);
+    ESP_LOGW(survey_tag, "SNTP resync failed, keeping RTC time");
+  }
+}
+
+/**
+ * @brief Powers up the GPS, aids it with the last fix and waits for a new one.
+ */
+static void priv_survey_refresh_gps(void)
+{
+  if (gy_neo6mv2_init(&s_gps_data) != ESP_OK) {
+    return;
+  }
+
+  if (s_warm_state.gps_fix_valid) {
+    time_t   now         = s_warm_state.time_synced ? time(NULL) : 0;
+    uint64_t since_ms    = s_warm_state.survey_ms - s_warm_state.time_sync_ms;
+    uint32_t time_acc_ms = 1000 + (uint32_t)(since_ms * survey_rtc_drift_ppm / 1000000);
+    gy_neo6mv2_send_aiding(s_warm_state.latitude, s_warm_state.longitude,
+                           survey_gps_position_acc_m, now, time_acc_ms);
+  }
+
+  TickType_t start = xTaskGetTickCount();
+  while (xTaskGetTickCount() - start < pdMS_TO_TICKS(survey_gps_fix_timeout_ms)) {
+    if (gy_neo6mv2_read(&s_gps_data) == ESP_OK && s_gps_data.fix_status) {
+      s_warm_state.gps_fix_valid = true;
+      s_warm_state.latitude      = s_gps_data.latitude;
+      s_warm_state.longitude     = s_gps_data.longitude;
+      s_warm_state.gps_fix_time  = time(NULL);
+      ESP_LOGI(survey_tag, "GPS fix after %" PRIu32 " ms",
+               (uint32_t)pdTICKS_TO_MS(xTaskGetTickCount() - start));
+      return;
+    }
+  }
+  ESP_LOGW(survey_tag, "No GPS fix within %d ms", survey_gps_fix_timeout_ms);
+}
+
+/**
+ * @brief Builds the JSON record for the batch the ULP just completed.
+ *
+ * @param[in] sample_count Number of ULP samples in the batch.
+ * @return A dynamically allocated JSON string, the caller frees it.
+ */
+static char *priv_survey_batch_to_json(uint32_t sample_count)
+{
+  cJSON *json = cJSON_CreateObject();
+  if (!json) {
+    ESP_LOGE(survey_tag, "Failed to create JSON object.");
+    return NULL;
+  }
+
+  cJSON_AddStringToObject(json, "sensor_type", "survey");
+  cJSON_AddNumberToObject(json, "wake", s_warm_state.wake_count);
+  cJSON_AddNumberToObject(json, "end_time", (double)time(NULL));
+  cJSON_AddBoolToObject(json, "time_synced", s_warm_state.time_synced);
+  cJSON_AddNumberToObject(json, "period_ms", CONFIG_TOPOROBO_SURVEY_SAMPLE_PERIOD_MS);
+
+  /* Readings taken before the heater warmed up are not meaningful */
+  bool mq135_warm = s_warm_state.survey_ms >= mq135_warmup_time_ms;
+  cJSON_AddBoolToObject(json, "mq135_warm", mq135_warm);
+  if (mq135_warm) {
+    cJSON *ppm = cJSON_AddArrayToObject(json, "mq135_ppm");
+    if (!ppm) {
+      ESP_LOGE(survey_tag, "Failed to add mq135_ppm to JSON.");
+      cJSON_Delete(json);
+      return NULL;
+    }
+    const uint32_t *samples = &ulp_samples;
+    for (uint32_t i = 0; i < sample_count; i++) {
+      cJSON_AddItemToArray(ppm, cJSON_CreateNumber(mq135_raw_to_ppm(samples[i] & 0xFFFF)));
+    }
+  }
+
+  /* Only a successful read this wake marks the data updated */
+  if (s_dht22_data.state == k_dht22_data_updated) {
+    cJSON_AddNumberToObject(json, "temperature_c", s_dht22_data.temperature_c);
+    cJSON_AddNumberToObject(json, "humidity", s_dht22_data.humidity);
+  }
+  if (s_bh1750_data.state == k_bh1750_data_updated) {
+    cJSON_AddNumberToObject(json, "lux", s_bh1750_data.lux);
+  }
+  if (s_warm_state.gps_fix_valid) {
+    cJSON_AddNumberToObject(json, "latitude", s_warm_state.latitude);
+    cJSON_AddNumberToObject(json, "longitude", s_warm_state.longitude);
+    cJSON_AddNumberToObject(json, "gps_fix_time", (double)s_warm_state.gps_fix_time);
+  }
+
+  char *json_string = cJSON_PrintUnformatted(json);
+  if (!json_string) {
+    ESP_LOGE(survey_tag, "Failed to serialize JSON object.");
+  }
+  cJSON_Delete(json);
+  return json_string;
+}
+
+/**
+ * @brief Appends one batch record to the survey file on the SD card.
+ */
+static esp_err_t priv_survey_write_sd(const char *json_string)
+{
+  if (sd_card_init() != ESP_OK) {
+    return ESP_FAIL;
+  }
+
+  FILE *file = fopen(CONFIG_TOPOROBO_SURVEY_PATH, "a");
+  if (file == NULL) {
+    ESP_LOGE(survey_tag, "Failed to open %s", CONFIG_TOPOROBO_SURVEY_PATH);
+    return ESP_FAIL;
+  }
+  bool ok = fputs(json_string, file) >= 0 && fputc('\n', file) != EOF;
+  fclose(file);
+
+  if (!ok) {
+    ESP_LOGE(survey_tag, "Failed to write survey record");
+    return ESP_FAIL;
+  }
+  return ESP_OK;
+}
+
+/**
+ * @brief Handles a ULP wake: reads the slow I2C/1-Wire sensors, stores and
+ *        uploads the batch.
+ */
+static void priv_survey_flush_batch(void)
+{
+  uint32_t sample_count = ulp_sample_count & 0xFFFF;
+  if (sample_count > CONFIG_TOPOROBO_SURVEY_BATCH_SAMPLES) {
+    sample_count = CONFIG_TOPOROBO_SURVEY_BATCH_SAMPLES;
+  }
+
+  s_warm_state.wake_count++;
+  s_warm_state.survey_ms += (uint64_t)sample_count * CONFIG_TOPOROBO_SURVEY_SAMPLE_PERIOD_MS;
+
+  /* Temperature, humidity and light change slowly, one reading per batch */
+  if (dht22_init(&s_dht22_data) == ESP_OK) {
+    dht22_read(&s_dht22_data);
+  }
+  if (bh1750_init(&s_bh1750_data) == ESP_OK) {
+    vTaskDelay(pdMS_TO_TICKS(survey_bh1750_conversion_ms)); /* First result after power on */
+    bh1750_read(&s_bh1750_data);
+  }
+
+  if (CONFIG_TOPOROBO_SURVEY_GPS_FIX_INTERVAL > 0 &&
+      (s_warm_state.wake_count - 1) % CONFIG_TOPOROBO_SURVEY_GPS_FIX_INTERVAL == 0) {
+    priv_survey_refresh_gps();
+  }
+
+  bool wifi_up = wifi_init_sta() == ESP_OK;
+  if (wifi_up) {
+    priv_survey_sync_time();
+  }
+
+  char *json_string = priv_survey_batch_to_json(sample_count);
+  if (json_string == NULL) {
+    return;
+  }
+
+  priv_survey_write_sd(json_string);
+  if (!wifi_up || send_sensor_data_to_webserver(json_string) != ESP_OK) {
+    s_warm_state.upload_failures++;
+    ESP_LOGW(survey_tag, "Batch %" PRIu32 " kept on SD only (%" PRIu32 " not uploaded)",
+             s_warm_state.wake_count, s_warm_state.upload_failures);
+  }
+  free(json_string);
+}
+
+/**
+ * @brief Resets the warm state and prepares the ULP after a cold boot.
+ */
+static esp_err_t priv_survey_cold_start(void)
+{
+  memset(&s_warm_state, 0, sizeof(s_warm_state));
+  s_warm_state.magic = survey_warm_state_magic;
+
+  if (wifi_init_sta() == ESP_OK) {
+    priv_survey_sync_time();
+  }
+
+  return priv_survey_load_ulp();
+}
+
+/* Public Functions ***********************************************************/
+
+void survey_manager_run(void)
+{
+  /* Wi-Fi keeps its calibration data in NVS */
+  esp_err_t ret = nvs_flash_init();
+  if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+    nvs_flash_erase();
+    nvs_flash_init();
+  }
+
+  if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_ULP &&
+      s_warm_state.magic == survey_warm_state_magic) {
+    priv_survey_flush_batch();
+  } else {
+    ESP_LOGI(survey_tag, "Cold boot, starting survey");
+    if (priv_survey_cold_start() != ESP_OK) {
+      ESP_LOGE(survey_tag, "Survey start failed, retrying after a sleep period");
+      esp_sleep_enable_timer_wakeup(CONFIG_TOPOROBO_SURVEY_SAMPLE_PERIOD_MS * 1000ULL);
+      esp_deep_sleep_start();
+    }
+  }
+
+  /* Restart the ULP on an empty batch; it stopped its own timer before waking us */
+  ulp_sample_count = 0;
+  ulp_set_wakeup_period(0, CONFIG_TOPOROBO_SURVEY_SAMPLE_PERIOD_MS * 1000);
+  esp_sleep_enable_ulp_wakeup();
+  ret = ulp_run(&ulp_entry - RTC_SLOW_MEM);
+  if (ret != ESP_OK) {
+    ESP_LOGE(survey_tag, "Failed to start ULP program: %s", esp_err_to_name(ret));
+    esp_sleep_enable_timer_wakeup(CONFIG_TOPOROBO_SURVEY_SAMPLE_PERIOD_MS * 1000ULL);
+  }
+
+  ESP_LOGI(survey_tag, "Sleeping, %.1f s survey time so far",
+           s_warm_state.survey_ms / 1000.0);
+  esp_deep_sleep_disable_rom_logging();
+  esp_deep_sleep_start();
+}
+
+#endif /* CONFIG_TOPOROBO_SURVEY_MODE */
@@ -0,0 +1,345 @@
+/* main/include/managers/system_monitor_manager.c */
+
+#include "system_monitor_manager.h"
+#include <string.h>
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "cJSON.h"
+#include "common/rtos_alloc.h"
+#include "common/metrics.h"
+
+/* Macros *********************************************************************/
+
+#define system_monitor_task_stack_bytes (4096)
+
+/* Globals (Constants) ********************************************************/
+
+const char    *system_monitor_tag              = "SYSTEM_MONITOR";
+const uint32_t system_monitor_period_ticks     = pdMS_TO_TICKS(10 * 1000);
+const uint32_t system_monitor_stack_warn_bytes = 512;
+
+/**
+ * @brief Capability masks sampled for each `system_monitor_heap_t` class.
+ */
+static const uint32_t system_monitor_heap_caps[k_system_monitor_heap_count] = {
+  MALLOC_CAP_INTERNAL, /* k_system_monitor_heap_internal */
+  MALLOC_CAP_DMA,      /* k_system_monitor_heap_dma */
+  MALLOC_CAP_SPIRAM,   /* k_system_monitor_heap_psram */
+};
+
+/**
+ * @brief Human readable names for each heap class, used in logs and JSON.
+ */
+static const char *system_monitor_heap_names[k_system_monitor_heap_count] = {
+  "internal",
+  "dma",
+  "psram",
+};
+
+/**
+ * @brief Metric labels for each heap class.
+ */
+static const char *system_monitor_heap_labels[k_system_monitor_heap_count] = {
+  "heap=\"internal\"",
+  "heap=\"dma\"",
+  "heap=\"psram\"",
+};
+
+/* Globals (Static) ***********************************************************/
+
+static SemaphoreHandle_t         s_snapshot_mutex = NULL; /**< Guards `s_snapshot` */
+static system_monitor_snapshot_t s_snapshot;              /**< Latest published snapshot */
+static system_monitor_snapshot_t s_sample;                /**< Snapshot being built by the task */
+static TaskStatus_t              s_task_status[system_monitor_max_tasks];
+
+rtos_semaphore_storage_define(s_snapshot_mutex_storage);
+rtos_task_storage_define(s_system_monitor_task_storage, system_monitor_task_stack_bytes);
+
+/**
+ * @brief Run time counters of the previous and the current sample, used to
+ *        compute deltas.
+ *
+ * Tasks are matched by handle; a task that is new in this sample reports its
+ * whole run time since creation as the delta. The task order changes from
+ * sample to sample, so the current sample is recorded in the other slot and
+ * the slots are swapped once every task has been looked up.
+ */
+static TaskHandle_t s_run_handles[2][system_monitor_max_tasks];
+static uint32_t     s_run_times[2][system_monitor_max_tasks];
+static uint8_t      s_run_counts[2]   = { 0, 0 };
+static uint8_t      s_prev_slot       = 0;
+static uint32_t     s_prev_total_time = 0;
+
+static metrics_gauge_t s_heap_free_metrics[k_system_monitor_heap_count];
+static metrics_gauge_t s_heap_minimum_free_metrics[k_system_monitor_heap_count];
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Looks up the run time a task had in the previous sample.
+ *
+ * @param[in] handle Handle of the task.
+ * @return The previous run time counter, or 0 if the task was not seen before.
+ */
+static uint32_t priv_system_monitor_prev_runtime(TaskHandle_t handle)
+{
+  for (uint8_t i = 0; i < s_run_counts[s_prev_slot]; i++) {
+    if (s_run_handles[s_prev_slot][i] == handle) {
+      return s_run_times[s_prev_slot][i];
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Samples every task and fills the task and core sections of `s_sample`.
+ */
+static void priv_system_monitor_sample_tasks(void)
+{
+  configRUN_TIME_COUNTER_TYPE total_time = 0;
+  UBaseType_t                 count      = uxTaskGetSystemState(s_task_status,
+                                                                system_monitor_max_tasks,
+                                                                &total_time);
+  uint32_t                    elapsed    = (uint32_t)total_time - s_prev_total_time;
+  uint8_t                     next_slot  = s_prev_slot ^ 1;
+
+  if (count == 0) {
+    /* The status array is too small; nothing is reported for this interval */
+    ESP_LOGW(system_monitor_tag, "More than %d tasks running, task stats skipped",
+             system_monitor_max_tasks);
+  }
+
+  s_sample.task_count = (uint8_t)count;
+  for (int core = 0; core < portNUM_PROCESSORS; core++) {
+    s_sample.core_load_percent[core] = 0.0f;
+  }
+
+  for (UBaseType_t i = 0; i < count; i++) {
+    TaskStatus_t                *status = &(s_task_status[i]);
+    system_monitor_task_stats_t *stats  = &(s_sample.tasks[i]);
+    uint32_t                     delta  = status->ulRunTimeCounter -
+                                          priv_system_monitor_prev_runtime(status->xHandle);
+
+    strncpy(stats->name, status->pcTaskName, sizeof(stats->name) - 1);
+    stats->name[sizeof(stats->name) - 1] = '\0';
+    stats->stack_high_water_mark         = status->usStackHighWaterMark;
+    stats->runtime                       = status->ulRunTimeCounter;
+    stats->cpu_percent                   = (elapsed > 0) ? (100.0f * delta) / elapsed : 0.0f;
+    stats->core_id                       = (status->xCoreID == tskNO_AFFINITY) ?
+                                           -1 : (int8_t)status->xCoreID;
+    stats->priority                      = (uint8_t)status->uxCurrentPriority;
+
+    /* The idle task of each core accounts for that core's free time */
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+      if (status->xHandle == xTaskGetIdleTaskHandleForCore(core)) {
+        s_sample.core_load_percent[core] = 100.0f - stats->cpu_percent;
+      }
+    }
+
+    s_run_handles[next_slot][i] = status->xHandle;
+    s_run_times[next_slot][i]   = status->ulRunTimeCounter;
+  }
+
+  s_run_counts[next_slot] = (uint8_t)count;
+  s_prev_slot             = next_slot;
+  s_prev_total_time       = (uint32_t)total_time;
+}
+
+/**
+ * @brief Samples every heap capability class into `s_sample`.
+ */
+static void priv_system_monitor_sample_heaps(void)
+{
+  for (uint8_t i = 0; i < k_system_monitor_heap_count; i++) {
+    system_monitor_heap_stats_t *heap = &(s_sample.heaps[i]);
+    uint32_t                     caps = system_monitor_heap_caps[i];
+
+    heap->total_bytes        = heap_caps_get_total_size(caps);
+    heap->free_bytes         = heap_caps_get_free_size(caps);
+    heap->minimum_free_bytes = heap_caps_get_minimum_free_size(caps);
+    heap->largest_free_block = heap_caps_get_largest_free_block(caps);
+
+    metrics_gauge_set(&s_heap_free_metrics[i], heap->free_bytes);
+    metrics_gauge_set(&s_heap_minimum_free_metrics[i], heap->minimum_free_bytes);
+  }
+}
+
+/**
+ * @brief Logs the sample held in `s_sample`.
+ *
+ * Tasks whose stack high-water mark is under `system_monitor_stack_warn_bytes`
+ * are logged as warnings.
+ */
+static void priv_system_monitor_log(void)
+{
+  for (int core = 0; core < portNUM_PROCESSORS; core++) {
+    ESP_LOGI(system_monitor_tag, "Core %d load: %.1f%%", core,
+             s_sample.core_load_percent[core]);
+  }
+
+  for (uint8_t i = 0; i < s_sample.task_count; i++) {
+    system_monitor_task_stats_t *stats = &(s_sample.tasks[i]);
+
+    if (stats->stack_high_water_mark < system_monitor_stack_warn_bytes) {
+      ESP_LOGW(system_monitor_tag, "Task %-16s stack free: %5lu B (low), cpu: %5.1f%%, core: %d",
+               stats->name, (unsigned long)stats->stack_high_water_mark,
+               stats->cpu_percent, stats->core_id);
+    } else {
+      ESP_LOGI(system_monitor_tag, "Task %-16s stack free: %5lu B, cpu: %5.1f%%, core: %d",
+               stats->name, (unsigned long)stats->stack_high_water_mark,
+               stats->cpu_percent, stats->core_id);
+    }
+  }
+
+  for (uint8_t i = 0; i < k_system_monitor_heap_count; i++) {
+    system_monitor_heap_stats_t *heap = &(s_sample.heaps[i]);
+    if (heap->total_bytes == 0) {
+      continue; /* e.g. no PSRAM fitted */
+    }
+    ESP_LOGI(system_monitor_tag, "Heap %-8s free: %u, min free: %u, largest block: %u, total: %u",
+             system_monitor_heap_names[i], (unsigned)heap->free_bytes,
+             (unsigned)heap->minimum_free_bytes, (unsigned)heap->largest_free_block,
+             (unsigned)heap->total_bytes);
+  }
+}
+
+/**
+ * @brief System monitor task, samples and publishes stats periodically.
+ */
+static void priv_system_monitor_task(void *param)
+{
+  TickType_t last_wake = xTaskGetTickCount();
+
+  while (1) {
+    s_sample.uptime_ms = pdTICKS_TO_MS(xTaskGetTickCount());
+    priv_system_monitor_sample_tasks();
+    priv_system_monitor_sample_heaps();
+    priv_system_monitor_log();
+
+    if (xSemaphoreTake(s_snapshot_mutex, portMAX_DELAY) == pdTRUE) {
+      memcpy(&s_snapshot, &s_sample, sizeof(s_snapshot));
+      xSemaphoreGive(s_snapshot_mutex);
+    }
+
+    vTaskDelayUntil(&last_wake, system_monitor_period_ticks);
+  }
+}
+
+/* Public Functions ***********************************************************/
+
+esp_err_t system_monitor_init(void)
+{
+  s_snapshot_mutex = priv_rtos_mutex_create(rtos_storage_ref(s_snapshot_mutex_storage));
+  if (s_snapshot_mutex == NULL) {
+    ESP_LOGE(system_monitor_tag, "Failed to create snapshot mutex");
+    return ESP_FAIL;
+  }
+
+  for (uint8_t i = 0; i < k_system_monitor_heap_count; i++) {
+    metrics_gauge_register(&s_heap_free_metrics[i], "toporobo_heap_free_bytes",
+                           "Free bytes per heap capability class.",
+                           system_monitor_heap_labels[i]);
+    metrics_gauge_register(&s_heap_minimum_free_metrics[i], "toporobo_heap_minimum_free_bytes",
+                           "Lowest free bytes since boot per heap capability class.",
+                           system_monitor_heap_labels[i]);
+  }
+
+  /* Lowest non-idle priority on the processing core so sampling never delays
+   * acquisition */
+  esp_err_t ret = priv_rtos_task_create(priv_system_monitor_task, "SystemMonitor",
+                                        system_monitor_task_stack_bytes, NULL, 1, NULL, 0,
+                                        rtos_storage_ref(s_system_monitor_task_storage));
+  if (ret != ESP_OK) {
+    ESP_LOGE(system_monitor_tag, "Failed to create system monitor task");
+    return ESP_FAIL;
+  }
+
+  ESP_LOGI(system_monitor_tag, "System monitor started");
+  return ESP_OK;
+}
+
+esp_err_t system_monitor_get_snapshot(system_monitor_snapshot_t *snapshot)
+{
+  if (snapshot == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (s_snapshot_mutex == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  if (xSemaphoreTake(s_snapshot_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+    return ESP_ERR_TIMEOUT;
+  }
+  memcpy(snapshot, &s_snapshot, sizeof(*snapshot));
+  xSemaphoreGive(s_snapshot_mutex);
+  return ESP_OK;
+}
+
+char *system_monitor_snapshot_to_json(const system_monitor_snapshot_t *snapshot)
+{
+  cJSON *json = cJSON_CreateObject();
+  if (!json) {
+    ESP_LOGE(system_monitor_tag, "Failed to create JSON object.");
+    return NULL;
+  }
+
+  cJSON_AddNumberToObject(json, "uptime_ms", snapshot->uptime_ms);
+
+  cJSON *cores = cJSON_AddArrayToObject(json, "core_load_percent");
+  cJSON *tasks = cJSON_AddArrayToObject(json, "tasks");
+  cJSON *heaps = cJSON_AddObjectToObject(json, "heaps");
+  if (!cores || !tasks || !heaps) {
+    ESP_LOGE(system_monitor_tag, "Failed to add sections to JSON.");
+    cJSON_Delete(json);
+    return NULL;
+  }
+
+  for (int core = 0; core < portNUM_PROCESSORS; core++) {
+    cJSON_AddItemToArray(cores, cJSON_CreateNumber(snapshot->core_load_percent[core]));
+  }
+
+  for (uint8_t i = 0; i < snapshot->task_count; i++) {
+    const system_monitor_task_stats_t *stats = &(snapshot->tasks[i]);
+    cJSON                             *task  = cJSON_CreateObject();
+    if (!task) {
+      ESP_LOGE(system_monitor_tag, "Failed to create task JSON object.");
+      cJSON_Delete(json);
+      return NULL;
+    }
+    cJSON_AddStringToObject(task, "name", stats->name);
+    cJSON_AddNumberToObject(task, "stack_high_water_mark", stats->stack_high_water_mark);
+    cJSON_AddNumberToObject(task, "runtime", stats->runtime);
+    cJSON_AddNumberToObject(task, "cpu_percent", stats->cpu_percent);
+    cJSON_AddNumberToObject(task, "core_id", stats->core_id);
+    cJSON_AddNumberToObject(task, "priority", stats->priority);
+    cJSON_AddItemToArray(tasks, task);
+  }
+
+  for (uint8_t i = 0; i < k_system_monitor_heap_count; i++) {
+    const system_monitor_heap_stats_t *stats = &(snapshot->heaps[i]);
+    cJSON                             *heap  = cJSON_AddObjectToObject(heaps,
+                                                                       system_monitor_heap_names[i]);
+    if (!heap) {
+      ESP_LOGE(system_monitor_tag, "Failed to add heap %s to JSON.",
+               system_monitor_heap_names[i]);
+      cJSON_Delete(json);
+      return NULL;
+    }
+    cJSON_AddNumberToObject(heap, "total_bytes", stats->total_bytes);
+    cJSON_AddNumberToObject(heap, "free_bytes", stats->free_bytes);
+    cJSON_AddNumberToObject(heap, "minimum_free_bytes", stats->minimum_free_bytes);
+    cJSON_AddNumberToObject(heap, "largest_free_block", stats->largest_free_block);
+  }
+
+  char *json_string = cJSON_PrintUnformatted(json);
+  if (!json_string) {
+    ESP_LOGE(system_monitor_tag, "Failed to serialize JSON object.");
+    cJSON_Delete(json);
+    return NULL;
+  }
+
+  cJSON_Delete(json);
+  return json_string;
+}
@@ -0,0 +1,597 @@
+/* main/include/managers/telemetry_manager.c */
+
+#include "telemetry_manager.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+#include "sensor_hal.h"
+#include "sensor_schema.h"
+#include "snapshot_manager.h"
+#include "aggregation_manager.h"
+#include "common/mem_policy.h"
+#include "common/rtos_alloc.h"
+#include "common/report_filter.h"
+#include "file_write_manager.h"
+#include "sd_card_hal.h"
+#include "webserver_tasks.h"
+#include "columnar_manager.h"
+
+/* Macros *********************************************************************/
+
+#define telemetry_queue_length      (16)
+#define telemetry_task_stack_bytes  (4096)
+#define telemetry_csv_row_bytes     (256)
+#define telemetry_stale_check_ms    (1000) /* Columnar blocks of quiet topics */
+#define telemetry_format_bit(format) (1UL << (format))
+#define telemetry_channel(type, field, value_type, abs_deadband, rel_deadband) \
+  { offsetof(type, field), (value_type), (abs_deadband), (rel_deadband) }
+
+/* Globals (Constants) ********************************************************/
+
+const char *telemetry_tag = "TELEMETRY";
+
+/**
+ * @brief Name and accepted formats of each `telemetry_sink_t`.
+ */
+static const struct {
+  const char *name;
+  uint32_t    formats;
+} telemetry_sinks[k_telemetry_sink_count] = {
+  { "http",     telemetry_format_bit(k_telemetry_format_json) },   /* k_telemetry_sink_http */
+  { "sd",       telemetry_format_bit(k_telemetry_format_json) |
+                telemetry_format_bit(k_telemetry_format_binary) |
+                telemetry_format_bit(k_telemetry_format_csv) },    /* k_telemetry_sink_sd */
+  { "live",     telemetry_format_bit(k_telemetry_format_json) },   /* k_telemetry_sink_live */
+  { "columnar", telemetry_format_bit(k_telemetry_format_binary) }, /* k_telemetry_sink_columnar */
+};
+
+/**
+ * @brief Routing rules. Every sample goes to the web server and the live view
+ *        as JSON; the SD card keeps compact binary records, thinned out for
+ *        the fast IMU and magnetometer streams, window summaries as JSON
+ *        lines, and the slow light and climate streams also as CSV tables
+ *        that open straight in a spreadsheet. With `CONFIG_TOPOROBO_AGGREGATION_RAW_LOCAL_ONLY`, raw samples
+ *        of aggregated topics only take their SD card route. The columnar
+ *        export, when enabled, gets every sample the report filter lets
+ *        through, without decimation; like every route it does not see the
+ *        samples the filter suppresses.
+ */
+static const telemetry_route_t telemetry_routes[] = {
+  /* Topic                        Sink                   Format                     Decimation */
+  { k_event_bus_topic_bh1750,     k_telemetry_sink_http, k_telemetry_format_json,   1  },
+  { k_event_bus_topic_bh1750,     k_telemetry_sink_live, k_telemetry_format_json,   1  },
+  { k_event_bus_topic_bh1750,     k_telemetry_sink_sd,   k_telemetry_format_binary, 1  },
+  { k_event_bus_topic_bh1750,     k_telemetry_sink_sd,   k_telemetry_format_csv,    1  },
+  { k_event_bus_topic_qmc5883l,   k_telemetry_sink_http, k_telemetry_format_json,   1  },
+  { k_event_bus_topic_qmc5883l,   k_telemetry_sink_live, k_telemetry_format_json,   1  },
+  { k_event_bus_topic_qmc5883l,   k_telemetry_sink_sd,   k_telemetry_format_binary, 10 },
+  { k_event_bus_topic_mpu6050,    k_telemetry_sink_http, k_telemetry_format_json,   1  },
+  { k_event_bus_topic_mpu6050,    k_telemetry_sink_live, k_telemetry_format_json,   1  },
+  { k_event_bus_topic_mpu6050,    k_telemetry_sink_sd,   k_telemetry_format_binary, 10 },
+  { k_event_bus_topic_dht22,      k_telemetry_sink_http, k_telemetry_format_json,   1  },
+  { k_event_bus_topic_dht22,      k_telemetry_sink_live, k_telemetry_format_json,   1  },
+  { k_event_bus_topic_dht22,      k_telemetry_sink_sd,   k_telemetry_format_binary, 1  },
+  { k_event_bus_topic_dht22,      k_telemetry_sink_sd,   k_telemetry_format_csv,    1  },
+  { k_event_bus_topic_gy_neo6mv2, k_telemetry_sink_http, k_telemetry_format_json,   1  },
+  { k_event_bus_topic_gy_neo6mv2, k_telemetry_sink_live, k_telemetry_format_json,   1  },
+  { k_event_bus_topic_gy_neo6mv2, k_telemetry_sink_sd,   k_telemetry_format_binary, 1  },
+  { k_event_bus_topic_ccs811,     k_telemetry_sink_http, k_telemetry_format_json,   1  },
+  { k_event_bus_topic_ccs811,     k_telemetry_sink_live, k_telemetry_format_json,   1  },
+  { k_event_bus_topic_ccs811,     k_telemetry_sink_sd,   k_telemetry_format_binary, 1  },
+  { k_event_bus_topic_mq135,      k_telemetry_sink_http, k_telemetry_format_json,   1  },
+  { k_event_bus_topic_mq135,      k_telemetry_sink_live, k_telemetry_format_json,   1  },
+  { k_event_bus_topic_mq135,      k_telemetry_sink_sd,   k_telemetry_format_binary, 1  },
+  { k_event_bus_topic_snapshot,   k_telemetry_sink_http, k_telemetry_format_json,   1  },
+  { k_event_bus_topic_snapshot,   k_telemetry_sink_live, k_telemetry_format_json,   1  },
+  { k_event_bus_topic_snapshot,   k_telemetry_sink_sd,   k_telemetry_format_binary, 1  },
+  { k_event_bus_topic_summary,    k_telemetry_sink_http, k_telemetry_format_json,   1  },
+  { k_event_bus_topic_summary,    k_telemetry_sink_live, k_telemetry_format_json,   1  },
+  { k_event_bus_topic_summary,    k_telemetry_sink_sd,   k_telemetry_format_json,   1  },
+#if CONFIG_TOPOROBO_COLUMNAR_EXPORT
+  { k_event_bus_topic_bh1750,     k_telemetry_sink_columnar, k_telemetry_format_binary, 1 },
+  { k_event_bus_topic_qmc5883l,   k_telemetry_sink_columnar, k_telemetry_format_binary, 1 },
+  { k_event_bus_topic_mpu6050,    k_telemetry_sink_columnar, k_telemetry_format_binary, 1 },
+  { k_event_bus_topic_dht22,      k_telemetry_sink_columnar, k_telemetry_format_binary, 1 },
+  { k_event_bus_topic_gy_neo6mv2, k_telemetry_sink_columnar, k_telemetry_format_binary, 1 },
+  { k_event_bus_topic_ccs811,     k_telemetry_sink_columnar, k_telemetry_format_binary, 1 },
+  { k_event_bus_topic_mq135,      k_telemetry_sink_columnar, k_telemetry_format_binary, 1 },
+  { k_event_bus_topic_snapshot,   k_telemetry_sink_columnar, k_telemetry_format_binary, 1 },
+#endif
+};
+
+#define telemetry_route_count (sizeof(telemetry_routes) / sizeof(telemetry_routes[0]))
+
+/**
+ * @brief Deadbands of the slow environmental streams. A `state` channel with
+ *        no deadband reports every state change (e.g. a sensor going into
+ *        error) immediately. With both deadbands set the wider one applies,
+ *        e.g. lux reports on 5 lux below 100 lux and on 5 % above it.
+ */
+static const report_filter_channel_t telemetry_bh1750_channels[] = {
+  telemetry_channel(bh1750_data_t, lux, k_report_filter_float, 5.0f, 0.05f),
+  telemetry_channel(bh1750_data_t, state, k_report_filter_uint8, 0.0f, 0.0f),
+};
+
+static const report_filter_channel_t telemetry_dht22_channels[] = {
+  telemetry_channel(dht22_data_t, temperature_c, k_report_filter_float, 0.2f, 0.0f),
+  telemetry_channel(dht22_data_t, humidity, k_report_filter_float, 1.0f, 0.0f),
+  telemetry_channel(dht22_data_t, state, k_report_filter_uint8, 0.0f, 0.0f),
+};
+
+static const report_filter_channel_t telemetry_gy_neo6mv2_channels[] = {
+  telemetry_channel(gy_neo6mv2_data_t, latitude, k_report_filter_float, 0.00005f, 0.0f), /* ~5 m */
+  telemetry_channel(gy_neo6mv2_data_t, longitude, k_report_filter_float, 0.00005f, 0.0f),
+  telemetry_channel(gy_neo6mv2_data_t, fix_status, k_report_filter_uint8, 0.0f, 0.0f),
+};
+
+static const report_filter_channel_t telemetry_ccs811_channels[] = {
+  telemetry_channel(ccs811_data_t, eco2, k_report_filter_uint16, 25.0f, 0.05f),
+  telemetry_channel(ccs811_data_t, tvoc, k_report_filter_uint16, 10.0f, 0.05f),
+  telemetry_channel(ccs811_data_t, state, k_report_filter_uint8, 0.0f, 0.0f),
+};
+
+static const report_filter_channel_t telemetry_mq135_channels[] = {
+  telemetry_channel(mq135_data_t, gas_concentration, k_report_filter_float, 5.0f, 0.05f),
+  telemetry_channel(mq135_data_t, state, k_report_filter_uint8, 0.0f, 0.0f),
+};
+
+#define telemetry_channels(table) (table), (sizeof(table) / sizeof((table)[0]))
+
+/**
+ * @brief Reporting policy of each topic, applied before routing. A sample is
+ *        routed only if a channel left its deadband or nothing was reported
+ *        for `max_silence_ms`. Topics without channels (the IMU, the
+ *        magnetometer, snapshots and summaries) report every sample.
+ */
+static const struct {
+  const report_filter_channel_t *channels;
+  uint8_t                        channel_count;
+  uint32_t                       max_silence_ms;
+} telemetry_policies[k_event_bus_topic_count] = {
+  [k_event_bus_topic_bh1750]     = { telemetry_channels(telemetry_bh1750_channels),     60000 },
+  [k_event_bus_topic_dht22]      = { telemetry_channels(telemetry_dht22_channels),      60000 },
+  [k_event_bus_topic_gy_neo6mv2] = { telemetry_channels(telemetry_gy_neo6mv2_channels), 30000 },
+  [k_event_bus_topic_ccs811]     = { telemetry_channels(telemetry_ccs811_channels),     60000 },
+  [k_event_bus_topic_mq135]      = { telemetry_channels(telemetry_mq135_channels),      60000 },
+};
+
+/* Globals (Static) ***********************************************************/
+
+static QueueHandle_t       s_telemetry_queue = NULL;
+static uint32_t            s_route_counts[telemetry_route_count];  /* Router task only */
+static telemetry_buffer_t *s_live[k_event_bus_topic_count];        /* Guarded by s_lock */
+static report_filter_t     s_filters[k_event_bus_topic_count];     /* Router task only */
+static telemetry_stats_t   s_stats;                                /* Guarded by s_lock */
+static bool                s_csv_started[k_event_bus_topic_count]; /* Router task only */
+static portMUX_TYPE        s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+rtos_queue_storage_define(s_telemetry_queue_storage, telemetry_queue_length,
+                          sizeof(event_bus_msg_t *));
+rtos_task_storage_define(s_telemetry_task_storage, telemetry_task_stack_bytes);
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Encodes `msg` into `buffer->data` with its topic's schema.
+ *
+ * Topics without a schema fall back to their own JSON encoder and, for the
+ * binary format, the raw struct; they have no CSV form.
+ */
+static void priv_telemetry_encode_payload(const event_bus_msg_t *msg, const sensor_schema_t *schema,
+                                          telemetry_format_t format, telemetry_buffer_t *buffer)
+{
+  buffer->data   = NULL;
+  buffer->length = 0;
+
+  switch (format) {
+    case k_telemetry_format_json: {
+      char *json = NULL;
+      if (schema != NULL) {
+        json = sensor_schema_to_json(schema, msg->payload);
+      } else if (msg->topic == k_event_bus_topic_summary) {
+        json = aggregation_summary_to_json((const aggregation_summary_t *)msg->payload);
+      }
+      buffer->data   = (uint8_t *)json;
+      buffer->length = (json != NULL) ? strlen(json) : 0;
+      break;
+    }
+    case k_telemetry_format_binary: {
+      size_t payload_size = (schema != NULL) ? schema->binary_size : msg->size;
+      buffer->data        = mem_policy_malloc(k_mem_policy_internal,
+                                              sizeof(telemetry_binary_header_t) + payload_size);
+      if (buffer->data == NULL) {
+        return;
+      }
+      if (schema != NULL) {
+        payload_size = sensor_schema_to_binary(schema, msg->payload,
+                                               buffer->data + sizeof(telemetry_binary_header_t),
+                                               payload_size);
+      } else {
+        memcpy(buffer->data + sizeof(telemetry_binary_header_t), msg->payload, payload_size);
+      }
+      telemetry_binary_header_t header = {
+        .topic        = msg->topic,
+        .reserved     = 0,
+        .size         = payload_size,
+        .timestamp_us = msg->timestamp_us,
+      };
+      memcpy(buffer->data, &header, sizeof(header));
+      buffer->length = sizeof(header) + payload_size;
+      break;
+    }
+    case k_telemetry_format_csv: {
+      if (schema == NULL) {
+        return;
+      }
+      size_t size  = telemetry_csv_row_bytes;
+      buffer->data = mem_policy_malloc(k_mem_policy_internal, size);
+      if (buffer->data == NULL) {
+        return;
+      }
+      int prefix = snprintf((char *)buffer->data, size, "%" PRId64 ",", msg->timestamp_us);
+      size_t row = sensor_schema_to_csv(schema, msg->payload, (char *)buffer->data + prefix,
+                                        size - prefix);
+      buffer->length = (row > 0) ? prefix + row : 0;
+      if (buffer->length == 0) {
+        free(buffer->data);
+        buffer->data = NULL;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+/**
+ * @brief Encodes `msg` into a new buffer holding one reference for the caller.
+ *
+ * @return The buffer, or NULL if encoding or allocation failed.
+ */
+static telemetry_buffer_t *priv_telemetry_encode(const event_bus_msg_t *msg,
+                                                 telemetry_format_t format)
+{
+  telemetry_buffer_t *buffer = mem_policy_malloc(k_mem_policy_internal, sizeof(telemetry_buffer_t));
+  if (buffer == NULL) {
+    return NULL;
+  }
+
+  priv_telemetry_encode_payload(msg, telemetry_manager_schema(msg->topic), format, buffer);
+  if (buffer->data == NULL) {
+    free(buffer);
+    return NULL;
+  }
+
+  buffer->timestamp_us = msg->timestamp_us;
+  buffer->topic        = msg->topic;
+  buffer->format       = format;
+  buffer->refs         = 1;
+  return buffer;
+}
+
+/**
+ * @brief Queues the header row of `path` ahead of the topic's first CSV row
+ *        since boot, unless the file already has one.
+ *
+ * The file writer appends in queue order, so the header lands first even
+ * though the file does not exist yet when the row is queued.
+ */
+static esp_err_t priv_telemetry_csv_header(event_bus_topic_t topic, const char *path)
+{
+  struct stat info;
+  char        header[telemetry_csv_row_bytes];
+
+  if (s_csv_started[topic]) {
+    return ESP_OK;
+  }
+  if (stat(path, &info) == 0 && info.st_size > 0) {
+    s_csv_started[topic] = true;
+    return ESP_OK;
+  }
+
+  int    prefix = snprintf(header, sizeof(header), "timestamp_us,");
+  size_t length = sensor_schema_csv_header(telemetry_manager_schema(topic), header + prefix,
+                                           sizeof(header) - prefix);
+  if (length == 0) {
+    ESP_LOGE(telemetry_tag, "CSV header of %s does not fit", event_bus_topic_name(topic));
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  esp_err_t ret = file_write_enqueue_bytes(path, header, prefix + length);
+  if (ret == ESP_OK) {
+    s_csv_started[topic] = true;
+  }
+  return ret;
+}
+
+/**
+ * @brief Appends a buffer to `<topic>.txt` (JSON), `<topic>.bin` (binary) or
+ *        `<topic>.csv` (CSV) on the SD card. A new CSV file starts with its
+ *        header row.
+ */
+static esp_err_t priv_telemetry_sd_deliver(telemetry_buffer_t *buffer)
+{
+  static const char *extensions[k_telemetry_format_count] = { "txt", "bin", "csv" };
+  char               path[max_file_path_length];
+
+  snprintf(path, sizeof(path), "%s/%s.%s", sd_card_mount,
+           event_bus_topic_name(buffer->topic), extensions[buffer->format]);
+  if (buffer->format == k_telemetry_format_csv) {
+    esp_err_t ret = priv_telemetry_csv_header(buffer->topic, path);
+    if (ret != ESP_OK) {
+      return ret; /* A row without its header would be unreadable */
+    }
+  }
+  return (buffer->format == k_telemetry_format_json)
+         ? file_write_enqueue(path, (const char *)buffer->data)
+         : file_write_enqueue_bytes(path, buffer->data, buffer->length);
+}
+
+/**
+ * @brief Replaces the live-view sample for the buffer's topic.
+ */
+static esp_err_t priv_telemetry_live_deliver(telemetry_buffer_t *buffer)
+{
+  telemetry_buffer_retain(buffer);
+
+  portENTER_CRITICAL(&s_lock);
+  telemetry_buffer_t *previous = s_live[buffer->topic];
+  s_live[buffer->topic]        = buffer;
+  portEXIT_CRITICAL(&s_lock);
+
+  telemetry_buffer_release(previous);
+  return ESP_OK;
+}
+
+/**
+ * @brief Hands `buffer` to `sink`.
+ *
+ * The buffer is borrowed for the call; a sink that keeps it takes its own
+ * reference.
+ */
+static esp_err_t priv_telemetry_deliver(telemetry_sink_t sink, telemetry_buffer_t *buffer)
+{
+  switch (sink) {
+    case k_telemetry_sink_http:     return webserver_tasks_enqueue(buffer);
+    case k_telemetry_sink_sd:       return priv_telemetry_sd_deliver(buffer);
+    case k_telemetry_sink_live:     return priv_telemetry_live_deliver(buffer);
+    case k_telemetry_sink_columnar: return columnar_manager_append(buffer);
+    default:                        return ESP_ERR_INVALID_ARG;
+  }
+}
+
+/**
+ * @brief Routes one bus message, encoding it at most once per format.
+ */
+static void priv_telemetry_route(const event_bus_msg_t *msg)
+{
+  telemetry_buffer_t *encoded[k_telemetry_format_count] = { NULL };
+  telemetry_stats_t   delta                             = { .samples = 1 };
+
+  if (!report_filter_check(&s_filters[msg->topic], msg->payload, msg->timestamp_us)) {
+    portENTER_CRITICAL(&s_lock);
+    s_stats.samples++;
+    s_stats.suppressed++;
+    portEXIT_CRITICAL(&s_lock);
+    return;
+  }
+
+  for (size_t i = 0; i < telemetry_route_count; i++) {
+    const telemetry_route_t *route = &telemetry_routes[i];
+    if (route->topic != msg->topic) {
+      continue;
+    }
+    if (route->sink != k_telemetry_sink_sd && aggregation_manager_raw_local_only(msg->topic)) {
+      continue; /* Only the summaries leave the robot */
+    }
+    if (s_route_counts[i]++ % route->decimation != 0) {
+      delta.decimated++;
+      continue;
+    }
+
+    if (encoded[route->format] == NULL) {
+      encoded[route->format] = priv_telemetry_encode(msg, route->format);
+      if (encoded[route->format] == NULL) {
+        delta.failures++;
+        continue;
+      }
+      delta.encodes++;
+    }
+
+    if (priv_telemetry_deliver(route->sink, encoded[route->format]) == ESP_OK) {
+      delta.deliveries++;
+    } else {
+      delta.failures++;
+    }
+  }
+
+  for (uint8_t i = 0; i < k_telemetry_format_count; i++) {
+    telemetry_buffer_release(encoded[i]); /* The router's own reference */
+  }
+
+  portENTER_CRITICAL(&s_lock);
+  s_stats.samples    += delta.samples;
+  s_stats.encodes    += delta.encodes;
+  s_stats.deliveries += delta.deliveries;
+  s_stats.decimated  += delta.decimated;
+  s_stats.failures   += delta.failures;
+  portEXIT_CRITICAL(&s_lock);
+}
+
+/**
+ * @brief Routes every sample received from the event bus, and writes out the
+ *        columnar blocks of topics that went quiet.
+ *
+ * The columnar blocks belong to this task, so the age check runs here too,
+ * waking at least every `telemetry_stale_check_ms`.
+ */
+static void priv_telemetry_task(void *param)
+{
+  event_bus_msg_t *msg;
+  int64_t          last_check_us = esp_timer_get_time();
+
+  while (1) {
+    if (xQueueReceive(s_telemetry_queue, &msg, pdMS_TO_TICKS(telemetry_stale_check_ms)) == pdTRUE) {
+      priv_telemetry_route(msg);
+      event_bus_release(msg);
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    if (now_us - last_check_us >= telemetry_stale_check_ms * 1000LL) {
+      columnar_manager_flush_stale(now_us);
+      last_check_us = now_us;
+    }
+  }
+}
+
+/* Public Functions ***********************************************************/
+
+esp_err_t telemetry_manager_init(void)
+{
+  for (size_t i = 0; i < telemetry_route_count; i++) {
+    const telemetry_route_t *route = &telemetry_routes[i];
+    if (route->topic >= k_event_bus_topic_count || route->sink >= k_telemetry_sink_count ||
+        route->format >= k_telemetry_format_count || route->decimation == 0 ||
+        (telemetry_sinks[route->sink].formats & telemetry_format_bit(route->format)) == 0) {
+      ESP_LOGE(telemetry_tag, "Invalid route %u (%s -> %s)", (unsigned)i,
+               event_bus_topic_name(route->topic),
+               route->sink < k_telemetry_sink_count ? telemetry_sinks[route->sink].name : "?");
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+
+  for (uint8_t i = 0; i < k_event_bus_topic_count; i++) {
+    if (report_filter_init(&s_filters[i], telemetry_policies[i].channels,
+                           telemetry_policies[i].channel_count,
+                           telemetry_policies[i].max_silence_ms) != ESP_OK) {
+      ESP_LOGE(telemetry_tag, "Invalid reporting policy for %s", event_bus_topic_name(i));
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+
+  s_telemetry_queue = priv_rtos_queue_create(telemetry_queue_length, event_bus_queue_item_size,
+                                             rtos_storage_ref(s_telemetry_queue_storage));
+  if (s_telemetry_queue == NULL) {
+    ESP_LOGE(telemetry_tag, "Failed to create telemetry queue");
+    return ESP_FAIL;
+  }
+
+  if (event_bus_subscribe(event_bus_all_topics, s_telemetry_queue) != ESP_OK) {
+    ESP_LOGE(telemetry_tag, "Failed to subscribe to the event bus");
+    return ESP_FAIL;
+  }
+
+  if (priv_rtos_task_create(priv_telemetry_task, "telemetry", telemetry_task_stack_bytes,
+                            NULL, 4, NULL, 0,
+                            rtos_storage_ref(s_telemetry_task_storage)) != ESP_OK) {
+    ESP_LOGE(telemetry_tag, "Failed to create telemetry task");
+    return ESP_FAIL;
+  }
+
+  ESP_LOGI(telemetry_tag, "Telemetry router started with %u routes",
+           (unsigned)telemetry_route_count);
+  return ESP_OK;
+}
+
+const sensor_schema_t *telemetry_manager_schema(event_bus_topic_t topic)
+{
+  switch (topic) {
+    case k_event_bus_topic_bh1750:     return &bh1750_schema;
+    case k_event_bus_topic_qmc5883l:   return &qmc5883l_schema;
+    case k_event_bus_topic_mpu6050:    return &mpu6050_schema;
+    case k_event_bus_topic_dht22:      return &dht22_schema;
+    case k_event_bus_topic_gy_neo6mv2: return &gy_neo6mv2_schema;
+    case k_event_bus_topic_ccs811:     return &ccs811_schema;
+    case k_event_bus_topic_mq135:      return &mq135_schema;
+    case k_event_bus_topic_snapshot:   return &snapshot_schema;
+    default:                           return NULL;
+  }
+}
+
+void telemetry_buffer_retain(telemetry_buffer_t *buffer)
+{
+  portENTER_CRITICAL(&s_lock);
+  buffer->refs++;
+  portEXIT_CRITICAL(&s_lock);
+}
+
+void telemetry_buffer_release(telemetry_buffer_t *buffer)
+{
+  if (buffer == NULL) {
+    return;
+  }
+
+  portENTER_CRITICAL(&s_lock);
+  bool last = (--buffer->refs == 0);
+  portEXIT_CRITICAL(&s_lock);
+
+  if (last) {
+    free(buffer->data);
+    free(buffer);
+  }
+}
+
+telemetry_buffer_t *telemetry_manager_live_acquire(event_bus_topic_t topic)
+{
+  if (topic >= k_event_bus_topic_count) {
+    return NULL;
+  }
+
+  portENTER_CRITICAL(&s_lock);
+  telemetry_buffer_t *buffer = s_live[topic];
+  if (buffer != NULL) {
+    buffer->refs++;
+  }
+  portEXIT_CRITICAL(&s_lock);
+
+  return buffer;
+}
+
+void telemetry_manager_get_stats(telemetry_stats_t *stats)
+{
+  portENTER_CRITICAL(&s_lock);
+  *stats = s_stats;
+  portEXIT_CRITICAL(&s_lock);
+}
+
+char *telemetry_manager_stats_to_json(void)
+{
+  telemetry_stats_t stats;
+  telemetry_manager_get_stats(&stats);
+
+  cJSON *root = cJSON_CreateObject();
+  if (root == NULL) {
+    return NULL;
+  }
+
+  cJSON_AddNumberToObject(root, "samples", stats.samples);
+  cJSON_AddNumberToObject(root, "suppressed", stats.suppressed);
+  cJSON_AddNumberToObject(root, "encodes", stats.encodes);
+  cJSON_AddNumberToObject(root, "deliveries", stats.deliveries);
+  cJSON_AddNumberToObject(root, "decimated", stats.decimated);
+  cJSON_AddNumberToObject(root, "failures", stats.failures);
+
+  cJSON *topics = cJSON_AddObjectToObject(root, "topics");
+  for (uint8_t i = 0; i < k_event_bus_topic_count && topics != NULL; i++) {
+    cJSON *topic = cJSON_AddObjectToObject(topics, event_bus_topic_name(i));
+    if (topic == NULL) {
+      break;
+    }
+    /* Written by the router task only; a torn read just lags by a sample */
+    cJSON_AddNumberToObject(topic, "reported", s_filters[i].reported);
+    cJSON_AddNumberToObject(topic, "suppressed", s_filters[i].suppressed);
+  }
+
+  char *json_string = cJSON_PrintUnformatted(root);
+  cJSON_Delete(root);
+  return json_string;
+}
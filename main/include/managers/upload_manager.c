@@ -0,0 +1,452 @@
+/* main/include/managers/upload_manager.c */
+
+#include "upload_manager.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_crt_bundle.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+#include "common/rtos_alloc.h"
+#include "common/arena.h"
+#include "common/trace.h"
+#include "common/metrics.h"
+#include "file_write_manager.h"
+
+/* Macros *********************************************************************/
+
+#define upload_queue_length      (8)
+#define upload_task_stack_bytes  (6144)
+#define upload_task_priority     (2)     /* Below the sinks, above retention */
+#define upload_task_core_id      (0)     /* Processing core */
+#define upload_max_attempts      (5)     /* Attempts per file before it is dropped, not counting waits for the writer */
+#define upload_retry_base_ms     (10000) /* First retry delay, doubled per attempt */
+#define upload_settle_s          (10)    /* Unmodified age before a file is read, past the writer's idle close */
+#define upload_timeout_ms        (15000)
+#define upload_max_url_length    (256)
+#define upload_chunk_head_bytes  (8)     /* Room for "<hex size>\r\n" before each chunk */
+#define upload_chunk_tail_bytes  (2)     /* "\r\n" after each chunk */
+
+/* Structs ********************************************************************/
+
+/**
+ * @brief Response headers of interest, filled by the client event handler.
+ */
+typedef struct {
+  int64_t offset; /**< `Upload-Offset` of the response, -1 if absent */
+} upload_response_t;
+
+/* Globals (Constants) ********************************************************/
+
+const char *upload_tag = "UPLOAD";
+
+#if CONFIG_TOPOROBO_UPLOAD
+
+/**
+ * @brief Bucket bounds of the upload duration metric (s), retries included.
+ */
+static const float upload_duration_bounds[] = { 1, 2, 5, 10, 30, 60, 120, 300, 600 };
+
+/* Globals (Static) ***********************************************************/
+
+static QueueHandle_t  s_upload_queue = NULL;
+static upload_stats_t s_stats        = { 0 };
+static portMUX_TYPE   s_lock         = portMUX_INITIALIZER_UNLOCKED;
+
+static metrics_counter_t   s_bytes_metric;
+static metrics_histogram_t s_duration_metric;
+
+/* Upload task only, emptied after each attempt: the URL and one chunk with
+ * its framing, never the whole file */
+arena_define(s_upload_arena, "upload",
+             upload_max_url_length + upload_chunk_head_bytes + CONFIG_TOPOROBO_UPLOAD_CHUNK_BYTES +
+             upload_chunk_tail_bytes + 8);
+
+rtos_queue_storage_define(s_upload_queue_storage, upload_queue_length, max_file_path_length);
+rtos_task_storage_define(s_upload_task_storage, upload_task_stack_bytes);
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Adds `delta` to the counter at `counter` under the stats lock.
+ */
+static void priv_upload_count(uint32_t *counter, uint32_t delta)
+{
+  portENTER_CRITICAL(&s_lock);
+  *counter += delta;
+  portEXIT_CRITICAL(&s_lock);
+}
+
+/**
+ * @brief Tells whether the station interface has an IP address.
+ */
+static bool priv_upload_network_ready(void)
+{
+  esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+  if (netif == NULL) {
+    return false;
+  }
+
+  esp_netif_ip_info_t ip_info;
+  return esp_netif_get_ip_info(netif, &ip_info) == ESP_OK && ip_info.ip.addr != 0;
+}
+
+/**
+ * @brief Records the `Upload-Offset` response header.
+ *
+ * `esp_http_client_get_header` only reads request headers, so response
+ * headers are picked up here while `esp_http_client_fetch_headers` parses them.
+ */
+static esp_err_t priv_upload_event_handler(esp_http_client_event_t *event)
+{
+  upload_response_t *response = event->user_data;
+
+  if (event->event_id == HTTP_EVENT_ON_HEADER && response != NULL &&
+      strcasecmp(event->header_key, "Upload-Offset") == 0) {
+    response->offset = strtoll(event->header_value, NULL, 10);
+  }
+  return ESP_OK;
+}
+
+/**
+ * @brief Creates a client for `url` with the given method.
+ */
+static esp_http_client_handle_t priv_upload_client(const char *url, esp_http_client_method_t method,
+                                                   upload_response_t *response)
+{
+  esp_http_client_config_t config = {
+    .url               = url,
+    .method            = method,
+    .timeout_ms        = upload_timeout_ms,
+    .event_handler     = priv_upload_event_handler,
+    .user_data         = response,
+    .crt_bundle_attach = esp_crt_bundle_attach, /* Verifies HTTPS upload servers */
+  };
+  return esp_http_client_init(&config);
+}
+
+/**
+ * @brief Asks the server how many bytes of the file it holds.
+ *
+ * @return The acknowledged offset, 0 if the server has no such file, or -1 on error.
+ */
+static int64_t priv_upload_query_offset(const char *url)
+{
+  upload_response_t        response = { .offset = -1 };
+  esp_http_client_handle_t client   = priv_upload_client(url, HTTP_METHOD_HEAD, &response);
+  int64_t                  offset   = -1;
+  int                      status   = 0;
+
+  if (client == NULL) {
+    ESP_LOGE(upload_tag, "Failed to initialize HTTP client");
+    return -1;
+  }
+
+  trace_begin(k_trace_category_http, "upload head", 0);
+  if (esp_http_client_open(client, 0) == ESP_OK && esp_http_client_fetch_headers(client) >= 0) {
+    status = esp_http_client_get_status_code(client);
+    if (status == 404) {
+      offset = 0;
+    } else if (status / 100 == 2 && response.offset >= 0) {
+      offset = response.offset;
+    } else {
+      ESP_LOGW(upload_tag, "Offset query of %s returned %d", url, status);
+    }
+  }
+  trace_end(k_trace_category_http, "upload head", (uint16_t)status);
+
+  esp_http_client_close(client);
+  esp_http_client_cleanup(client);
+  return offset;
+}
+
+/**
+ * @brief Streams `file` from `offset` to its end as one chunked PATCH.
+ *
+ * @return The offset the server acknowledged afterwards, or -1 on error.
+ */
+static int64_t priv_upload_send(const char *url, FILE *file, int64_t offset, int64_t size)
+{
+  upload_response_t        response = { .offset = -1 };
+  esp_http_client_handle_t client   = priv_upload_client(url, HTTP_METHOD_PATCH, &response);
+  int64_t                  acked    = -1;
+  int                      status   = 0;
+  char                     value[24];
+
+  if (client == NULL) {
+    ESP_LOGE(upload_tag, "Failed to initialize HTTP client");
+    return -1;
+  }
+
+  esp_http_client_set_header(client, "Content-Type", "application/octet-stream");
+  snprintf(value, sizeof(value), "%lld", (long long)offset);
+  esp_http_client_set_header(client, "Upload-Offset", value);
+  snprintf(value, sizeof(value), "%lld", (long long)size);
+  esp_http_client_set_header(client, "Upload-Length", value);
+
+  /* A negative length sends Transfer-Encoding: chunked, the framing is ours */
+  trace_begin(k_trace_category_http, "upload patch", 0);
+  if (esp_http_client_open(client, -1) != ESP_OK) {
+    ESP_LOGW(upload_tag, "Failed to connect to %s", url);
+    trace_end(k_trace_category_http, "upload patch", 0);
+    esp_http_client_cleanup(client);
+    return -1;
+  }
+
+  uint8_t *chunk = arena_alloc(&s_upload_arena, upload_chunk_head_bytes +
+                                CONFIG_TOPOROBO_UPLOAD_CHUNK_BYTES + upload_chunk_tail_bytes);
+  bool     ok    = (chunk != NULL) && fseek(file, (long)offset, SEEK_SET) == 0;
+  while (ok && offset < size) {
+    size_t want   = (size - offset < CONFIG_TOPOROBO_UPLOAD_CHUNK_BYTES)
+                      ? (size_t)(size - offset) : CONFIG_TOPOROBO_UPLOAD_CHUNK_BYTES;
+    size_t length = fread(chunk + upload_chunk_head_bytes, 1, want, file);
+    if (length == 0) {
+      ESP_LOGE(upload_tag, "Read failed at offset %lld", (long long)offset);
+      ok = false;
+      break;
+    }
+
+    /* Right-align the size line against the data so the chunk is one write */
+    char head[upload_chunk_head_bytes + 1];
+    int  head_length = snprintf(head, sizeof(head), "%x\r\n", (unsigned)length);
+    uint8_t *start   = chunk + upload_chunk_head_bytes - head_length;
+    memcpy(start, head, head_length);
+    memcpy(chunk + upload_chunk_head_bytes + length, "\r\n", upload_chunk_tail_bytes);
+
+    int total = head_length + (int)length + upload_chunk_tail_bytes;
+    if (esp_http_client_write(client, (const char *)start, total) != total) {
+      ESP_LOGW(upload_tag, "Connection lost at offset %lld", (long long)offset);
+      ok = false;
+      break;
+    }
+
+    offset += length;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.bytes += length;
+    portEXIT_CRITICAL(&s_lock);
+    metrics_counter_add(&s_bytes_metric, length);
+  }
+
+  if (ok && esp_http_client_write(client, "0\r\n\r\n", 5) == 5 &&
+      esp_http_client_fetch_headers(client) >= 0) {
+    status = esp_http_client_get_status_code(client);
+    if (status / 100 == 2 && response.offset >= 0) {
+      acked = response.offset;
+    } else {
+      ESP_LOGW(upload_tag, "Upload to %s returned %d", url, status);
+    }
+  }
+  trace_end(k_trace_category_http, "upload patch", (uint16_t)status);
+
+  esp_http_client_close(client);
+  esp_http_client_cleanup(client);
+  return acked;
+}
+
+/**
+ * @brief Makes one attempt at uploading the rest of `path`.
+ *
+ * @return
+ * - ESP_OK once the server holds the whole file.
+ * - ESP_ERR_INVALID_STATE if the file is still being written; not an attempt.
+ * - ESP_ERR_NOT_FOUND if the file no longer exists.
+ * - ESP_FAIL on a network or server error.
+ */
+static esp_err_t priv_upload_attempt(const char *path)
+{
+  char       *url = arena_alloc(&s_upload_arena, upload_max_url_length);
+  struct stat info;
+
+  if (url == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  if (stat(path, &info) != 0) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  /* A file the writer still appends to keeps growing, and a segment it holds
+   * open is preallocated past its data; wait until it is left alone */
+  if (time(NULL) - info.st_mtime < upload_settle_s) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (!priv_upload_network_ready()) {
+    return ESP_FAIL;
+  }
+
+  const char *name = strrchr(path, '/');
+  name             = (name != NULL) ? name + 1 : path;
+  snprintf(url, upload_max_url_length, "%s/%s", CONFIG_TOPOROBO_UPLOAD_URL, name);
+
+  int64_t offset = priv_upload_query_offset(url);
+  if (offset < 0) {
+    return ESP_FAIL;
+  }
+  if (offset >= info.st_size) {
+    return ESP_OK;
+  }
+  if (offset > 0) {
+    ESP_LOGI(upload_tag, "Resuming %s at %lld of %ld bytes", name, (long long)offset, info.st_size);
+    priv_upload_count(&s_stats.resumed, 1);
+  }
+
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    ESP_LOGE(upload_tag, "Failed to open %s", path);
+    return ESP_ERR_NOT_FOUND;
+  }
+  int64_t acked = priv_upload_send(url, file, offset, info.st_size);
+  fclose(file);
+
+  return (acked == info.st_size) ? ESP_OK : ESP_FAIL;
+}
+
+/**
+ * @brief Uploads queued files one at a time, retrying each with backoff.
+ *
+ * A file still being written does not use up its attempts: it goes to the
+ * back of the queue, one settle period later, so an active log or segment
+ * waits until the writer is done with it without holding up other files.
+ */
+static void priv_upload_task(void *param)
+{
+  char path[max_file_path_length];
+
+  while (1) {
+    if (xQueueReceive(s_upload_queue, path, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+
+    int64_t   start_us = esp_timer_get_time();
+    esp_err_t ret      = ESP_FAIL;
+    for (uint8_t attempt = 0; attempt < upload_max_attempts; attempt++) {
+      if (attempt > 0) {
+        priv_upload_count(&s_stats.retries, 1);
+        vTaskDelay(pdMS_TO_TICKS(upload_retry_base_ms << (attempt - 1)));
+      }
+      arena_begin(&s_upload_arena);
+      ret = priv_upload_attempt(path);
+      arena_end(&s_upload_arena);
+      if (ret == ESP_OK || ret == ESP_ERR_NOT_FOUND || ret == ESP_ERR_INVALID_STATE) {
+        break;
+      }
+    }
+
+    if (ret == ESP_ERR_INVALID_STATE) {
+      vTaskDelay(pdMS_TO_TICKS(upload_settle_s * 1000));
+      if (xQueueSendToBack(s_upload_queue, path, 0) == pdTRUE) {
+        priv_upload_count(&s_stats.deferred, 1);
+        continue;
+      }
+      ESP_LOGW(upload_tag, "Upload queue full, dropped %s", path);
+    }
+
+    if (ret == ESP_OK) {
+      ESP_LOGI(upload_tag, "Uploaded %s", path);
+      priv_upload_count(&s_stats.completed, 1);
+      metrics_histogram_observe(&s_duration_metric, (esp_timer_get_time() - start_us) / 1e6f);
+    } else {
+      ESP_LOGE(upload_tag, "Gave up on %s: %s", path, esp_err_to_name(ret));
+      priv_upload_count(&s_stats.failed, 1);
+    }
+  }
+}
+
+#endif /* CONFIG_TOPOROBO_UPLOAD */
+
+/* Public Functions ***********************************************************/
+
+esp_err_t upload_manager_init(void)
+{
+#if CONFIG_TOPOROBO_UPLOAD
+  s_upload_queue = priv_rtos_queue_create(upload_queue_length, max_file_path_length,
+                                          rtos_storage_ref(s_upload_queue_storage));
+  if (s_upload_queue == NULL) {
+    ESP_LOGE(upload_tag, "Failed to create upload queue");
+    return ESP_FAIL;
+  }
+
+  metrics_counter_register(&s_bytes_metric, "toporobo_upload_bytes_total",
+                           "File bytes sent to the upload server.", NULL);
+  metrics_histogram_register(&s_duration_metric, "toporobo_upload_duration_seconds",
+                             "Time to upload a file, retries included.", NULL,
+                             upload_duration_bounds,
+                             sizeof(upload_duration_bounds) / sizeof(upload_duration_bounds[0]));
+
+  if (priv_rtos_task_create(priv_upload_task, "Upload", upload_task_stack_bytes, NULL,
+                            upload_task_priority, NULL, upload_task_core_id,
+                            rtos_storage_ref(s_upload_task_storage)) != ESP_OK) {
+    ESP_LOGE(upload_tag, "Failed to create upload task");
+    return ESP_FAIL;
+  }
+
+  ESP_LOGI(upload_tag, "Uploading to %s in %d-byte chunks", CONFIG_TOPOROBO_UPLOAD_URL,
+           CONFIG_TOPOROBO_UPLOAD_CHUNK_BYTES);
+#endif
+  return ESP_OK;
+}
+
+esp_err_t upload_manager_enqueue(const char *path)
+{
+#if CONFIG_TOPOROBO_UPLOAD
+  char request[max_file_path_length];
+
+  if (path == NULL || strlen(path) >= sizeof(request)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (s_upload_queue == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  strncpy(request, path, sizeof(request));
+  if (xQueueSend(s_upload_queue, request, 0) != pdTRUE) {
+    ESP_LOGW(upload_tag, "Upload queue full, dropped %s", path);
+    return ESP_FAIL;
+  }
+  priv_upload_count(&s_stats.queued, 1);
+  return ESP_OK;
+#else
+  (void)path;
+  return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void upload_manager_get_stats(upload_stats_t *stats)
+{
+#if CONFIG_TOPOROBO_UPLOAD
+  portENTER_CRITICAL(&s_lock);
+  *stats = s_stats;
+  portEXIT_CRITICAL(&s_lock);
+#else
+  memset(stats, 0, sizeof(*stats));
+#endif
+}
+
+char *upload_manager_stats_to_json(void)
+{
+  upload_stats_t stats;
+  upload_manager_get_stats(&stats);
+
+  cJSON *root = cJSON_CreateObject();
+  if (root == NULL) {
+    return NULL;
+  }
+
+  cJSON_AddNumberToObject(root, "queued", stats.queued);
+  cJSON_AddNumberToObject(root, "completed", stats.completed);
+  cJSON_AddNumberToObject(root, "resumed", stats.resumed);
+  cJSON_AddNumberToObject(root, "retries", stats.retries);
+  cJSON_AddNumberToObject(root, "failed", stats.failed);
+  cJSON_AddNumberToObject(root, "bytes", (double)stats.bytes);
+
+  char *json_string = cJSON_PrintUnformatted(root);
+  cJSON_Delete(root);
+  return json_string;
+}
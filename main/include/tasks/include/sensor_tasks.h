@@ -4,7 +4,9 @@
 #define TOPOROBO_SENSOR_TASKS_H
 
 #include "sensor_hal.h"
+#include <stddef.h>
 #include "esp_err.h"
+#include "common/rtos_alloc.h"
 
 /* Structs ********************************************************************/
 
@@ -12,15 +14,17 @@
  * @brief Structure to hold configuration for each sensor.
  *
  * This structure contains information about each sensor, including its name,
- * initialization and task functions, a pointer to its specific data structure,
- * and an enabled flag to indicate whether the sensor should be active in the system.
+ * initialization and task functions, where its data lives in `sensor_data_t`,
+ * an enabled flag to indicate whether the sensor should be active in the system,
+ * and the storage its task is created from in static allocation mode.
  */
 typedef struct {
-  const char *sensor_name;            /**< Name of the sensor for identification in logs. */
-  esp_err_t (*init_function)(void *); /**< Function pointer to initialize the sensor. */
-  void      (*task_function)(void *); /**< Function pointer to the sensor's data recording task. */
-  void       *data_ptr;               /**< Pointer to the sensor-specific data structure. */
-  bool        enabled;                /**< Flag to indicate if the sensor is enabled (true) or disabled (false). */
+  const char          *sensor_name;            /**< Name of the sensor for identification in logs. */
+  esp_err_t          (*init_function)(void *); /**< Function pointer to initialize the sensor. */
+  void               (*task_function)(void *); /**< Function pointer to the sensor's data recording task. */
+  size_t               data_offset;            /**< Offset of the sensor-specific data inside `sensor_data_t`. */
+  bool                 enabled;                /**< Flag to indicate if the sensor is enabled (true) or disabled (false). */
+  rtos_task_storage_t *task_storage;           /**< Static task storage, NULL unless `CONFIG_TOPOROBO_STATIC_ALLOCATION`. */
 } sensor_config_t;
 
 /* Public Functions ***********************************************************/
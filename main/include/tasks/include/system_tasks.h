@@ -16,14 +16,6 @@
  */
 extern const char *system_tag;
 
-/* Globals ********************************************************************/
-
-/* TODO: Add doc comment */
-extern sensor_data_t g_sensor_data;
-
-/* TODO: Add doc comment */
-extern pca9685_board_t *g_pwm_controller_linked_list;
-
 /* Public Functions ***********************************************************/
 
 /**
@@ -43,10 +35,11 @@ esp_err_t system_tasks_init(void);
  * relay video to the web server, and handle Wi-Fi operations. Tasks are pinned
  * to the appropriate cores based on their functionality.
  *
- * - Wi-Fi handling is pinned to Core 0.
- * - Motor monitoring is pinned to Core 1.
- * - Sensor data collection is pinned to Core 1.
- * - Webserver video relay is pinned to Core 1.
+ * - Sensor acquisition is pinned to Core 1; samples leave it through the
+ *   event bus's lock-free ingress rings.
+ * - Event dispatch, telemetry routing, storage, Wi-Fi and HTTP are pinned to
+ *   Core 0.
+ * - Motor monitoring is not pinned.
  *
  * @return ESP_OK if all tasks start successfully; ESP_FAIL if any task fails.
  */
@@ -3,14 +3,102 @@
 #ifndef TOPOROBO_WEBSERVER_TASKS_H
 #define TOPOROBO_WEBSERVER_TASKS_H
 
+#include <stdint.h>
 #include "esp_err.h"
+#include "telemetry_manager.h"
+#include "common/stream_stats.h"
+
+/* Structs ********************************************************************/
+
+/**
+ * @struct webserver_sink_stats_t
+ * @brief Counters of the web server sink since boot.
+ */
+typedef struct {
+  uint32_t       sent;         /**< Batches sent for the first time */
+  uint32_t       resent;       /**< Batches sent again after no acknowledgement */
+  uint32_t       acked_unsent; /**< Batches acknowledged cumulatively, after their own response was lost */
+  uint32_t       dropped;      /**< Unacknowledged batches pushed out of a full resend window */
+  uint32_t       pending;      /**< Batches in the resend window now */
+  uint32_t       connects;     /**< New connections, each with a full or resumed TLS handshake for HTTPS */
+  uint32_t       warmups;      /**< Pre-connects at link-up */
+  stream_stats_t connect_ms;   /**< Time to connect (TCP plus TLS handshake), ms */
+} webserver_sink_stats_t;
+
+/* Public Functions ***********************************************************/
+
+/**
+ * @brief Starts the task that uploads sensor samples to the web server.
+ *
+ * The task posts the JSON buffers routed to `k_telemetry_sink_http`. It runs
+ * on core 0 with the rest of the network stack, so neither sensor tasks nor
+ * the router block on HTTP.
+ *
+ * Delivery is exactly-once-effective. Each buffer is a batch with a sequence
+ * number, sent with these headers:
+ * - `Upload-Session`: random per boot, scopes the sequence numbers.
+ * - `Upload-Sequence`: 1, 2, 3, ... in the session.
+ * - `Idempotency-Key`: `<session>-<sequence>`, for de-duplicating retries.
+ * - `Upload-Base`: oldest sequence number still in the resend window; earlier
+ *   batches are either held by the server or dropped, never sent again.
+ *
+ * A batch is kept (referenced) in a resend window of 16 until a 2xx response
+ * acknowledges it; batches whose POST timed out are sent again, so the server
+ * must ignore a key it has seen. Every response should also carry
+ * `Upload-Ack: <n>`, the highest sequence number up to which every batch of
+ * the session is held or below `Upload-Base`: the batches it covers leave the window without
+ * a resend, with no extra round trip. When the window is full the oldest
+ * batch is dropped. `tools/upload_server.py` implements the server side.
+ *
+ * All requests share one HTTP client, so the connection is kept between
+ * POSTs. For an HTTPS `webserver_url` the server is verified against the
+ * built-in CA bundle (or `webserver_cert_pem`) and, with `CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS`, a
+ * reconnect resumes the TLS session instead of doing a full handshake. The
+ * task connects as soon as the station gets an IP address, so the first
+ * sample does not wait for the handshake.
+ *
+ * @return ESP_OK if the task was started; ESP_FAIL otherwise.
+ *
+ * @note Call before `telemetry_manager_init`.
+ */
+esp_err_t webserver_tasks_init(void);
+
+/**
+ * @brief Queues a JSON telemetry buffer for upload.
+ *
+ * Takes its own reference to `buffer` and releases it once the upload has
+ * been attempted. Never blocks.
+ *
+ * @param[in] buffer Buffer in `k_telemetry_format_json`.
+ * @return
+ * - ESP_OK if the buffer was queued.
+ * - ESP_ERR_INVALID_ARG if the buffer is not JSON.
+ * - ESP_FAIL if the upload queue is full.
+ */
+esp_err_t webserver_tasks_enqueue(telemetry_buffer_t *buffer);
 
 /**
  * @brief Sends a JSON string to the web server.
  *
+ * A single untracked POST, without sequence headers or retries.
+ *
  * @param json_string Pointer to the JSON string to send.
  * @return esp_err_t ESP_OK if data sent successfully, error code otherwise.
  */
 esp_err_t send_sensor_data_to_webserver(const char *json_string);
 
+/**
+ * @brief Copies the sink counters.
+ *
+ * @param[out] stats Destination for the counters.
+ */
+void webserver_tasks_get_stats(webserver_sink_stats_t *stats);
+
+/**
+ * @brief Serializes the sink counters to a JSON string.
+ *
+ * @return Heap string the caller must free, or NULL on failure.
+ */
+char *webserver_tasks_stats_to_json(void);
+
 #endif /* TOPOROBO_WEBSERVER_TASKS_H */
@@ -5,12 +5,22 @@
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "common/rtos_alloc.h"
+#include "snapshot_manager.h"
 
 /* Constants ******************************************************************/
 
 const uint8_t num_pca9685_boards = 1;
 const char   *motor_tag          = "Motor Tasks";
 
+/* Macros *********************************************************************/
+
+#define motor_testing_task_stack_bytes (2048)
+
+/* Globals (Static) ***********************************************************/
+
+rtos_task_storage_define(s_testing_task_storage, motor_testing_task_stack_bytes);
+
 /* Private Functions **********************************************************/
 
 static void priv_testing(void *arg)
@@ -23,6 +33,7 @@ static void priv_testing(void *arg)
   while (1) {
     for (float f = 0.0f; f <= 180.0; f += 10) {
       pca9685_set_angle(pwm_controller_linked_list, 0xFFFF, 0, f);
+      snapshot_manager_servo_moved();
       ESP_LOGI(motor_tag, "Setting motors to %f", f);
       vTaskDelay(pdMS_TO_TICKS(1000)); /* Delay for 1 second */
     }    
@@ -44,19 +55,21 @@ esp_err_t motors_init(pca9685_board_t **pwm_controller_linked_list)
 
 esp_err_t motor_tasks_start(pca9685_board_t *pwm_controller_linked_list)
 {
-  BaseType_t task_created;
+  esp_err_t ret;
 
   /* Start priv_testing task */
-  task_created = xTaskCreate(
+  ret = priv_rtos_task_create(
     priv_testing,
     "TestingTask",
-    2048,
+    motor_testing_task_stack_bytes,
     (void *)pwm_controller_linked_list,
     5,
-    NULL
+    NULL,
+    tskNO_AFFINITY,
+    rtos_storage_ref(s_testing_task_storage)
   );
 
-  if (task_created != pdPASS) {
+  if (ret != ESP_OK) {
     ESP_LOGE(motor_tag, "Failed to create priv_testing task.");
     return ESP_FAIL;
   }
@@ -4,20 +4,44 @@
 
 #include "sensor_tasks.h"
 #include "system_tasks.h"
+#include "snapshot_manager.h"
 #include "esp_log.h"
 
+/* Macros *********************************************************************/
+
+#define sensor_task_stack_bytes (4096) /* Stack reserved for each sensor task */
+#define sensor_task_core_id     (1)    /* Acquisition core; processing and I/O run on core 0 */
+
 /* Globals (Static) ***********************************************************/
 
+rtos_task_storage_define(s_bh1750_task_storage,     sensor_task_stack_bytes);
+rtos_task_storage_define(s_qmc5883l_task_storage,   sensor_task_stack_bytes);
+rtos_task_storage_define(s_mpu6050_task_storage,    sensor_task_stack_bytes);
+rtos_task_storage_define(s_dht22_task_storage,      sensor_task_stack_bytes);
+rtos_task_storage_define(s_gy_neo6mv2_task_storage, sensor_task_stack_bytes);
+rtos_task_storage_define(s_ccs811_task_storage,     sensor_task_stack_bytes);
+rtos_task_storage_define(s_mq135_task_storage,      sensor_task_stack_bytes);
+
 static sensor_config_t s_sensors[] = {
-  { "BH1750",     bh1750_init,     bh1750_tasks,     &(g_sensor_data.bh1750_data),     false },
-  { "QMC5883L",   qmc5883l_init,   qmc5883l_tasks,   &(g_sensor_data.qmc5883l_data),   false },
-  { "MPU6050",    mpu6050_init,    mpu6050_tasks,    &(g_sensor_data.mpu6050_data),    false },
-  { "DHT22",      dht22_init,      dht22_tasks,      &(g_sensor_data.dht22_data),      false },
-  { "GY-NEO6MV2", gy_neo6mv2_init, gy_neo6mv2_tasks, &(g_sensor_data.gy_neo6mv2_data), false },
-  { "CCS811",     ccs811_init,     ccs811_tasks,     &(g_sensor_data.ccs811_data),     false },
-  { "MQ135",      mq135_init,      mq135_tasks,      &(g_sensor_data.mq135_data),      false },
+  { "BH1750",     bh1750_init,     bh1750_tasks,     offsetof(sensor_data_t, bh1750_data),     false, rtos_storage_ref(s_bh1750_task_storage)     },
+  { "QMC5883L",   qmc5883l_init,   qmc5883l_tasks,   offsetof(sensor_data_t, qmc5883l_data),   false, rtos_storage_ref(s_qmc5883l_task_storage)   },
+  { "MPU6050",    mpu6050_init,    mpu6050_tasks,    offsetof(sensor_data_t, mpu6050_data),    false, rtos_storage_ref(s_mpu6050_task_storage)    },
+  { "DHT22",      dht22_init,      dht22_tasks,      offsetof(sensor_data_t, dht22_data),      false, rtos_storage_ref(s_dht22_task_storage)      },
+  { "GY-NEO6MV2", gy_neo6mv2_init, gy_neo6mv2_tasks, offsetof(sensor_data_t, gy_neo6mv2_data), false, rtos_storage_ref(s_gy_neo6mv2_task_storage) },
+  { "CCS811",     ccs811_init,     ccs811_tasks,     offsetof(sensor_data_t, ccs811_data),     false, rtos_storage_ref(s_ccs811_task_storage)     },
+  { "MQ135",      mq135_init,      mq135_tasks,      offsetof(sensor_data_t, mq135_data),      false, rtos_storage_ref(s_mq135_task_storage)      },
 };
 
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Returns the data struct of sensor `index` inside `sensor_data`.
+ */
+static void *priv_sensor_data_ptr(sensor_data_t *sensor_data, int index)
+{
+  return (uint8_t *)sensor_data + s_sensors[index].data_offset;
+}
+
 /* Public Functions ***********************************************************/
 
 esp_err_t sensors_init(sensor_data_t *sensor_data)
@@ -28,7 +52,7 @@ esp_err_t sensors_init(sensor_data_t *sensor_data)
   for (int i = 0; i < sizeof(s_sensors) / sizeof(sensor_config_t); i++) {
     if (s_sensors[i].enabled) {
       ESP_LOGI(system_tag, "Initializing sensor: %s", s_sensors[i].sensor_name);
-      status = s_sensors[i].init_function(s_sensors[i].data_ptr);
+      status = s_sensors[i].init_function(priv_sensor_data_ptr(sensor_data, i));
 
       if (status == ESP_OK) {
         ESP_LOGI(system_tag, "Sensor %s initialized successfully",
@@ -51,11 +75,14 @@ esp_err_t sensor_tasks(sensor_data_t *sensor_data)
   esp_err_t overall_status = ESP_OK;
 
   for (int i = 0; i < sizeof(s_sensors) / sizeof(sensor_config_t); i++) {
-    if (s_sensors[i].enabled) {
+    if (s_sensors[i].enabled && snapshot_manager_claims(priv_sensor_data_ptr(sensor_data, i))) {
+      ESP_LOGI(system_tag, "Sensor %s is sampled by snapshot mode", s_sensors[i].sensor_name);
+    } else if (s_sensors[i].enabled) {
       ESP_LOGI(system_tag, "Creating task for sensor: %s", s_sensors[i].sensor_name);
-      BaseType_t ret = xTaskCreate(s_sensors[i].task_function, s_sensors[i].sensor_name,
-          4096, s_sensors[i].data_ptr, 5, NULL);
-      if (ret != pdPASS) {
+      esp_err_t ret = priv_rtos_task_create(s_sensors[i].task_function, s_sensors[i].sensor_name,
+          sensor_task_stack_bytes, priv_sensor_data_ptr(sensor_data, i), 5, NULL, sensor_task_core_id,
+          s_sensors[i].task_storage);
+      if (ret != ESP_OK) {
         ESP_LOGE(system_tag, "Task creation failed for sensor: %s",
             s_sensors[i].sensor_name);
         overall_status = ESP_FAIL;
@@ -2,20 +2,38 @@
 
 #include "system_tasks.h"
 #include "esp_log.h"
+#include "common/deferred_log.h"
+#include "common/power.h"
+#include "common/event_bus.h"
+#include "common/arena.h"
+#include "common/mem_policy.h"
 #include "file_write_manager.h"
+#include "sd_card_hal.h"
+#include "http_server_manager.h"
+#include "system_monitor_manager.h"
+#include "snapshot_manager.h"
+#include "telemetry_manager.h"
+#include "aggregation_manager.h"
+#include "retention_manager.h"
+#include "upload_manager.h"
+#include "heap_trace_manager.h"
+#include "metrics_manager.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "nvs_flash.h"
 #include "time_manager.h"
+#include "webserver_tasks.h"
 
 /* Constants ******************************************************************/
 
 const char *system_tag = "Topographic-Robot";
 
-/* Globals ********************************************************************/
+/* Globals (Static) ***********************************************************/
 
-sensor_data_t    g_sensor_data                = {};
-pca9685_board_t *g_pwm_controller_linked_list = {};
+/* Owned here and handed to the sensor and motor tasks at start-up; other
+ * components receive samples through the event bus instead */
+static sensor_data_t    s_sensor_data                = {};
+static pca9685_board_t *s_pwm_controller_linked_list = NULL;
 
 /* Private (Static) Functions *************************************************/
 
@@ -48,19 +66,52 @@ static esp_err_t priv_clear_nvs_flash(void)
 
 esp_err_t system_tasks_init(void)
 {
+  /* Start the deferred log drain task first, hot paths log through it */
+  if (deferred_log_init() != ESP_OK) {
+    ESP_LOGE(system_tag, "Deferred logging initialization failed.");
+    return ESP_FAIL;
+  }
+
+  /* Serve the JSON of tasks in an arena cycle from their arena, before any is built */
+  arena_json_hooks_install();
+
+  /* Count allocation failures per memory class from the start */
+  if (mem_policy_init() != ESP_OK) {
+    ESP_LOGE(system_tag, "Memory policy initialization failed.");
+    return ESP_FAIL;
+  }
+
+  /* Configure DFS and light sleep before any driver takes a PM lock */
+  if (power_init() != ESP_OK) {
+    ESP_LOGE(system_tag, "Power management initialization failed.");
+    return ESP_FAIL;
+  }
+
+  /* Create the message pool before any producer or consumer starts */
+  if (event_bus_init() != ESP_OK) {
+    ESP_LOGE(system_tag, "Event bus initialization failed.");
+    return ESP_FAIL;
+  }
+
   /* Initialize NVS storage */
   if (priv_clear_nvs_flash() != ESP_OK) {
     return ESP_FAIL;
   }
 
   /* Initialize sensor communication */
-  if (sensors_init(&g_sensor_data) != ESP_OK) {
+  if (sensors_init(&s_sensor_data) != ESP_OK) {
     ESP_LOGE(system_tag, "Sensor communication initialization failed.");
     return ESP_FAIL;
   }
   
+  /* Take over the snapshot sensors before their own tasks would start */
+  if (snapshot_manager_init(&s_sensor_data) != ESP_OK) {
+    ESP_LOGE(system_tag, "Snapshot mode initialization failed.");
+    return ESP_FAIL;
+  }
+
   /* Initialize motor controllers */
-  if (motors_init(&g_pwm_controller_linked_list) != ESP_OK) {
+  if (motors_init(&s_pwm_controller_linked_list) != ESP_OK) {
     ESP_LOGE(system_tag, "Motor controller initialization failed.");
     return ESP_FAIL;
   }
@@ -71,32 +122,91 @@ esp_err_t system_tasks_init(void)
     return ESP_FAIL;
   }
   
+  /* Start the sink uploading sensor samples to the web server */
+  if (webserver_tasks_init() != ESP_OK) {
+    ESP_LOGE(system_tag, "Web server sink initialization failed.");
+    return ESP_FAIL;
+  }
+
+  /* Initialize the on-robot HTTP server (diagnostics) */
+  if (http_server_manager_init() != ESP_OK) {
+    ESP_LOGE(system_tag, "HTTP server initialization failed.");
+    return ESP_FAIL;
+  }
+
   /* Initialize time (SNTP) */
   if (time_manager_init() != ESP_OK) {
 		ESP_LOGE(system_tag ,"Time initialization failed.");
 		return ESP_FAIL;
 	}
   
+  /* Mount the SD card; without one the card sinks refuse writes until a retry mounts it */
+  if (sd_card_init() != ESP_OK) {
+    ESP_LOGE(system_tag, "SD card not mounted, card logging is disabled until it is.");
+  }
+
   /* Initialize storage (e.g., SD card or SPIFFS) */
   if (file_write_manager_init() != ESP_OK) {
     ESP_LOGE(system_tag, "Storage initialization failed.");
     return ESP_FAIL;
   }
 
+  /* Route sensor samples to the sinks, now that all of them are running */
+  if (telemetry_manager_init() != ESP_OK) {
+    ESP_LOGE(system_tag, "Telemetry router initialization failed.");
+    return ESP_FAIL;
+  }
+
+  /* Summarize sensor channels over windows, published back through the router */
+  if (aggregation_manager_init() != ESP_OK) {
+    ESP_LOGE(system_tag, "Aggregation initialization failed.");
+    return ESP_FAIL;
+  }
+
+  /* Roll up aging columnar segments on the SD card in the background */
+  if (retention_manager_init() != ESP_OK) {
+    ESP_LOGE(system_tag, "Retention initialization failed.");
+    return ESP_FAIL;
+  }
+
+  /* Stream stored files to the upload server on request */
+  if (upload_manager_init() != ESP_OK) {
+    ESP_LOGE(system_tag, "Upload initialization failed.");
+    return ESP_FAIL;
+  }
+
+  /* Snapshot the metrics registry to the card periodically */
+  if (metrics_manager_init() != ESP_OK) {
+    ESP_LOGE(system_tag, "Metrics snapshot initialization failed.");
+    return ESP_FAIL;
+  }
+
   ESP_LOGI(system_tag, "All system components initialized successfully.");
   return ESP_OK;
 }
 
 esp_err_t system_tasks_start(void)
 {
+  /* Start the system monitor (stack, CPU and heap usage) */
+  if (system_monitor_init() != ESP_OK) {
+    ESP_LOGE(system_tag, "System monitor start failed.");
+    return ESP_FAIL;
+  }
+
+  /* Allocation hot spot tracing, idle until a window is requested */
+  if (heap_trace_manager_init() != ESP_OK) {
+    ESP_LOGE(system_tag, "Heap trace start failed.");
+    return ESP_FAIL;
+  }
+
   /* Start sensor tasks */
-  if (sensor_tasks(&g_sensor_data) != ESP_OK) {
+  if (sensor_tasks(&s_sensor_data) != ESP_OK) {
     ESP_LOGE(system_tag, "Sensor tasks start failed.");
     return ESP_FAIL;
   }
 
   /* Start motor control tasks */
-  if (motor_tasks_start(g_pwm_controller_linked_list) != ESP_OK) {
+  if (motor_tasks_start(s_pwm_controller_linked_list) != ESP_OK) {
     ESP_LOGE(system_tag, "Motor tasks start failed.");
     return ESP_FAIL;
   }
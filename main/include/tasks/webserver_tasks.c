@@ -3,21 +3,213 @@
 #include "webserver_tasks.h"
 #include "webserver_info.h"
 #include "system_tasks.h"
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_crt_bundle.h"
+#include "esp_event.h"
 #include "esp_http_client.h"
 #include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+#include "common/rtos_alloc.h"
+#include "common/trace.h"
 
-/* Public Functions ***********************************************************/
+/* Macros *********************************************************************/
 
-#include "esp_netif.h"
-#include "esp_http_client.h"
-#include "esp_log.h"
+#define webserver_sink_queue_length      (16)
+#define webserver_sink_task_stack_bytes  (4096)
+#define webserver_resend_window          (16)   /* Unacknowledged batches kept for resending */
+#define webserver_resend_interval_ms     (5000) /* Resend period while the window is not empty */
+#define webserver_timeout_ms             (10000)
 
-esp_err_t send_sensor_data_to_webserver(const char *json_string)
+/* Structs ********************************************************************/
+
+/**
+ * @brief A batch sent to the web server and not acknowledged yet.
+ */
+typedef struct {
+  telemetry_buffer_t *buffer;   /**< Batch contents, referenced until acknowledged */
+  uint32_t            sequence; /**< Per-session sequence number, from 1 */
+  bool                acked;    /**< The server confirmed the batch */
+} webserver_batch_t;
+
+/**
+ * @brief Response headers of interest, filled by the client event handler.
+ */
+typedef struct {
+  int64_t ack; /**< `Upload-Ack` of the response, -1 if absent */
+} webserver_response_t;
+
+/* Globals (Static) ***********************************************************/
+
+static QueueHandle_t s_webserver_sink_queue = NULL;
+
+/* Shared by every request and kept between them, so its connection (and TLS
+ * session) is reused; guarded by `s_client_mutex` */
+static esp_http_client_handle_t s_client          = NULL;
+static SemaphoreHandle_t        s_client_mutex    = NULL;
+static int64_t                  s_request_us      = 0;     /* Start of the request in progress */
+static bool                     s_connection_open = false; /* The client holds a connection */
+static bool                     s_connected       = false; /* The request in progress connected anew */
+
+/* Sink task only: resend window, oldest batch at `s_window_head` */
+static webserver_batch_t s_window[webserver_resend_window];
+static uint8_t           s_window_head  = 0;
+static uint8_t           s_window_count = 0;
+static uint32_t          s_session      = 0; /* Random per boot, scopes the sequence numbers */
+static uint32_t          s_sequence     = 0; /* Last sequence number assigned */
+
+static webserver_sink_stats_t s_stats = { 0 };
+static portMUX_TYPE           s_lock  = portMUX_INITIALIZER_UNLOCKED;
+
+rtos_queue_storage_define(s_webserver_sink_queue_storage, webserver_sink_queue_length,
+                          sizeof(telemetry_buffer_t *));
+rtos_task_storage_define(s_webserver_sink_task_storage, webserver_sink_task_stack_bytes);
+rtos_semaphore_storage_define(s_client_mutex_storage);
+
+/* Private Functions **********************************************************/
+
+/**
+ * @brief Adds one to the counter at `counter` under the stats lock.
+ */
+static void priv_webserver_count(uint32_t *counter)
 {
-  if (json_string == NULL) {
-    ESP_LOGE(system_tag, "JSON string is NULL.");
-    return ESP_ERR_INVALID_ARG;
+  portENTER_CRITICAL(&s_lock);
+  (*counter)++;
+  portEXIT_CRITICAL(&s_lock);
+}
+
+/**
+ * @brief Times new connections and records the `Upload-Ack` response header.
+ *
+ * `HTTP_EVENT_ON_CONNECTED` follows the TCP connect and, for HTTPS, the TLS
+ * handshake, so its delay from the start of the request is the handshake cost.
+ */
+static esp_err_t priv_webserver_event_handler(esp_http_client_event_t *event)
+{
+  webserver_response_t *response = event->user_data;
+
+  switch (event->event_id) {
+    case HTTP_EVENT_ON_CONNECTED: {
+      float connect_ms = (float)(esp_timer_get_time() - s_request_us) / 1000.0f;
+      s_connection_open = true;
+      s_connected       = true;
+      portENTER_CRITICAL(&s_lock);
+      s_stats.connects++;
+      stream_stats_add(&s_stats.connect_ms, connect_ms);
+      portEXIT_CRITICAL(&s_lock);
+      break;
+    }
+    case HTTP_EVENT_DISCONNECTED:
+      s_connection_open = false;
+      break;
+    case HTTP_EVENT_ON_HEADER:
+      if (response != NULL && strcasecmp(event->header_key, "Upload-Ack") == 0) {
+        response->ack = strtoll(event->header_value, NULL, 10);
+      }
+      break;
+    default:
+      break;
   }
+  return ESP_OK;
+}
+
+/**
+ * @brief Returns the mutex of the shared client, creating it on first use.
+ *
+ * Created here rather than only by `webserver_tasks_init`, as survey mode
+ * sends through `send_sensor_data_to_webserver` without starting the sink.
+ * The first call comes from `webserver_tasks_init` or from the survey task
+ * alone, so the creation does not race.
+ */
+static SemaphoreHandle_t priv_webserver_client_mutex(void)
+{
+  if (s_client_mutex == NULL) {
+    s_client_mutex = priv_rtos_mutex_create(rtos_storage_ref(s_client_mutex_storage));
+  }
+  return s_client_mutex;
+}
+
+/**
+ * @brief Returns the shared client, creating it on first use.
+ *
+ * HTTPS servers are verified against the built-in CA bundle, or against
+ * `webserver_cert_pem` when webserver_info.h defines it. With
+ * `CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS` the client keeps the TLS session,
+ * so reconnecting resumes it instead of doing a full handshake.
+ */
+static esp_http_client_handle_t priv_webserver_client(void)
+{
+  if (s_client == NULL) {
+    esp_http_client_config_t config = {
+      .url                 = webserver_url,
+      .method              = HTTP_METHOD_POST,
+      .timeout_ms          = webserver_timeout_ms,
+      .event_handler       = priv_webserver_event_handler,
+#ifdef webserver_cert_pem
+      .cert_pem            = webserver_cert_pem,
+#else
+      .crt_bundle_attach   = esp_crt_bundle_attach,
+#endif
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+      .save_client_session = true,
+#endif
+    };
+    s_client = esp_http_client_init(&config);
+  }
+  return s_client;
+}
+
+/**
+ * @brief Performs the request set up on `client`.
+ *
+ * A quick failure on a kept connection is retried once on a new one: the
+ * server closed it while idle, so the request did not get through. A slow
+ * failure (a timeout) is left to the resend window.
+ */
+static esp_err_t priv_webserver_perform(esp_http_client_handle_t client)
+{
+  for (uint8_t attempt = 0; ; attempt++) {
+    bool reused  = s_connection_open;
+    s_request_us = esp_timer_get_time();
+    s_connected  = false;
+
+    esp_err_t err = esp_http_client_perform(client);
+    if (err == ESP_OK) {
+      return ESP_OK;
+    }
+
+    bool quick = esp_timer_get_time() - s_request_us < webserver_timeout_ms * 1000LL / 2;
+    esp_http_client_close(client); /* Start over on a new connection */
+    s_connection_open = false;
+    if (!reused || s_connected || !quick || attempt > 0) {
+      return err;
+    }
+  }
+}
+
+/**
+ * @brief Sends one request to the web server on the shared client.
+ *
+ * @param[in] method HTTP_METHOD_POST, or HTTP_METHOD_HEAD to only connect.
+ * @param[in] data JSON bytes, NULL for none.
+ * @param[in] length Size of `data`.
+ * @param[in] batch Batch to send the sequence headers of, or NULL for none.
+ * @param[out] response Acknowledgement of the server, may be NULL.
+ * @return ESP_OK if the server answered with a 2xx status, an error otherwise.
+ */
+static esp_err_t priv_webserver_request(esp_http_client_method_t method, const char *data,
+                                        size_t length, const webserver_batch_t *batch,
+                                        webserver_response_t *response)
+{
+  static const char *batch_headers[] = {
+    "Upload-Session", "Upload-Sequence", "Idempotency-Key", "Upload-Base",
+  };
 
   /* Check if the network is ready */
   esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
@@ -32,37 +224,307 @@ esp_err_t send_sensor_data_to_webserver(const char *json_string)
     return ESP_FAIL;
   }
 
-  esp_http_client_config_t config = {
-    .url    = webserver_url,
-    .method = HTTP_METHOD_POST,
-  };
+  if (priv_webserver_client_mutex() == NULL) {
+    ESP_LOGE(system_tag, "Failed to create web server client mutex.");
+    return ESP_FAIL;
+  }
+  xSemaphoreTake(s_client_mutex, portMAX_DELAY);
 
-  esp_http_client_handle_t client = esp_http_client_init(&config);
+  esp_http_client_handle_t client = priv_webserver_client();
   if (client == NULL) {
     ESP_LOGE(system_tag, "Failed to initialize HTTP client.");
+    xSemaphoreGive(s_client_mutex);
     return ESP_FAIL;
   }
 
+  esp_http_client_set_method(client, method);
+  esp_http_client_set_user_data(client, response);
   if (esp_http_client_set_header(client, "Content-Type", "application/json") != ESP_OK) {
     ESP_LOGE(system_tag, "Failed to set HTTP header.");
-    esp_http_client_cleanup(client);
+    xSemaphoreGive(s_client_mutex);
     return ESP_FAIL;
   }
 
-  if (esp_http_client_set_post_field(client, json_string, strlen(json_string)) != ESP_OK) {
+  if (batch != NULL) {
+    char value[24];
+    snprintf(value, sizeof(value), "%08" PRIx32, s_session);
+    esp_http_client_set_header(client, batch_headers[0], value);
+    snprintf(value, sizeof(value), "%" PRIu32, batch->sequence);
+    esp_http_client_set_header(client, batch_headers[1], value);
+    snprintf(value, sizeof(value), "%08" PRIx32 "-%" PRIu32, s_session, batch->sequence);
+    esp_http_client_set_header(client, batch_headers[2], value);
+    snprintf(value, sizeof(value), "%" PRIu32, s_window[s_window_head].sequence);
+    esp_http_client_set_header(client, batch_headers[3], value);
+  } else {
+    for (size_t i = 0; i < sizeof(batch_headers) / sizeof(batch_headers[0]); i++) {
+      esp_http_client_delete_header(client, batch_headers[i]);
+    }
+  }
+
+  if (esp_http_client_set_post_field(client, data, (int)length) != ESP_OK) {
     ESP_LOGE(system_tag, "Failed to set HTTP POST field.");
-    esp_http_client_cleanup(client);
+    xSemaphoreGive(s_client_mutex);
     return ESP_FAIL;
   }
 
-  esp_err_t err = esp_http_client_perform(client);
+  const char *traced = (method == HTTP_METHOD_HEAD) ? "http head" : "http post";
+  trace_begin(k_trace_category_http, traced, 0);
+  esp_err_t err = priv_webserver_perform(client);
+  trace_end(k_trace_category_http, traced,
+            (err == ESP_OK) ? (uint16_t)esp_http_client_get_status_code(client) : 0);
+  if (err == ESP_OK && method == HTTP_METHOD_POST &&
+      esp_http_client_get_status_code(client) / 100 != 2) {
+    ESP_LOGW(system_tag, "Web server returned %d.", esp_http_client_get_status_code(client));
+    err = ESP_FAIL;
+  }
+
+  esp_http_client_set_user_data(client, NULL);
+  xSemaphoreGive(s_client_mutex);
+  return err;
+}
+
+/**
+ * @brief Connects to the web server ahead of the first sample.
+ *
+ * Called when the station gets an IP address, so the TCP connection and TLS
+ * handshake are done before data is waiting; the connection is kept for the
+ * next POST.
+ */
+static void priv_webserver_warm_up(void)
+{
+  priv_webserver_count(&s_stats.warmups);
+  if (priv_webserver_request(HTTP_METHOD_HEAD, NULL, 0, NULL, NULL) != ESP_OK) {
+    ESP_LOGW(system_tag, "Web server pre-connect failed.");
+  }
+}
+
+/**
+ * @brief Asks the sink task to pre-connect when the station gets an IP address.
+ */
+static void priv_webserver_ip_handler(void *arg, esp_event_base_t event_base, int32_t event_id,
+                                      void *event_data)
+{
+  telemetry_buffer_t *warm_up = NULL; /* NULL entry: pre-connect request */
+  xQueueSend(s_webserver_sink_queue, &warm_up, 0);
+}
+
+/**
+ * @brief Marks every batch up to the cumulative acknowledgement `ack` as
+ *        acknowledged, then releases the acknowledged batches at the head.
+ */
+static void priv_webserver_window_ack(int64_t ack)
+{
+  for (uint8_t i = 0; i < s_window_count && ack > 0; i++) {
+    webserver_batch_t *batch = &s_window[(s_window_head + i) % webserver_resend_window];
+    if (!batch->acked && batch->sequence <= ack) {
+      batch->acked = true;
+      priv_webserver_count(&s_stats.acked_unsent); /* Its own response was lost */
+    }
+  }
+
+  while (s_window_count > 0 && s_window[s_window_head].acked) {
+    telemetry_buffer_release(s_window[s_window_head].buffer);
+    s_window[s_window_head].buffer = NULL;
+    s_window_head = (s_window_head + 1) % webserver_resend_window;
+    s_window_count--;
+  }
+}
+
+/**
+ * @brief Sends one batch of the window and applies the acknowledgement.
+ *
+ * @return ESP_OK if the server acknowledged the batch.
+ */
+static esp_err_t priv_webserver_window_send(webserver_batch_t *batch)
+{
+  webserver_response_t response = { .ack = -1 };
+
+  esp_err_t err = priv_webserver_request(HTTP_METHOD_POST, (const char *)batch->buffer->data,
+                                         batch->buffer->length, batch, &response);
+  if (err == ESP_OK) {
+    batch->acked = true;
+  }
+  priv_webserver_window_ack(response.ack);
+  return err;
+}
+
+/**
+ * @brief Appends `buffer` to the window under a new sequence number and sends it.
+ *
+ * The newest batch goes first: the cumulative acknowledgement in its
+ * response tells which earlier batches the server already holds, so those
+ * are dropped from the window without being sent again.
+ *
+ * @return ESP_OK if the server acknowledged the batch.
+ */
+static esp_err_t priv_webserver_window_push(telemetry_buffer_t *buffer)
+{
+  if (s_window_count == webserver_resend_window) {
+    /* Window full: the oldest batch is given up */
+    telemetry_buffer_release(s_window[s_window_head].buffer);
+    s_window_head = (s_window_head + 1) % webserver_resend_window;
+    s_window_count--;
+    priv_webserver_count(&s_stats.dropped);
+  }
+
+  uint8_t index   = (s_window_head + s_window_count) % webserver_resend_window;
+  s_window[index] = (webserver_batch_t){ .buffer = buffer, .sequence = ++s_sequence };
+  s_window_count++;
+
+  priv_webserver_count(&s_stats.sent);
+  esp_err_t err = priv_webserver_window_send(&s_window[index]);
+  if (err != ESP_OK) {
+    ESP_LOGW(system_tag, "Batch %" PRIu32 " not acknowledged, kept for resending.", s_sequence);
+  }
+  return err;
+}
+
+/**
+ * @brief Resends the unacknowledged batches, oldest first, until one fails.
+ */
+static void priv_webserver_window_resend(void)
+{
+  while (1) {
+    webserver_batch_t *batch = NULL;
+    for (uint8_t i = 0; i < s_window_count && batch == NULL; i++) {
+      webserver_batch_t *candidate = &s_window[(s_window_head + i) % webserver_resend_window];
+      if (!candidate->acked) {
+        batch = candidate;
+      }
+    }
+    if (batch == NULL) {
+      return;
+    }
+
+    priv_webserver_count(&s_stats.resent);
+    if (priv_webserver_window_send(batch) != ESP_OK) {
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Uploads every buffer routed to the web server.
+ *
+ * Each buffer becomes a batch with a sequence number. The batch stays
+ * referenced in the resend window until the server acknowledges it, so a
+ * timed-out POST is retried instead of lost. The server de-duplicates
+ * retries by their idempotency key.
+ */
+static void priv_webserver_sink_task(void *param)
+{
+  telemetry_buffer_t *buffer;
+
+  s_session = esp_random();
+
+  while (1) {
+    TickType_t wait = (s_window_count > 0) ? pdMS_TO_TICKS(webserver_resend_interval_ms)
+                                           : portMAX_DELAY;
+    if (xQueueReceive(s_webserver_sink_queue, &buffer, wait) == pdTRUE) {
+      if (buffer == NULL) {
+        priv_webserver_warm_up();
+      } else if (priv_webserver_window_push(buffer) != ESP_OK) {
+        continue; /* The server is not answering, do not pile resends onto it */
+      }
+    }
+    priv_webserver_window_resend();
+  }
+}
+
+/* Public Functions ***********************************************************/
+
+esp_err_t webserver_tasks_init(void)
+{
+  if (priv_webserver_client_mutex() == NULL) {
+    ESP_LOGE(system_tag, "Failed to create web server client mutex.");
+    return ESP_FAIL;
+  }
+
+  s_webserver_sink_queue = priv_rtos_queue_create(webserver_sink_queue_length,
+                                                  sizeof(telemetry_buffer_t *),
+                                                  rtos_storage_ref(s_webserver_sink_queue_storage));
+  if (s_webserver_sink_queue == NULL) {
+    ESP_LOGE(system_tag, "Failed to create web server sink queue.");
+    return ESP_FAIL;
+  }
+
+  if (priv_rtos_task_create(priv_webserver_sink_task, "webserver_sink",
+                            webserver_sink_task_stack_bytes, NULL, 4, NULL, 0,
+                            rtos_storage_ref(s_webserver_sink_task_storage)) != ESP_OK) {
+    ESP_LOGE(system_tag, "Failed to create web server sink task.");
+    return ESP_FAIL;
+  }
+
+  if (esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, priv_webserver_ip_handler,
+                                          NULL, NULL) != ESP_OK) {
+    ESP_LOGW(system_tag, "Web server pre-connect at link-up unavailable.");
+  }
+
+  return ESP_OK;
+}
+
+esp_err_t webserver_tasks_enqueue(telemetry_buffer_t *buffer)
+{
+  if (buffer == NULL || buffer->format != k_telemetry_format_json) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  telemetry_buffer_retain(buffer);
+  if (xQueueSend(s_webserver_sink_queue, &buffer, 0) != pdTRUE) {
+    telemetry_buffer_release(buffer);
+    return ESP_FAIL;
+  }
+  return ESP_OK;
+}
+
+esp_err_t send_sensor_data_to_webserver(const char *json_string)
+{
+  if (json_string == NULL) {
+    ESP_LOGE(system_tag, "JSON string is NULL.");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  esp_err_t err = priv_webserver_request(HTTP_METHOD_POST, json_string, strlen(json_string),
+                                         NULL, NULL);
   if (err == ESP_OK) {
     ESP_LOGI(system_tag, "Data sent successfully.");
   } else {
     ESP_LOGE(system_tag, "Failed to send data: %s", esp_err_to_name(err));
   }
-
-  esp_http_client_cleanup(client);
   return err;
 }
 
+void webserver_tasks_get_stats(webserver_sink_stats_t *stats)
+{
+  portENTER_CRITICAL(&s_lock);
+  *stats         = s_stats;
+  stats->pending = s_window_count; /* Written by the sink task only */
+  portEXIT_CRITICAL(&s_lock);
+}
+
+char *webserver_tasks_stats_to_json(void)
+{
+  webserver_sink_stats_t stats;
+  webserver_tasks_get_stats(&stats);
+
+  cJSON *root = cJSON_CreateObject();
+  if (root == NULL) {
+    return NULL;
+  }
+
+  cJSON_AddNumberToObject(root, "sent", stats.sent);
+  cJSON_AddNumberToObject(root, "resent", stats.resent);
+  cJSON_AddNumberToObject(root, "acked_unsent", stats.acked_unsent);
+  cJSON_AddNumberToObject(root, "dropped", stats.dropped);
+  cJSON_AddNumberToObject(root, "pending", stats.pending);
+  cJSON_AddNumberToObject(root, "connects", stats.connects);
+  cJSON_AddNumberToObject(root, "warmups", stats.warmups);
+  if (stats.connect_ms.count > 0) {
+    cJSON_AddNumberToObject(root, "connect_ms_mean", stats.connect_ms.mean);
+    cJSON_AddNumberToObject(root, "connect_ms_max", stats.connect_ms.max);
+  }
+
+  char *json_string = cJSON_PrintUnformatted(root);
+  cJSON_Delete(root);
+  return json_string;
+}
@@ -9,6 +9,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 #include "freertos/timers.h"
+#include "common/rtos_alloc.h"
+#include "common/metrics.h"
 
 /* Constants ******************************************************************/
 
@@ -25,6 +27,11 @@ const uint32_t wifi_connect_timeout_ms = 30000;
  * (flags) that tasks can set, clear, or wait on */
 static EventGroupHandle_t s_wifi_event_group   = NULL;
 static TimerHandle_t      s_wifi_connect_timer = NULL;
+static metrics_counter_t  s_wifi_disconnect_metric;
+static metrics_counter_t  s_wifi_reconnect_metric;
+
+rtos_event_group_storage_define(s_wifi_event_group_storage);
+rtos_timer_storage_define(s_wifi_connect_timer_storage);
 
 /* Private (Static) Functions *************************************************/
 
@@ -52,6 +59,7 @@ static void priv_event_handler(void *arg, esp_event_base_t event_base,
       esp_wifi_connect();
       ESP_LOGI(wifi_tag, "Trying to connect to the AP");
     } else if (event_id == WIFI_EVENT_STA_DISCONNECTED) {
+      metrics_counter_inc(&s_wifi_disconnect_metric);
       if (s_retry_num < wifi_max_retry) {
         esp_wifi_connect();
         s_retry_num++;
@@ -66,6 +74,9 @@ static void priv_event_handler(void *arg, esp_event_base_t event_base,
   if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
     ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
     ESP_LOGI(wifi_tag, "Got IP: " IPSTR, IP2STR(&event->ip_info.ip));
+    if (metrics_counter_value(&s_wifi_disconnect_metric) > 0) {
+      metrics_counter_inc(&s_wifi_reconnect_metric); /* Back after a lost link */
+    }
     s_retry_num = 0;
     xTimerStop(s_wifi_connect_timer, 0); // Stop the timer as connection succeeded
     xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
@@ -76,12 +87,17 @@ esp_err_t wifi_init_sta(void)
 {
   ESP_LOGI(wifi_tag, "Starting WiFi initialization in station mode.");
 
-  s_wifi_event_group = xEventGroupCreate();
+  s_wifi_event_group = priv_rtos_event_group_create(rtos_storage_ref(s_wifi_event_group_storage));
   if (!s_wifi_event_group) {
     ESP_LOGE(wifi_tag, "Failed to create event group.");
     return ESP_ERR_NO_MEM;
   }
 
+  metrics_counter_register(&s_wifi_disconnect_metric, "toporobo_wifi_disconnects_total",
+                           "Station disconnections, failed connection attempts included.", NULL);
+  metrics_counter_register(&s_wifi_reconnect_metric, "toporobo_wifi_reconnects_total",
+                           "IP addresses obtained again after a disconnection.", NULL);
+
   esp_netif_init();
   esp_event_loop_create_default();
   esp_netif_create_default_wifi_sta();
@@ -100,11 +116,12 @@ esp_err_t wifi_init_sta(void)
   esp_wifi_start();
 
   ESP_LOGI(wifi_tag, "Starting connection timeout timer.");
-  s_wifi_connect_timer = xTimerCreate("WiFiConnectTimer",
-                                      pdMS_TO_TICKS(wifi_connect_timeout_ms),
-                                      pdFALSE,
-                                      NULL,
-                                      priv_wifi_connect_timeout_cb);
+  s_wifi_connect_timer = priv_rtos_timer_create("WiFiConnectTimer",
+                                                pdMS_TO_TICKS(wifi_connect_timeout_ms),
+                                                pdFALSE,
+                                                NULL,
+                                                priv_wifi_connect_timeout_cb,
+                                                rtos_storage_ref(s_wifi_connect_timer_storage));
   if (!s_wifi_connect_timer) {
     ESP_LOGE(wifi_tag, "Failed to create connection timeout timer.");
     return ESP_ERR_NO_MEM;
@@ -5,10 +5,17 @@
  *       to write to files on the SD card */
 
 #include "system_tasks.h"
+#include "survey_manager.h"
+#include "sdkconfig.h"
 #include "esp_log.h"
 
 void app_main(void)
 {
+#if CONFIG_TOPOROBO_SURVEY_MODE
+  /* Unattended survey: sample, flush and deep sleep, never returns */
+  survey_manager_run();
+#endif
+
   /* Initialize System-Level Tasks (motor, sensors, webserver, etc) */
   /* One sensor might have failed, but others might still be good,
    * dont exit here */
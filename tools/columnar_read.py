@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+# tools/columnar_read.py
+
+"""Read columnar export files (/sdcard/<sensor>.col) written by columnar_manager.c.
+
+Only the requested columns are read from each block, and blocks whose time
+range lies outside --start/--end are skipped using their header alone.
+Column names come from the sensor schemas in the source tree (see
+tools/telemetry_decode.py). Gorilla-compressed blocks are decoded with
+tools/gorilla.py.
+
+Rollup segments written by retention_manager.c read the same way; their
+columns are the interval start, the sample count and <field>.min/.mean/.max.
+
+timestamp_us is Unix time in microseconds, or microseconds since boot for
+blocks written before the device clock was set.
+
+Usage:
+  python3 tools/columnar_read.py /sdcard/mpu6050.col
+  python3 tools/columnar_read.py /sdcard/dht22-*-1m.col
+  python3 tools/columnar_read.py --columns accel_z --start 1700000000000000 /sdcard/mpu6050.col
+  python3 tools/columnar_read.py --blocks /sdcard/dht22.col
+"""
+
+import argparse
+import csv
+import os
+import struct
+import sys
+
+from gorilla import decode_floats, decode_ints
+from telemetry_decode import REPO_ROOT, load_schemas
+
+# Constants ###################################################################
+
+BLOCK_MAGIC          = 0x4C4F4354  # "TCOL"
+BLOCK_VERSION        = 1
+BLOCK_HEADER_FORMAT  = "<IBBBBIIqq"  # columnar_block_header_t
+BLOCK_HEADER_SIZE    = struct.calcsize(BLOCK_HEADER_FORMAT)
+COLUMN_HEADER_FORMAT = "<BBHIff"     # columnar_column_header_t
+COLUMN_HEADER_SIZE   = struct.calcsize(COLUMN_HEADER_FORMAT)
+TIMESTAMP_FIELD      = 0xFFFF
+COUNT_FIELD          = 0xFFFE  # Rollup sample count
+STAT_NAMES           = ["", ".min", ".mean", ".max"]  # columnar_stat_t, field bits 12..13
+ENCODING_RAW         = 0
+ENCODING_GORILLA     = 1
+
+# sensor_schema_kind_t -> struct code, None for fixed-width strings
+KIND_CODES = {0: "f", 1: "B", 2: "H", 3: "I", 4: "q", 5: None}
+
+# Functions ###################################################################
+
+
+def read_column(f, block_start, column, count, size, encoding):
+  """Read one column of `size` bytes of a block into a list."""
+  kind, width, _, offset, _, _ = column
+  f.seek(block_start + offset)
+  data = f.read(size)
+  code = KIND_CODES.get(kind)
+  if code is None:
+    return [data[i * width:(i + 1) * width].split(b"\0", 1)[0].decode("ascii", "replace")
+            for i in range(count)]
+  if encoding == ENCODING_GORILLA:
+    values = list((decode_floats if code == "f" else decode_ints)(data, count))
+  else:
+    values = struct.unpack(f"<{count}{code}", data[:width * count])
+  return [float(f"{v:.7g}") for v in values] if code == "f" else list(values)
+
+
+def column_name(field, schema_fields):
+  """Name of a column from its header `field`."""
+  if field == TIMESTAMP_FIELD:
+    return "timestamp_us"
+  if field == COUNT_FIELD:
+    return "count"
+  index, stat = field & 0x0FFF, (field >> 12) & 0x3
+  name        = schema_fields[index][0] if index < len(schema_fields) else f"field{index}"
+  return name + STAT_NAMES[stat]
+
+
+def iter_blocks(f):
+  """Yield (block start, header fields, column headers) for every block."""
+  while True:
+    block_start = f.tell()
+    raw         = f.read(BLOCK_HEADER_SIZE)
+    if len(raw) < BLOCK_HEADER_SIZE:
+      return
+    header = struct.unpack(BLOCK_HEADER_FORMAT, raw)
+    magic, version, column_count, block_size = header[0], header[1], header[3], header[6]
+    if magic != BLOCK_MAGIC or version != BLOCK_VERSION:
+      print(f"warning: bad block at offset {block_start}, stopping", file=sys.stderr)
+      return
+    columns = [struct.unpack(COLUMN_HEADER_FORMAT, f.read(COLUMN_HEADER_SIZE))
+               for _ in range(column_count)]
+    yield block_start, header, columns
+    f.seek(block_start + block_size)
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__,
+                                   formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument("--columns", help="comma separated field names (default: all)")
+  parser.add_argument("--start", type=int, help="first timestamp_us to include")
+  parser.add_argument("--end", type=int, help="last timestamp_us to include")
+  parser.add_argument("--blocks", action="store_true",
+                      help="list block headers and column min/max instead of rows")
+  parser.add_argument("--root", default=REPO_ROOT, help="firmware source tree")
+  parser.add_argument("files", nargs="+", help="columnar export files")
+  args = parser.parse_args()
+
+  schemas   = load_schemas(args.root)
+  wanted    = args.columns.split(",") if args.columns else None
+  start     = args.start if args.start is not None else -(1 << 63)
+  end       = args.end if args.end is not None else (1 << 63) - 1
+  writer    = csv.writer(sys.stdout)
+  last_keys = None
+
+  for path in args.files:
+    with open(path, "rb") as f:
+      for block_start, header, columns in iter_blocks(f):
+        _, _, topic, _, encoding, count, block_size, t_min_us, t_max_us = header
+        if t_max_us < start or t_min_us > end:
+          continue  # Skipped without reading any column
+        name, _, schema_fields = schemas.get(topic, (str(topic), None, []))
+        ends = [c[3] for c in columns[1:]] + [block_size]
+        keys = [column_name(c[2], schema_fields) for c in columns]
+
+        if args.blocks:
+          print(f"{os.path.basename(path)} @{block_start}: {name} {count} rows "
+                f"{t_min_us}..{t_max_us} us, {block_size} bytes"
+                f"{' gorilla' if encoding == ENCODING_GORILLA else ''}")
+          for key, column in zip(keys, columns):
+            if column[2] != TIMESTAMP_FIELD and KIND_CODES.get(column[0]) is not None:
+              print(f"  {key}: min {column[4]:.7g} max {column[5]:.7g}")
+          continue
+
+        selected = [i for i, key in enumerate(keys)
+                    if key == "timestamp_us" or wanted is None or key in wanted
+                    or key.split(".")[0] in wanted]
+        values   = {i: read_column(f, block_start, columns[i], count,
+                               ends[i] - columns[i][3], encoding)
+                    for i in selected}
+        if [keys[i] for i in selected] != last_keys:
+          last_keys = [keys[i] for i in selected]
+          writer.writerow(["sensor"] + last_keys)
+        timestamps = values[0]
+        for row in range(count):
+          if start <= timestamps[row] <= end:
+            writer.writerow([name] + [values[i][row] for i in selected])
+
+
+if __name__ == "__main__":
+  main()
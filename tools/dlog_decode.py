@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+# tools/dlog_decode.py
+
+"""Decode a binary deferred log dump written by components/common/deferred_log.c.
+
+Records only hold the address of their call site descriptor and of their tag,
+so the firmware ELF that produced the dump is needed to recover the format
+strings.
+
+Usage:
+  python3 tools/dlog_decode.py build/Topographic-Robot.elf /sdcard/dlog.bin
+
+Requires pyelftools (`pip install pyelftools`, already part of ESP-IDF's
+Python environment).
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+from elftools.elf.elffile import ELFFile
+
+# Constants ###################################################################
+
+FILE_MAGIC       = b"DLOG"
+FILE_HEADER_SIZE = 8
+HEADER_FORMAT    = "<IIQBBH"  # deferred_log_header_t
+HEADER_SIZE      = struct.calcsize(HEADER_FORMAT)
+DESC_FORMAT      = "<IBB8B"   # deferred_log_desc_t (format, level, arg_count, arg_types)
+MAX_ARGS         = 8
+LEVEL_LETTERS    = "NEWIDV"
+
+ARG_I32, ARG_U32, ARG_I64, ARG_U64, ARG_F32, ARG_F64, ARG_STR = range(1, 8)
+
+ARG_STRUCTS = {
+  ARG_I32: "<i",
+  ARG_U32: "<I",
+  ARG_I64: "<q",
+  ARG_U64: "<Q",
+  ARG_F32: "<f",
+  ARG_F64: "<d",
+}
+
+# printf conversion specification, split into the parts Python's % operator
+# understands and the C length modifier it does not.
+SPEC_RE = re.compile(r"%(?P<flags>[-+ #0]*)(?P<width>\d*)(?P<precision>\.\d*)?"
+                     r"(?P<length>hh|h|ll|l|j|z|t|L)?(?P<conv>[diouxXeEfFgGaAcs%])")
+
+# Classes #####################################################################
+
+
+class ElfImage:
+  """Read-only view of the loadable sections of the firmware ELF."""
+
+  def __init__(self, path):
+    self._sections = []
+    with open(path, "rb") as f:
+      elf = ELFFile(f)
+      for section in elf.iter_sections():
+        if section["sh_addr"] == 0 or section["sh_type"] == "SHT_NOBITS":
+          continue
+        self._sections.append((section["sh_addr"], section.data()))
+    self._descs = {}
+
+  def read(self, addr, size):
+    for start, data in self._sections:
+      if start <= addr and addr + size <= start + len(data):
+        return data[addr - start:addr - start + size]
+    raise KeyError(f"address 0x{addr:08x} not found in ELF")
+
+  def read_cstring(self, addr, limit=512):
+    for start, data in self._sections:
+      if start <= addr < start + len(data):
+        offset = addr - start
+        end    = data.find(b"\0", offset, offset + limit)
+        return data[offset:end if end >= 0 else offset + limit].decode("utf-8", "replace")
+    raise KeyError(f"address 0x{addr:08x} not found in ELF")
+
+  def descriptor(self, addr):
+    if addr not in self._descs:
+      fields = struct.unpack(DESC_FORMAT, self.read(addr, struct.calcsize(DESC_FORMAT)))
+      fmt_addr, level, arg_count = fields[0], fields[1], fields[2]
+      self._descs[addr] = (self.read_cstring(fmt_addr), level, list(fields[3:3 + arg_count]))
+    return self._descs[addr]
+
+# Functions ###################################################################
+
+
+def decode_args(arg_types, payload):
+  """Decode the payload into Python values, stopping at a truncated argument."""
+  values = []
+  offset = 0
+  for arg_type in arg_types:
+    if arg_type == ARG_STR:
+      if offset + 1 > len(payload):
+        break
+      length  = payload[offset]
+      offset += 1
+      values.append(payload[offset:offset + length].decode("utf-8", "replace"))
+      offset += length
+      continue
+    fmt  = ARG_STRUCTS.get(arg_type)
+    if fmt is None or offset + struct.calcsize(fmt) > len(payload):
+      break
+    values.append(struct.unpack_from(fmt, payload, offset)[0])
+    offset += struct.calcsize(fmt)
+  return values
+
+
+def format_message(fmt, values):
+  """Apply a C format string to decoded values, like the on-device formatter."""
+  values = iter(values)
+
+  def convert(match):
+    if match.group("conv") == "%":
+      return "%"
+    try:
+      value = next(values)
+    except StopIteration:
+      return "<?>"
+    conv = match.group("conv")
+    if conv in "iu":
+      conv = "d"
+    elif conv == "c" and isinstance(value, int):
+      value = chr(value & 0xFF)
+    spec = "%" + match.group("flags") + match.group("width") + (match.group("precision") or "") + conv
+    try:
+      return spec % value
+    except (TypeError, ValueError):
+      return "<?>"
+
+  return SPEC_RE.sub(convert, fmt)
+
+
+def iter_records(data):
+  """Yield (header fields, payload) for every record, skipping file headers."""
+  offset = 0
+  while offset < len(data):
+    if data[offset:offset + len(FILE_MAGIC)] == FILE_MAGIC:
+      yield None, None  # Boot boundary
+      offset += FILE_HEADER_SIZE
+      continue
+    if offset + HEADER_SIZE > len(data):
+      print(f"warning: {len(data) - offset} trailing bytes ignored", file=sys.stderr)
+      return
+    header   = struct.unpack_from(HEADER_FORMAT, data, offset)
+    offset  += HEADER_SIZE
+    payload  = data[offset:offset + header[3]]
+    offset  += header[3]
+    yield header, payload
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__,
+                                   formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument("elf", help="firmware ELF that wrote the dump")
+  parser.add_argument("dump", help="binary deferred log file")
+  args = parser.parse_args()
+
+  image = ElfImage(args.elf)
+  with open(args.dump, "rb") as f:
+    data = f.read()
+
+  boot = 0
+  for header, payload in iter_records(data):
+    if header is None:
+      boot += 1
+      print(f"--- boot {boot} ---")
+      continue
+    desc_addr, tag_addr, timestamp_us, _, core_id, _ = header
+    try:
+      fmt, level, arg_types = image.descriptor(desc_addr)
+      tag                   = image.read_cstring(tag_addr)
+    except KeyError as err:
+      print(f"? ({timestamp_us // 1000}) <unknown record: {err}>")
+      continue
+    letter  = LEVEL_LETTERS[level] if level < len(LEVEL_LETTERS) else "?"
+    message = format_message(fmt, decode_args(arg_types, payload))
+    print(f"{letter} ({timestamp_us // 1000}) {tag}: {message} [core {core_id}]")
+
+
+if __name__ == "__main__":
+  main()
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+# tools/gorilla.py
+
+"""Streaming decoder for the gorilla streams of components/common/gorilla.c.
+
+Values are yielded one at a time while the bit stream is read, so long
+streams never need to be held decoded in memory. See common/gorilla.h for
+the bit layout.
+
+Usage (as a module):
+  from gorilla import decode_ints, decode_floats
+  timestamps = list(decode_ints(data, count))
+
+Usage (stand-alone, one raw stream):
+  python3 tools/gorilla.py --kind float --count 256 column.bin
+"""
+
+import argparse
+import struct
+import sys
+
+# Constants ###################################################################
+
+# Payload bits of the delta-of-delta buckets, indexed by leading '1' count - 1
+DOD_PAYLOAD_BITS = [7, 9, 12, 20, 64]
+
+# Classes #####################################################################
+
+
+class BitReader:
+  """Reads MSB-first bit fields from bytes."""
+
+  def __init__(self, data):
+    self.data = data
+    self.pos  = 0
+
+  def bits(self, count):
+    value = 0
+    for _ in range(count):
+      byte = self.pos >> 3
+      if byte >= len(self.data):
+        raise EOFError("gorilla stream truncated")
+      value = (value << 1) | ((self.data[byte] >> (7 - (self.pos & 7))) & 1)
+      self.pos += 1
+    return value
+
+  def signed(self, count):
+    value = self.bits(count)
+    return value - (1 << count) if value & (1 << (count - 1)) else value
+
+# Functions ###################################################################
+
+
+def decode_ints(data, count):
+  """Yield `count` values of an integer (delta-of-delta) stream."""
+  reader = BitReader(data)
+  if count == 0:
+    return
+  value = reader.signed(64)
+  delta = 0
+  yield value
+  for _ in range(count - 1):
+    ones = 0
+    while ones < len(DOD_PAYLOAD_BITS) and reader.bits(1):
+      ones += 1
+    dod = reader.signed(DOD_PAYLOAD_BITS[ones - 1]) if ones else 0
+    delta += dod
+    value += delta
+    yield value
+
+
+def decode_floats(data, count):
+  """Yield `count` values of a float (XOR) stream."""
+  reader = BitReader(data)
+  if count == 0:
+    return
+  bits     = reader.bits(32)
+  leading  = 0
+  trailing = 0
+  yield struct.unpack("<f", struct.pack("<I", bits))[0]
+  for _ in range(count - 1):
+    if reader.bits(1):
+      if reader.bits(1):
+        leading    = reader.bits(5)
+        meaningful = reader.bits(5) + 1
+        trailing   = 32 - leading - meaningful
+      bits ^= reader.bits(32 - leading - trailing) << trailing
+    yield struct.unpack("<f", struct.pack("<I", bits))[0]
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__,
+                                   formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument("--kind", choices=["int", "float"], required=True, help="stream kind")
+  parser.add_argument("--count", type=int, required=True, help="values in the stream")
+  parser.add_argument("file", help="raw stream bytes")
+  args = parser.parse_args()
+
+  with open(args.file, "rb") as f:
+    data = f.read()
+  decode = decode_floats if args.kind == "float" else decode_ints
+  try:
+    for value in decode(data, args.count):
+      print(f"{value:.7g}" if args.kind == "float" else value)
+  except EOFError as error:
+    print(f"warning: {error}", file=sys.stderr)
+
+
+if __name__ == "__main__":
+  main()
@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+# tools/telemetry_decode.py
+
+"""Decode binary telemetry records written by the telemetry router to the SD card.
+
+Each record is a telemetry_binary_header_t (topic, reserved, size,
+timestamp_us) followed by the sample packed per its sensor schema. The
+schemas are read from the firmware headers, so the decoder always matches
+the source tree it is run from:
+  components/sensors/include/sensor_schema.h       (sensor schemas)
+  main/include/managers/include/snapshot_manager.h (snapshot schema)
+  components/common/include/common/event_bus.h     (topic numbers)
+
+Usage:
+  python3 tools/telemetry_decode.py /sdcard/bh1750.bin
+  python3 tools/telemetry_decode.py --format csv /sdcard/mpu6050.bin > mpu6050.csv
+"""
+
+import argparse
+import csv
+import json
+import math
+import os
+import re
+import struct
+import sys
+
+# Constants ###################################################################
+
+REPO_ROOT      = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SCHEMA_FILES   = [
+  "components/sensors/include/sensor_schema.h",
+  "main/include/managers/include/snapshot_manager.h",
+]
+EVENT_BUS_FILE = "components/common/include/common/event_bus.h"
+
+HEADER_FORMAT = "<BBHq"  # telemetry_binary_header_t
+HEADER_SIZE   = struct.calcsize(HEADER_FORMAT)
+
+KIND_STRUCTS = {
+  "f32": "<f",
+  "u8":  "<B",
+  "u16": "<H",
+  "u32": "<I",
+  "i64": "<q",
+}
+
+FIELDS_RE = re.compile(r"#define\s+(\w+)_schema_fields\(field\)((?:.*\\\n)*.*)")
+FIELD_RE  = re.compile(r"field\(\s*\w+\s*,\s*[^,]+?,\s*\"([^\"]+)\"\s*,\s*(\w+)\s*\)")
+LIST_RE   = re.compile(r"schema\(\s*(\w+)\s*,\s*\w+\s*,\s*\"([^\"]+)\"\s*\)")
+TOPIC_RE  = re.compile(r"k_event_bus_topic_(\w+)\s*=\s*(\d+)")
+
+# Functions ###################################################################
+
+
+def load_schemas(root):
+  """Return {topic number: (name, sensor_type, [(key, kind), ...])}."""
+  fields       = {}
+  sensor_types = {}
+  for path in SCHEMA_FILES:
+    with open(os.path.join(root, path)) as f:
+      text = f.read()
+    for match in FIELDS_RE.finditer(text):
+      fields[match.group(1)] = FIELD_RE.findall(match.group(2))
+    sensor_types.update(LIST_RE.findall(text))
+
+  with open(os.path.join(root, EVENT_BUS_FILE)) as f:
+    topics = {name: int(number) for name, number in TOPIC_RE.findall(f.read())}
+
+  return {number: (name, sensor_types.get(name, name), fields[name])
+          for name, number in topics.items() if name in fields}
+
+
+def decode_payload(schema_fields, payload):
+  """Unpack one packed record into an ordered dict, None if it is truncated."""
+  values = {}
+  offset = 0
+  for key, kind in schema_fields:
+    if kind == "str":
+      if offset + 1 > len(payload):
+        return None
+      length      = payload[offset]
+      offset     += 1
+      values[key] = payload[offset:offset + length].decode("ascii", "replace")
+      offset     += length
+      continue
+    fmt = KIND_STRUCTS[kind]
+    if offset + struct.calcsize(fmt) > len(payload):
+      return None
+    value = struct.unpack_from(fmt, payload, offset)[0]
+    if kind == "f32":
+      value = float(f"{value:.7g}") if math.isfinite(value) else None
+    values[key] = value
+    offset     += struct.calcsize(fmt)
+  return values
+
+
+def iter_records(data):
+  """Yield (topic, timestamp_us, payload) for every record."""
+  offset = 0
+  while offset + HEADER_SIZE <= len(data):
+    topic, _, size, timestamp_us = struct.unpack_from(HEADER_FORMAT, data, offset)
+    offset += HEADER_SIZE
+    if offset + size > len(data):
+      break
+    yield topic, timestamp_us, data[offset:offset + size]
+    offset += size
+  if offset < len(data):
+    print(f"warning: {len(data) - offset} trailing bytes ignored", file=sys.stderr)
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__,
+                                   formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument("--format", choices=["json", "csv"], default="json",
+                      help="output JSON lines (default) or CSV")
+  parser.add_argument("--root", default=REPO_ROOT, help="firmware source tree")
+  parser.add_argument("files", nargs="+", help="binary telemetry files")
+  args = parser.parse_args()
+
+  schemas    = load_schemas(args.root)
+  writer     = csv.writer(sys.stdout) if args.format == "csv" else None
+  last_topic = None
+
+  for path in args.files:
+    with open(path, "rb") as f:
+      data = f.read()
+    for topic, timestamp_us, payload in iter_records(data):
+      if topic not in schemas:
+        print(f"warning: record for unknown topic {topic} skipped", file=sys.stderr)
+        continue
+      name, sensor_type, schema_fields = schemas[topic]
+      values = decode_payload(schema_fields, payload)
+      if values is None:
+        print(f"warning: truncated {name} record skipped", file=sys.stderr)
+        continue
+
+      if writer is None:
+        print(json.dumps({"sensor_type": sensor_type, "timestamp_us": timestamp_us, **values}))
+        continue
+      if topic != last_topic:
+        writer.writerow(["sensor", "timestamp_us"] + [key for key, _ in schema_fields])
+        last_topic = topic
+      writer.writerow([name, timestamp_us] + ["" if v is None else v for v in values.values()])
+
+
+if __name__ == "__main__":
+  main()
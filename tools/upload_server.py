@@ -0,0 +1,241 @@
+#!/usr/bin/env python3
+# tools/upload_server.py
+
+"""Receiving end of the uploads of upload_manager.c and webserver_tasks.c.
+
+Files are stored as <directory>/<name>. HEAD reports how many bytes of a
+file are held in an Upload-Offset header (404 if none). PATCH appends a
+body, plain or chunked, if its Upload-Offset matches that length (409
+otherwise). Every chunk is written out as soon as it is decoded, so a
+transfer that is cut keeps what arrived and the robot resumes from there.
+
+Telemetry batches POSTed to any other path are appended to
+<directory>/telemetry.jsonl, once per Idempotency-Key: a resent batch is
+acknowledged again but not stored twice. Each response carries
+Upload-Ack, the highest sequence number up to which all batches of the
+Upload-Session are held or below the sender's Upload-Base.
+
+With --cert and --key the server speaks HTTPS and logs, per connection,
+whether the TLS handshake was full or resumed a session, to check the
+robot's session resumption and connection reuse.
+
+Usage:
+  python3 tools/upload_server.py --port 8080 --directory uploads
+  (then set CONFIG_TOPOROBO_UPLOAD_URL to http://<host>:8080/uploads
+   and webserver_url to http://<host>:8080/telemetry)
+
+  openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 -nodes \
+    -days 365 -subj /CN=<host> -addext subjectAltName=IP:<host> \
+    -keyout key.pem -out cert.pem
+  python3 tools/upload_server.py --port 8443 --cert cert.pem --key key.pem
+  (then use https:// URLs and define webserver_cert_pem in webserver_info.h
+   as the contents of cert.pem, which is not in the CA bundle)
+"""
+
+import argparse
+import os
+import ssl
+import sys
+import threading
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+# Constants ###################################################################
+
+URL_PREFIX     = "/uploads/"
+TELEMETRY_FILE = "telemetry.jsonl"
+MAX_CHUNK_SIZE = 1 << 20  # Larger chunk sizes are treated as a broken stream
+
+# Classes #####################################################################
+
+
+class Session:
+  """Sequence numbers received in one Upload-Session."""
+
+  def __init__(self):
+    self.received = set()
+    self.ack      = 0  # All of 1..ack received or skipped
+
+  def receive(self, sequence, base):
+    """Record `sequence`, returning False if it was received before.
+
+    Sequence numbers below `base` will never be sent again, so gaps there
+    do not hold the acknowledgement back.
+    """
+    duplicate = sequence <= self.ack or sequence in self.received
+    if not duplicate:
+      self.received.add(sequence)
+    if base - 1 > self.ack:
+      self.received = {s for s in self.received if s >= base}
+      self.ack      = base - 1
+    while self.ack + 1 in self.received:
+      self.ack += 1
+      self.received.discard(self.ack)
+    return not duplicate
+
+
+class UploadHandler(BaseHTTPRequestHandler):
+  protocol_version = "HTTP/1.1"
+  directory        = "."
+  sessions         = {}
+  lock             = threading.Lock()
+  handshakes       = {"full": 0, "resumed": 0}
+
+  def setup(self):
+    super().setup()
+    if isinstance(self.connection, ssl.SSLSocket):
+      kind = "resumed" if self.connection.session_reused else "full"
+      with self.lock:
+        self.handshakes[kind] += 1
+        counts = dict(self.handshakes)
+      self.log_message("%s %s handshake (full %d, resumed %d)", self.connection.version(), kind,
+                       counts["full"], counts["resumed"])
+
+  def handle(self):
+    try:
+      super().handle()
+    except ConnectionError:
+      pass  # The robot dropped the connection, it resends what was not acknowledged
+
+  def path_of(self):
+    name = self.path[len(URL_PREFIX):] if self.path.startswith(URL_PREFIX) else ""
+    if not name or "/" in name or name.startswith("."):
+      return None
+    return os.path.join(self.directory, name)
+
+  def reply(self, status, offset=None, ack_header=None):
+    self.send_response(status)
+    if offset is not None:
+      self.send_header("Upload-Offset", str(offset))
+    if ack_header is not None:
+      self.send_header("Upload-Ack", str(ack_header))
+    self.send_header("Content-Length", "0")
+    self.end_headers()
+
+  def do_HEAD(self):
+    path = self.path_of()
+    if path is None:
+      self.reply(400)
+    elif not os.path.exists(path):
+      self.reply(404)
+    else:
+      self.reply(200, os.path.getsize(path))
+
+  def do_PATCH(self):
+    path = self.path_of()
+    if path is None:
+      self.close_connection = True  # The body is not read
+      self.reply(400)
+      return
+    held = os.path.getsize(path) if os.path.exists(path) else 0
+    try:
+      offset = int(self.headers.get("Upload-Offset", ""))
+    except ValueError:
+      self.close_connection = True
+      self.reply(400)
+      return
+    if offset != held:
+      self.close_connection = True
+      self.reply(409, held)
+      return
+
+    with open(path, "ab") as f:
+      try:
+        for data in self.body():
+          f.write(data)
+          f.flush()
+      except (ConnectionError, EOFError, ValueError) as error:
+        self.log_message("%s cut at %d bytes: %s", os.path.basename(path), f.tell(), error)
+        self.close_connection = True
+        return
+      held = f.tell()
+
+    length = self.headers.get("Upload-Length")
+    self.log_message("%s holds %d of %s bytes", os.path.basename(path), held, length or "?")
+    self.reply(204, held)
+
+  def do_POST(self):
+    try:
+      data = b"".join(self.body())
+    except (ConnectionError, EOFError, ValueError):
+      self.close_connection = True
+      return
+
+    session_id = self.headers.get("Upload-Session")
+    sequence   = self.headers.get("Upload-Sequence", "")
+    base       = self.headers.get("Upload-Base", "")
+    ack        = None
+    fresh      = True
+    if session_id and sequence.isdigit():
+      with self.lock:
+        session = self.sessions.setdefault(session_id, Session())
+        fresh   = session.receive(int(sequence), int(base) if base.isdigit() else 0)
+        ack     = session.ack
+    if fresh:
+      with self.lock, open(os.path.join(self.directory, TELEMETRY_FILE), "ab") as f:
+        f.write(data.rstrip(b"\n") + b"\n")
+    else:
+      self.log_message("duplicate %s ignored", self.headers.get("Idempotency-Key"))
+    self.reply(200, ack_header=ack)
+
+  def body(self):
+    """Yield the request body piece by piece, decoding chunked transfers."""
+    if self.headers.get("Transfer-Encoding", "").lower() != "chunked":
+      remaining = int(self.headers.get("Content-Length", "0"))
+      while remaining > 0:
+        data = self.rfile.read(min(remaining, 65536))
+        if not data:
+          raise EOFError("body truncated")
+        remaining -= len(data)
+        yield data
+      return
+
+    while True:
+      line = self.rfile.readline()
+      if not line.endswith(b"\r\n"):
+        raise EOFError("chunk size line truncated")
+      size = int(line.split(b";")[0], 16)
+      if size > MAX_CHUNK_SIZE:
+        raise ValueError(f"chunk of {size} bytes")
+      if size == 0:
+        while self.rfile.readline() not in (b"\r\n", b""):  # Trailers
+          pass
+        return
+      data = self.rfile.read(size)
+      if len(data) != size or self.rfile.read(2) != b"\r\n":
+        # Keep the part that arrived, the sender resumes after it
+        if data:
+          yield data
+        raise EOFError("chunk truncated")
+      yield data
+
+# Functions ###################################################################
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__,
+                                   formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument("--port", type=int, default=8080, help="TCP port")
+  parser.add_argument("--directory", default="uploads", help="where files are stored")
+  parser.add_argument("--cert", help="PEM certificate, serves HTTPS with --key")
+  parser.add_argument("--key", help="PEM private key of --cert")
+  args = parser.parse_args()
+
+  os.makedirs(args.directory, exist_ok=True)
+  UploadHandler.directory = args.directory
+  server = ThreadingHTTPServer(("", args.port), UploadHandler)
+  scheme = "http"
+  if args.cert:
+    context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+    context.load_cert_chain(args.cert, args.key)
+    server.socket = context.wrap_socket(server.socket, server_side=True)
+    scheme = "https"
+  print(f"Storing uploads in {args.directory}/, listening on {scheme} port {args.port}",
+        file=sys.stderr)
+  try:
+    server.serve_forever()
+  except KeyboardInterrupt:
+    pass
+
+
+if __name__ == "__main__":
+  main()